@@ -98,6 +98,11 @@ public:
   virtual AmSession* onRefer(const AmSipRequest& req, const string& app_name,
 			     const map<string,string>& app_params);
   virtual int onLoad();
+
+#ifdef USE_MYSQL
+  /** audio files are looked up in MySQL on each call */
+  bool supportsSessionThreadPool() { return false; }
+#endif
 };
 
 /** \brief session logic implementation of conference sessions */
@@ -252,6 +252,15 @@ bool DSMChartReader::importModule(const string& mod_cmd, const string& mod_path)
 	  fname.c_str());
     return false;
   }
+#ifdef SESSION_THREADPOOL
+  if (!mod->supportsSessionThreadPool()) {
+    ERROR("module '%s' blocks in session context and can not be used "
+	  "with the session thread pool (SESSION_THREADPOOL)\n",
+	  fname.c_str());
+    delete mod;
+    return false;
+  }
+#endif
   mods.push_back(mod);
   DBG("loaded module '%s' from '%s'\n", 
       params.c_str(), fname.c_str());
@@ -54,6 +54,10 @@ class DSMModule {
   virtual void onBeforeDestroy(DSMSession* sc_sess, AmSession* sess) { }
   virtual void processSdpOffer(AmSdp& offer) { }
   virtual void processSdpAnswer(const AmSdp& offer, AmSdp& answer) { }
+
+  /** @return false if actions block the session (e.g. on a DB query),
+      which is not allowed with the session thread pool */
+  virtual bool supportsSessionThreadPool() { return true; }
 };
 
 typedef map<string,string> EventParamT;
@@ -42,6 +42,7 @@ using namespace aws;
 
 DECLARE_MODULE_BEGIN(MOD_CLS_NAME);
   int preload();
+  bool supportsSessionThreadPool() { return false; }
 
   static ConnectionPool<S3ConnectionPtr>* s3ConnectionPool;
   static ConnectionPool<SQSConnectionPtr>* sqsConnectionPool;
@@ -39,6 +39,8 @@ class CurlModule
   DSMAction* getAction(const string& from_str);
   DSMCondition* getCondition(const string& from_str);
 
+  bool supportsSessionThreadPool() { return false; }
+
   static bool curl_initialized;
 };
 
@@ -50,6 +50,8 @@ class SCMysqlModule
   
   DSMAction* getAction(const string& from_str);
   DSMCondition* getCondition(const string& from_str);
+
+  bool supportsSessionThreadPool() { return false; }
 };
 
 class DSMMyConnection 
@@ -45,6 +45,8 @@ class SCPyModule
 
   DSMAction* getAction(const string& from_str);
   DSMCondition* getCondition(const string& from_str);
+  bool supportsSessionThreadPool() { return false; }
+
   static PyObject* dsm_module;
   static PyObject* session_module;
   static PyInterpreterState* interp;
@@ -52,6 +52,8 @@ class DSMRedisModule
   
   DSMAction* getAction(const string& from_str);
   DSMCondition* getCondition(const string& from_str);
+
+  bool supportsSessionThreadPool() { return false; }
 };
 
 class DSMRedisConnection
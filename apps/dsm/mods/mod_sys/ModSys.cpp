@@ -30,6 +30,7 @@
 
 #include "DSMSession.h"
 #include "AmSession.h"
+#include "AmAsyncJob.h"
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -47,6 +48,7 @@ MOD_ACTIONEXPORT_BEGIN(MOD_CLS_NAME) {
   DEF_CMD("sys.unlinkArray", SCUnlinkArrayAction);
   DEF_CMD("sys.tmpnam", SCTmpNamAction);
   DEF_CMD("sys.popen", SCPopenAction);
+  DEF_CMD("sys.popenAsync", SCPopenAsyncAction);
 
   DEF_CMD("sys.getTimestamp", SCSysGetTimestampAction);
   DEF_CMD("sys.subTimestamp", SCSysSubTimestampAction);
@@ -259,22 +261,15 @@ EXEC_ACTION_START(SCTmpNamAction) {
   }
 } EXEC_ACTION_END;
 
-CONST_ACTION_2P(SCPopenAction, '=', false);
-EXEC_ACTION_START(SCPopenAction) {
-  string dst_var = par1;
-  if (dst_var.length() && dst_var[0]=='$')
-    dst_var = dst_var.substr(1);
-
-  string cmd = resolveVars(par2, sess, sc_sess, event_params);
-  
-  DBG("executing '%s' while saving output to $%s\n", 
-      cmd.c_str(), dst_var.c_str());
-
+/** run cmd, returns false and sets err on failure */
+static bool sys_popen(const string& cmd, string& res, int& status,
+		      string& err_type, string& err) {
   char buf[100];
-  string res;
   FILE* fp = popen(cmd.c_str(), "r");
   if (fp==NULL) {
-    throw DSMException("sys", "type", "popen", "cause", strerror(errno));
+    err_type = "popen";
+    err = strerror(errno);
+    return false;
   }
 
   size_t rlen;
@@ -290,14 +285,92 @@ EXEC_ACTION_START(SCPopenAction) {
     res += string(buf, rlen);
   }
 
-  sc_sess->var[dst_var] = res;
-  
-  int status = pclose(fp);
+  status = pclose(fp);
   if (status==-1) {
-    throw DSMException("sys", "type", "pclose", "cause", strerror(errno));
+    err_type = "pclose";
+    err = strerror(errno);
+    return false;
   }
-  sc_sess->var[dst_var+".status"] = int2str(status);
   DBG("child process returned status %d\n", status);
+  return true;
+}
+
+CONST_ACTION_2P(SCPopenAction, '=', false);
+EXEC_ACTION_START(SCPopenAction) {
+  string dst_var = par1;
+  if (dst_var.length() && dst_var[0]=='$')
+    dst_var = dst_var.substr(1);
+
+  string cmd = resolveVars(par2, sess, sc_sess, event_params);
+  
+  DBG("executing '%s' while saving output to $%s\n", 
+      cmd.c_str(), dst_var.c_str());
+
+  string res, err_type, err;
+  int status = 0;
+  if (!sys_popen(cmd, res, status, err_type, err)) {
+    if (err_type == "pclose")
+      sc_sess->var[dst_var] = res;
+    throw DSMException("sys", "type", err_type, "cause", err);
+  }
+
+  sc_sess->var[dst_var] = res;
+  sc_sess->var[dst_var+".status"] = int2str(status);
+
+} EXEC_ACTION_END;
+
+/** sys.popenAsync: executes the command in an async job thread */
+class SysPopenJob
+  : public AmAsyncJob
+{
+  string dst_var;
+  string cmd;
+  DSMEvent* ev;
+
+ public:
+  SysPopenJob(const string& session_id, const string& dst_var,
+	      const string& cmd)
+    : AmAsyncJob(session_id), dst_var(dst_var), cmd(cmd),
+      ev(new DSMEvent()) { }
+  ~SysPopenJob() { delete ev; }
+
+  void run() {
+    string res, err_type, err;
+    int status = 0;
+
+    ev->params["type"] = "popen";
+    ev->params["var"] = dst_var;
+    if (!sys_popen(cmd, res, status, err_type, err)) {
+      ev->params["error"] = err_type;
+      ev->params["cause"] = err;
+    }
+    ev->params["result"] = res;
+    ev->params["status"] = int2str(status);
+  }
+
+  AmEvent* getResultEvent() {
+    AmEvent* res = ev;
+    ev = NULL;
+    return res;
+  }
+};
+
+CONST_ACTION_2P(SCPopenAsyncAction, '=', false);
+EXEC_ACTION_START(SCPopenAsyncAction) {
+  string dst_var = par1;
+  if (dst_var.length() && dst_var[0]=='$')
+    dst_var = dst_var.substr(1);
+
+  string cmd = resolveVars(par2, sess, sc_sess, event_params);
+
+  DBG("executing '%s' asynchronously for $%s\n",
+      cmd.c_str(), dst_var.c_str());
+
+  if (AmAsyncJobProcessor::instance()->
+      post(new SysPopenJob(sess->getLocalTag(), dst_var, cmd)) < 0) {
+    throw DSMException("sys", "type", "popen", "cause",
+		       "no async job thread available");
+  }
 
 } EXEC_ACTION_END;
 
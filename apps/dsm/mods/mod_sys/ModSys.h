@@ -30,7 +30,10 @@
 
 #define MOD_CLS_NAME SCSysModule
 
-DECLARE_MODULE(MOD_CLS_NAME);
+DECLARE_MODULE_BEGIN(MOD_CLS_NAME);
+  /** sys.popen waits for the command in session context */
+  bool supportsSessionThreadPool() { return false; }
+DECLARE_MODULE_END;
 
 DEF_SCCondition(FileExistsCondition);
 DEF_ACTION_1P(SCMkDirAction);
@@ -40,6 +43,7 @@ DEF_ACTION_1P(SCUnlinkAction);
 DEF_ACTION_2P(SCUnlinkArrayAction);
 DEF_ACTION_1P(SCTmpNamAction);
 DEF_ACTION_2P(SCPopenAction);
+DEF_ACTION_2P(SCPopenAsyncAction);
 
 DEF_ACTION_1P(SCSysGetTimestampAction);
 DEF_ACTION_2P(SCSysSubTimestampAction);
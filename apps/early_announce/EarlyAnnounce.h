@@ -63,6 +63,11 @@ public:
   int onLoad();
   AmSession* onInvite(const AmSipRequest& req, const string& app_name,
 		      const map<string,string>& app_params);
+
+#ifdef USE_MYSQL
+  /** announcements are looked up in MySQL on each call */
+  bool supportsSessionThreadPool() { return false; }
+#endif
 };
 
 /** \brief session logic implementation for early_announce sessions */
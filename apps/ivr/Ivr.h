@@ -111,6 +111,9 @@ class IvrFactory: public AmSessionFactory
   AmSession* onInvite(const AmSipRequest& req, const string& app_name,
 		      const map<string,string>& app_params);
 
+  /** scripts run with the interpreter lock held in session context */
+  bool supportsSessionThreadPool() { return false; }
+
   void addDeferredThread(PyObject* pyCallable);
 
   void setupSessionTimer(AmSession* s);
@@ -101,6 +101,9 @@ class PySemsFactory: public AmSessionFactory
 
   int onLoad();
   AmSession* onInvite(const AmSipRequest& req);
+
+  /** scripts run with the interpreter lock held in session context */
+  bool supportsSessionThreadPool() { return false; }
 };
 
 /** \brief wrapper for pySems dialog bas class */
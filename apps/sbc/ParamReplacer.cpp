@@ -35,10 +35,35 @@
 #include <algorithm>
 #include <stdlib.h>
 
-int replaceParsedParam(const string& s, size_t p,
-			const AmUriParser& parsed, string& res) {
-  int skip_chars=1;
-  switch (s[p+1]) {
+/* Returns a url-encoded version of str */
+/* IMPORTANT: be sure to free() the returned string after use */
+char *url_encode(const char *str);
+
+/** s[i], or 0 past the end of s */
+static inline char at(const string& s, size_t i)
+{
+  return i < s.length() ? s[i] : '\0';
+}
+
+/** parse a request URI into 'parser' on first use */
+static bool parse_once(AmUriParser& parser, const string& uri,
+		       const char* name)
+{
+  if (parser.uri.empty()) {
+    parser.uri = uri;
+    if (!parser.parse_uri()) {
+      WARN("Error parsing %s '%s'\n", name, uri.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+/** append the URI part selected with $xX to res */
+static void append_uri_part(const AmUriParser& parsed,
+			    const ParamTemplate::Op& op, string& res)
+{
+  switch (op.c) {
   case 'u': { // URI
     res+=parsed.uri_user+"@"+parsed.uri_host;
     if (!parsed.uri_port.empty())
@@ -54,46 +79,34 @@ int replaceParsedParam(const string& s, size_t p,
   case 'p': res+=parsed.uri_port; break; // port
   case 'H': res+=parsed.uri_headers; break; // Headers
   case 'P': { // Params
-    if((s.length() > p+3) && (s[p+2] == '(')) {
-      size_t skip_p = p+3;
-      for (;skip_p<s.length() && s[skip_p] != ')';skip_p++) { }
-      if (skip_p==s.length()) {
-	WARN("Error parsing $%cP() param replacement (unclosed brackets)\n",s[p]);
-	break;
-      }
-      string param_name = s.substr(p+3,skip_p-p-3);
-      if(param_name.empty()) {
-	res+=parsed.uri_param;
-	skip_chars = skip_p-p;
-	break;
-      }
-      
-      const string& uri_params = parsed.uri_param;
-      const char* c = uri_params.c_str();
-      list<sip_avp*> params;
-      if(parse_gen_params(&params,&c,uri_params.length(),0) < 0) {
-	DBG("could not parse URI parameters");
-	free_gen_params(&params);
-	break;
-      }
+    if (op.param_mode == ParamTemplate::AllParams) {
+      res+=parsed.uri_param;
+      break;
+    }
+    if (op.param_mode != ParamTemplate::NamedParam)
+      break;
+
+    const string& uri_params = parsed.uri_param;
+    const char* c = uri_params.c_str();
+    list<sip_avp*> params;
+    if(parse_gen_params(&params,&c,uri_params.length(),0) < 0) {
+      DBG("could not parse URI parameters");
+      free_gen_params(&params);
+      break;
+    }
 
-      string param;
-      for(list<sip_avp*>::iterator it = params.begin(); 
-	  it != params.end(); it++) {
+    string param;
+    for(list<sip_avp*>::iterator it = params.begin(); 
+	it != params.end(); it++) {
 
-	if(lower_cmp_n((*it)->name.s,(*it)->name.len,
-		       param_name.c_str(),param_name.length()))
-	  continue;
+      if(lower_cmp_n((*it)->name.s,(*it)->name.len,
+		     op.arg.c_str(),op.arg.length()))
+	continue;
 
-	param = c2stlstr((*it)->value);
-      }
-      free_gen_params(&params);
-      res+=param;
-      skip_chars = skip_p-p;
-    }
-    else {
-      res+=parsed.uri_param; 
+      param = c2stlstr((*it)->value);
     }
+    free_gen_params(&params);
+    res+=param;
   } break;
   case 'n': res+=parsed.display_name; break; // Params
 
@@ -102,681 +115,831 @@ int replaceParsedParam(const string& s, size_t p,
   //   if (it != parsed.params.end())
   //     res+=it->second;
   // } break;
-  default: WARN("unknown replace pattern $%c%c\n",
-		s[p], s[p+1]); break;
+  default: WARN("unknown URI part replace pattern '%c'\n", op.c); break;
   };
-
-  return skip_chars;
 }
 
-/* Returns a url-decoded version of str */
-/* IMPORTANT: be sure to free() the returned string after use */
-char *url_encode(const char *str);
-
-string replaceParameters(const string& s,
-			 const char* r_type,
-			 const AmSipRequest& req,
-			 const SBCCallProfile* call_profile,
-			 const string& app_param,
-			 AmUriParser& ruri_parser, 
-			 AmUriParser& from_parser,
-			 AmUriParser& to_parser,
-			 bool rebuild_ruri,
-			 bool rebuild_from,
-			 bool rebuild_to) {
-  string res;
-  bool is_replaced = false;
+ParamTemplate::ParamTemplate(const string& s)
+  : pattern(s), is_replaced(false), literal_len(0)
+{
   size_t p = 0;
   bool is_escaped = false;
-  const string& used_hdrs = req.hdrs; //(hdrs == NULL) ? req.hdrs : *hdrs;
 
-  // char last_char=' ';
-  
   while (p<s.length()) {
-    size_t skip_chars = 1;
-
     if (is_escaped) {
       switch (s[p]) {
-      case 'r': res += '\r'; break;
-      case 'n': res += '\n'; break;
-      case 't': res += '\t'; break;
-      default: res += s[p]; break;
+      case 'r': addLiteral('\r'); break;
+      case 'n': addLiteral('\n'); break;
+      case 't': addLiteral('\t'); break;
+      default: addLiteral(s[p]); break;
       }
       is_escaped = false;
-    } else { // not escaped
-      if (s[p]=='\\') {
-	if (p==s.length()-1) {
-	  res += '\\'; // add single \ at the end
-	} else {
-	  is_escaped = true;
-	  is_replaced = true;
-	}
-      } else if ((s[p]=='$') && (s.length() >= p+1)) {
+    } else if (s[p]=='\\') {
+      if (p==s.length()-1) {
+	addLiteral('\\'); // add single \ at the end
+      } else {
+	is_escaped = true;
 	is_replaced = true;
-	p++;
-	switch (s[p]) {
-	case 'f': { // from
-	  if ((s.length() == p+1) || (s[p+1] == '.')) {
-	    if (rebuild_from) {
-	      res += from_parser.nameaddr_str();
-	    } else {
-	      res += req.from;
-	    }
+      }
+    } else if (s[p]=='$') {
+      is_replaced = true;
+      p++;
+      p+=compilePattern(s, p); // skip $.X
+    } else {
+      addLiteral(s[p]);
+    }
 
-	    break;
-	  }
+    p++;
+  }
+}
 
-	  if (s[p+1]=='t') { // $ft - from tag
-	    res += req.from_tag;
-	    break;
-	  }
+ParamTemplate::~ParamTemplate()
+{
+  for (vector<Op>::iterator it = ops.begin(); it != ops.end(); it++)
+    delete it->sub;
+}
 
-	  if (from_parser.uri.empty()) {
-	    from_parser.uri = req.from;
-	    if (!from_parser.parse_uri()) {
-	      WARN("Error parsing From URI '%s'\n", req.from.c_str());
-	      break;
-	    }
-	  }
+void ParamTemplate::addLiteral(char c)
+{
+  if (ops.empty() || ops.back().type != Literal)
+    ops.push_back(Op(Literal));
+  ops.back().arg += c;
+  literal_len++;
+}
 
-	  skip_chars=replaceParsedParam(s, p, from_parser, res);
+ParamTemplate* ParamTemplate::compileSub(const string& s)
+{
+  return new ParamTemplate(s);
+}
 
-	}; break;
+/** URI part $xX at p (p: position of x); @return chars to skip */
+size_t ParamTemplate::compileUriPart(const string& s, size_t p, Op& op)
+{
+  op.c = at(s, p+1);
+  if (op.c != 'P' || (s.length() <= p+3) || (s[p+2] != '('))
+    return 1;
+
+  size_t skip_p = p+3;
+  for (;skip_p<s.length() && s[skip_p] != ')';skip_p++) { }
+  if (skip_p==s.length()) {
+    WARN("Error parsing $%cP() param replacement (unclosed brackets)\n",s[p]);
+    op.param_mode = BadParam;
+    return 1;
+  }
 
-	case 't': { // to
-	  if ((s.length() == p+1) || (s[p+1] == '.')) {
-	    if (rebuild_to) {
-	      res += to_parser.nameaddr_str();
-	    } else {
-	      res += req.to;
-	    }
-	    break;
-	  }
+  op.arg = s.substr(p+3,skip_p-p-3);
+  op.param_mode = op.arg.empty() ? AllParams : NamedParam;
+  return skip_p-p;
+}
 
-	  if (s[p+1]=='t') { // $tt - to tag
-	    res += req.to_tag;
-	    break;
-	  }
+/** $-pattern at p (p: position after '$'); @return chars to skip */
+size_t ParamTemplate::compilePattern(const string& s, size_t p)
+{
+  size_t skip_chars = 1;
+  char c = at(s, p+1);
+  bool whole = (s.length() == p+1) || (c == '.');
+
+  switch (at(s, p)) {
+  case 'f': { // from
+    if (whole) {
+      ops.push_back(Op(From));
+    } else if (c=='t') { // $ft - from tag
+      ops.push_back(Op(FromTag));
+    } else {
+      Op op(FromPart);
+      skip_chars = compileUriPart(s, p, op);
+      ops.push_back(op);
+    }
+  } break;
 
-	  if (to_parser.uri.empty()) {
-	    to_parser.uri = req.to;
-	    if (!to_parser.parse_uri()) {
-	      WARN("Error parsing To URI '%s'\n", req.to.c_str());
-	      break;
-	    }
-	  }
+  case 't': { // to
+    if (whole) {
+      ops.push_back(Op(To));
+    } else if (c=='t') { // $tt - to tag
+      ops.push_back(Op(ToTag));
+    } else {
+      Op op(ToPart);
+      skip_chars = compileUriPart(s, p, op);
+      ops.push_back(op);
+    }
+  } break;
 
-	  skip_chars=replaceParsedParam(s, p, to_parser, res);
+  case 'r': { // r-uri
+    if (whole) {
+      ops.push_back(Op(RUri));
+    } else {
+      Op op(RUriPart);
+      skip_chars = compileUriPart(s, p, op);
+      ops.push_back(op);
+    }
+  } break;
 
-	}; break;
+  case 'c': { // call-id
+    if ((s.length() == p+1) || (c == 'i')) {
+      ops.push_back(Op(CallId));
+      break;
+    }
+    WARN("unknown replacement $c%c\n", c);
+  }; break;
+
+  case 's': { // source (remote)
+    if (c == 'i') { // $si source IP address
+      ops.push_back(Op(SrcIp));
+    } else if (c == 'p') { // $sp source port
+      ops.push_back(Op(SrcPort));
+    } else {
+      WARN("unknown replacement $s%c\n", c);
+    }
+  }; break;
+
+  case 'd': // destination (remote UAS)
+    ops.push_back(Op(Dest, c));
+    break;
+
+  case 'R': { // received (local)
+    switch (c) {
+    case 'i': // $Ri received IP address
+    case 'p': // $Rp received port
+    case 'f': // $Rf received interface id
+    case 'n': // $Rn received interface name
+    case 'I': // $RI received interface public IP
+      ops.push_back(Op(Recv, c));
+      break;
+    default:
+      WARN("unknown replacement $R%c\n", c);
+      break;
+    }
+  }; break;
 
-	case 'r': { // r-uri
-	  if ((s.length() == p+1) || (s[p+1] == '.')) {
-	    if (rebuild_ruri) {
-	      res += ruri_parser.uri_str();
-	    } else {
-	      res += req.r_uri;
-	    }
-	    break;
-	  }
+  case 'u': // Reg-cached destination user
+    ops.push_back(Op(RegDest, c));
+    break;
 
-	  if (ruri_parser.uri.empty()) {
-	    ruri_parser.uri = req.r_uri;
-	    if (!ruri_parser.parse_uri()) {
-	      WARN("Error parsing R-URI '%s'\n", req.r_uri.c_str());
-	      break;
-	    }
-	  }
-	  skip_chars=replaceParsedParam(s, p, ruri_parser, res);
-	}; break;
+  case 'U': { // Reg-cached originating user
+    if (c == 'a') { // $Ua originating AoR
+      ops.push_back(Op(RegOrigAor));
+    } else if (c == 'A') { // $UA originating alias
+      ops.push_back(Op(RegOrigAlias));
+    } else {
+      WARN("unknown replacement $U%c\n", c);
+    }
+  } break;
 
-	case 'c': { // call-id
-	  if ((s.length() == p+1) || (s[p+1] == 'i')) {
-	    res += req.callid;
-	    break;
-	  }
-	  WARN("unknown replacement $c%c\n", s[p+1]);
-	}; break;
+  case 'a': // P-Asserted-Identity
+  case 'p': { // P-Preferred-Identity
+    Op op(HdrUri);
+    op.arg2 = (s[p] == 'a') ?
+      SIP_HDR_P_ASSERTED_IDENTITY : SIP_HDR_P_PREFERRED_IDENTITY;
 
-	case 's': { // source (remote)
-	  if (s.length() < p+1) {
-	    WARN("unknown replacement $s\n");
-	    break;
-	  }
+    if (!whole) {
+      if (c == 'i') {
+	op.type = HdrUriId;
+      } else {
+	op.type = HdrUriPart;
+	skip_chars = compileUriPart(s, p, op);
+      }
+    }
+    ops.push_back(op);
+  }; break;
 
-	  if (s[p+1] == 'i') { // $si source IP address
-	    res += req.remote_ip;
-	    break;
-	  } else if (s[p+1] == 'p') { // $sp source port
-	    res += int2str(req.remote_port);
-	    break;
-	  }
+  case 'P': { // app-params
+    if (c != '(') {
+      WARN("Error parsing P param replacement (missing '(')\n");
+      break;
+    }
+    if (s.length()<p+3) {
+      WARN("Error parsing P param replacement (short string)\n");
+      break;
+    }
 
-	  WARN("unknown replacement $s%c\n", s[p+1]);
-	}; break;
+    size_t skip_p = p+2;
+    for (;skip_p<s.length() && s[skip_p] != ')';skip_p++) { }
+    if (skip_p==s.length()) {
+      WARN("Error parsing P param replacement (unclosed brackets)\n");
+      break;
+    }
 
-	case 'd': { // destination (remote UAS)
-	  if (s.length() < p+1) {
-	    WARN("unknown replacement $s\n");
-	    break;
-	  }
+    Op op(AppParam);
+    op.arg = s.substr(p+2, skip_p-p-2);
+    ops.push_back(op);
+    skip_chars = skip_p-p;
+  } break;
 
-	  if(!call_profile->next_hop.empty()) {
-	    cstring _next_hop = stl2cstr(call_profile->next_hop);
-	    list<sip_destination> dest_list;
-	    if(parse_next_hop(_next_hop,dest_list)) {
-	      WARN("parse_next_hop %.*s failed\n",
-		   _next_hop.len, _next_hop.s);
-	      break;
-	    }
+  case 'V': { // variable
+    if (c != '(') {
+      WARN("Error parsing V variable replacement (missing '(')\n");
+      break;
+    }
+    if (s.length()<p+3) {
+      WARN("Error parsing V param replacement (short string)\n");
+      break;
+    }
 
-	    if(dest_list.size() == 0) {
-	      WARN("next-hop is not empty, but the resulting destination list is\n");
-	      break;
-	    }
+    size_t skip_p = p+2;
+    for (;skip_p<s.length() && s[skip_p] != ')';skip_p++) { }
+    if (skip_p==s.length()) {
+      WARN("Error parsing V param replacement (unclosed brackets)\n");
+      break;
+    }
 
-	    const sip_destination& dest = dest_list.front();
-	    if (s[p+1] == 'i') { // $di remote UAS IP address
-	      res += c2stlstr(dest.host);
-	      break;
-	    } else if (s[p+1] == 'p') { // $dp remote UAS port
-	      res += int2str(dest.port);
-	      break;
-	    }
-	    WARN("unknown replacement $d%c\n", s[p+1]);
-	    break;
-	  }
+    Op op(Var);
+    op.arg = s.substr(p+2, skip_p-p-2);
+    size_t dotpos = op.arg.find('.');
+    if (dotpos != string::npos) {
+      op.arg2 = op.arg.substr(dotpos+1);
+      op.arg = op.arg.substr(0, dotpos);
+      // recursive replacement for call variable name (defined via GUI)
+      if (op.arg2.find('$') != string::npos)
+	op.sub = compileSub(op.arg2);
+    }
+    ops.push_back(op);
+    skip_chars = skip_p-p;
+  } break;
 
-	  if (ruri_parser.uri.empty()) {
-	    ruri_parser.uri = req.r_uri;
-	    if (!ruri_parser.parse_uri()) {
-	      WARN("Error parsing R-URI '%s'\n", req.r_uri.c_str());
-	      break;
-	    }
-	  }
+  case 'H': { // header
+    size_t name_offset = 2;
+    if (c != '(') {
+      if (at(s, p+2) != '(') {
+	WARN("Error parsing H header replacement (missing '(')\n");
+	break;
+      }
+      name_offset = 3;
+    }
+    if (s.length()<name_offset+1) {
+      WARN("Error parsing H header replacement (short string)\n");
+      break;
+    }
 
-	  if (s[p+1] == 'i') { // $di remote UAS IP address
-	    res += ruri_parser.uri_host;
-	    break;
-	  } else if (s[p+1] == 'p') { // $dp remote UAS port
-	    res += ruri_parser.uri_port;
-	    break;
-	  }
+    size_t skip_p = p+name_offset;
+    for (;skip_p<s.length() && s[skip_p] != ')';skip_p++) { }
+    if (skip_p==s.length()) {
+      WARN("Error parsing H header replacement (unclosed brackets)\n");
+      break;
+    }
 
-	  WARN("unknown replacement $d%c\n", s[p+1]);
-	}; break;
+    if (name_offset == 2) {
+      // full header
+      Op op(Header);
+      op.arg2 = s.substr(p+name_offset, skip_p-p-name_offset);
+      ops.push_back(op);
+    } else {
+      // parse URI and use component
+      Op op(HeaderPart);
+      op.arg2 = s.substr(p+name_offset, skip_p-p-name_offset);
+      //TODO: find out how to correct skip_chars correctly
+      compileUriPart(s, p, op);
+      ops.push_back(op);
+    }
+    skip_chars = skip_p-p;
+  } break;
 
-	case 'R': { // received (local)
-	  if (s.length() < p+1) {
-	    WARN("unknown replacement $R\n");
-	    break;
-	  }
+  case 'M': { // regex map
+    if (c != '(') {
+      WARN("Error parsing $M regex map replacement (missing '(')\n");
+      break;
+    }
+    if (s.length()<p+3) {
+      WARN("Error parsing $M regex map replacement (short string)\n");
+      break;
+    }
 
-	  if (s[p+1] == 'i') { // $Ri received IP address
-	    res += req.local_ip.c_str();
-	    break;
-	  } else if (s[p+1] == 'p') { // $Rp received port
-	    res += int2str(req.local_port);
-	    break;
-	  } else if (s[p+1] == 'f') { // $Rf received interface id
-	    res += int2str(req.local_if);
-	    break;
-	  } else if (s[p+1] == 'n') { // $Rn received interface name
-	    if (req.local_if < AmConfig::SIP_Ifs.size()) {
-	      res += AmConfig::SIP_Ifs[req.local_if].name;
-	    }
-	    break;
-	  } else if (s[p+1] == 'I') { // $RI received interface public IP
-	    if (req.local_if < AmConfig::SIP_Ifs.size()) {
-	      res += AmConfig::SIP_Ifs[req.local_if].PublicIP;
-	    }
-	    break;
-	  }
-	  WARN("unknown replacement $R%c\n", s[p+1]);
-	}; break;
+    size_t skip_p = skip_to_end_of_brackets(s, p+2);
+    if (skip_p==s.length()) {
+      WARN("Error parsing $M regex map replacement (unclosed brackets)\n");
+      skip_chars = skip_p-p;
+      break;
+    }
 
-	case 'u': {// Reg-cached destination user
-	  if (s.length() < p+1) {
-	    WARN("unknown replacement $u\n");
-	    break;
-	  }
+    string map_str = s.substr(p+2, skip_p-p-2);
+    size_t spos = map_str.rfind("=>");
+    if (spos == string::npos) {
+      skip_chars = skip_p-p;
+      WARN("Error parsing $M regex map replacement: no => found in '%s'\n",
+	   map_str.c_str());
+      break;
+    }
 
-	  // REG-Cache lookup
-	  AliasEntry alias_entry;
-	  const string& alias = req.user;
+    Op op(RegexMap);
+    op.arg = map_str.substr(0, spos);
+    op.arg2 = map_str.substr(spos+2);
+    op.sub = compileSub(op.arg);
+    ops.push_back(op);
+    skip_chars = skip_p-p;
+  } break;
 
-	  if(!RegisterCache::instance()->findAliasEntry(alias, alias_entry)) {
-	    WARN("reg-cache: User '%s' not found",alias.c_str());
-	    break;
-	  }
-	  
-	  if(s[p+1] == 'c') {
-	    res += alias_entry.contact_uri;
-	    break;
-	  }
-	  else if(s[p+1] == 's') {
-	    res += alias_entry.source_ip;
-	    if(alias_entry.source_port != 5060)
-	      res += ":" + int2str(alias_entry.source_port);
-	    break;
-	  }
-	  else if(s[p+1] == 'i') {
-	    res += AmConfig::SIP_Ifs[alias_entry.local_if].name;
-	    break;
-	  }
+  case '_': { // modify
+    if (s.length()<p+4) { // $_O()
+      WARN("Error parsing $_ modifier replacement (short string)\n");
+      break;
+    }
+
+    char operation = c;
+    if (operation != 'U' && operation != 'l'
+	&& operation != 's' && operation != '5') {
+      WARN("Error parsing $_%c string modifier: unknown operator '%c'\n",
+	   operation, operation);
+    }
+
+    if (s[p+2] != '(') {
+      WARN("Error parsing $U upcase replacement (missing '(')\n");
+      break;
+    }
+
+    size_t skip_p = skip_to_end_of_brackets(s, p+3);
+    if (skip_p==s.length()) {
+      WARN("Error parsing $_ modifier (unclosed brackets)\n");
+      skip_chars = skip_p-p;
+      break;
+    }
+
+    Op op(Modify, operation);
+    op.sub = compileSub(s.substr(p+3, skip_p-p-3));
+    ops.push_back(op);
+    skip_chars = skip_p-p;
+  } break;
+
+  case 'm': // Request method
+    ops.push_back(Op(Method));
+    break;
+
+  case '#': { // URL encoding
+    if (c != '(') {
+      WARN("Error parsing $# URL encoding (missing '(')\n");
+      break;
+    }
+    if (s.length()<p+3) {
+      WARN("Error parsing $# URL encoding (short string)\n");
+      break;
+    }
+
+    size_t skip_p = skip_to_end_of_brackets(s, p+2);
+    if (skip_p==s.length()) {
+      WARN("Error parsing $# URL encoding (unclosed brackets)\n");
+      skip_chars = skip_p-p;
+      break;
+    }
+
+    Op op(UrlEncode);
+    op.sub = compileSub(s.substr(p+2, skip_p-p-2));
+    ops.push_back(op);
+    skip_chars = skip_p-p;
+  } break;
+
+  default: {
+    WARN("unknown replace pattern $%c%c\n", at(s, p), c);
+  }; break;
+  };
+
+  return skip_chars;
+}
+
+void ParamTemplate::expand(ParamReplacerCtx& ctx, const AmSipRequest& req,
+			   string& res) const
+{
+  for (vector<Op>::const_iterator it = ops.begin(); it != ops.end(); it++) {
+    const Op& op = *it;
+
+    switch (op.type) {
+    case Literal: res += op.arg; break;
+
+    case From:
+      if (ctx.from_modified) {
+	res += ctx.from_parser.nameaddr_str();
+      } else {
+	res += req.from;
+      }
+      break;
+    case FromTag: res += req.from_tag; break;
+    case FromPart:
+      if (parse_once(ctx.from_parser, req.from, "From URI"))
+	append_uri_part(ctx.from_parser, op, res);
+      break;
+
+    case To:
+      if (ctx.to_modified) {
+	res += ctx.to_parser.nameaddr_str();
+      } else {
+	res += req.to;
+      }
+      break;
+    case ToTag: res += req.to_tag; break;
+    case ToPart:
+      if (parse_once(ctx.to_parser, req.to, "To URI"))
+	append_uri_part(ctx.to_parser, op, res);
+      break;
+
+    case RUri:
+      if (ctx.ruri_modified) {
+	res += ctx.ruri_parser.uri_str();
+      } else {
+	res += req.r_uri;
+      }
+      break;
+    case RUriPart:
+      if (parse_once(ctx.ruri_parser, req.r_uri, "R-URI"))
+	append_uri_part(ctx.ruri_parser, op, res);
+      break;
+
+    case CallId: res += req.callid; break;
+    case SrcIp: res += req.remote_ip; break;
+    case SrcPort: res += int2str(req.remote_port); break;
+
+    case Dest: { // destination (remote UAS)
+      if(ctx.call_profile && !ctx.call_profile->next_hop.empty()) {
+	cstring _next_hop = stl2cstr(ctx.call_profile->next_hop);
+	list<sip_destination> dest_list;
+	if(parse_next_hop(_next_hop,dest_list)) {
+	  WARN("parse_next_hop %.*s failed\n",
+	       _next_hop.len, _next_hop.s);
+	  break;
+	}
+
+	if(dest_list.size() == 0) {
+	  WARN("next-hop is not empty, but the resulting destination list is\n");
+	  break;
+	}
+
+	const sip_destination& dest = dest_list.front();
+	if (op.c == 'i') { // $di remote UAS IP address
+	  res += c2stlstr(dest.host);
+	} else if (op.c == 'p') { // $dp remote UAS port
+	  res += int2str(dest.port);
+	} else {
+	  WARN("unknown replacement $d%c\n", op.c);
+	}
+	break;
+      }
+
+      if (!parse_once(ctx.ruri_parser, req.r_uri, "R-URI"))
+	break;
+
+      if (op.c == 'i') { // $di remote UAS IP address
+	res += ctx.ruri_parser.uri_host;
+      } else if (op.c == 'p') { // $dp remote UAS port
+	res += ctx.ruri_parser.uri_port;
+      } else {
+	WARN("unknown replacement $d%c\n", op.c);
+      }
+    } break;
+
+    case Recv: { // received (local)
+      switch (op.c) {
+      case 'i': res += req.local_ip; break;
+      case 'p': res += int2str(req.local_port); break;
+      case 'f': res += int2str(req.local_if); break;
+      case 'n':
+	if (req.local_if < AmConfig::SIP_Ifs.size()) {
+	  res += AmConfig::SIP_Ifs[req.local_if].name;
+	}
+	break;
+      case 'I':
+	if (req.local_if < AmConfig::SIP_Ifs.size()) {
+	  res += AmConfig::SIP_Ifs[req.local_if].PublicIP;
+	}
+	break;
+      }
+    } break;
+
+    case RegDest: { // Reg-cached destination user
+      // REG-Cache lookup
+      AliasEntry alias_entry;
+      const string& alias = req.user;
+
+      if(!RegisterCache::instance()->findAliasEntry(alias, alias_entry)) {
+	WARN("reg-cache: User '%s' not found",alias.c_str());
+	break;
+      }
 	  
-	  WARN("unknown replacement $u%c\n", s[p+1]);
-	} break;
+      if(op.c == 'c') {
+	res += alias_entry.contact_uri;
+      }
+      else if(op.c == 's') {
+	res += alias_entry.source_ip;
+	if(alias_entry.source_port != 5060)
+	  res += ":" + int2str(alias_entry.source_port);
+      }
+      else if(op.c == 'i') {
+	res += AmConfig::SIP_Ifs[alias_entry.local_if].name;
+      }
+      else {
+	WARN("unknown replacement $u%c\n", op.c);
+      }
+    } break;
+
+    case RegOrigAor: { // $Ua originating AoR
+      AliasEntry ae;
+      RegisterCache* reg_cache = RegisterCache::instance();
+      if(reg_cache->findAEByContact(req.from_uri,req.remote_ip,
+				     req.remote_port,ae)) {
+	res += ae.aor;
+      }
+    } break;
 
-	case 'U': { // Reg-cached originating user
-	  if (s.length() < p+1) {
-	    WARN("unknown replacement $U\n");
-	    break;
-	  }
-	  if (s[p+1] == 'a') { // $Ua originating AoR
-	    AliasEntry ae;
-	    RegisterCache* reg_cache = RegisterCache::instance();
-	    if(reg_cache->findAEByContact(req.from_uri,req.remote_ip,
-					   req.remote_port,ae)) {
-	      res += ae.aor;
-	    }
-	    break;
-	  }
-	  else if(s[p+1] == 'A') { // $UA originating alias
-	    AliasEntry ae;
-	    RegisterCache* reg_cache = RegisterCache::instance();
-
-	    string aor;
-	    if (from_parser.uri.empty())
-	      aor = req.from;
-	    else if(!rebuild_from)
-	      aor = from_parser.uri;
-	    else
-	      aor = from_parser.uri_str();
-
-	    aor = RegisterCache::canonicalize_aor(from_parser.uri_str());
-
-	    map<string,string> alias_map;
-	    if(reg_cache->getAorAliasMap(aor, alias_map) && !alias_map.empty()) {
-
-	      bool is_registered = false;  
-	      for(map<string,string>::iterator it = alias_map.begin();
-		  it != alias_map.end(); it++) {
-
-		AliasEntry alias_entry;
-		if(reg_cache->findAliasEntry(it->first,alias_entry)) {
-		  if((alias_entry.source_ip == req.remote_ip) &&
-		     (alias_entry.source_port == req.remote_port)) {
-		    DBG("matching entry for alias '%s' found (src=%s:%i)",
-			it->first.c_str(), 
-			alias_entry.source_ip.c_str(),
-			alias_entry.source_port);
-		    is_registered = true;
-		    res += it->first;
-		    break;
-		  }
-		  // else {
-		  //   DBG("alias '%s': source IP/port mismatch: %s:%i != %s:%i",
-		  // 	it->first.c_str(),
-		  // 	alias_entry.source_ip.c_str(),
-		  // 	alias_entry.source_port,
-		  // 	context.invite_req->remote_ip.c_str(),
-		  // 	context.invite_req->remote_port);
-		  // }
-		}
-	      }
-	      if(is_registered)
-		break;
-	    }
-	    DBG("AoR '%s' is not registered",aor.c_str());
-	    break;
-	  }
-	  WARN("unknown replacement $U%c\n", s[p+1]);
-	} break;
-
-#define case_HDR(pv_char, pv_name, hdr_name)				\
-	  case pv_char: {						\
-	    AmUriParser uri_parser;					\
-	    uri_parser.uri = getHeader(used_hdrs, hdr_name);		\
-	    if ((s.length() == p+1) || (s[p+1] == '.')) {		\
-	      res += uri_parser.uri;					\
-	      break;							\
-	    }								\
-									\
-	    if (!uri_parser.parse_uri()) {				\
-	      WARN("Error parsing " pv_name " URI '%s'\n", uri_parser.uri.c_str()); \
-	      break;							\
-	    }								\
-	    if (s[p+1] == 'i') {					\
-	      res+=uri_parser.uri_user+"@"+uri_parser.uri_host;		\
-	      if (!uri_parser.uri_port.empty())				\
-		res+=":"+uri_parser.uri_port;				\
-	    } else {							\
-	      skip_chars=replaceParsedParam(s, p, uri_parser, res);	\
-	    }								\
-	  }; break;
-
-	  case_HDR('a', "PAI", SIP_HDR_P_ASSERTED_IDENTITY);  // P-Asserted-Identity
-	  case_HDR('p', "PPI", SIP_HDR_P_PREFERRED_IDENTITY); // P-Preferred-Identity
-
-	case 'P': { // app-params
-	  if (s[p+1] != '(') {
-	    WARN("Error parsing P param replacement (missing '(')\n");
-	    break;
-	  }
-	  if (s.length()<p+3) {
-	    WARN("Error parsing P param replacement (short string)\n");
-	    break;
-	  }
+    case RegOrigAlias: { // $UA originating alias
+      RegisterCache* reg_cache = RegisterCache::instance();
 
-	  size_t skip_p = p+2;
-	  for (;skip_p<s.length() && s[skip_p] != ')';skip_p++) { }
-	  if (skip_p==s.length()) {
-	    WARN("Error parsing P param replacement (unclosed brackets)\n");
-	    break;
-	  }
-	  string param_name = s.substr(p+2, skip_p-p-2);
-	  // DBG("param_name = '%s' (skip-p - p = %d)\n", param_name.c_str(), skip_p-p);
-	  res += get_header_keyvalue(app_param, param_name);
-	  skip_chars = skip_p-p;
-	} break;
-
-	case 'V': { // variable
-	  if (s[p+1] != '(') {
-	    WARN("Error parsing V variable replacement (missing '(')\n");
-	    break;
-	  }
-	  if (s.length()<p+3) {
-	    WARN("Error parsing V param replacement (short string)\n");
-	    break;
-	  }
+      string aor;
+      if (ctx.from_parser.uri.empty())
+	aor = req.from;
+      else if(!ctx.from_modified)
+	aor = ctx.from_parser.uri;
+      else
+	aor = ctx.from_parser.uri_str();
 
-	  size_t skip_p = p+2;
-	  for (;skip_p<s.length() && s[skip_p] != ')';skip_p++) { }
-	  if (skip_p==s.length()) {
-	    WARN("Error parsing V param replacement (unclosed brackets)\n");
-	    break;
-	  }
-	  string var_name = s.substr(p+2, skip_p-p-2);
-	  // DBG("param_name = '%s' (skip-p - p = %d)\n", param_name.c_str(), skip_p-p);
-	  if (!call_profile) {
-	    WARN("no call_profile object when replacing variable '%s'\n", var_name.c_str());
-	  } else {
-	    const AmArg* val = NULL;
-	    size_t dotpos = var_name.find('.');
-	    string vn;
-	    if (dotpos != string::npos) {
-	      vn = var_name.substr(dotpos+1);
-	      var_name = var_name.substr(0, dotpos);
-	    }
-	    SBCVarMapConstIteratorT it = call_profile->cc_vars.find(var_name);
-	    if (it != call_profile->cc_vars.end()) {
-	      if (vn.empty()) {
-		val = &it->second;
-	      } else {
-		if (isArgStruct(it->second)) {
-		  // recursive replacement for call variable name (defined via GUI)
-		  if (vn.find('$') != string::npos)
-		    vn = replaceParameters(vn, "CallVar Subname", req, 
-					   call_profile, app_param, 
-					   ruri_parser, from_parser, to_parser,
-					   rebuild_ruri, rebuild_from, rebuild_to);
-		  val = &it->second[vn];
-		} else {
-		  DBG("CC variable '%s' has wrong type: '%s'\n",
-		      vn.c_str(), AmArg::print(it->second).c_str());
-		}
-	      }
-	      if (val != NULL) {
-		if (val->getType() == AmArg::CStr)
-		  res += val->asCStr();
-		else
-		  res += AmArg::print(*val);
-	      }
-	    } else {
-	      DBG("CC variable '%s' does not exist\n", var_name.c_str());
-	    }
-	  }
+      aor = RegisterCache::canonicalize_aor(ctx.from_parser.uri_str());
 
-	  skip_chars = skip_p-p;
-	} break;
+      map<string,string> alias_map;
+      if(reg_cache->getAorAliasMap(aor, alias_map) && !alias_map.empty()) {
 
-	case 'H': { // header
-	  size_t name_offset = 2;
-	  if (s[p+1] != '(') {
-	    if (s[p+2] != '(') {
-	      WARN("Error parsing H header replacement (missing '(')\n");
+	bool is_registered = false;  
+	for(map<string,string>::iterator it = alias_map.begin();
+	    it != alias_map.end(); it++) {
+
+	  AliasEntry alias_entry;
+	  if(reg_cache->findAliasEntry(it->first,alias_entry)) {
+	    if((alias_entry.source_ip == req.remote_ip) &&
+	       (alias_entry.source_port == req.remote_port)) {
+	      DBG("matching entry for alias '%s' found (src=%s:%i)",
+		  it->first.c_str(), 
+		  alias_entry.source_ip.c_str(),
+		  alias_entry.source_port);
+	      is_registered = true;
+	      res += it->first;
 	      break;
 	    }
-	    name_offset = 3;
-	  }
-	  if (s.length()<name_offset+1) {
-	    WARN("Error parsing H header replacement (short string)\n");
-	    break;
 	  }
+	}
+	if(is_registered)
+	  break;
+      }
+      DBG("AoR '%s' is not registered",aor.c_str());
+    } break;
+
+    case HdrUri: // $a, $p
+    case Header: // $H(name)
+      res += getHeader(req.hdrs, op.arg2);
+      break;
+
+    case HdrUriId: // $ai, $pi
+    case HdrUriPart: // $aX, $pX
+    case HeaderPart: { // $HX(name)
+      if (op.type == HeaderPart && op.c == '.') {
+	res += getHeader(req.hdrs, op.arg2);
+	break;
+      }
 
-	  size_t skip_p = p+name_offset;
-	  for (;skip_p<s.length() && s[skip_p] != ')';skip_p++) { }
-	  if (skip_p==s.length()) {
-	    WARN("Error parsing H header replacement (unclosed brackets)\n");
-	    break;
-	  }
-	  string hdr_name = s.substr(p+name_offset, skip_p-p-name_offset);
-	  // DBG("param_name = '%s' (skip-p - p = %d)\n", param_name.c_str(), skip_p-p);
-	  if (name_offset == 2) {
-	    // full header
-	    res += getHeader(used_hdrs, hdr_name);
-	  } else {
-	    // parse URI and use component
-	    AmUriParser uri_parser;
-	    uri_parser.uri = getHeader(used_hdrs, hdr_name);
-	    if ((s[p+1] == '.')) {
-	      res += uri_parser.uri;
-	      break;
-	    }
+      const AmUriParser* uri_parser;
+      if (!ctx.getHeaderUri(req, op.arg2, uri_parser)) {
+	if (op.type == HeaderPart) {
+	  WARN("Error parsing header %s URI '%s'\n",
+	       op.arg2.c_str(), uri_parser->uri.c_str());
+	} else {
+	  WARN("Error parsing %s URI '%s'\n",
+	       op.arg2 == SIP_HDR_P_ASSERTED_IDENTITY ? "PAI" : "PPI",
+	       uri_parser->uri.c_str());
+	}
+	break;
+      }
 
-	    if (!uri_parser.parse_uri()) {
-	      WARN("Error parsing header %s URI '%s'\n",
-		   hdr_name.c_str(), uri_parser.uri.c_str());
-	      break;
-	    }
-	    //TODO: find out how to correct skip_chars correctly
-	    replaceParsedParam(s, p, uri_parser, res);
-	  }
-	  skip_chars = skip_p-p;
-	} break;
+      if (op.type == HdrUriId) {
+	res+=uri_parser->uri_user+"@"+uri_parser->uri_host;
+	if (!uri_parser->uri_port.empty())
+	  res+=":"+uri_parser->uri_port;
+      } else {
+	append_uri_part(*uri_parser, op, res);
+      }
+    } break;
 
-	case 'M': { // regex map
-	  if (s[p+1] != '(') {
-	    WARN("Error parsing $M regex map replacement (missing '(')\n");
-	    break;
-	  }
-	  if (s.length()<p+3) {
-	    WARN("Error parsing $M regex map replacement (short string)\n");
-	    break;
-	  }
+    case AppParam:
+      res += get_header_keyvalue(ctx.app_param, op.arg);
+      break;
 
-	  size_t skip_p = p+2;
-	  skip_p = skip_to_end_of_brackets(s, skip_p);
+    case Var: { // variable
+      if (!ctx.call_profile) {
+	WARN("no call_profile object when replacing variable '%s'\n",
+	     op.arg.c_str());
+	break;
+      }
 
-	  if (skip_p==s.length()) {
-	    WARN("Error parsing $M regex map replacement (unclosed brackets)\n");
-	    skip_chars = skip_p-p;
-	    break;
-	  }
+      SBCVarMapConstIteratorT v_it = ctx.call_profile->cc_vars.find(op.arg);
+      if (v_it == ctx.call_profile->cc_vars.end()) {
+	DBG("CC variable '%s' does not exist\n", op.arg.c_str());
+	break;
+      }
 
-	  string map_str = s.substr(p+2, skip_p-p-2);
-	  size_t spos = map_str.rfind("=>");
-	  if (spos == string::npos) {
-	    skip_chars = skip_p-p;
-	    WARN("Error parsing $M regex map replacement: no => found in '%s'\n",
-		 map_str.c_str());
-	    break;
-	  }
+      const AmArg* val = NULL;
+      if (op.arg2.empty()) {
+	val = &v_it->second;
+      } else if (isArgStruct(v_it->second)) {
+	if (op.sub) {
+	  string vn;
+	  op.sub->expand(ctx, req, vn);
+	  val = &v_it->second[vn];
+	} else {
+	  val = &v_it->second[op.arg2];
+	}
+      } else {
+	DBG("CC variable '%s' has wrong type: '%s'\n",
+	    op.arg2.c_str(), AmArg::print(v_it->second).c_str());
+      }
 
-	  string map_val = map_str.substr(0, spos);
-	  string map_val_replaced = 
-	    replaceParameters(map_val, r_type, req, 
-			      call_profile, app_param,
-			      ruri_parser, from_parser, to_parser,
-			      rebuild_ruri, rebuild_from, rebuild_to);
-
-	  string mapping_name = map_str.substr(spos+2);
-
-	  string map_res; 
-	  if (SBCFactory::instance()->regex_mappings.
-	      mapRegex(mapping_name, map_val_replaced.c_str(), map_res)) {
-	    DBG("matched regex mapping '%s' (orig '%s) in '%s'\n",
-		map_val_replaced.c_str(), map_val.c_str(), mapping_name.c_str());
-	    res+=map_res;
-	  } else {
-	    DBG("no match in regex mapping '%s' (orig '%s') in '%s'\n",
-		map_val_replaced.c_str(), map_val.c_str(), mapping_name.c_str());
-	  }
- 
-	  skip_chars = skip_p-p;
-	} break;
-
-	case '_': { // modify
-	  if (s.length()<p+4) { // $_O()
-	    WARN("Error parsing $_ modifier replacement (short string)\n");
-	    break;
-	  }
+      if (val != NULL) {
+	if (val->getType() == AmArg::CStr)
+	  res += val->asCStr();
+	else
+	  res += AmArg::print(*val);
+      }
+    } break;
+
+    case RegexMap: { // regex map
+      string map_val_replaced;
+      op.sub->expand(ctx, req, map_val_replaced);
+
+      string map_res; 
+      if (SBCFactory::instance()->regex_mappings.
+	  mapRegex(op.arg2, map_val_replaced.c_str(), map_res)) {
+	DBG("matched regex mapping '%s' (orig '%s) in '%s'\n",
+	    map_val_replaced.c_str(), op.arg.c_str(), op.arg2.c_str());
+	res+=map_res;
+      } else {
+	DBG("no match in regex mapping '%s' (orig '%s') in '%s'\n",
+	    map_val_replaced.c_str(), op.arg.c_str(), op.arg2.c_str());
+      }
+    } break;
+
+    case Modify: { // modify
+      string br_str;
+      op.sub->expand(ctx, req, br_str);
+      string br_str_replaced = br_str;
+
+      switch(op.c) {
+      case 'u': // uppercase
+	transform(br_str_replaced.begin(), br_str_replaced.end(),
+		  br_str_replaced.begin(), ::toupper); break;
+      case 'l': // lowercase
+	transform(br_str_replaced.begin(), br_str_replaced.end(),
+		  br_str_replaced.begin(), ::tolower); break;
+
+      case 's': // size (string length)
+	br_str_replaced = int2str((unsigned int)br_str.length());
+	break;
 
-	  char operation = s[p+1];
-	  if (operation != 'U' && operation != 'l'
-	      && operation != 's' && operation != '5') {
-	    WARN("Error parsing $_%c string modifier: unknown operator '%c'\n",
-		 operation, operation);
-	  }
+      case '5': // md5
+	br_str_replaced = calculateMD5(br_str);
+	break;
+
+      case 't': // extract 'transport' (last 3 characters)
+	if (br_str.length() >= 4) {
+	  br_str_replaced = br_str.substr(br_str.length()-3);
+	}
+	break;
 
-	  if (s[p+2] != '(') {
-	    WARN("Error parsing $U upcase replacement (missing '(')\n");
-	    break;
+      case 'r': // random
+	{
+	  int r_max;
+	  if (!str2int(br_str, r_max)){
+	    WARN("Error parsing $_r(%s) for random value, returning 0\n", br_str.c_str());
+	    br_str_replaced = "0";
+	  } else {
+	    br_str_replaced = int2str(rand()%r_max);
 	  }
+	}
+	break;
 
-	  size_t skip_p = p+3;
-	  skip_p = skip_to_end_of_brackets(s, skip_p);
+      default:
+	WARN("Error parsing $_%c string modifier: unknown operator '%c'\n",
+	     op.c, op.c);
+	break;
+      }
+      DBG("applied operator '%c': '%s' => '%s'\n", op.c,
+	  br_str.c_str(), br_str_replaced.c_str());
+      res+=br_str_replaced;
+    } break;
 
-	  if (skip_p==s.length()) {
-	    WARN("Error parsing $_ modifier (unclosed brackets)\n");
-	    skip_chars = skip_p-p;
-	    break;
-	  }
+    case UrlEncode: { // URL encoding
+      string expr_replaced;
+      op.sub->expand(ctx, req, expr_replaced);
 
-	  string br_str = s.substr(p+3, skip_p-p-3);
-	  string br_str_replaced = 
-	    replaceParameters(br_str, "$_*(...)",
-			      req, call_profile, app_param,
-			      ruri_parser, from_parser, to_parser,
-			      rebuild_ruri, rebuild_from, rebuild_to);
-
-	  br_str = br_str_replaced;
-	  switch(operation) {
-	  case 'u': // uppercase
-	    transform(br_str_replaced.begin(), br_str_replaced.end(),
-		      br_str_replaced.begin(), ::toupper); break;
-	  case 'l': // lowercase
-	    transform(br_str_replaced.begin(), br_str_replaced.end(),
-		      br_str_replaced.begin(), ::tolower); break;
-
-	  case 's': // size (string length)
-	    br_str_replaced = int2str((unsigned int)br_str.length());
-	    break;
-
-	  case '5': // md5
-	    br_str_replaced = calculateMD5(br_str);
-	    break;
-
-	  case 't': // extract 'transport' (last 3 characters)
-	    if (br_str.length() >= 4) {
-	      br_str_replaced = br_str.substr(br_str.length()-3);
-	    }
-	    break;
-
-	  case 'r': // random
-	    {
-	      int r_max;
-	      if (!str2int(br_str, r_max)){
-		WARN("Error parsing $_r(%s) for random value, returning 0\n", br_str.c_str());
-		br_str_replaced = "0";
-	      } else {
-		br_str_replaced = int2str(rand()%r_max);
-	      }
-	    }
-	    break;
+      char* val_escaped = url_encode(expr_replaced.c_str());
+      res += string(val_escaped);
+      free(val_escaped);
+    } break;
 
-	  default:
-	    WARN("Error parsing $_%c string modifier: unknown operator '%c'\n",
-		 operation, operation);
-	    break;
-	  }
-	  DBG("applied operator '%c': '%s' => '%s'\n", operation,
-	      br_str.c_str(), br_str_replaced.c_str());
-	  res+=br_str_replaced;
+    case Method: res += req.method; break;
+    }
+  }
+}
 
-	  skip_chars = skip_p-p;
-	} break;
+/** strings without $xy and \x are used as they are */
+static inline bool has_replacements(const string& s)
+{
+  return s.find_first_of("$\\") != string::npos;
+}
 
-	case 'm': // Request method
-	  res += req.method;
-	  break;
+ParamTemplateSet::Templates::~Templates()
+{
+  for (map<string, ParamTemplate*>::iterator it = patterns.begin();
+       it != patterns.end(); it++)
+    delete it->second;
+}
 
-	case '#': { // URL encoding
-	  if (s[p+1] != '(') {
-	    WARN("Error parsing $# URL encoding (missing '(')\n");
-	    break;
-	  }
-	  if (s.length()<p+3) {
-	    WARN("Error parsing $# URL encoding (short string)\n");
-	    break;
-	  }
+ParamTemplateSet::ParamTemplateSet()
+  : t(new Templates())
+{
+  inc_ref(t);
+}
 
-	  size_t skip_p = p+2;
-	  skip_p = skip_to_end_of_brackets(s, skip_p);
+ParamTemplateSet::ParamTemplateSet(const ParamTemplateSet& o)
+  : t(o.t)
+{
+  inc_ref(t);
+}
 
-	  if (skip_p==s.length()) {
-	    WARN("Error parsing $# URL encoding (unclosed brackets)\n");
-	    skip_chars = skip_p-p;
-	    break;
-	  }
+ParamTemplateSet::~ParamTemplateSet()
+{
+  dec_ref(t);
+}
 
-	  string expr_str = s.substr(p+2, skip_p-p-2);
-	  string expr_replaced = 
-	    replaceParameters(expr_str, r_type, req,
-			      call_profile, app_param, 
-			      ruri_parser, from_parser, to_parser,
-			      rebuild_ruri, rebuild_from, rebuild_to);
+ParamTemplateSet& ParamTemplateSet::operator=(const ParamTemplateSet& o)
+{
+  if (t != o.t) {
+    inc_ref(o.t);
+    dec_ref(t);
+    t = o.t;
+  }
+  return *this;
+}
 
-	  char* val_escaped = url_encode(expr_replaced.c_str());
-	  res += string(val_escaped);
-	  free(val_escaped);
+void ParamTemplateSet::add(const string& s)
+{
+  if (!has_replacements(s) || t->patterns.find(s) != t->patterns.end())
+    return;
 
-	  skip_chars = skip_p-p;
-	} break;
+  t->patterns[s] = new ParamTemplate(s);
+}
 
-	default: {
-	  WARN("unknown replace pattern $%c%c\n",
-	       s[p], s[p+1]);
-	}; break;
-	};
+const ParamTemplate* ParamTemplateSet::find(const string& s) const
+{
+  map<string, ParamTemplate*>::const_iterator it = t->patterns.find(s);
+  if (it == t->patterns.end())
+    return NULL;
+  return it->second;
+}
 
-	p+=skip_chars; // skip $.X
-      } else {
-	res += s[p];
-      }
-    } // end not escaped
+size_t ParamTemplateSet::size() const
+{
+  return t->patterns.size();
+}
 
-    p++;
+bool ParamReplacerCtx::getHeaderUri(const AmSipRequest& req,
+				    const string& hdr_name,
+				    const AmUriParser*& uri)
+{
+  string value = getHeader(req.hdrs, hdr_name);
+
+  HeaderUri& h = hdr_uris[hdr_name];
+  if (h.parser.uri.empty() || h.value != value) {
+    h.value = value;
+    h.parser = AmUriParser();
+    h.parser.uri = value;
+    h.parsed = h.parser.parse_uri();
   }
 
-  if (is_replaced) {
+  uri = &h.parser;
+  return h.parsed;
+}
+
+string ParamReplacerCtx::replaceParameters(const string& s,
+					   const char* r_type,
+					   const AmSipRequest& req)
+{
+  // nothing to replace
+  if (!has_replacements(s))
+    return s;
+
+  const ParamTemplate* t = NULL;
+  if (templates)
+    t = templates->find(s);
+  if (!t && call_profile)
+    t = call_profile->param_templates.find(s);
+
+  // not known when the profile was loaded, e.g. a replaced value
+  ParamTemplate* tmp = NULL;
+  if (!t)
+    t = tmp = new ParamTemplate(s);
+
+  string res;
+  res.reserve(t->getLiteralLength() + 128);
+  t->expand(*this, req, res);
+
+  if (t->isReplaced()) {
     DBG("%s pattern replace: '%s' -> '%s'\n", r_type, s.c_str(), res.c_str());
   }
+
+  delete tmp;
   return res;
 }
 
-
 //
 // URL encoding functions
 //
@@ -27,25 +27,138 @@
 #define _ParamReplacer_h_
 
 #include <string>
+#include <vector>
+#include <map>
 using std::string;
+using std::vector;
+using std::map;
 
 #include "AmSipMsg.h"
 #include "AmUriParser.h"
+#include "atomic_types.h"
 
 struct SBCCallProfile;
+struct ParamReplacerCtx;
 
-// $xy parameters replacement
-string replaceParameters(const string& s,
-			 const char* r_type,
-			 const AmSipRequest& req,
-			 const SBCCallProfile* call_profile,
-			 const string& app_param,
-			 AmUriParser& ruri_parser,
-			 AmUriParser& from_parser,
-			 AmUriParser& to_parser,
-			 bool rebuild_ruri,
-			 bool rebuild_from,
-			 bool rebuild_to);
+/**
+ * \brief $xy replacement pattern, compiled
+ *
+ * The pattern string is parsed once into a list of operations
+ * (literal text, request fields, URI parts, headers, ...), which
+ * are then evaluated for each request, appending to one buffer.
+ * The patterns of a call profile are compiled when the profile
+ * is loaded (see ParamTemplateSet).
+ */
+class ParamTemplate
+{
+public:
+  enum OpType {
+    Literal,
+    From, FromTag, FromPart,      // $f, $ft, $fX
+    To, ToTag, ToPart,            // $t, $tt, $tX
+    RUri, RUriPart,               // $r, $rX
+    CallId,                       // $ci
+    SrcIp, SrcPort,               // $si, $sp
+    Dest,                         // $dX
+    Recv,                         // $RX
+    RegDest,                      // $uX
+    RegOrigAor, RegOrigAlias,     // $Ua, $UA
+    HdrUri, HdrUriId, HdrUriPart, // $a/$p, $ai/$pi, $aX/$pX
+    AppParam,                     // $P(name)
+    Var,                          // $V(name.sub)
+    Header, HeaderPart,           // $H(name), $HX(name)
+    RegexMap,                     // $M(val=>map)
+    Modify,                       // $_X(val)
+    UrlEncode,                    // $#(val)
+    Method                        // $m
+  };
+
+  /** how a URI parameter part ($xP) is selected */
+  enum ParamMode {
+    AllParams,     // $xP, $xP()
+    NamedParam,    // $xP(name)
+    BadParam       // $xP(... unclosed
+  };
+
+  struct Op {
+    OpType type;
+    char c;              // selector character, e.g. 'i' in $si
+    ParamMode param_mode;
+    string arg;          // literal text, param/header/variable name
+    string arg2;         // header name, variable sub-name, map name
+    ParamTemplate* sub;  // nested pattern, e.g. in $_u(...)
+
+    Op(OpType type, char c = 0)
+      : type(type), c(c), param_mode(AllParams), sub(NULL) {}
+  };
+
+private:
+  vector<Op> ops;
+  string pattern;
+  bool is_replaced;
+  size_t literal_len;
+
+  void addLiteral(char c);
+  size_t compileUriPart(const string& s, size_t p, Op& op);
+  size_t compilePattern(const string& s, size_t p);
+  ParamTemplate* compileSub(const string& s);
+
+  // not copyable (owns sub patterns)
+  ParamTemplate(const ParamTemplate&);
+  const ParamTemplate& operator=(const ParamTemplate&);
+
+public:
+  ParamTemplate(const string& s);
+  ~ParamTemplate();
+
+  /** append the replaced pattern to 'res' */
+  void expand(ParamReplacerCtx& ctx, const AmSipRequest& req,
+	      string& res) const;
+
+  /** @return true if the pattern contains $xy or \x */
+  bool isReplaced() const { return is_replaced; }
+  const string& getPattern() const { return pattern; }
+  /** length of the literal text in the pattern */
+  size_t getLiteralLength() const { return literal_len; }
+};
+
+/**
+ * \brief compiled patterns, looked up by their text
+ *
+ * Filled when a call profile is loaded and read-only afterwards,
+ * so that lookups need no lock. Copies share the compiled
+ * patterns, e.g. the per-call copies of a call profile keep them
+ * after the profile has been reloaded.
+ */
+class ParamTemplateSet
+{
+  struct Templates
+    : public atomic_ref_cnt
+  {
+    map<string, ParamTemplate*> patterns;
+    ~Templates();
+  };
+
+  Templates* t;
+
+public:
+  ParamTemplateSet();
+  ParamTemplateSet(const ParamTemplateSet& o);
+  ~ParamTemplateSet();
+
+  ParamTemplateSet& operator=(const ParamTemplateSet& o);
+
+  /**
+   * Compile 's' if it contains $xy or \x.
+   * Must not be called once the set has been copied.
+   */
+  void add(const string& s);
+
+  /** @return the compiled pattern or NULL if 's' has not been added */
+  const ParamTemplate* find(const string& s) const;
+
+  size_t size() const;
+};
 
 struct ParamReplacerCtx
 {
@@ -60,27 +173,36 @@ struct ParamReplacerCtx
 
   const SBCCallProfile* call_profile;
 
+  /** compiled patterns to use before those of call_profile */
+  const ParamTemplateSet* templates;
+
+  /** URIs of headers used in patterns, parsed once per request */
+  struct HeaderUri {
+    string value;
+    AmUriParser parser;
+    bool parsed;
+  };
+  map<string, HeaderUri> hdr_uris;
+
   ParamReplacerCtx(const SBCCallProfile* call_profile=NULL)
     : ruri_modified(false), 
       from_modified(false), 
       to_modified(false),
-      call_profile(call_profile)
+      call_profile(call_profile),
+      templates(NULL)
   {}
 
+  /** $xy parameters replacement */
   string replaceParameters(const string& s,
 			   const char* r_type,
-			   const AmSipRequest& req) {
-    
-    return ::replaceParameters(s,r_type,req,
-			       call_profile,
-			       app_param,
-			       ruri_parser,
-			       from_parser,
-			       to_parser,
-			       ruri_modified,
-			       from_modified,
-			       to_modified);
-  }
+			   const AmSipRequest& req);
+
+  /**
+   * Get the parsed URI of header 'hdr_name' of 'req'.
+   * @return false if the URI could not be parsed
+   */
+  bool getHeaderUri(const AmSipRequest& req, const string& hdr_name,
+		    const AmUriParser*& uri);
 };
 
 #endif
@@ -4,7 +4,7 @@
 #define min(a,b) ((a) < (b) ? (a) : (b))
 
 DynRateLimit::DynRateLimit(unsigned int time_base_ms)
-  : last_update(0), counter(0)
+  : state(0)
 {
   // wall_clock has a resolution of 20ms
   time_base = time_base_ms / 20;
@@ -13,27 +13,28 @@ DynRateLimit::DynRateLimit(unsigned int time_base_ms)
 bool DynRateLimit::limit(unsigned int rate, unsigned int peak, 
 			 unsigned int size)
 {
-  lock();
+  u_int32_t now = AmAppTimer::instance()->wall_clock;
 
-  if(AmAppTimer::instance()->wall_clock - last_update 
-     > time_base) {
+  while(true) {
+    u_int64_t old_state = state;
 
-    update_limit(rate,peak);
-  }
+    u_int32_t last_update = (u_int32_t)(old_state >> 32);
+    int counter = (int32_t)(u_int32_t)old_state;
 
-  if(counter <= 0) {
-    unlock();
-    return true; // limit reached
-  }
+    if(now - last_update > time_base) {
+      counter = min((int)peak, counter+(int)rate);
+      last_update = now;
+    }
 
-  counter -= size;
-  unlock();
+    bool drop = (counter <= 0); // limit reached
+    if(!drop)
+      counter -= size;
 
-  return false; // do not limit
-}
+    u_int64_t new_state = ((u_int64_t)last_update << 32) | (u_int32_t)counter;
+    if(new_state == old_state)
+      return drop;
 
-void DynRateLimit::update_limit(int rate, int peak)
-{
-  counter = min(peak, counter+rate);
-  last_update = AmAppTimer::instance()->wall_clock;
+    if(__sync_bool_compare_and_swap(&state, old_state, new_state))
+      return drop;
+  }
 }
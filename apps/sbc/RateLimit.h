@@ -5,16 +5,18 @@
 #include "atomic_types.h"
 #include <sys/types.h>
 
+/**
+ * Token bucket, refilled every 'time_base'. Lock-free: the last update
+ * and the counter are kept in one 64 bit word, changed with CAS, so
+ * that it can be used from several RTP receiver threads per packet.
+ */
 class DynRateLimit
-  : protected AmMutex
 {
-  u_int32_t last_update;
-  int counter;
+  // last update (upper 32 bits) | counter (lower 32 bits, signed)
+  volatile u_int64_t state;
 
   unsigned int time_base;
 
-  void update_limit(int rate, int peak);
-
 public:
   // time_base_ms: milliseconds
   DynRateLimit(unsigned int time_base_ms);
@@ -31,7 +33,10 @@ public:
   bool limit(unsigned int rate, unsigned int peak, unsigned int size);
 
   /** Get last update timestamp (wheeltimer::wallclock ticks) */
-  u_int32_t getLastUpdate() { return last_update; }
+  u_int32_t getLastUpdate() const { return (u_int32_t)(state >> 32); }
+
+  /** Empty the bucket, to be refilled with the next unit */
+  void reset() { state = 0; }
 };
 
 class RateLimit
@@ -0,0 +1,615 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "RegCacheStorage.h"
+#include "sip/hash.h"
+
+#include "AmUtils.h"
+#include "log.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <algorithm>
+
+#define REG_CACHE_FILE_MAGIC     "SEMSREG1"
+#define REG_CACHE_FILE_MAGIC_LEN 8
+#define REG_CACHE_SNAPSHOT       "regcache.snapshot"
+#define REG_CACHE_JOURNAL        "regcache.journal."
+
+/** snapshot data is written in chunks of */
+#define REG_CACHE_WRITE_CHUNK    (1024*1024)
+
+// record types
+#define REC_UPDATE     'U'
+#define REC_UA_EXPIRES 'E'
+#define REC_DELETE     'D'
+
+static void put_u16(string& b, uint16_t v) { b.append((const char*)&v, sizeof(v)); }
+static void put_u32(string& b, uint32_t v) { b.append((const char*)&v, sizeof(v)); }
+static void put_i64(string& b, int64_t v)  { b.append((const char*)&v, sizeof(v)); }
+
+static void put_str(string& b, const string& s)
+{
+  put_u32(b, s.length());
+  b.append(s);
+}
+
+/** append a record with its length and hash */
+static void put_record(string& b, const string& rec)
+{
+  put_u32(b, rec.length());
+  put_u32(b, hashlittle(rec.data(), rec.length(), 0));
+  b.append(rec);
+}
+
+static string update_record(const string& aor, const string& alias,
+			    long int reg_expire, const AliasEntry& ae)
+{
+  string rec(1, REC_UPDATE);
+  put_str(rec, aor);
+  put_str(rec, alias);
+  put_i64(rec, reg_expire);
+  put_str(rec, ae.contact_uri);
+  put_str(rec, ae.source_ip);
+  put_u16(rec, ae.source_port);
+  put_str(rec, ae.trsp);
+  put_u16(rec, ae.local_if);
+  put_str(rec, ae.remote_ua);
+  put_i64(rec, ae.ua_expire);
+  return rec;
+}
+
+/** reads the fields of a record, 'ok' is false if it was too short */
+struct RecordReader
+{
+  const char* p;
+  const char* end;
+  bool ok;
+
+  RecordReader(const char* rec, size_t len)
+    : p(rec), end(rec + len), ok(true) {}
+
+  void get(void* v, size_t len) {
+    if (!ok || (size_t)(end - p) < len) {
+      ok = false;
+      return;
+    }
+    memcpy(v, p, len);
+    p += len;
+  }
+
+  char     type() { char v = 0;     get(&v, sizeof(v)); return v; }
+  uint16_t u16()  { uint16_t v = 0; get(&v, sizeof(v)); return v; }
+  uint32_t u32()  { uint32_t v = 0; get(&v, sizeof(v)); return v; }
+  int64_t  i64()  { int64_t v = 0;  get(&v, sizeof(v)); return v; }
+
+  string str() {
+    uint32_t len = u32();
+    if (!ok || (size_t)(end - p) < len) {
+      ok = false;
+      return string();
+    }
+    string s(p, len);
+    p += len;
+    return s;
+  }
+};
+
+static bool write_all(int fd, const char* data, size_t len)
+{
+  while (len) {
+    ssize_t res = write(fd, data, len);
+    if (res < 0) {
+      if (errno == EINTR)
+	continue;
+      return false;
+    }
+    data += res;
+    len -= res;
+  }
+  return true;
+}
+
+static bool write_header(int fd, unsigned int seq)
+{
+  string h(REG_CACHE_FILE_MAGIC);
+  put_u32(h, seq);
+  return write_all(fd, h.data(), h.length());
+}
+
+/**
+ * writes all bindings into a snapshot file
+ *
+ * The records are collected while the AoR bucket is locked and
+ * written only after it has been released.
+ */
+struct RegCacheSnapshotWriter
+  : public RegCacheVisitor
+{
+  int fd;
+  string buf;
+  unsigned int bindings;
+  bool failed;
+
+  RegCacheSnapshotWriter(int fd)
+    : fd(fd), bindings(0), failed(false) {}
+
+  bool flush() {
+    if (!failed && !write_all(fd, buf.data(), buf.length()))
+      failed = true;
+    buf.clear();
+    return !failed;
+  }
+
+  void visit(const string& canon_aor, const RegBinding& binding,
+	     const AliasEntry& alias_entry) {
+    put_record(buf, update_record(canon_aor, binding.alias,
+				  binding.reg_expire, alias_entry));
+    bindings++;
+  }
+
+  void bucketDone() {
+    if (buf.length() >= REG_CACHE_WRITE_CHUNK)
+      flush();
+  }
+};
+
+/** inserts a part of the bindings of a snapshot */
+class RegCacheRestoreThread
+  : public AmThread
+{
+  RegCacheFileStorage* storage;
+  const vector<std::pair<const char*, size_t> >& records;
+  size_t begin;
+  size_t end;
+  long int now;
+
+protected:
+  void run() {
+    for (size_t i = begin; i < end; i++)
+      storage->applyRecord(records[i].first, records[i].second, now);
+  }
+  void on_stop() {}
+
+public:
+  RegCacheRestoreThread(RegCacheFileStorage* storage,
+			const vector<std::pair<const char*, size_t> >& records,
+			size_t begin, size_t end, long int now)
+    : storage(storage), records(records), begin(begin), end(end), now(now) {}
+};
+
+RegCacheFileStorage::RegCacheFileStorage(_RegisterCache* cache,
+					 const string& dir,
+					 unsigned int snapshot_interval,
+					 unsigned int restore_threads)
+  : cache(cache), dir(dir),
+    snapshot_interval(snapshot_interval),
+    restore_threads(restore_threads),
+    journal_fd(-1), journal_seq(0),
+    last_snapshot(0), running(true),
+    restored_bindings(0), restore_time(0)
+{
+}
+
+RegCacheFileStorage::~RegCacheFileStorage()
+{
+  running.set(false);
+  join();
+  flush();
+  if (journal_fd >= 0)
+    close(journal_fd);
+}
+
+string RegCacheFileStorage::journalName(unsigned int seq)
+{
+  return dir + "/" REG_CACHE_JOURNAL + int2str(seq);
+}
+
+bool RegCacheFileStorage::openJournal(unsigned int seq)
+{
+  string fname = journalName(seq);
+  int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+  if (fd < 0) {
+    ERROR("creating register cache journal '%s': %s\n",
+	  fname.c_str(), strerror(errno));
+    return false;
+  }
+  if (!write_header(fd, seq)) {
+    ERROR("writing register cache journal '%s': %s\n",
+	  fname.c_str(), strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  journal_fd = fd;
+  journal_seq = seq;
+  return true;
+}
+
+void RegCacheFileStorage::appendRecord(const string& rec)
+{
+  journal_mut.lock();
+  put_record(journal_buf, rec);
+  journal_mut.unlock();
+  journal_records.inc();
+}
+
+void RegCacheFileStorage::flush()
+{
+  string buf;
+  journal_mut.lock();
+  buf.swap(journal_buf);
+  journal_mut.unlock();
+
+  if (buf.empty())
+    return;
+
+  if (journal_fd < 0 && !openJournal(journal_seq + 1))
+    return;
+
+  if (!write_all(journal_fd, buf.data(), buf.length())) {
+    ERROR("writing register cache journal '%s': %s\n",
+	  journalName(journal_seq).c_str(), strerror(errno));
+  }
+}
+
+bool RegCacheFileStorage::writeSnapshot()
+{
+  struct timeval start, end, diff;
+  gettimeofday(&start, NULL);
+  last_snapshot = start.tv_sec;
+
+  // later changes go to the new journal, replayed after the snapshot
+  int old_fd = journal_fd;
+  unsigned int old_seq = journal_seq;
+  string buf;
+  journal_mut.lock();
+  buf.swap(journal_buf);
+  bool opened = openJournal(journal_seq + 1);
+  journal_mut.unlock();
+
+  if (!opened)
+    journal_fd = -1;
+
+  if (old_fd >= 0) {
+    if (!write_all(old_fd, buf.data(), buf.length())) {
+      ERROR("writing register cache journal '%s': %s\n",
+	    journalName(old_seq).c_str(), strerror(errno));
+    }
+    close(old_fd);
+  }
+  if (!opened)
+    return false;
+
+  string tmp_name = dir + "/" REG_CACHE_SNAPSHOT ".tmp";
+  string fname = dir + "/" REG_CACHE_SNAPSHOT;
+  int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    ERROR("creating register cache snapshot '%s': %s\n",
+	  tmp_name.c_str(), strerror(errno));
+    return false;
+  }
+
+  RegCacheSnapshotWriter w(fd);
+  bool res = write_header(fd, journal_seq);
+  if (res) {
+    cache->visitBindings(w);
+    res = w.flush();
+  }
+  if (!res || fsync(fd)) {
+    ERROR("writing register cache snapshot '%s': %s\n",
+	  tmp_name.c_str(), strerror(errno));
+    close(fd);
+    unlink(tmp_name.c_str());
+    return false;
+  }
+  close(fd);
+
+  if (rename(tmp_name.c_str(), fname.c_str())) {
+    ERROR("renaming register cache snapshot to '%s': %s\n",
+	  fname.c_str(), strerror(errno));
+    unlink(tmp_name.c_str());
+    return false;
+  }
+
+  // the journals before are in the snapshot now
+  DIR* d = opendir(dir.c_str());
+  if (d) {
+    struct dirent* e;
+    while ((e = readdir(d)) != NULL) {
+      unsigned int seq;
+      if (!strncmp(e->d_name, REG_CACHE_JOURNAL, strlen(REG_CACHE_JOURNAL)) &&
+	  !str2i(e->d_name + strlen(REG_CACHE_JOURNAL), seq) &&
+	  seq < journal_seq) {
+	unlink((dir + "/" + e->d_name).c_str());
+      }
+    }
+    closedir(d);
+  }
+
+  snapshots_written.inc();
+  gettimeofday(&end, NULL);
+  timersub(&end, &start, &diff);
+  DBG("register cache snapshot: %u bindings written in %lu.%06lus\n",
+      w.bindings, (unsigned long)diff.tv_sec, (unsigned long)diff.tv_usec);
+  return true;
+}
+
+bool RegCacheFileStorage::readFile(const string& fname, unsigned int& seq,
+				   vector<std::pair<const char*, size_t> >& records,
+				   char*& data, size_t& len)
+{
+  data = NULL;
+  len = 0;
+
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ERROR("opening '%s': %s\n", fname.c_str(), strerror(errno));
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) ||
+      st.st_size < REG_CACHE_FILE_MAGIC_LEN + (off_t)sizeof(uint32_t)) {
+    ERROR("'%s' is not a register cache file\n", fname.c_str());
+    close(fd);
+    return false;
+  }
+
+  void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    ERROR("mapping '%s': %s\n", fname.c_str(), strerror(errno));
+    return false;
+  }
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  data = (char*)p;
+  len = st.st_size;
+
+  if (memcmp(data, REG_CACHE_FILE_MAGIC, REG_CACHE_FILE_MAGIC_LEN)) {
+    ERROR("'%s' is not a register cache file\n", fname.c_str());
+    munmap(data, len);
+    data = NULL;
+    return false;
+  }
+  memcpy(&seq, data + REG_CACHE_FILE_MAGIC_LEN, sizeof(seq));
+
+  const char* pos = data + REG_CACHE_FILE_MAGIC_LEN + sizeof(uint32_t);
+  const char* end = data + len;
+  while (pos < end) {
+    uint32_t rec_len, hash;
+    if ((size_t)(end - pos) < 2 * sizeof(uint32_t))
+      break;
+    memcpy(&rec_len, pos, sizeof(rec_len));
+    memcpy(&hash, pos + sizeof(uint32_t), sizeof(hash));
+    const char* rec = pos + 2 * sizeof(uint32_t);
+    if ((size_t)(end - rec) < rec_len ||
+	hashlittle(rec, rec_len, 0) != hash)
+      break;
+
+    records.push_back(std::make_pair(rec, (size_t)rec_len));
+    pos = rec + rec_len;
+  }
+
+  if (pos < end) {
+    // e.g. crashed while writing
+    WARN("%s: ignoring %lu bytes after the last complete record\n",
+	 fname.c_str(), (unsigned long)(end - pos));
+  }
+  return true;
+}
+
+void RegCacheFileStorage::applyRecord(const char* rec, size_t len, long int now)
+{
+  RecordReader r(rec, len);
+  switch (r.type()) {
+  case REC_UPDATE: {
+    AliasEntry ae;
+    ae.aor = r.str();
+    ae.alias = r.str();
+    long int reg_expire = r.i64();
+    ae.contact_uri = r.str();
+    ae.source_ip = r.str();
+    ae.source_port = r.u16();
+    ae.trsp = r.str();
+    ae.local_if = r.u16();
+    ae.remote_ua = r.str();
+    ae.ua_expire = r.i64();
+    if (!r.ok)
+      break;
+
+    if (reg_expire > now)
+      cache->update(ae.alias, reg_expire, ae);
+    else
+      cache->remove(ae.aor, ae.contact_uri, ae.alias);
+  } break;
+
+  case REC_UA_EXPIRES: {
+    string alias = r.str();
+    long int ua_expire = r.i64();
+    if (r.ok)
+      cache->updateAliasExpires(alias, ua_expire);
+  } break;
+
+  case REC_DELETE: {
+    string aor = r.str();
+    string uri = r.str();
+    string alias = r.str();
+    if (r.ok)
+      cache->remove(aor, uri, alias);
+  } break;
+
+  default:
+    r.ok = false;
+  }
+
+  if (!r.ok)
+    WARN("ignoring malformed register cache record\n");
+}
+
+bool RegCacheFileStorage::restore()
+{
+  struct timeval start, end, diff;
+  gettimeofday(&start, NULL);
+
+  struct stat st;
+  if (stat(dir.c_str(), &st) || !S_ISDIR(st.st_mode)) {
+    ERROR("register cache storage directory '%s' not found\n", dir.c_str());
+    return false;
+  }
+
+  unsigned int first_journal = 0;
+  size_t snapshot_records = 0;
+  string snapshot = dir + "/" REG_CACHE_SNAPSHOT;
+  if (!access(snapshot.c_str(), F_OK)) {
+    vector<std::pair<const char*, size_t> > records;
+    char* data;
+    size_t len;
+    if (!readFile(snapshot, first_journal, records, data, len))
+      return false;
+
+    // each binding is only once in a snapshot, so they can be
+    // inserted in any order
+    unsigned int n = restore_threads ? restore_threads : 1;
+    if (n > records.size())
+      n = records.size() ? records.size() : 1;
+    vector<RegCacheRestoreThread*> threads;
+    for (unsigned int i = 0; i < n; i++) {
+      threads.push_back(new RegCacheRestoreThread(this, records,
+						  records.size() * i / n,
+						  records.size() * (i+1) / n,
+						  start.tv_sec));
+      threads.back()->start();
+    }
+    for (unsigned int i = 0; i < n; i++) {
+      threads[i]->join();
+      delete threads[i];
+    }
+
+    snapshot_records = records.size();
+    munmap(data, len);
+  }
+
+  // journals written after the snapshot, in order
+  vector<unsigned int> journals;
+  DIR* d = opendir(dir.c_str());
+  if (d) {
+    struct dirent* e;
+    while ((e = readdir(d)) != NULL) {
+      unsigned int seq;
+      if (!strncmp(e->d_name, REG_CACHE_JOURNAL, strlen(REG_CACHE_JOURNAL)) &&
+	  !str2i(e->d_name + strlen(REG_CACHE_JOURNAL), seq) &&
+	  seq >= first_journal) {
+	journals.push_back(seq);
+      }
+    }
+    closedir(d);
+  }
+  std::sort(journals.begin(), journals.end());
+
+  size_t journal_records = 0;
+  for (vector<unsigned int>::iterator it = journals.begin();
+       it != journals.end(); it++) {
+    vector<std::pair<const char*, size_t> > records;
+    char* data;
+    size_t len;
+    unsigned int seq;
+    if (!readFile(journalName(*it), seq, records, data, len))
+      continue;
+
+    for (size_t i = 0; i < records.size(); i++)
+      applyRecord(records[i].first, records[i].second, start.tv_sec);
+
+    journal_records += records.size();
+    munmap(data, len);
+  }
+
+  journal_seq = journals.empty() ? first_journal : journals.back();
+  if (!openJournal(journal_seq + 1))
+    return false;
+
+  gettimeofday(&end, NULL);
+  timersub(&end, &start, &diff);
+  restored_bindings = cache->getActiveRegs();
+  restore_time = diff.tv_sec + diff.tv_usec / 1e6;
+
+  INFO("register cache: restored %u bindings from '%s' in %.3fs "
+       "(%zd snapshot records, %zd records in %zd journals)\n",
+       restored_bindings, dir.c_str(), restore_time,
+       snapshot_records, journal_records, journals.size());
+  return true;
+}
+
+void RegCacheFileStorage::run()
+{
+  writeSnapshot();
+
+  while (running.get()) {
+    usleep(REG_CACHE_JOURNAL_FLUSH_MS * 1000);
+    flush();
+
+    if (snapshot_interval &&
+	time(NULL) - last_snapshot >= (time_t)snapshot_interval)
+      writeSnapshot();
+  }
+}
+
+void RegCacheFileStorage::on_stop()
+{
+  running.set(false);
+}
+
+void RegCacheFileStorage::onDelete(const string& aor, const string& uri,
+				   const string& alias)
+{
+  string rec(1, REC_DELETE);
+  put_str(rec, aor);
+  put_str(rec, uri);
+  put_str(rec, alias);
+  appendRecord(rec);
+}
+
+void RegCacheFileStorage::onUpdate(const string& canon_aor, const string& alias,
+				   long int expires, const AliasEntry& alias_update)
+{
+  appendRecord(update_record(canon_aor, alias, expires, alias_update));
+}
+
+void RegCacheFileStorage::onUpdate(const string& alias, long int ua_expires)
+{
+  string rec(1, REC_UA_EXPIRES);
+  put_str(rec, alias);
+  put_i64(rec, ua_expires);
+  appendRecord(rec);
+}
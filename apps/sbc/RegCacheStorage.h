@@ -0,0 +1,135 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _RegCacheStorage_h_
+#define _RegCacheStorage_h_
+
+#include "RegisterCache.h"
+#include "AmThread.h"
+#include "atomic_types.h"
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+/** how often changes are written to the journal (ms) */
+#define REG_CACHE_JOURNAL_FLUSH_MS 100
+
+#define DEFAULT_REG_CACHE_SNAPSHOT_INTERVAL 300 /* s */
+#define DEFAULT_REG_CACHE_RESTORE_THREADS   4
+
+/**
+ * \brief register cache storage in files
+ *
+ * Each change of the register cache is appended as a binary record to
+ * a journal file (by this thread, every REG_CACHE_JOURNAL_FLUSH_MS). From
+ * time to time all bindings are written to a snapshot, and a new
+ * journal is started with it. On startup, restore() reads the snapshot,
+ * re-inserts its bindings with several threads, and replays the
+ * journals written after it, so that registered UAs stay reachable
+ * over a restart without re-registering.
+ *
+ * Files in the storage directory (host byte order):
+ *   regcache.snapshot     bindings, and the first journal to replay
+ *   regcache.journal.<n>  changes since the snapshot
+ */
+class RegCacheFileStorage
+  : public RegCacheStorageHandler,
+    public AmThread
+{
+  _RegisterCache* cache;
+  string dir;
+  unsigned int snapshot_interval;
+  unsigned int restore_threads;
+
+  /** records not yet written to the journal */
+  string journal_buf;
+  int journal_fd;
+  unsigned int journal_seq;
+  AmMutex journal_mut;
+
+  time_t last_snapshot;
+  AmSharedVar<bool> running;
+
+  // stats
+  atomic_int64 journal_records;
+  atomic_int   snapshots_written;
+  unsigned int restored_bindings;
+  double       restore_time;
+
+  string journalName(unsigned int seq);
+  bool openJournal(unsigned int seq);
+  void appendRecord(const string& rec);
+
+  /**
+   * Map a snapshot or journal file and find its records.
+   * @return false if it could not be read
+   */
+  bool readFile(const string& fname, unsigned int& seq,
+		vector<std::pair<const char*, size_t> >& records,
+		char*& data, size_t& len);
+
+  /* AmThread interface */
+  void run();
+  void on_stop();
+
+public:
+  RegCacheFileStorage(_RegisterCache* cache, const string& dir,
+		      unsigned int snapshot_interval,
+		      unsigned int restore_threads);
+  ~RegCacheFileStorage();
+
+  /**
+   * Restore the register cache from the files
+   * (before this is set as storage handler).
+   * @return false on error
+   */
+  bool restore();
+
+  /** write the pending records to the journal */
+  void flush();
+
+  /** start a new journal and write a snapshot */
+  bool writeSnapshot();
+
+  /** apply a record to the register cache */
+  void applyRecord(const char* rec, size_t len, long int now);
+
+  /* RegCacheStorageHandler interface */
+  void onDelete(const string& aor, const string& uri, const string& alias);
+  void onUpdate(const string& canon_aor, const string& alias,
+		long int expires, const AliasEntry& alias_update);
+  void onUpdate(const string& alias, long int ua_expires);
+
+  unsigned long long getJournalRecords() { return journal_records.get(); }
+  unsigned int getSnapshotsWritten() { return snapshots_written.get(); }
+  unsigned int getRestoredBindings() { return restored_bindings; }
+  /** @return duration of restore() in seconds */
+  double getRestoreTime() { return restore_time; }
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "RegExpiryWheel.h"
+
+using std::make_pair;
+
+RegExpiryTimer::~RegExpiryTimer()
+{
+  if(wheel)
+    wheel->unschedule(this);
+}
+
+RegExpiryWheel::RegExpiryWheel(long int now)
+  : clock(now), scheduled(0)
+{
+  for(int w = 0; w < REG_EXPIRY_WHEELS; w++)
+    for(int s = 0; s < REG_EXPIRY_WHEEL_SLOTS; s++)
+      init_list(&wheels[w][s]);
+
+  init_list(&due);
+}
+
+void RegExpiryWheel::init_list(RegExpiryTimer* head)
+{
+  head->prev = head->next = head;
+}
+
+void RegExpiryWheel::append(RegExpiryTimer* head, RegExpiryTimer* t)
+{
+  t->next = head;
+  t->prev = head->prev;
+  head->prev->next = t;
+  head->prev = t;
+}
+
+void RegExpiryWheel::unlink(RegExpiryTimer* t)
+{
+  t->prev->next = t->next;
+  t->next->prev = t->prev;
+  t->prev = t->next = NULL;
+}
+
+void RegExpiryWheel::place(RegExpiryTimer* t)
+{
+  if(t->expires <= clock) {
+    append(&due,t);
+    return;
+  }
+
+  // first wheel in which the timer's slot is less than
+  // a full turn ahead of the clock
+  for(int w = 0; w < REG_EXPIRY_WHEELS; w++) {
+    int shift = w * REG_EXPIRY_WHEEL_BITS;
+    long int ahead = (t->expires >> shift) - (clock >> shift);
+    if(ahead < REG_EXPIRY_WHEEL_SLOTS) {
+      append(&wheels[w][(t->expires >> shift) & REG_EXPIRY_WHEEL_MASK],t);
+      return;
+    }
+  }
+
+  // beyond the last wheel: park it in its last slot,
+  // it will be placed again from there
+  int shift = (REG_EXPIRY_WHEELS - 1) * REG_EXPIRY_WHEEL_BITS;
+  unsigned int slot = ((clock >> shift) + REG_EXPIRY_WHEEL_SLOTS - 1)
+    & REG_EXPIRY_WHEEL_MASK;
+  append(&wheels[REG_EXPIRY_WHEELS - 1][slot],t);
+}
+
+void RegExpiryWheel::cascade(int wheel, unsigned int slot)
+{
+  RegExpiryTimer* head = &wheels[wheel][slot];
+  RegExpiryTimer* t = head->next;
+  init_list(head);
+
+  while(t != head) {
+    RegExpiryTimer* next = t->next;
+    place(t);
+    t = next;
+  }
+}
+
+void RegExpiryWheel::schedule(RegExpiryTimer* t, long int expires)
+{
+  mut.lock();
+  if(t->next)
+    unlink(t);
+  else
+    scheduled++;
+
+  t->wheel = this;
+  t->expires = expires;
+  place(t);
+  mut.unlock();
+}
+
+void RegExpiryWheel::unschedule(RegExpiryTimer* t)
+{
+  mut.lock();
+  if(t->next) {
+    unlink(t);
+    scheduled--;
+  }
+  mut.unlock();
+}
+
+void RegExpiryWheel::expire(long int now,
+			    vector<pair<string,string> >& expired)
+{
+  mut.lock();
+  while(clock < now) {
+    clock++;
+
+    // cascade the wheels which have completed a turn,
+    // outer ones first
+    int w = 1;
+    while(w < REG_EXPIRY_WHEELS &&
+	  !(clock & ((1L << (w * REG_EXPIRY_WHEEL_BITS)) - 1)))
+      w++;
+
+    for(w--; w > 0; w--) {
+      cascade(w,(clock >> (w * REG_EXPIRY_WHEEL_BITS))
+	      & REG_EXPIRY_WHEEL_MASK);
+    }
+
+    cascade(0,clock & REG_EXPIRY_WHEEL_MASK);
+  }
+
+  while(due.next != &due) {
+    RegExpiryTimer* t = due.next;
+    expired.push_back(make_pair(*t->aor,*t->idx));
+    unlink(t);
+    scheduled--;
+  }
+  mut.unlock();
+}
+
+unsigned int RegExpiryWheel::getScheduled()
+{
+  mut.lock();
+  unsigned int res = scheduled;
+  mut.unlock();
+  return res;
+}
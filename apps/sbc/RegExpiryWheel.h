@@ -0,0 +1,131 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _RegExpiryWheel_h_
+#define _RegExpiryWheel_h_
+
+#include "AmThread.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+using std::string;
+using std::vector;
+using std::pair;
+
+#define REG_EXPIRY_WHEEL_BITS  6
+#define REG_EXPIRY_WHEEL_SLOTS (1 << REG_EXPIRY_WHEEL_BITS)
+#define REG_EXPIRY_WHEEL_MASK  (REG_EXPIRY_WHEEL_SLOTS - 1)
+
+/* 64s, ~68min, ~3days, ~194days */
+#define REG_EXPIRY_WHEELS      4
+
+class RegExpiryWheel;
+
+/**
+ * \brief expiry timer of a register cache binding
+ *
+ * Embedded into the binding, and unscheduled when destroyed. 'aor'
+ * and 'idx' point to the keys under which the binding is stored in
+ * the register cache; they must stay valid while it is scheduled.
+ * Copies are never scheduled.
+ */
+struct RegExpiryTimer
+{
+  RegExpiryTimer* prev;
+  RegExpiryTimer* next;
+  long int expires;
+
+  // set on first use, never reset
+  RegExpiryWheel* wheel;
+
+  const string* aor;
+  const string* idx;
+
+  RegExpiryTimer()
+    : prev(NULL), next(NULL), expires(0),
+      wheel(NULL), aor(NULL), idx(NULL)
+  {}
+
+  RegExpiryTimer(const RegExpiryTimer&)
+    : prev(NULL), next(NULL), expires(0),
+      wheel(NULL), aor(NULL), idx(NULL)
+  {}
+
+  RegExpiryTimer& operator=(const RegExpiryTimer&) { return *this; }
+
+  ~RegExpiryTimer();
+};
+
+/**
+ * \brief hierarchical timer wheel for register cache expiry
+ *
+ * Timers are kept in REG_EXPIRY_WHEELS wheels of REG_EXPIRY_WHEEL_SLOTS
+ * slots with a resolution of one second; the first wheel holds the
+ * timers of the next 64 seconds, the next ones cover 64 times the
+ * range of the previous one each. When the first wheel has turned, the
+ * next slot of the second wheel is spread over the first one, and so
+ * on. Thus advancing the clock touches only the timers due (and, once
+ * in a while, a slot to cascade), whatever the number of timers.
+ */
+class RegExpiryWheel
+{
+  RegExpiryTimer wheels[REG_EXPIRY_WHEELS][REG_EXPIRY_WHEEL_SLOTS];
+
+  // expired, to be collected
+  RegExpiryTimer due;
+
+  // last second processed
+  long int clock;
+
+  unsigned int scheduled;
+  AmMutex mut;
+
+  static void init_list(RegExpiryTimer* head);
+  static void append(RegExpiryTimer* head, RegExpiryTimer* t);
+  static void unlink(RegExpiryTimer* t);
+
+  void place(RegExpiryTimer* t);
+  void cascade(int wheel, unsigned int slot);
+
+public:
+  RegExpiryWheel(long int now);
+
+  /** (Re-)schedule 't' to expire at 'expires' (unix time) */
+  void schedule(RegExpiryTimer* t, long int expires);
+
+  void unschedule(RegExpiryTimer* t);
+
+  /**
+   * Advance the clock to 'now', and collect the keys of all timers
+   * expired meanwhile. These are unscheduled.
+   */
+  void expire(long int now, vector<pair<string,string> >& expired);
+
+  unsigned int getScheduled();
+};
+
+#endif
@@ -25,38 +25,51 @@
 #include "RegexMapper.h"
 #include "log.h"
 
+RegexMapper::~RegexMapper() {
+  for (std::map<string, SharedRegexMapping*>::iterator it =
+	 regex_mappings.begin(); it != regex_mappings.end(); it++)
+    dec_ref(it->second);
+}
+
 bool RegexMapper::mapRegex(const string& mapping_name, const char* test_s,
 			   string& result) {
   lock();
-  std::map<string, RegexMappingVector>::iterator it=regex_mappings.find(mapping_name);
+  std::map<string, SharedRegexMapping*>::iterator it=regex_mappings.find(mapping_name);
   if (it == regex_mappings.end()) {
     unlock();
     ERROR("regex mapping '%s' is not loaded!\n", mapping_name.c_str());
     return false;
   }
 
-  bool res = run_regex_mapping(it->second, test_s, result);
+  SharedRegexMapping* mapping = it->second;
+  inc_ref(mapping);
   unlock();
+
+  bool res = mapping->run(test_s, result);
+  dec_ref(mapping);
   return res;
 }
 
-void RegexMapper::setRegexMap(const string& mapping_name, const RegexMappingVector& r) {
+void RegexMapper::setRegexMap(const string& mapping_name, SharedRegexMapping* r) {
+  inc_ref(r);
+
+  SharedRegexMapping* old = NULL;
   lock();
-  std::map<string, RegexMappingVector>::iterator it=regex_mappings.find(mapping_name);
-  if (it != regex_mappings.end()) {
-    for (RegexMappingVector::iterator r_it =
-	   it->second.begin(); r_it != it->second.end(); r_it++) {
-      regfree(&r_it->first);
-    }
-  }
+  std::map<string, SharedRegexMapping*>::iterator it=regex_mappings.find(mapping_name);
+  if (it != regex_mappings.end())
+    old = it->second;
   regex_mappings[mapping_name] = r;
   unlock();
+
+  // freed here or by the last lookup still using it
+  if (old)
+    dec_ref(old);
 }
 
 std::vector<std::string> RegexMapper::getNames() {
   std::vector<std::string> res;
   lock();
-  for (std::map<string, RegexMappingVector>::iterator it=
+  for (std::map<string, SharedRegexMapping*>::iterator it=
 	 regex_mappings.begin(); it != regex_mappings.end(); it++)
     res.push_back(it->first);
   unlock();
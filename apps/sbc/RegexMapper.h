@@ -27,18 +27,33 @@
 #define _RegexMapper_h_
 
 #include "AmUtils.h"
+#include "atomic_types.h"
 
 #include <map>
 #include <vector>
 #include <string>
 #include "AmThread.h"
 
+/** regex mapping shared by lookups in progress and the mapper */
+struct SharedRegexMapping
+  : public RegexMapping,
+    public atomic_ref_cnt
+{
+};
+
+/**
+ * \brief named regex mappings ($M() in profiles)
+ *
+ * A lookup only holds the lock while getting a reference to the
+ * mapping; a reloaded mapping replaces the old one, which is freed
+ * when the last lookup using it is finished.
+ */
 struct RegexMapper {
 
   RegexMapper() { }
-  ~RegexMapper() { }
+  ~RegexMapper();
 
-  std::map<string, RegexMappingVector> regex_mappings;
+  std::map<string, SharedRegexMapping*> regex_mappings;
   AmMutex regex_mappings_mut;
 
   void lock() { regex_mappings_mut.lock(); }
@@ -47,7 +62,8 @@ struct RegexMapper {
   bool mapRegex(const string& mapping_name, const char* test_s,
 		string& result);
 
-  void setRegexMap(const string& mapping_name, const RegexMappingVector& r);
+  /** replace (or add) a mapping; r is owned by the mapper afterwards */
+  void setRegexMap(const string& mapping_name, SharedRegexMapping* r);
 
   std::vector<std::string> getNames();
 };
@@ -10,15 +10,16 @@
 #include "AmUtils.h"
 #include "SBCEventLog.h"
 
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
 #include <utility>
 using std::pair;
 using std::make_pair;
 
-#define REG_CACHE_CYCLE 10L /* 10 seconds to expire all buckets */
-
- /* in us */
-#define REG_CACHE_SINGLE_CYCLE \
-  ((REG_CACHE_CYCLE*1000000L)/REG_CACHE_TABLE_ENTRIES)
+/* max. sleep of the register cache thread (us) */
+#define REG_CACHE_MAX_SLEEP 100000L
 
 static unsigned int hash_1str(const string& str)
 {
@@ -68,42 +69,26 @@ void AorBucket::dump_elmt(const string& aor,
   }
 }
 
-void AorBucket::gbc(RegCacheStorageHandler* h, long int now, 
-		    list<string>& alias_list)
+const string* AorBucket::getKey(const string& aor)
 {
-  for(value_map::iterator it = elmts.begin(); it != elmts.end();) {
-
-    AorEntry* aor_e = it->second;
-    if(aor_e) {
-
-      for(AorEntry::iterator reg_it = aor_e->begin();
-	  reg_it != aor_e->end();) {
-
-	RegBinding* binding = reg_it->second;
-
-	if(binding && (binding->reg_expire <= now)) {
-
-	  alias_list.push_back(binding->alias);
-	  AorEntry::iterator del_it = reg_it++;
+  value_map::iterator it = find(aor);
+  if(it == elmts.end())
+    return NULL;
 
-	  DBG("delete binding: '%s' -> '%s' (%li <= %li)",
-	      del_it->first.c_str(),binding->alias.c_str(),
-	      binding->reg_expire,now);
+  return &it->first;
+}
 
-	  delete binding;
-	  aor_e->erase(del_it);
-	  continue;
-	}
-	reg_it++;
-      }
-    }
-    if(!aor_e || aor_e->empty()) {
-      DBG("delete empty AOR: '%s'", it->first.c_str());
-      value_map::iterator del_it = it++;
-      elmts.erase(del_it);
+void AorBucket::getBindings(vector<pair<string,RegBinding> >& bindings)
+{
+  for(value_map::iterator it = elmts.begin(); it != elmts.end(); it++) {
+    if(!it->second)
       continue;
+
+    for(AorEntry::iterator reg_it = it->second->begin();
+	reg_it != it->second->end(); reg_it++) {
+      if(reg_it->second)
+	bindings.push_back(make_pair(it->first,*reg_it->second));
     }
-    it++;
   }
 }
 
@@ -188,7 +173,8 @@ struct RegCacheLogHandler
 _RegisterCache::_RegisterCache()
   : reg_cache_ht(REG_CACHE_TABLE_ENTRIES),
     id_idx(REG_CACHE_TABLE_ENTRIES),
-    contact_idx(REG_CACHE_TABLE_ENTRIES)
+    contact_idx(REG_CACHE_TABLE_ENTRIES),
+    expiry_wheel(time(NULL))
 {
   // debug register cache WRITE operations
   setStorageHandler(new RegCacheLogHandler());
@@ -205,24 +191,79 @@ _RegisterCache::~_RegisterCache()
   DBG("##### DUMP END #####");
 }
 
-void _RegisterCache::gbc(unsigned int bucket_id)
+void _RegisterCache::scheduleExpiry(AorBucket* bucket, const string& canon_aor,
+				    AorEntry* aor_e, const string& idx,
+				    RegBinding* binding)
 {
-  // if(!bucket_id) {
-  //   DBG("REG CACHE GBC CYCLE starting...");
-  // }
+  AorEntry::iterator it = aor_e->find(idx);
+  binding->expiry.aor = bucket->getKey(canon_aor);
+  binding->expiry.idx = (it != aor_e->end()) ? &it->first : NULL;
+
+  if(!binding->expiry.aor || !binding->expiry.idx) {
+    ERROR("binding '%s' not found in AOR '%s': not scheduling its expiry",
+	  idx.c_str(),canon_aor.c_str());
+    expiry_wheel.unschedule(&binding->expiry);
+    return;
+  }
 
-  struct timeval now;
-  gettimeofday(&now,NULL);
+  expiry_wheel.schedule(&binding->expiry,binding->reg_expire);
+}
 
-  AorBucket* bucket = reg_cache_ht.get_bucket(bucket_id);
-  bucket->lock();
-  list<string> alias_list;
-  bucket->gbc(storage_handler.get(),now.tv_sec,alias_list);
-  for(list<string>::iterator it = alias_list.begin();
-      it != alias_list.end(); it++){
-    removeAlias(*it,true);
+void _RegisterCache::expireBindings(long int now)
+{
+  struct timespec cpu_start,cpu_end;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID,&cpu_start);
+
+  vector<pair<string,string> > expired;
+  expiry_wheel.expire(now,expired);
+
+  for(vector<pair<string,string> >::iterator it = expired.begin();
+      it != expired.end(); it++) {
+
+    const string& canon_aor = it->first;
+    AorBucket* bucket = getAorBucket(canon_aor);
+    bucket->lock();
+
+    AorEntry* aor_e = bucket->get(canon_aor);
+    AorEntry::iterator reg_it;
+    if(!aor_e || ((reg_it = aor_e->find(it->second)) == aor_e->end()) ||
+       !reg_it->second || (reg_it->second->reg_expire > now)) {
+      // removed or re-scheduled meanwhile
+      bucket->unlock();
+      continue;
+    }
+
+    RegBinding* binding = reg_it->second;
+    string alias = binding->alias;
+
+    DBG("delete binding: '%s' -> '%s' (%li <= %li)",
+	reg_it->first.c_str(),alias.c_str(),binding->reg_expire,now);
+
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    long long delay = (tv.tv_sec - binding->reg_expire) * 1000LL
+      + tv.tv_usec / 1000;
+    if(delay < 0) delay = 0;
+    expiry_delay_total.inc(delay);
+    if((unsigned long long)delay > expiry_delay_max.get())
+      expiry_delay_max.set(delay);
+    expired_regs.inc();
+
+    delete binding;
+    aor_e->erase(reg_it);
+    if(aor_e->empty()) {
+      DBG("delete empty AOR: '%s'", canon_aor.c_str());
+      bucket->remove(canon_aor);
+    }
+
+    removeAlias(alias,true);
+    bucket->unlock();
   }
-  bucket->unlock();
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID,&cpu_end);
+  expiry_cpu_time.inc((cpu_end.tv_sec - cpu_start.tv_sec) * 1000000LL
+		      + (cpu_end.tv_nsec - cpu_start.tv_nsec) / 1000);
+  expiry_runs.inc();
 }
 
 void _RegisterCache::on_stop()
@@ -232,19 +273,22 @@ void _RegisterCache::on_stop()
 
 void _RegisterCache::run()
 {
-  struct timespec tick,rem;
-  tick.tv_sec  = (REG_CACHE_SINGLE_CYCLE/1000000L);
-  tick.tv_nsec = (REG_CACHE_SINGLE_CYCLE - (tick.tv_sec)*1000000L) * 1000L;
-
   running.set(true);
 
-  gbc_bucket_id = 0;
+  long int last = 0;
   while(running.get()) {
-    gbc(gbc_bucket_id);
-    gbc_bucket_id = (gbc_bucket_id+1);
-    gbc_bucket_id &= (REG_CACHE_TABLE_ENTRIES-1);
-    nanosleep(&tick,&rem);
-  }  
+    struct timeval now;
+    gettimeofday(&now,NULL);
+    if(now.tv_sec != last) {
+      expireBindings(now.tv_sec);
+      last = now.tv_sec;
+    }
+
+    // wake up at the next full second
+    gettimeofday(&now,NULL);
+    long int sleep_us = 1000000L - now.tv_usec;
+    usleep(sleep_us < REG_CACHE_MAX_SLEEP ? sleep_us : REG_CACHE_MAX_SLEEP);
+  }
 }
 
 /**
@@ -437,6 +481,7 @@ void _RegisterCache::update(const string& alias, long int reg_expires,
   }
   // and update binding
   binding->reg_expire = reg_expires;
+  scheduleExpiry(bucket,canon_aor,aor_e,uri + "/" + public_ip,binding);
 
   AliasEntry* alias_e = alias_bucket->getContact(alias);
   // if no alias map entry, insert a new one
@@ -517,6 +562,7 @@ void _RegisterCache::update(long int reg_expires, const AliasEntry& alias_update
 	}
 
 	// relink binding with the new index
+	expiry_wheel.unschedule(&binding->expiry);
       	aor_e->erase(binding_it);
 	aor_e->insert(AorEntry::value_type(idx, binding));
       }
@@ -560,6 +606,7 @@ void _RegisterCache::update(long int reg_expires, const AliasEntry& alias_update
   }
   // and update binding
   binding->reg_expire = reg_expires;
+  scheduleExpiry(bucket,canon_aor,aor_e,idx,binding);
 
   AliasBucket* alias_bucket = getAliasBucket(binding->alias);
   alias_bucket->lock();
@@ -778,6 +825,26 @@ bool _RegisterCache::findAliasEntry(const string& alias, AliasEntry& alias_entry
   return res;
 }
 
+void _RegisterCache::visitBindings(RegCacheVisitor& v)
+{
+  for(unsigned int i = 0; i < REG_CACHE_TABLE_ENTRIES; i++) {
+    AorBucket* bucket = reg_cache_ht.get_bucket(i);
+    bucket->lock();
+
+    vector<pair<string,RegBinding> > bindings;
+    bucket->getBindings(bindings);
+    for(vector<pair<string,RegBinding> >::iterator it = bindings.begin();
+	it != bindings.end(); it++) {
+      AliasEntry ae;
+      if(findAliasEntry(it->second.alias,ae))
+	v.visit(it->first,it->second,ae);
+    }
+
+    bucket->unlock();
+    v.bucketDone();
+  }
+}
+
 bool _RegisterCache::findAEByContact(const string& contact_uri,
 				     const string& remote_ip,
 				     unsigned short remote_port,
@@ -856,7 +923,7 @@ int _RegisterCache::parseExpires(RegisterCacheCtx& ctx,
   if (!expires_str.empty() && str2i(expires_str, ctx.requested_expires)) {
     AmBasicSipDialog::reply_error(req, 400, "Bad Request", 
 				  "Warning: Malformed expires\r\n", logger);
-    return true; // error reply sent
+    return -1; // error reply sent
   }
   ctx.expires_parsed = true;
   return 0;
@@ -871,6 +938,19 @@ bool _RegisterCache::throttleRegister(RegisterCacheCtx& ctx,
     return false; // fwd
   }
 
+  bool res = throttleRegisterContacts(ctx,req,logger);
+  if(!res)
+    throttle_misses.inc();
+  else if(ctx.throttled)
+    throttle_hits.inc();
+
+  return res;
+}
+
+bool _RegisterCache::throttleRegisterContacts(RegisterCacheCtx& ctx,
+					      const AmSipRequest& req,
+					      msg_logger *logger)
+{
   if (req.contact.empty() || (req.contact == "*")) {
     // binding query or unregister
     DBG("req.contact.empty() || (req.contact == \"*\")\n");
@@ -884,11 +964,11 @@ bool _RegisterCache::throttleRegister(RegisterCacheCtx& ctx,
     return true; // error reply sent
   }
 
-  unsigned int default_expires;
-  if(ctx.requested_expires && (ctx.requested_expires > ctx.max_ua_expires))
+  // Expires header (or DEFAULT_REG_EXPIRES), capped by max_ua_expires
+  // if that is set
+  unsigned int default_expires = ctx.requested_expires;
+  if(ctx.max_ua_expires && (default_expires > ctx.max_ua_expires))
     default_expires = ctx.max_ua_expires;
-  else
-    default_expires = ctx.requested_expires;
 
   vector<pair<string, long int> > alias_updates;
   for(vector<AmUriParser>::iterator contact_it = ctx.contacts.begin();
@@ -944,6 +1024,7 @@ bool _RegisterCache::throttleRegister(RegisterCacheCtx& ctx,
     if(contact_expires + 4 /* 4 seconds buffer */ 
        >= reg_binding.reg_expire) {
       DBG("%li + 4 >= %li",contact_expires,reg_binding.reg_expire);
+      throttle_refreshes.inc();
       return false; // fwd
     }
     
@@ -989,6 +1070,7 @@ bool _RegisterCache::throttleRegister(RegisterCacheCtx& ctx,
 
   // send 200 reply
   AmBasicSipDialog::reply_error(req, 200, "OK", contact_hdr, logger);
+  ctx.throttled = true;
   return true;
 }
 
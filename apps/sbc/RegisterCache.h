@@ -8,13 +8,18 @@
 #include "AmSipMsg.h"
 #include "AmUriParser.h"
 #include "AmAppTimer.h"
+#include "RegExpiryWheel.h"
 
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
+#include <utility>
 using std::string;
 using std::map;
 using std::auto_ptr;
+using std::vector;
+using std::pair;
 
 #define REG_CACHE_TABLE_POWER   10
 #define REG_CACHE_TABLE_ENTRIES (1<<REG_CACHE_TABLE_POWER)
@@ -39,6 +44,9 @@ struct RegBinding
   // unique-id used as contact user toward the registrar
   string alias;
 
+  // fires at reg_expire
+  RegExpiryTimer expiry;
+
   RegBinding()
     : reg_expire(0)
   {}
@@ -80,6 +88,8 @@ struct AliasEntry
 
 struct RegCacheStorageHandler 
 {
+  virtual ~RegCacheStorageHandler() {}
+
   virtual void onDelete(const string& aor, const string& uri, 
 			const string& alias) {}
 
@@ -89,6 +99,21 @@ struct RegCacheStorageHandler
   virtual void onUpdate(const string& alias, long int ua_expires) {}
 };
 
+/**
+ * Called for every binding by _RegisterCache::visitBindings()
+ */
+struct RegCacheVisitor
+{
+  virtual ~RegCacheVisitor() {}
+
+  /** called with the AoR bucket locked: must not block */
+  virtual void visit(const string& canon_aor, const RegBinding& binding,
+		     const AliasEntry& alias_entry) = 0;
+
+  /** called after each AoR bucket, once it has been unlocked */
+  virtual void bucketDone() {}
+};
+
 /**
  * Hash-table bucket:
  *   AoR -> AorEntry
@@ -107,9 +132,15 @@ public:
    */
   AorEntry* get(const string& aor);
 
+  /**
+   * Key under which the AOR's entry is stored
+   * (valid as long as the entry exists).
+   */
+  const string* getKey(const string& aor);
+
   /* Maintenance stuff */
 
-  void gbc(RegCacheStorageHandler* h, long int now, list<string>& alias_list);
+  void getBindings(vector<pair<string,RegBinding> >& bindings);
   void dump_elmt(const string& aor, const AorEntry* p_aor_entry) const;
 };
 
@@ -179,13 +210,17 @@ struct RegisterCacheCtx
   unsigned int min_reg_expires;
   unsigned int max_ua_expires;
 
+  // answered from the cache by throttleRegister()
+  bool throttled;
+
   RegisterCacheCtx()
     : aor_parsed(false),
       contacts_parsed(false),
       requested_expires(DEFAULT_REG_EXPIRES),
       expires_parsed(false),
       min_reg_expires(0),
-      max_ua_expires(0)
+      max_ua_expires(0),
+      throttled(false)
   {}
 };
 
@@ -198,14 +233,24 @@ class _RegisterCache
 
   auto_ptr<RegCacheStorageHandler> storage_handler;
 
-  unsigned int gbc_bucket_id;
+  RegExpiryWheel expiry_wheel;
 
   AmSharedVar<bool> running;
 
   // stats
   atomic_int active_regs;
-
-  void gbc(unsigned int bucket_id);
+  atomic_int64 expired_regs;
+  atomic_int64 expiry_delay_total; // ms
+  atomic_int64 expiry_delay_max;   // ms
+  atomic_int64 expiry_cpu_time;    // us
+  atomic_int64 expiry_runs;
+  atomic_int64 throttle_hits;
+  atomic_int64 throttle_misses;
+  atomic_int64 throttle_refreshes;
+
+  void scheduleExpiry(AorBucket* bucket, const string& canon_aor,
+		      AorEntry* aor_e, const string& idx,
+		      RegBinding* binding);
   void removeAlias(const string& alias, bool generate_event);
 
 protected:
@@ -241,6 +286,10 @@ protected:
   int parseContacts(RegisterCacheCtx& ctx, const AmSipRequest& req, msg_logger *logger);
   int parseExpires(RegisterCacheCtx& ctx, const AmSipRequest& req, msg_logger *logger);
 
+  bool throttleRegisterContacts(RegisterCacheCtx& ctx,
+				const AmSipRequest& req,
+				msg_logger *logger);
+
   void setAliasUATimer(AliasEntry* alias_e);
   void removeAliasUATimer(AliasEntry* alias_e);
 
@@ -351,10 +400,41 @@ public:
 			const AmSipRequest& req,
                         msg_logger *logger = NULL);
 
+  /**
+   * Call the visitor for all bindings, one AoR bucket after the
+   * other (locked meanwhile).
+   */
+  void visitBindings(RegCacheVisitor& v);
+
+  /**
+   * Remove the bindings expired at the registrar until 'now'.
+   * Called every second by the register cache thread.
+   */
+  void expireBindings(long int now);
+
   /**
    * Statistics
    */
   unsigned int getActiveRegs() { return active_regs.get(); }
+  unsigned long long getExpiredRegs() { return expired_regs.get(); }
+  unsigned int getScheduledExpiries() { return expiry_wheel.getScheduled(); }
+
+  /** delay between the expiry of bindings and their removal (ms) */
+  unsigned long long getExpiryDelayTotal() { return expiry_delay_total.get(); }
+  unsigned long long getExpiryDelayMax() { return expiry_delay_max.get(); }
+
+  /** CPU time spent removing expired bindings (us), and in how many runs */
+  unsigned long long getExpiryCPUTime() { return expiry_cpu_time.get(); }
+  unsigned long long getExpiryRuns() { return expiry_runs.get(); }
+
+  /**
+   * REGISTERs answered by throttleRegister() (not sent upstream),
+   * forwarded by it, and forwarded because the upstream binding
+   * was about to expire.
+   */
+  unsigned long long getThrottleHits() { return throttle_hits.get(); }
+  unsigned long long getThrottleMisses() { return throttle_misses.get(); }
+  unsigned long long getThrottleRefreshes() { return throttle_refreshes.get(); }
 };
 
 typedef singleton<_RegisterCache> RegisterCache;
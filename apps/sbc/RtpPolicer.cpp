@@ -0,0 +1,215 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "RtpPolicer.h"
+#include "AmAppTimer.h"
+#include "AmUtils.h"
+#include "log.h"
+
+#include <strings.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* pt_rate of payload types not policed */
+#define RTP_POLICER_UNLIMITED ((unsigned int)-1)
+
+#define RTP_POLICER_KEY(ssrc,pt) \
+  ((1ULL << 40) | ((u_int64_t)(ssrc) << 8) | (pt))
+
+_RtpPolicingStats::~_RtpPolicingStats()
+{
+  for(map<string,RtpPolicingCounters*>::iterator it = counters.begin();
+      it != counters.end(); it++) {
+    delete it->second;
+  }
+}
+
+RtpPolicingCounters* _RtpPolicingStats::get(const string& name)
+{
+  AmLock l(counters_mut);
+
+  map<string,RtpPolicingCounters*>::iterator it = counters.find(name);
+  if(it != counters.end())
+    return it->second;
+
+  RtpPolicingCounters* c = new RtpPolicingCounters();
+  counters[name] = c;
+  return c;
+}
+
+void _RtpPolicingStats::getReport(AmArg& ret)
+{
+  AmLock l(counters_mut);
+
+  ret.assertStruct();
+  for(map<string,RtpPolicingCounters*>::iterator it = counters.begin();
+      it != counters.end(); it++) {
+
+    AmArg& p = ret[it->first];
+    p["dropped_packets"] = (long long)it->second->dropped_packets.get();
+    p["dropped_bytes"] = (long long)it->second->dropped_bytes.get();
+    p["unknown_payload"] = (long long)it->second->unknown_payload.get();
+  }
+}
+
+RtpPolicer::RtpPolicer(unsigned int tolerance, RtpPolicingCounters* counters)
+  : active(-1), tolerance(tolerance), counters(counters)
+{
+  memset(pt_rate, 0, sizeof(pt_rate));
+}
+
+unsigned int RtpPolicer::getBitrate(const SdpPayload& p)
+{
+  static const struct {
+    const char* name;
+    unsigned int kbps;
+  } codecs[] = {
+    { "PCMU", 64 }, { "PCMA", 64 }, { "G722", 64 },
+    { "G729", 8 }, { "G723", 7 }, { "GSM", 14 }, { "iLBC", 16 },
+    { "AMR", 13 }, { "AMR-WB", 24 },
+    { "telephone-event", 8 }, { "CN", 2 },
+  };
+
+  const char* name = p.encoding_name.c_str();
+  for(unsigned int i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+    if(!strcasecmp(name,codecs[i].name))
+      return codecs[i].kbps;
+  }
+
+  // G726-16, G726-24, ...
+  if(!strncasecmp(name,"G726-",5))
+    return atoi(name + 5);
+
+  if(!strcasecmp(name,"L16") && (p.clock_rate > 0))
+    return p.clock_rate * 16 * (p.encoding_param > 0 ? p.encoding_param : 1) / 1000;
+
+  if(!strcasecmp(name,"speex"))
+    return (p.clock_rate > 16000) ? 44 : ((p.clock_rate > 8000) ? 42 : 25);
+
+  if(!strcasecmp(name,"opus")) {
+    size_t pos = p.sdp_format_parameters.find("maxaveragebitrate=");
+    if(pos != string::npos) {
+      int bps = atoi(p.sdp_format_parameters.c_str() + pos + 18);
+      if(bps > 0)
+	return (bps + 999) / 1000;
+    }
+  }
+
+  return 0;
+}
+
+void RtpPolicer::addCaps(const AmSdp& sdp, unsigned int* rates)
+{
+  for(vector<SdpMedia>::const_iterator m = sdp.media.begin();
+      m != sdp.media.end(); m++) {
+
+    if(!m->port)
+      continue;
+
+    for(vector<SdpPayload>::const_iterator p = m->payloads.begin();
+	p != m->payloads.end(); p++) {
+
+      if((p->payload_type < 0) || (p->payload_type >= 128))
+	continue;
+
+      unsigned int kbps = getBitrate(*p);
+      unsigned int rate = RTP_POLICER_UNLIMITED;
+      if(kbps) {
+	rate = (kbps * 1000 / 8 + RTP_POLICER_HDR_OVERHEAD)
+	  * (100 + tolerance) / 100;
+      }
+
+      // the higher one, if used for different codecs
+      if(rate > rates[p->payload_type])
+	rates[p->payload_type] = rate;
+    }
+  }
+}
+
+void RtpPolicer::setCaps(const AmSdp& offer, const AmSdp& answer)
+{
+  unsigned int rates[128];
+  memset(rates, 0, sizeof(rates));
+
+  addCaps(offer, rates);
+  addCaps(answer, rates);
+
+  // publish the new table only once it is complete
+  int next = (active == 0) ? 1 : 0;
+  memcpy(pt_rate[next], rates, sizeof(rates));
+  __sync_synchronize();
+  active = next;
+}
+
+RtpPolicer::Slot* RtpPolicer::getSlot(u_int64_t key)
+{
+  for(int i = 0; i < RTP_POLICER_SLOTS; i++) {
+    if(slots[i].key == key)
+      return &slots[i];
+  }
+
+  // take a free slot, or one of a stream not seen for a while
+  u_int32_t now = AmAppTimer::instance()->wall_clock;
+  for(int i = 0; i < RTP_POLICER_SLOTS; i++) {
+    u_int64_t k = slots[i].key;
+    if(k && (now - slots[i].limit.getLastUpdate() <= RTP_POLICER_IDLE_TICKS))
+      continue;
+
+    if(__sync_bool_compare_and_swap(&slots[i].key, k, key)) {
+      slots[i].limit.reset();
+      return &slots[i];
+    }
+  }
+
+  return &slots[RTP_POLICER_SLOTS];
+}
+
+bool RtpPolicer::police(unsigned int ssrc, unsigned char pt, unsigned int size)
+{
+  int t = active;
+  if(t < 0)
+    return false; // nothing negotiated yet
+
+  unsigned int rate = pt_rate[t][pt & 0x7f];
+  if(rate == RTP_POLICER_UNLIMITED)
+    return false;
+
+  if(!rate) {
+    if(counters) counters->unknown_payload.inc();
+    return true;
+  }
+
+  Slot* slot = getSlot(RTP_POLICER_KEY(ssrc,pt & 0x7f));
+  if(slot->limit.limit(rate,rate,size)) {
+    if(counters) {
+      counters->dropped_packets.inc();
+      counters->dropped_bytes.inc(size);
+    }
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,142 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _RtpPolicer_h_
+#define _RtpPolicer_h_
+
+#include "RateLimit.h"
+#include "AmThread.h"
+#include "AmArg.h"
+#include "AmSdp.h"
+#include "atomic_types.h"
+#include "singleton.h"
+
+#include <sys/types.h>
+
+#include <string>
+#include <map>
+using std::string;
+using std::map;
+
+/** streams (SSRC/payload type) policed separately per call leg */
+#define RTP_POLICER_SLOTS 8
+
+/** a stream's slot may be taken over after 5s (wheeltimer ticks) */
+#define RTP_POLICER_IDLE_TICKS (5000 / 20)
+
+/** RTP headers (100 packets/s) on top of the codec's bitrate (bytes/s) */
+#define RTP_POLICER_HDR_OVERHEAD (100 * 12)
+
+#define DEFAULT_RTP_POLICER_TOLERANCE 50 /* % */
+
+/** drop counters of all calls with a call profile */
+struct RtpPolicingCounters
+{
+  // over the bandwidth cap
+  atomic_int64 dropped_packets;
+  atomic_int64 dropped_bytes;
+
+  // payload type not negotiated
+  atomic_int64 unknown_payload;
+};
+
+class _RtpPolicingStats
+{
+  map<string,RtpPolicingCounters*> counters;
+  AmMutex counters_mut;
+
+protected:
+  _RtpPolicingStats() {}
+  ~_RtpPolicingStats();
+
+  void dispose() {}
+
+public:
+  /** Counters of call profile 'name' (never freed) */
+  RtpPolicingCounters* get(const string& name);
+
+  void getReport(AmArg& ret);
+};
+
+typedef singleton<_RtpPolicingStats> RtpPolicingStats;
+
+/**
+ * \brief polices relayed RTP by the negotiated codecs
+ *
+ * Each stream (SSRC and payload type) gets a token bucket allowing
+ * the bitrate of its codec plus 'tolerance' percent; payload types
+ * not negotiated are dropped. Codecs without a known bitrate are not
+ * policed. Lock-free, to be used per packet from the RTP receiver
+ * threads.
+ */
+class RtpPolicer
+{
+  /**
+   * bytes/s allowed per payload type, 0: not negotiated.
+   * setCaps() fills the table not in use and then switches
+   * 'active' over, so that police() never sees a partly set one.
+   */
+  unsigned int pt_rate[2][128];
+  // table used by police(), -1 before the caps are set
+  volatile int active;
+
+  struct Slot
+  {
+    // RTP_POLICER_KEY(ssrc,pt), 0: unused
+    volatile u_int64_t key;
+    DynRateLimit limit;
+
+    Slot() : key(0), limit(1000) {}
+  };
+
+  // + 1 shared by the streams without a slot of their own
+  Slot slots[RTP_POLICER_SLOTS + 1];
+
+  unsigned int tolerance;
+  RtpPolicingCounters* counters;
+
+  Slot* getSlot(u_int64_t key);
+  void addCaps(const AmSdp& sdp, unsigned int* rates);
+
+public:
+  RtpPolicer(unsigned int tolerance, RtpPolicingCounters* counters);
+
+  /**
+   * Set the caps from the negotiated SDP.
+   * Not to be called from more than one thread at a time.
+   */
+  void setCaps(const AmSdp& offer, const AmSdp& answer);
+
+  /**
+   * @return true if the packet should be dropped
+   */
+  bool police(unsigned int ssrc, unsigned char pt, unsigned int size);
+
+  /** @return the codec's bitrate (kbit/s), 0 if not known */
+  static unsigned int getBitrate(const SdpPayload& p);
+};
+
+#endif
@@ -60,6 +60,10 @@ SBC - feature-wishlist
 #include "SubscriptionDialog.h"
 #include "RegisterDialog.h"
 #include "RegisterCache.h"
+#include "RegCacheStorage.h"
+#include "RtpPolicer.h"
+#include "SBCCallRegistry.h"
+#include "SBCEventLog.h"
 
 #include <algorithm>
 
@@ -157,6 +161,7 @@ SBCFactory::SBCFactory(const string& _app_name)
 
 SBCFactory::~SBCFactory() {
   RegisterCache::dispose();
+  SBCEventLog::dispose();
 }
 
 int SBCFactory::onLoad()
@@ -195,7 +200,7 @@ int SBCFactory::onLoad()
     }
   }
 
-  active_profile = explode(cfg.getParameter("active_profile"), ",");
+  setActiveProfileRules(cfg.getParameter("active_profile"));
   if (active_profile.empty()) {
     ERROR("active_profile not set.\n");
     return -1;
@@ -221,14 +226,21 @@ int SBCFactory::onLoad()
   for (vector<string>::iterator it =
 	 regex_maps.begin(); it != regex_maps.end(); it++) {
     string regex_map_file_name = AmConfig::ModConfigPath + *it + ".conf";
-    RegexMappingVector v;
-    if (!read_regex_mapping(regex_map_file_name, "=>",
-			    ("SBC regex mapping " + *it+":").c_str(), v)) {
+    SharedRegexMapping* v = new SharedRegexMapping();
+    if (!v->read(regex_map_file_name, "=>",
+		 ("SBC regex mapping " + *it+":").c_str())) {
       ERROR("reading regex mapping from '%s'\n", regex_map_file_name.c_str());
+      delete v;
       return -1;
     }
     regex_mappings.setRegexMap(*it, v);
-    INFO("loaded regex mapping '%s'\n", it->c_str());
+    INFO("loaded regex mapping '%s' (%zd entries, %zd indexed by prefix)\n",
+	 it->c_str(), v->size(), v->indexed());
+  }
+
+  if (!SBCEventLog::instance()->configure(cfg)) {
+    ERROR("configuring the SBC event log\n");
+    return -1;
   }
 
   core_options_handling = cfg.getParameter("core_options_handling") == "yes";
@@ -246,16 +258,46 @@ int SBCFactory::onLoad()
 
   subnot_processor.addThreads(cfg.getParameterInt("out_of_dialog_threads",
                                                   DEFAULT_OOD_THREADS));
+
+  string reg_cache_dir = cfg.getParameter("reg_cache_storage_dir");
+  if (!reg_cache_dir.empty()) {
+    RegCacheFileStorage* storage =
+      new RegCacheFileStorage(RegisterCache::instance(), reg_cache_dir,
+			      cfg.getParameterInt("reg_cache_snapshot_interval",
+						  DEFAULT_REG_CACHE_SNAPSHOT_INTERVAL),
+			      cfg.getParameterInt("reg_cache_restore_threads",
+						  DEFAULT_REG_CACHE_RESTORE_THREADS));
+    if (!storage->restore()) {
+      ERROR("restoring register cache from '%s'\n", reg_cache_dir.c_str());
+      delete storage;
+      return -1;
+    }
+    RegisterCache::instance()->setStorageHandler(storage);
+    storage->start();
+  }
   RegisterCache::instance()->start();
 
   return 0;
 }
 
+void SBCFactory::setActiveProfileRules(const string& rules)
+{
+  active_profile = explode(rules, ",");
+
+  ParamTemplateSet templates;
+  for (vector<string>::const_iterator it = active_profile.begin();
+       it != active_profile.end(); it++) {
+    templates.add(*it);
+  }
+  active_profile_templates = templates;
+}
+
 /** get the first matching profile name from active profiles */
 SBCCallProfile* SBCFactory::getActiveProfileMatch(const AmSipRequest& req,
 						  ParamReplacerCtx& ctx) 
 {
   string profile, profile_rule;
+  ctx.templates = &active_profile_templates;
   vector<string>::const_iterator it = active_profile.begin();
   for (; it != active_profile.end(); it++) {
 
@@ -274,6 +316,7 @@ SBCCallProfile* SBCFactory::getActiveProfileMatch(const AmSipRequest& req,
       break;
     }
   }
+  ctx.templates = NULL;
 
   DBG("active profile = %s\n", profile.c_str());
 
@@ -414,6 +457,20 @@ void SBCFactory::onOoDRequest(const AmSipRequest& req)
   
   call_profile.fix_append_hdrs(ctx, req);
 
+  if((req.method == SIP_METH_REGISTER) &&
+     call_profile.reg_caching && call_profile.reg_throttling) {
+    // answer refreshes from the cache while the upstream binding lasts
+    RegisterCacheCtx reg_ctx;
+    reg_ctx.min_reg_expires = call_profile.min_reg_expires;
+    reg_ctx.max_ua_expires = call_profile.max_ua_expires;
+    if(RegisterCache::instance()->throttleRegister(reg_ctx, req,
+						    call_profile.log_sip ?
+						    logger : NULL)) {
+      oodHandlingTerminated(req, cc_modules, call_profile);
+      return;
+    }
+  }
+
   SimpleRelayCreator::Relay relay(NULL,NULL);
   if(req.method == SIP_METH_REGISTER) {
     relay = simpleRelayCreator->createRegisterRelay(call_profile, cc_modules);
@@ -480,8 +537,21 @@ void SBCFactory::invoke(const string& method, const AmArg& args,
     ret.push(AmArg("loadCallcontrolModules"));
     ret.push(AmArg("postControlCmd"));
     ret.push(AmArg("printCallStats"));
+    ret.push(AmArg("getRegCacheStats"));
+    ret.push(AmArg("getRtpPolicingStats"));
+    ret.push(AmArg("getCallRegistry"));
+    ret.push(AmArg("getEventLogStats"));
   } else if(method == "printCallStats"){ 
     B2BMediaStatistics::instance()->getReport(args, ret);
+  } else if(method == "getRegCacheStats"){
+    getRegCacheStats(args, ret);
+  } else if(method == "getRtpPolicingStats"){
+    RtpPolicingStats::instance()->getReport(ret);
+  } else if(method == "getCallRegistry"){
+    getCallRegistry(args, ret);
+  } else if(method == "getEventLogStats"){
+    if (!SBCEventLog::instance()->getStats(ret))
+      ret.assertStruct();
   }  else
     throw AmDynInvoke::NotImplemented(method);
 }
@@ -622,7 +692,7 @@ void SBCFactory::setActiveProfile(const AmArg& args, AmArg& ret) {
     return;
   }
   profiles_mut.lock();
-  active_profile = explode(args[0]["active_profile"].asCStr(), ",");
+  setActiveProfileRules(args[0]["active_profile"].asCStr());
   profiles_mut.unlock();
   ret.push(200);
   ret.push("OK");
@@ -653,9 +723,12 @@ void SBCFactory::setRegexMap(const AmArg& args, AmArg& ret) {
 
   string m_name = args[0]["name"].asCStr();
   string m_file = args[0]["file"].asCStr();
-  RegexMappingVector v;
-  if (!read_regex_mapping(m_file, "=>", "SBC regex mapping", v)) {
+  // the mapping is read before taking the lock, calls go on with
+  // the old one meanwhile
+  SharedRegexMapping* v = new SharedRegexMapping();
+  if (!v->read(m_file, "=>", "SBC regex mapping")) {
     ERROR("reading regex mapping from '%s'\n", m_file.c_str());
+    delete v;
     ret.push(401);
     ret.push("Error reading regex mapping from file");
     return;
@@ -699,6 +772,43 @@ void SBCFactory::postControlCmd(const AmArg& args, AmArg& ret) {
   }
 }
 
+void SBCFactory::getRegCacheStats(const AmArg& args, AmArg& ret) {
+  _RegisterCache* reg_cache = RegisterCache::instance();
+
+  unsigned long long expired = reg_cache->getExpiredRegs();
+  unsigned long long runs = reg_cache->getExpiryRuns();
+
+  ret["active_regs"] = (int)reg_cache->getActiveRegs();
+  ret["scheduled_expiries"] = (int)reg_cache->getScheduledExpiries();
+  ret["expired_regs"] = (long long)expired;
+  ret["expiry_delay_avg_ms"] =
+    (long long)(expired ? reg_cache->getExpiryDelayTotal() / expired : 0);
+  ret["expiry_delay_max_ms"] = (long long)reg_cache->getExpiryDelayMax();
+  ret["expiry_cpu_time_us"] = (long long)reg_cache->getExpiryCPUTime();
+  ret["expiry_cpu_per_run_us"] =
+    (long long)(runs ? reg_cache->getExpiryCPUTime() / runs : 0);
+  ret["throttle_hits"] = (long long)reg_cache->getThrottleHits();
+  ret["throttle_misses"] = (long long)reg_cache->getThrottleMisses();
+  ret["throttle_upstream_refreshes"] = (long long)reg_cache->getThrottleRefreshes();
+}
+
+void SBCFactory::getCallRegistry(const AmArg& args, AmArg& ret) {
+  std::vector<std::pair<string,SBCCallRegistryEntry> > calls;
+  SBCCallRegistry::getCalls(calls);
+
+  ret["size"] = (int)calls.size();
+  AmArg& legs = ret["legs"];
+  legs.assertArray();
+  for (size_t i = 0; i < calls.size(); i++) {
+    AmArg leg;
+    leg["ltag"] = calls[i].first;
+    leg["other_ltag"] = calls[i].second.ltag;
+    leg["other_rtag"] = calls[i].second.rtag;
+    leg["callid"] = calls[i].second.callid;
+    legs.push(leg);
+  }
+}
+
 bool SBCFactory::CCRoute(const AmSipRequest& req,
 			 vector<AmDynInvoke*>& cc_modules,
 			 SBCCallProfile& call_profile)
@@ -72,8 +72,12 @@ class SBCFactory: public AmSessionFactory,
   std::map<string, SBCCallProfile> call_profiles;
   
   vector<string> active_profile;
+  /** compiled active_profile rules */
+  ParamTemplateSet active_profile_templates;
   AmMutex profiles_mut;
 
+  void setActiveProfileRules(const string& rules);
+
   bool core_options_handling;
 
   auto_ptr<CallLegCreator> callLegCreator;
@@ -89,6 +93,8 @@ class SBCFactory: public AmSessionFactory,
   void setRegexMap(const AmArg& args, AmArg& ret);
   void loadCallcontrolModules(const AmArg& args, AmArg& ret);
   void postControlCmd(const AmArg& args, AmArg& ret);
+  void getRegCacheStats(const AmArg& args, AmArg& ret);
+  void getCallRegistry(const AmArg& args, AmArg& ret);
 
   SBCCallProfile* getActiveProfileMatch(const AmSipRequest& req, 
 					ParamReplacerCtx& ctx);
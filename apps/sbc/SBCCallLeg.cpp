@@ -146,6 +146,11 @@ SBCCallLeg::SBCCallLeg(const SBCCallProfile& call_profile, AmSipDialog* p_dlg,
 				     1000);
     rtp_relay_rate_limit.reset(limit);
   }
+
+  if(call_profile.rtprelay_policing) {
+    rtp_policer.reset(new RtpPolicer(call_profile.rtprelay_policing_tolerance,
+				     call_profile.rtprelay_policing_counters));
+  }
 }
 
 // B leg constructor (from SBCCalleeSession)
@@ -184,6 +189,11 @@ SBCCallLeg::SBCCallLeg(SBCCallLeg* caller, AmSipDialog* p_dlg,
     rtp_relay_rate_limit.reset(new RateLimit(*caller->rtp_relay_rate_limit.get()));
   }
 
+  if(call_profile.rtprelay_policing) {
+    rtp_policer.reset(new RtpPolicer(call_profile.rtprelay_policing_tolerance,
+				     call_profile.rtprelay_policing_counters));
+  }
+
   // CC interfaces and variables should be already "evaluated" by A leg, we just
   // need to load the DI interfaces for us (later they will be initialized with
   // original INVITE so it must be done in A leg's thread!)
@@ -1376,6 +1386,10 @@ bool SBCCallLeg::onBeforeRTPRelay(AmRtpPacket* p, sockaddr_storage* remote_addr)
      rtp_relay_rate_limit->limit(p->getBufferSize()))
     return false; // drop
 
+  if(rtp_policer.get() &&
+     rtp_policer->police(p->ssrc,p->payload,p->getBufferSize()))
+    return false; // drop
+
   return true; // relay
 }
 
@@ -1387,6 +1401,20 @@ void SBCCallLeg::onAfterRTPRelay(AmRtpPacket* p, sockaddr_storage* remote_addr)
   }
 }
 
+bool SBCCallLeg::canOffloadRTPRelay()
+{
+  // rate limiting, policing and RTP measurements need to see every packet
+  return !rtp_relay_rate_limit.get() && !rtp_policer.get() && rtp_pegs.empty();
+}
+
+int SBCCallLeg::onSdpCompleted(const AmSdp& local, const AmSdp& remote)
+{
+  if(rtp_policer.get())
+    rtp_policer->setCaps(local,remote);
+
+  return CallLeg::onSdpCompleted(local,remote);
+}
+
 void SBCCallLeg::logCallStart(const AmSipReply& reply)
 {
   std::map<int,AmSipRequest>::iterator t_req = recvd_req.find(reply.cseq);
@@ -31,6 +31,7 @@
 #include "ExtendedCCInterface.h"
 #include "sbc_events.h"
 #include "RateLimit.h"
+#include "RtpPolicer.h"
 
 class PayloadIdMapping
 {
@@ -81,6 +82,7 @@ class SBCCallLeg : public CallLeg, public CredentialHolder
 
   // Rate limiting
   auto_ptr<RateLimit> rtp_relay_rate_limit;
+  auto_ptr<RtpPolicer> rtp_policer;
   
   // Measurements
   list<atomic_int*> rtp_pegs;
@@ -131,6 +133,10 @@ class SBCCallLeg : public CallLeg, public CredentialHolder
    */
   virtual bool onBeforeRTPRelay(AmRtpPacket* p, sockaddr_storage* remote_addr);
   virtual void onAfterRTPRelay(AmRtpPacket* p, sockaddr_storage* remote_addr);
+  virtual bool canOffloadRTPRelay();
+
+  // OA callbacks
+  virtual int onSdpCompleted(const AmSdp& local, const AmSdp& remote);
 
   void logCallStart(const AmSipReply& reply);
   void logCanceledCall();
@@ -34,6 +34,7 @@
 
 #include "SBCCallControlAPI.h"
 #include "RTPParameters.h"
+#include "RtpPolicer.h"
 #include "SDPFilter.h"
 #include "RegisterCache.h"
 
@@ -377,6 +378,12 @@ bool SBCCallProfile::readFromConfiguration(const string& name,
   rtprelay_dtmf_detection =
     cfg.getParameter("rtprelay_dtmf_detection", "no") == "yes";
 
+  rtprelay_policing = cfg.getParameter("rtprelay_policing", "no") == "yes";
+  rtprelay_policing_tolerance =
+    cfg.getParameterInt("rtprelay_policing_tolerance", DEFAULT_RTP_POLICER_TOLERANCE);
+  if (rtprelay_policing)
+    rtprelay_policing_counters = RtpPolicingStats::instance()->get(name);
+
   outbound_interface = cfg.getParameter("outbound_interface");
   aleg_outbound_interface = cfg.getParameter("aleg_outbound_interface");
 
@@ -400,6 +407,7 @@ bool SBCCallProfile::readFromConfiguration(const string& name,
   reg_caching = cfg.getParameter("enable_reg_caching","no") == "yes";
   min_reg_expires = cfg.getParameterInt("min_reg_expires",0);
   max_ua_expires = cfg.getParameterInt("max_ua_expires",0);
+  reg_throttling = cfg.getParameter("enable_reg_throttling","no") == "yes";
 
   max_491_retry_time = cfg.getParameterInt("max_491_retry_time", 2000);
 
@@ -517,6 +525,10 @@ bool SBCCallProfile::readFromConfiguration(const string& name,
 	   rtprelay_dtmf_filtering?"en":"dis");
       INFO("SBC:      RTP Relay RTP DTMF detection %sabled\n",
 	   rtprelay_dtmf_detection?"en":"dis");
+      if (rtprelay_policing) {
+	INFO("SBC:      RTP Relay policing enabled (tolerance %u%%)\n",
+	     rtprelay_policing_tolerance);
+      }
     }
 
     INFO("SBC:      SST on A leg enabled: '%s'\n", sst_aleg_enabled.empty() ?
@@ -579,10 +591,24 @@ bool SBCCallProfile::readFromConfiguration(const string& name,
   INFO("SBC:      reg-caching: '%s'\n", reg_caching ? "yes" : "no");
   INFO("SBC:      min_reg_expires: %i\n", min_reg_expires);
   INFO("SBC:      max_ua_expires: %i\n", max_ua_expires);
+  INFO("SBC:      reg-throttling: '%s'\n", reg_throttling ? "yes" : "no");
 
   codec_prefs.infoPrint();
   transcoder.infoPrint();
 
+  // compile the patterns of the profile once; copies of this
+  // profile made before (e.g. of running calls) keep their set
+  param_templates = ParamTemplateSet();
+  for (std::map<string,string>::const_iterator it =
+	 cfg.begin(); it != cfg.end(); it++) {
+    param_templates.add(it->second);
+  }
+  for (CCInterfaceListIteratorT it =
+	 cc_interfaces.begin(); it != cc_interfaces.end(); it++) {
+    param_templates.add(it->cc_name);
+  }
+  DBG("SBC:      %zd compiled patterns\n", param_templates.size());
+
   return true;
 }
 
@@ -47,6 +47,8 @@ typedef map<string, AmArg>   SBCVarMapT;
 typedef SBCVarMapT::iterator SBCVarMapIteratorT;
 typedef SBCVarMapT::const_iterator SBCVarMapConstIteratorT;
 
+struct RtpPolicingCounters;
+
 struct CCInterface {
   string cc_name;
   string cc_module;
@@ -107,6 +109,9 @@ struct SBCCallProfile
   string md5hash;
   string profile_file;
 
+  /** $xy patterns of the profile's values, compiled on load */
+  ParamTemplateSet param_templates;
+
   string ruri;       /* updated if set */
   string ruri_host;  /* updated if set */
   string from;       /* updated if set */
@@ -210,6 +215,10 @@ struct SBCCallProfile
   int rtprelay_bw_limit_rate;
   int rtprelay_bw_limit_peak;
 
+  bool rtprelay_policing;
+  unsigned int rtprelay_policing_tolerance;
+  RtpPolicingCounters* rtprelay_policing_counters;
+
   list<atomic_int*> aleg_rtp_counters;
   list<atomic_int*> bleg_rtp_counters;
 
@@ -291,6 +300,7 @@ struct SBCCallProfile
   bool reg_caching;
   unsigned int min_reg_expires;
   unsigned int max_ua_expires;
+  bool reg_throttling;
 
   // todo: RTP transcoding mode
 
@@ -356,10 +366,14 @@ struct SBCCallProfile
     aleg_rtprelay_interface_value(-1),
     rtprelay_bw_limit_rate(-1),
     rtprelay_bw_limit_peak(-1),
+    rtprelay_policing(false),
+    rtprelay_policing_tolerance(0),
+    rtprelay_policing_counters(NULL),
     outbound_interface_value(-1),
     have_aleg_sdpfilter(false),
     contact_hiding(false),
     reg_caching(false),
+    reg_throttling(false),
     log_rtp(false),
     log_sip(false),
     patch_ruri_next_hop(false),
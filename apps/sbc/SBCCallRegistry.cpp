@@ -24,28 +24,56 @@
  */
 
 #include "SBCCallRegistry.h"
+#include "sip/hash.h"
 #include "log.h"
 
-AmMutex SBCCallRegistry::registry_mutex;
-std::map<string, SBCCallRegistryEntry> SBCCallRegistry::registry;
+hash_table<SBCCallRegistryBucket> SBCCallRegistry::registry(SBC_CALL_REGISTRY_BUCKETS);
+atomic_int SBCCallRegistry::calls;
+
+bool SBCCallRegistryBucket::set(const string& ltag, const SBCCallRegistryEntry& other_dlg)
+{
+  value_map::iterator it = elmts.find(ltag);
+  if (it != elmts.end()) {
+    *it->second = other_dlg;
+    return false;
+  }
+
+  insert(ltag, new SBCCallRegistryEntry(other_dlg));
+  return true;
+}
+
+void SBCCallRegistryBucket::getEntries(std::vector<std::pair<string,SBCCallRegistryEntry> >& entries)
+{
+  for (value_map::iterator it = elmts.begin(); it != elmts.end(); it++) {
+    entries.push_back(std::make_pair(it->first, *it->second));
+  }
+}
+
+SBCCallRegistryBucket* SBCCallRegistry::getBucket(const string& ltag) {
+  unsigned int h = hashlittle(ltag.c_str(), ltag.length(), 0);
+  return registry.get_bucket(h & (SBC_CALL_REGISTRY_BUCKETS-1));
+}
 
 void SBCCallRegistry::addCall(const string& ltag, const SBCCallRegistryEntry& other_dlg) {
-  registry_mutex.lock();
-  registry[ltag] = other_dlg;
-  registry_mutex.unlock();
+  SBCCallRegistryBucket* bucket = getBucket(ltag);
+  bucket->lock();
+  if (bucket->set(ltag, other_dlg))
+    calls.inc();
+  bucket->unlock();
 
   DBG("SBCCallRegistry: Added call '%s' - mapped to: '%s'/'%s'/'%s'\n", ltag.c_str(), other_dlg.ltag.c_str(), other_dlg.rtag.c_str(), other_dlg.callid.c_str());
 }
 
 void SBCCallRegistry::updateCall(const string& ltag, const string& other_rtag) {
-  registry_mutex.lock();
+  SBCCallRegistryBucket* bucket = getBucket(ltag);
+  bucket->lock();
 
-  std::map<string, SBCCallRegistryEntry>::iterator it = registry.find(ltag);
-  if (it != registry.end()) {
-    it->second.rtag = other_rtag;
+  SBCCallRegistryEntry* e = bucket->get(ltag);
+  if (e) {
+    e->rtag = other_rtag;
   }
 
-  registry_mutex.unlock();
+  bucket->unlock();
 
   DBG("SBCCallRegistry: Updated call '%s' - rtag to: '%s'\n", ltag.c_str(), other_rtag.c_str());
 }
@@ -53,13 +81,14 @@ void SBCCallRegistry::updateCall(const string& ltag, const string& other_rtag) {
 bool SBCCallRegistry::lookupCall(const string& ltag, SBCCallRegistryEntry& other_dlg) {
   bool res = false;
 
-  registry_mutex.lock();
-  std::map<string, SBCCallRegistryEntry>::iterator it = registry.find(ltag);
-  if (it != registry.end()) {
+  SBCCallRegistryBucket* bucket = getBucket(ltag);
+  bucket->lock();
+  SBCCallRegistryEntry* e = bucket->get(ltag);
+  if (e) {
     res = true;
-    other_dlg = it->second;
+    other_dlg = *e;
   }
-  registry_mutex.unlock();
+  bucket->unlock();
 
   if (res) {
     DBG("SBCCallRegistry: found call mapping '%s' -> '%s'/'%s'/'%s'\n",
@@ -71,9 +100,21 @@ bool SBCCallRegistry::lookupCall(const string& ltag, SBCCallRegistryEntry& other
 }
 
 void SBCCallRegistry::removeCall(const string& ltag) {
-  registry_mutex.lock();
-  registry.erase(ltag);
-  registry_mutex.unlock();  
+  SBCCallRegistryBucket* bucket = getBucket(ltag);
+  bucket->lock();
+  if (bucket->remove(ltag))
+    calls.dec();
+  bucket->unlock();  
 
   DBG("SBCCallRegistry: removed entry for call '%s'\n", ltag.c_str());
 }
+
+void SBCCallRegistry::getCalls(std::vector<std::pair<string,SBCCallRegistryEntry> >& entries) {
+  entries.reserve(calls.get());
+  for (unsigned int i = 0; i < SBC_CALL_REGISTRY_BUCKETS; i++) {
+    SBCCallRegistryBucket* bucket = registry.get_bucket(i);
+    bucket->lock();
+    bucket->getEntries(entries);
+    bucket->unlock();
+  }
+}
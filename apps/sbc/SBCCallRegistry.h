@@ -27,10 +27,17 @@
 #define _SBCCallRegistry_H
 
 #include "AmThread.h"
+#include "atomic_types.h"
+#include "hash_table.h"
 
 #include <string>
 using std::string;
 #include <map>
+#include <vector>
+#include <utility>
+
+/* number of buckets in the call registry (power of 2) */
+#define SBC_CALL_REGISTRY_BUCKETS 1024
 
 struct SBCCallRegistryEntry
 {
@@ -43,10 +50,36 @@ SBCCallRegistryEntry(const string& callid, const string& ltag, const string& rta
   : ltag(ltag), rtag(rtag), callid(callid) { }
 };
 
+/**
+ * Hash-table bucket:
+ *   ltag -> other leg's dialog
+ */
+class SBCCallRegistryBucket
+  : public ht_map_bucket<string,SBCCallRegistryEntry>
+{
+public:
+  SBCCallRegistryBucket(unsigned long id)
+  : ht_map_bucket<string,SBCCallRegistryEntry>(id)
+  {}
+
+  /** @return false if an existing entry has been replaced */
+  bool set(const string& ltag, const SBCCallRegistryEntry& other_dlg);
+
+  void getEntries(std::vector<std::pair<string,SBCCallRegistryEntry> >& entries);
+};
+
+/**
+ * Maps call legs to their other leg, for Replaces handling. Calls
+ * are spread over SBC_CALL_REGISTRY_BUCKETS separately locked
+ * buckets, so that call setup and teardown do not serialize on one
+ * mutex.
+ */
 class SBCCallRegistry 
 {
-  static AmMutex registry_mutex;
-  static std::map<string, SBCCallRegistryEntry> registry;
+  static hash_table<SBCCallRegistryBucket> registry;
+  static atomic_int calls;
+
+  static SBCCallRegistryBucket* getBucket(const string& ltag);
 
  public:
   SBCCallRegistry() { }
@@ -56,6 +89,15 @@ class SBCCallRegistry
   static void updateCall(const string& ltag, const string& other_rtag);
   static bool lookupCall(const string& ltag, SBCCallRegistryEntry& other_dlg);
   static void removeCall(const string& ltag);
+
+  /** number of call legs registered */
+  static unsigned int getSize() { return calls.get(); }
+
+  /**
+   * Copy all entries, locking one bucket at a time (monitoring):
+   * calls added or removed meanwhile may or may not be included.
+   */
+  static void getCalls(std::vector<std::pair<string,SBCCallRegistryEntry> >& entries);
 };
 
-#endif                           
+#endif
@@ -23,7 +23,10 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 #include "SBCEventLog.h"
+#include "SBCEventLogQueue.h"
+#include "SBCEventLogSinks.h"
 #include "AmAppTimer.h"
+#include "AmUtils.h"
 
 #include "AmArg.h"
 #include "ampi/MonitoringAPI.h"
@@ -52,6 +55,146 @@ struct MonitoringEventLogHandler
   }
 };
 
+static SBCEventLogHandler* createSink(const string& name,
+				      const AmConfigReader& cfg)
+{
+  if(name == "monitoring") {
+    if(NULL == MONITORING_GLOBAL_INTERFACE) {
+      ERROR("event_log: the monitoring module is not loaded\n");
+      return NULL;
+    }
+    return new MonitoringEventLogHandler();
+  }
+
+  if(name.compare(0, 5, "file:") == 0) {
+    FileEventLogSink* sink =
+      new FileEventLogSink(name.substr(5),
+			   cfg.getParameterInt("event_log_file_max_size") * 1024UL * 1024UL,
+			   cfg.getParameterInt("event_log_file_rotations",
+					       DEFAULT_EVENT_LOG_FILE_ROTATIONS));
+    if(!sink->open()) {
+      delete sink;
+      return NULL;
+    }
+    return sink;
+  }
+
+  if(name == "syslog" || name.compare(0, 7, "syslog:") == 0) {
+    int facility = -1;
+    string facility_name = cfg.getParameter("event_log_syslog_facility");
+    if(!facility_name.empty() &&
+       (facility = SyslogEventLogSink::parseFacility(facility_name)) < 0) {
+      ERROR("event_log_syslog_facility '%s' not understood\n",
+	    facility_name.c_str());
+      return NULL;
+    }
+
+    SyslogEventLogSink::Transport transport = SyslogEventLogSink::Local;
+    string host;
+    unsigned int port = DEFAULT_EVENT_LOG_SYSLOG_PORT;
+    if(name != "syslog") {
+      // syslog:udp:<host>[:<port>], syslog:tcp:<host>[:<port>]
+      string proto = name.substr(7, 4);
+      if(proto == "udp:")
+	transport = SyslogEventLogSink::UDP;
+      else if(proto == "tcp:")
+	transport = SyslogEventLogSink::TCP;
+      else {
+	ERROR("event_log: unknown syslog transport in '%s'\n", name.c_str());
+	return NULL;
+      }
+
+      host = name.substr(11);
+      size_t colon = host.rfind(':');
+      if(colon != string::npos) {
+	if(str2i(host.substr(colon + 1), port) || !port || port > 65535) {
+	  ERROR("event_log: invalid port in '%s'\n", name.c_str());
+	  return NULL;
+	}
+	host.erase(colon);
+      }
+      if(host.empty()) {
+	ERROR("event_log: syslog server missing in '%s'\n", name.c_str());
+	return NULL;
+      }
+    }
+
+    SyslogEventLogSink* sink =
+      new SyslogEventLogSink(transport, host, port, facility);
+    if(!sink->open()) {
+      delete sink;
+      return NULL;
+    }
+    return sink;
+  }
+
+  ERROR("event_log: unknown sink '%s'\n", name.c_str());
+  return NULL;
+}
+
+bool _SBCEventLog::configure(const AmConfigReader& cfg)
+{
+  vector<string> sinks = explode(cfg.getParameter("event_log"), ",");
+  if(sinks.empty())
+    return true;
+
+  AsyncEventLogHandler::Overflow overflow = AsyncEventLogHandler::Drop;
+  string overflow_s = cfg.getParameter("event_log_overflow", "drop");
+  if(overflow_s == "wait")
+    overflow = AsyncEventLogHandler::Wait;
+  else if(overflow_s != "drop") {
+    ERROR("event_log_overflow '%s' not understood\n", overflow_s.c_str());
+    return false;
+  }
+
+  AsyncEventLogHandler* h =
+    new AsyncEventLogHandler(cfg.getParameterInt("event_log_queue_size",
+						 DEFAULT_EVENT_LOG_QUEUE_SIZE),
+			     cfg.getParameterInt("event_log_batch_size",
+						 DEFAULT_EVENT_LOG_BATCH_SIZE),
+			     overflow,
+			     cfg.getParameterInt("event_log_max_wait",
+						 DEFAULT_EVENT_LOG_MAX_WAIT));
+
+  for(vector<string>::iterator it = sinks.begin(); it != sinks.end(); it++) {
+    SBCEventLogHandler* sink = createSink(trim(*it, " \t"), cfg);
+    if(!sink) {
+      delete h;
+      return false;
+    }
+    h->addSink(sink);
+  }
+
+  h->start();
+  async_handler = h;
+  setEventLogHandler(h);
+
+  INFO("SBC event log: '%s' (overflow: %s)\n",
+       cfg.getParameter("event_log").c_str(), overflow_s.c_str());
+  return true;
+}
+
+void _SBCEventLog::stop()
+{
+  // the handler is kept: late events are queued, but not written
+  if(async_handler)
+    async_handler->shutdown();
+}
+
+void _SBCEventLog::dispose()
+{
+  stop();
+}
+
+bool _SBCEventLog::getStats(AmArg& ret)
+{
+  if(!async_handler)
+    return false;
+
+  async_handler->getStats(ret);
+  return true;
+}
+
 void _SBCEventLog::useMonitoringLog()
 {
   if(NULL != MONITORING_GLOBAL_INTERFACE) {
@@ -66,6 +209,10 @@ void _SBCEventLog::useMonitoringLog()
 
 void _SBCEventLog::setEventLogHandler(SBCEventLogHandler* lh)
 {
+  if(async_handler && lh != async_handler) {
+    async_handler->shutdown();
+    async_handler = NULL;
+  }
   log_handler.reset(lh);
 }
 
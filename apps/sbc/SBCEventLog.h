@@ -30,6 +30,7 @@
 #include "AmArg.h"
 #include "AmSipMsg.h"
 #include "AmBasicSipDialog.h"
+#include "AmConfigReader.h"
 
 #include <memory>
 #include <string>
@@ -38,23 +39,56 @@ using std::auto_ptr;
 using std::string;
 using std::map;
 
+class AsyncEventLogHandler;
+
 struct SBCEventLogHandler
 {
+  virtual ~SBCEventLogHandler() {}
+
   virtual void logEvent(long int timestamp, const string& id, 
 			const string& type, const AmArg& ev)=0;
+
+  /**
+   * Write out buffered events (called by the async
+   * event log after each batch).
+   * @return false on errors
+   */
+  virtual bool flush() { return true; }
 };
 
 class _SBCEventLog
 {
   auto_ptr<SBCEventLogHandler> log_handler;
 
+  /** set if the events are logged through the async event log */
+  AsyncEventLogHandler* async_handler;
+
 protected:
-  _SBCEventLog() {}
+  _SBCEventLog() : async_handler(NULL) {}
   ~_SBCEventLog() {}
 
+  void dispose();
+
 public:
+  /**
+   * Set up the async event log with the sinks from 'event_log'
+   * (sbc.conf), if any.
+   * @return false on errors
+   */
+  bool configure(const AmConfigReader& cfg);
+
+  /** write out all queued events and stop the async event log */
+  void stop();
+
   void useMonitoringLog();
   void setEventLogHandler(SBCEventLogHandler* lh);
+
+  /** @return true if events are logged somewhere */
+  bool hasHandler() const { return log_handler.get() != NULL; }
+
+  /** @return false if there is no async event log */
+  bool getStats(AmArg& ret);
+
   void logEvent(const string& id, const string& type, const AmArg& event);
 
   void logCallStart(const AmSipRequest& req, const string& local_tag,
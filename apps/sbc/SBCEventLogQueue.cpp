@@ -0,0 +1,154 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "SBCEventLogQueue.h"
+#include "log.h"
+
+#include <unistd.h>
+
+/* producer wait step if the queue is full (us) */
+#define EVENT_LOG_WAIT_STEP_US 100
+
+AsyncEventLogHandler::AsyncEventLogHandler(unsigned int queue_size,
+					   unsigned int batch_size,
+					   Overflow overflow,
+					   unsigned int max_wait_ms)
+  : queue(queue_size),
+    batch_size(batch_size ? batch_size : 1),
+    overflow(overflow), max_wait_us(max_wait_ms * 1000),
+    stop_requested(false)
+{
+}
+
+AsyncEventLogHandler::~AsyncEventLogHandler()
+{
+  for(vector<SBCEventLogHandler*>::iterator it = sinks.begin();
+      it != sinks.end(); it++) {
+    delete *it;
+  }
+}
+
+void AsyncEventLogHandler::addSink(SBCEventLogHandler* sink)
+{
+  sinks.push_back(sink);
+}
+
+bool AsyncEventLogHandler::push(long int timestamp, const string& id,
+				const string& type, const AmArg& ev)
+{
+  unsigned long pos;
+  unsigned int waited_us = 0;
+  Record* r;
+  while(!(r = queue.begin_push(pos))) {
+    // full
+    if(overflow != Wait || waited_us >= max_wait_us) {
+      dropped.inc();
+      return false;
+    }
+    if(!waited_us)
+      waited.inc();
+    usleep(EVENT_LOG_WAIT_STEP_US);
+    waited_us += EVENT_LOG_WAIT_STEP_US;
+  }
+
+  r->timestamp = timestamp;
+  r->id = id;
+  r->type = type;
+  r->ev = ev;
+
+  queue.end_push(pos);
+  queued.inc();
+  return true;
+}
+
+void AsyncEventLogHandler::logEvent(long int timestamp, const string& id,
+				    const string& type, const AmArg& ev)
+{
+  push(timestamp, id, type, ev);
+}
+
+unsigned int AsyncEventLogHandler::drain()
+{
+  unsigned int n = 0;
+  Record* r;
+  while(n < batch_size && (r = queue.front())) {
+    for(vector<SBCEventLogHandler*>::iterator it = sinks.begin();
+	it != sinks.end(); it++) {
+      (*it)->logEvent(r->timestamp, r->id, r->type, r->ev);
+    }
+    r->ev.clear();
+    queue.pop();
+    n++;
+  }
+
+  if(n) {
+    for(vector<SBCEventLogHandler*>::iterator it = sinks.begin();
+	it != sinks.end(); it++) {
+      if(!(*it)->flush())
+	sink_errors.inc();
+    }
+    written.inc(n);
+    batches.inc();
+  }
+
+  return n;
+}
+
+void AsyncEventLogHandler::run()
+{
+  while(!stop_requested.get()) {
+    if(drain() < batch_size)
+      usleep(EVENT_LOG_IDLE_US);
+  }
+
+  while(drain());
+
+  DBG("event log writer stopped\n");
+}
+
+void AsyncEventLogHandler::on_stop()
+{
+  stop_requested.set(true);
+}
+
+void AsyncEventLogHandler::shutdown()
+{
+  // stop() detaches the thread: wait for the last events
+  stop();
+  while(!is_stopped())
+    usleep(1000);
+}
+
+void AsyncEventLogHandler::getStats(AmArg& ret)
+{
+  ret["queued"] = (long long)queued.get();
+  ret["written"] = (long long)written.get();
+  ret["dropped"] = (long long)dropped.get();
+  ret["waited"] = (long long)waited.get();
+  ret["batches"] = (long long)batches.get();
+  ret["sink_errors"] = (long long)sink_errors.get();
+  ret["pending"] = (long long)(queued.get() - written.get());
+}
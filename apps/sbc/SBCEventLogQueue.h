@@ -0,0 +1,129 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _SBCEventLogQueue_h_
+#define _SBCEventLogQueue_h_
+
+#include "SBCEventLog.h"
+#include "AmThread.h"
+#include "AmBoundedQueue.h"
+#include "atomic_types.h"
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+#define DEFAULT_EVENT_LOG_QUEUE_SIZE 65536
+#define DEFAULT_EVENT_LOG_BATCH_SIZE 256
+#define DEFAULT_EVENT_LOG_MAX_WAIT   10 /* ms */
+
+/** poll interval of the event log writer when idle (us) */
+#define EVENT_LOG_IDLE_US 5000
+
+/**
+ * \brief async event log
+ *
+ * Events are copied into a bounded lock-free queue, and handed to the sinks in batches by a writer thread, calling
+ * flush() on each sink after a batch. Formatting and writing events
+ * (files, syslog, monitoring) thus does not happen in the call's
+ * thread, and a slow sink does not slow down call processing.
+ *
+ * If the queue is full, the event is dropped (Drop), or the producer
+ * waits up to 'max_wait' ms for the writer to make room (Wait).
+ */
+class AsyncEventLogHandler
+  : public SBCEventLogHandler,
+    public AmThread
+{
+public:
+  enum Overflow {
+    Drop=0,
+    Wait
+  };
+
+private:
+  struct Record {
+    long int timestamp;
+    string   id;
+    string   type;
+    AmArg    ev;
+  };
+
+  AmBoundedQueue<Record> queue;
+
+  unsigned int batch_size;
+  Overflow     overflow;
+  unsigned int max_wait_us;
+
+  vector<SBCEventLogHandler*> sinks;
+
+  AmSharedVar<bool> stop_requested;
+
+  // stats
+  atomic_int64 queued;
+  atomic_int64 written;
+  atomic_int64 dropped;
+  atomic_int64 waited;
+  atomic_int64 batches;
+  atomic_int64 sink_errors;
+
+  bool push(long int timestamp, const string& id,
+	    const string& type, const AmArg& ev);
+
+  /** hand a batch of queued events to the sinks, @return # of events */
+  unsigned int drain();
+
+  /* AmThread interface */
+  void run();
+  void on_stop();
+
+public:
+  AsyncEventLogHandler(unsigned int queue_size, unsigned int batch_size,
+		       Overflow overflow, unsigned int max_wait_ms);
+  ~AsyncEventLogHandler();
+
+  /** Add a sink (owned by the event log), before start() */
+  void addSink(SBCEventLogHandler* sink);
+
+  /** Stop the writer thread after all queued events are written */
+  void shutdown();
+
+  /* SBCEventLogHandler interface */
+  void logEvent(long int timestamp, const string& id,
+		const string& type, const AmArg& ev);
+
+  unsigned long long getQueued() { return queued.get(); }
+  unsigned long long getWritten() { return written.get(); }
+  unsigned long long getDropped() { return dropped.get(); }
+  unsigned long long getWaited() { return waited.get(); }
+  unsigned long long getBatches() { return batches.get(); }
+  unsigned long long getSinkErrors() { return sink_errors.get(); }
+
+  void getStats(AmArg& ret);
+};
+
+#endif
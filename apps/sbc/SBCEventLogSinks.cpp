@@ -0,0 +1,301 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "SBCEventLogSinks.h"
+#include "AmUtils.h"
+#include "jsonArg.h"
+#include "log.h"
+#include "sip/resolver.h"
+#include "sip/ip_util.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/* send timeout of the TCP syslog connection */
+#define EVENT_LOG_TCP_TIMEOUT_MS 1000
+
+string event2json(long int timestamp, const string& id,
+		  const string& type, const AmArg& ev)
+{
+  return "{\"ts\":" + long2str(timestamp) +
+    ",\"id\":" + str2json(id) +
+    ",\"type\":" + str2json(type) +
+    ",\"attrs\":" + arg2json(ev) + "}";
+}
+
+FileEventLogSink::FileEventLogSink(const string& path, unsigned long max_size,
+				   unsigned int rotations)
+  : path(path), max_size(max_size), rotations(rotations),
+    fd(-1), size(0)
+{
+}
+
+FileEventLogSink::~FileEventLogSink()
+{
+  if(fd >= 0)
+    close(fd);
+}
+
+bool FileEventLogSink::open()
+{
+  fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if(fd < 0) {
+    ERROR("opening event log file '%s': %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+
+  struct stat st;
+  size = fstat(fd, &st) ? 0 : st.st_size;
+  return true;
+}
+
+bool FileEventLogSink::rotate()
+{
+  close(fd);
+  fd = -1;
+
+  if(!rotations) {
+    unlink(path.c_str());
+  }
+  else {
+    for(unsigned int i = rotations - 1; i > 0; i--) {
+      rename((path + "." + int2str(i)).c_str(),
+	     (path + "." + int2str(i + 1)).c_str());
+    }
+    rename(path.c_str(), (path + ".1").c_str());
+  }
+
+  return open();
+}
+
+void FileEventLogSink::logEvent(long int timestamp, const string& id,
+				const string& type, const AmArg& ev)
+{
+  buf += event2json(timestamp, id, type, ev);
+  buf += '\n';
+}
+
+bool FileEventLogSink::flush()
+{
+  if(buf.empty())
+    return true;
+
+  if(fd < 0 && !open()) {
+    buf.clear();
+    return false;
+  }
+
+  bool res = true;
+  size_t written = 0;
+  while(written < buf.size()) {
+    ssize_t w = write(fd, buf.data() + written, buf.size() - written);
+    if(w < 0) {
+      if(errno == EINTR)
+	continue;
+      ERROR("writing event log file '%s': %s\n", path.c_str(), strerror(errno));
+      res = false;
+      break;
+    }
+    written += w;
+  }
+  size += written;
+  buf.clear();
+
+  if(max_size && size >= max_size && !rotate())
+    res = false;
+
+  return res;
+}
+
+SyslogEventLogSink::SyslogEventLogSink(Transport transport, const string& host,
+				       unsigned short port, int facility)
+  : transport(transport), host(host), port(port), facility(facility),
+    fd(-1), error(false)
+{
+  memset(&addr, 0, sizeof(addr));
+}
+
+SyslogEventLogSink::~SyslogEventLogSink()
+{
+  disconnect();
+}
+
+int SyslogEventLogSink::parseFacility(const string& name)
+{
+  static const struct { const char* name; int facility; } facilities[] = {
+    { "user", LOG_USER }, { "daemon", LOG_DAEMON },
+    { "local0", LOG_LOCAL0 }, { "local1", LOG_LOCAL1 },
+    { "local2", LOG_LOCAL2 }, { "local3", LOG_LOCAL3 },
+    { "local4", LOG_LOCAL4 }, { "local5", LOG_LOCAL5 },
+    { "local6", LOG_LOCAL6 }, { "local7", LOG_LOCAL7 },
+  };
+
+  for(unsigned int i = 0; i < sizeof(facilities) / sizeof(facilities[0]); i++) {
+    if(name == facilities[i].name)
+      return facilities[i].facility;
+  }
+  return -1;
+}
+
+bool SyslogEventLogSink::open()
+{
+  if(transport == Local)
+    return true;
+
+  dns_handle dh;
+  if(resolver::instance()->resolve_name(host.c_str(), &dh, &addr, IPv4) < 0) {
+    ERROR("resolving event log syslog server '%s' failed\n", host.c_str());
+    return false;
+  }
+  am_set_port(&addr, port);
+
+  char h[256];
+  if(gethostname(h, sizeof(h)))
+    hostname = "-";
+  else {
+    h[sizeof(h) - 1] = '\0';
+    hostname = h;
+  }
+
+  // TCP is connected with the first batch
+  return transport == TCP || connect();
+}
+
+bool SyslogEventLogSink::connect()
+{
+  fd = socket(addr.ss_family, transport == TCP ? SOCK_STREAM : SOCK_DGRAM, 0);
+  if(fd < 0) {
+    ERROR("event log syslog socket: %s\n", strerror(errno));
+    return false;
+  }
+
+  if(transport == TCP) {
+    struct timeval tv;
+    tv.tv_sec = EVENT_LOG_TCP_TIMEOUT_MS / 1000;
+    tv.tv_usec = (EVENT_LOG_TCP_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  }
+
+  if(::connect(fd, (struct sockaddr*)&addr, SA_len(&addr)) < 0) {
+    ERROR("connecting to event log syslog server %s:%u: %s\n",
+	  host.c_str(), port, strerror(errno));
+    disconnect();
+    return false;
+  }
+  return true;
+}
+
+void SyslogEventLogSink::disconnect()
+{
+  if(fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+string SyslogEventLogSink::format(const string& id, const string& type,
+				  const AmArg& ev)
+{
+  if(isArgCStr(ev))
+    return ev.asCStr();
+
+  return type + " " + id + " " + arg2json(ev);
+}
+
+void SyslogEventLogSink::logEvent(long int timestamp, const string& id,
+				  const string& type, const AmArg& ev)
+{
+  if(transport == Local) {
+    int prio = LOG_INFO;
+    if(facility >= 0) prio |= facility;
+    syslog(prio, "%s", format(id, type, ev).c_str());
+    return;
+  }
+
+  // RFC 3164: <PRI>Mmm dd hh:mm:ss HOSTNAME TAG: MSG
+  char ts[32];
+  struct tm tm;
+  time_t t = timestamp;
+  if(!localtime_r(&t, &tm) || !strftime(ts, sizeof(ts), "%b %e %H:%M:%S", &tm))
+    ts[0] = '\0';
+
+  int pri = (facility >= 0 ? facility : LOG_USER) | LOG_INFO;
+  string msg = "<" + int2str(pri) + ">" + ts + " " + hostname + " sems: " +
+    format(id, type, ev);
+
+  if(transport == UDP) {
+    if(fd < 0 || send(fd, msg.data(), msg.size(), 0) < 0)
+      error = true;
+    return;
+  }
+
+  buf += msg;
+  buf += '\n';
+}
+
+bool SyslogEventLogSink::flush()
+{
+  if(transport != TCP) {
+    bool res = !error;
+    error = false;
+    return res;
+  }
+
+  if(buf.empty())
+    return true;
+
+  if(fd < 0 && !connect()) {
+    buf.clear();
+    return false;
+  }
+
+  size_t sent = 0;
+  while(sent < buf.size()) {
+    ssize_t s = send(fd, buf.data() + sent, buf.size() - sent, MSG_NOSIGNAL);
+    if(s < 0) {
+      if(errno == EINTR)
+	continue;
+      ERROR("sending to event log syslog server %s:%u: %s\n",
+	    host.c_str(), port, strerror(errno));
+      // reconnect with the next batch
+      disconnect();
+      buf.clear();
+      return false;
+    }
+    sent += s;
+  }
+  buf.clear();
+  return true;
+}
@@ -0,0 +1,132 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _SBCEventLogSinks_h_
+#define _SBCEventLogSinks_h_
+
+#include "SBCEventLog.h"
+
+#include <sys/socket.h>
+
+#include <string>
+using std::string;
+
+#define DEFAULT_EVENT_LOG_SYSLOG_PORT    514
+#define DEFAULT_EVENT_LOG_FILE_ROTATIONS 5
+
+/** @return one event as JSON object: {"ts":..,"id":..,"type":..,"attrs":..} */
+string event2json(long int timestamp, const string& id,
+		  const string& type, const AmArg& ev);
+
+/**
+ * \brief event log sink writing JSON lines to a file
+ *
+ * If the file exceeds 'max_size' bytes, it is renamed to <path>.1
+ * (<path>.1 to <path>.2 and so on, up to 'rotations' files) and a
+ * new one is started.
+ */
+class FileEventLogSink
+  : public SBCEventLogHandler
+{
+  string path;
+  unsigned long max_size;
+  unsigned int rotations;
+
+  int fd;
+  unsigned long size;
+  string buf;
+
+  bool rotate();
+
+public:
+  FileEventLogSink(const string& path, unsigned long max_size,
+		   unsigned int rotations);
+  ~FileEventLogSink();
+
+  /** @return false if the file could not be opened */
+  bool open();
+
+  void logEvent(long int timestamp, const string& id,
+		const string& type, const AmArg& ev);
+  bool flush();
+};
+
+/**
+ * \brief event log sink sending events to syslog
+ *
+ * Events are logged with the local syslog(), or sent to a remote
+ * syslog server in RFC 3164 format, one datagram per event (UDP) or
+ * newline separated (TCP, one write per batch). Events which only
+ * consist of a string (e.g. CDRs) are logged as they are, others as
+ * "<type> <id> <attributes as JSON>".
+ */
+class SyslogEventLogSink
+  : public SBCEventLogHandler
+{
+public:
+  enum Transport {
+    Local=0,
+    UDP,
+    TCP
+  };
+
+private:
+  Transport transport;
+  string host;
+  unsigned short port;
+  /** -1: default (local: as configured for SEMS, remote: user) */
+  int facility;
+
+  int fd;
+  struct sockaddr_storage addr;
+  string hostname;
+
+  string buf;
+  bool error;
+
+  bool connect();
+  void disconnect();
+
+public:
+  SyslogEventLogSink(Transport transport, const string& host,
+		     unsigned short port, int facility);
+  ~SyslogEventLogSink();
+
+  /** @return false if the server could not be resolved */
+  bool open();
+
+  /** @return the message text of an event */
+  static string format(const string& id, const string& type, const AmArg& ev);
+
+  /** @return the facility (LOG_*) named 'name', -1 if unknown */
+  static int parseFacility(const string& name);
+
+  void logEvent(long int timestamp, const string& id,
+		const string& type, const AmArg& ev);
+  bool flush();
+};
+
+#endif
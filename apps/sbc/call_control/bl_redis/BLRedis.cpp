@@ -52,6 +52,9 @@ public:
 
       return 0;
     }
+
+    /** REDIS queries are made synchronously from the call */
+    bool supportsSessionThreadPool() { return false; }
 };
 
 EXPORT_PLUGIN_CLASS_FACTORY(CCBLRedisFactory, MOD_NAME);
@@ -0,0 +1,329 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "AmPlugIn.h"
+#include "AmConfigReader.h"
+#include "AmConfig.h"
+#include "AmUtils.h"
+#include "log.h"
+#include "AmArg.h"
+
+#include "LPMRoute.h"
+
+#include "SBCCallControlAPI.h"
+#include "AmSipHeaders.h"
+
+#include <string.h>
+
+class LPMRouteFactory : public AmDynInvokeFactory
+{
+public:
+    LPMRouteFactory(const string& name)
+	: AmDynInvokeFactory(name) {}
+
+    AmDynInvoke* getInstance(){
+	return LPMRoute::instance();
+    }
+
+    int onLoad(){
+      if (LPMRoute::instance()->onLoad())
+	return -1;
+
+      DBG("LPM route call control loaded.\n");
+
+      return 0;
+    }
+};
+
+EXPORT_PLUGIN_CLASS_FACTORY(LPMRouteFactory, MOD_NAME);
+
+LPMRoute* LPMRoute::_instance=0;
+
+LPMRoute* LPMRoute::instance()
+{
+    if(!_instance)
+	_instance = new LPMRoute();
+    return _instance;
+}
+
+LPMRoute::LPMRoute()
+{
+}
+
+LPMRoute::~LPMRoute()
+{
+  for (std::map<string, SharedPrefixTable*>::iterator it = tables.begin();
+       it != tables.end(); it++)
+    dec_ref(it->second);
+}
+
+int LPMRoute::onLoad() {
+  AmConfigReader cfg;
+
+  if(cfg.loadFile(AmConfig::ModConfigPath + string(MOD_NAME ".conf"))) {
+    INFO(MOD_NAME " configuration file (%s) not found, "
+	 "no route tables loaded\n",
+	 (AmConfig::ModConfigPath + string(MOD_NAME ".conf")).c_str());
+    return 0;
+  }
+
+  vector<string> names = explode(cfg.getParameter("tables"), ",");
+  for (vector<string>::iterator it = names.begin(); it != names.end(); it++) {
+    string name = trim(*it, " \t");
+    string fname = cfg.getParameter(name + "_file");
+    if (fname.empty()) {
+      ERROR("no file configured for route table '%s' (%s_file)\n",
+	    name.c_str(), name.c_str());
+      return -1;
+    }
+    if (!readTable(name, fname))
+      return -1;
+  }
+
+  return 0;
+}
+
+bool LPMRoute::readTable(const string& name, const string& fname)
+{
+  // read before taking the lock, calls go on with the old table meanwhile
+  SharedPrefixTable* t = new SharedPrefixTable();
+  if (!t->load(fname)) {
+    ERROR("reading route table '%s' from '%s'\n", name.c_str(), fname.c_str());
+    delete t;
+    return false;
+  }
+
+  INFO("loaded route table '%s' from '%s': %zd prefixes, %zd routes\n",
+       name.c_str(), fname.c_str(), t->size(), t->getValues());
+  if (t->getDuplicates()) {
+    WARN("route table '%s': %zd duplicate prefixes ignored\n",
+	 name.c_str(), t->getDuplicates());
+  }
+
+  inc_ref(t);
+  SharedPrefixTable* old = NULL;
+  tables_mut.lock();
+  std::map<string, SharedPrefixTable*>::iterator it = tables.find(name);
+  if (it != tables.end())
+    old = it->second;
+  tables[name] = t;
+  table_files[name] = fname;
+  tables_mut.unlock();
+
+  // freed here or after the last lookup still using it
+  if (old)
+    dec_ref(old);
+  return true;
+}
+
+SharedPrefixTable* LPMRoute::getTable(const string& name)
+{
+  SharedPrefixTable* t = NULL;
+  tables_mut.lock();
+  std::map<string, SharedPrefixTable*>::iterator it;
+  if (name.empty() && tables.size() == 1)
+    it = tables.begin();
+  else
+    it = tables.find(name);
+  if (it != tables.end()) {
+    t = it->second;
+    inc_ref(t);
+  }
+  tables_mut.unlock();
+  return t;
+}
+
+void LPMRoute::invoke(const string& method, const AmArg& args, AmArg& ret)
+{
+  if (method == "start"){
+
+    SBCCallProfile* call_profile =
+      dynamic_cast<SBCCallProfile*>(args[CC_API_PARAMS_CALL_PROFILE].asObject());
+
+    start(args[CC_API_PARAMS_CC_NAMESPACE].asCStr(),
+	  call_profile, args[CC_API_PARAMS_CFGVALUES], ret);
+
+  } else if (method == "connect"){
+    // unused
+  } else if (method == "end"){
+    // unused
+  } else if (method == "loadTable"){
+    args.assertArrayFmt("s");
+    loadTable(args, ret);
+  } else if (method == "lookup"){
+    args.assertArrayFmt("ss");
+    lookup(args, ret);
+  } else if (method == "listTables"){
+    listTables(args, ret);
+  } else if (method == "_list"){
+    ret.push("start");
+    ret.push("connect");
+    ret.push("end");
+    ret.push("loadTable");
+    ret.push("lookup");
+    ret.push("listTables");
+  }
+  else
+    throw AmDynInvoke::NotImplemented(method);
+}
+
+static string getValue(const AmArg& values, const char* name)
+{
+  if (!values.hasMember(name) || !isArgCStr(values[name]))
+    return "";
+  return values[name].asCStr();
+}
+
+void LPMRoute::start(const string& cc_name, SBCCallProfile* call_profile,
+		     const AmArg& values, AmArg& res)
+{
+  if (!call_profile)
+    return;
+
+  string table_name = getValue(values, "table");
+  string number = getValue(values, "number");
+
+  SharedPrefixTable* t = getTable(table_name);
+  if (!t) {
+    ERROR("configuration error: route table '%s' not loaded\n", table_name.c_str());
+    res.push(AmArg());
+    AmArg& res_cmd = res.back();
+    res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
+    res_cmd[SBC_CC_REFUSE_CODE] = 500;
+    res_cmd[SBC_CC_REFUSE_REASON] = SIP_REPLY_SERVER_INTERNAL_ERROR;
+    return;
+  }
+
+  size_t prefix_len = 0;
+  const string* route = t->lookup(number.c_str(), &prefix_len);
+  bool found = route != NULL;
+  if (found) {
+    size_t start = number.length() && number[0] == '+' ? 1 : 0;
+    DBG("route for '%s': prefix '%s', route '%s'\n", number.c_str(),
+	number.substr(start, prefix_len).c_str(), route->c_str());
+    call_profile->cc_vars[cc_name + "::route"] = *route;
+    call_profile->cc_vars[cc_name + "::prefix"] = number.substr(start, prefix_len);
+  }
+  dec_ref(t);
+
+  if (found)
+    return;
+
+  DBG("no route for '%s'\n", number.c_str());
+  unsigned int refuse_code = 0;
+  string code = getValue(values, "refuse_code");
+  if (!code.empty() && (str2i(code, refuse_code) || refuse_code < 300 ||
+			refuse_code > 699)) {
+    ERROR("configuration error: invalid refuse_code '%s'\n", code.c_str());
+    refuse_code = 500;
+  }
+  if (!refuse_code)
+    return;
+
+  string reason = getValue(values, "refuse_reason");
+  res.push(AmArg());
+  AmArg& res_cmd = res.back();
+  res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
+  res_cmd[SBC_CC_REFUSE_CODE] = (int)refuse_code;
+  res_cmd[SBC_CC_REFUSE_REASON] = reason.empty() ? "No Route" : reason;
+}
+
+void LPMRoute::loadTable(const AmArg& args, AmArg& ret)
+{
+  string name = args[0].asCStr();
+  string fname;
+  if (args.size() > 1 && isArgCStr(args[1])) {
+    fname = args[1].asCStr();
+  } else {
+    tables_mut.lock();
+    std::map<string, string>::iterator it = table_files.find(name);
+    if (it != table_files.end())
+      fname = it->second;
+    tables_mut.unlock();
+  }
+
+  if (fname.empty()) {
+    ret.push(400);
+    ret.push("Parameters error: expected <name> [<file name>]");
+    return;
+  }
+
+  if (!readTable(name, fname)) {
+    ret.push(500);
+    ret.push("Error reading route table from file");
+    return;
+  }
+  ret.push(200);
+  ret.push("OK");
+}
+
+void LPMRoute::lookup(const AmArg& args, AmArg& ret)
+{
+  SharedPrefixTable* t = getTable(args[0].asCStr());
+  if (!t) {
+    ret.push(404);
+    ret.push("Route table not loaded");
+    return;
+  }
+
+  string number = args[1].asCStr();
+  size_t prefix_len = 0;
+  const string* route = t->lookup(number.c_str(), &prefix_len);
+  if (route) {
+    size_t start = number.length() && number[0] == '+' ? 1 : 0;
+    AmArg r;
+    r["prefix"] = number.substr(start, prefix_len);
+    r["route"] = *route;
+    ret.push(200);
+    ret.push("OK");
+    ret.push(r);
+  } else {
+    ret.push(404);
+    ret.push("No route");
+  }
+  dec_ref(t);
+}
+
+void LPMRoute::listTables(const AmArg& args, AmArg& ret)
+{
+  AmArg l;
+  l.assertArray();
+  tables_mut.lock();
+  for (std::map<string, SharedPrefixTable*>::iterator it = tables.begin();
+       it != tables.end(); it++) {
+    AmArg t;
+    t["name"] = it->first;
+    t["file"] = table_files[it->first];
+    t["prefixes"] = (int)it->second->size();
+    t["routes"] = (int)it->second->getValues();
+    l.push(t);
+  }
+  tables_mut.unlock();
+
+  ret.push(200);
+  ret.push("OK");
+  ret.push(l);
+}
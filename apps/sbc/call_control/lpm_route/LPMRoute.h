@@ -0,0 +1,76 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _CC_LPM_ROUTE_H
+#define _CC_LPM_ROUTE_H
+
+#include "AmApi.h"
+#include "AmPrefixTable.h"
+#include "AmThread.h"
+#include "atomic_types.h"
+
+#include "SBCCallProfile.h"
+
+#include <map>
+
+/** prefix table shared by the calls using it */
+struct SharedPrefixTable
+  : public AmPrefixTable, public atomic_ref_cnt
+{
+};
+
+/**
+ * longest prefix match routing: looks up a number in a route table
+ * and sets the route found as call control variable
+ */
+class LPMRoute : public AmDynInvoke
+{
+  static LPMRoute* _instance;
+
+  std::map<string, SharedPrefixTable*> tables;
+  std::map<string, string> table_files;
+  AmMutex tables_mut;
+
+  /** @return table (to be dec_ref'd) or NULL */
+  SharedPrefixTable* getTable(const string& name);
+  bool readTable(const string& name, const string& fname);
+
+  void start(const string& cc_name, SBCCallProfile* call_profile,
+	     const AmArg& values, AmArg& res);
+
+  void loadTable(const AmArg& args, AmArg& ret);
+  void lookup(const AmArg& args, AmArg& ret);
+  void listTables(const AmArg& args, AmArg& ret);
+
+ public:
+  LPMRoute();
+  ~LPMRoute();
+  static LPMRoute* instance();
+  void invoke(const string& method, const AmArg& args, AmArg& ret);
+  int onLoad();
+};
+
+#endif
@@ -30,6 +30,7 @@
 
 #include "CCParallelCalls.h"
 #include "SBCCallControlAPI.h"
+#include "sip/hash.h"
 
 #include <string.h>
 
@@ -39,6 +40,7 @@ unsigned int CCParallelCalls::refuse_code = 402;
 string CCParallelCalls::refuse_reason = "Too Many Simultaneous Calls";
 
 CCParallelCalls::CCParallelCalls()
+  : call_control_calls(PCALLS_BUCKETS)
 {
 }
 
@@ -92,10 +94,16 @@ void CCParallelCalls::invoke(const string& method, const AmArg& args, AmArg& ret
 
   } else if(method == CC_INTERFACE_MAND_VALUES_METHOD){
     ret.push("uuid");
+  } else if(method == "getCalls"){
+    getCalls(ret);
+  } else if(method == "getStats"){
+    getStats(ret);
   } else if(method == "_list"){
     ret.push("start");
     ret.push("connect");
     ret.push("end");
+    ret.push("getCalls");
+    ret.push("getStats");
   }
   else
     throw AmDynInvoke::NotImplemented(method);
@@ -141,10 +149,11 @@ void CCParallelCalls::start(const string& cc_namespace,
   bool do_limit = !max_calls;
   unsigned int current_calls = 0;
   if (max_calls) {
-    call_control_calls_mut.lock();
-    map<string, unsigned int>::iterator it=call_control_calls.find(uuid);
-    if (it==call_control_calls.end()) {
-      call_control_calls[uuid] = current_calls = 1;
+    PCallsBucket* bucket = getBucket(uuid);
+    bucket->lock();
+    map<string, unsigned int>::iterator it=bucket->calls.find(uuid);
+    if (it==bucket->calls.end()) {
+      bucket->calls[uuid] = current_calls = 1;
     } else {
       if (it->second < max_calls) {
 	it->second++;
@@ -153,19 +162,21 @@ void CCParallelCalls::start(const string& cc_namespace,
       }
       current_calls = it->second;
     }
+    bucket->unlock();
   }
 
-  call_control_calls_mut.unlock();
-
   DBG("uuid %s has %u active calls (limit = %s)\n",
       uuid.c_str(), current_calls, do_limit?"true":"false");
 
   if (do_limit) {
+    refused_calls.inc();
     res.push(AmArg());
     AmArg& res_cmd = res[0];
     res_cmd[SBC_CC_ACTION] = SBC_CC_REFUSE_ACTION;
     res_cmd[SBC_CC_REFUSE_CODE] = (int)refuse_code;
     res_cmd[SBC_CC_REFUSE_REASON] = refuse_reason;
+  } else {
+    active_calls.inc();
   }
 
 #undef REFUSE_WITH_SERVER_INTERNAL_ERROR
@@ -189,17 +200,49 @@ void CCParallelCalls::end(const string& cc_namespace, const string& ltag,
 
   unsigned int new_call_count  = 0;
 
-  call_control_calls_mut.lock();
-  if (call_control_calls[uuid] > 1) {
-    new_call_count = --call_control_calls[uuid];
-  }  else {
-    call_control_calls.erase(uuid);
+  PCallsBucket* bucket = getBucket(uuid);
+  bucket->lock();
+  map<string, unsigned int>::iterator it=bucket->calls.find(uuid);
+  if (it != bucket->calls.end()) {
+    if (it->second > 1) {
+      new_call_count = --it->second;
+    } else {
+      bucket->calls.erase(it);
+    }
+    active_calls.dec();
   }
-  call_control_calls_mut.unlock();
+  bucket->unlock();
 
   DBG("uuid '%s' now has %u active calls\n", uuid.c_str(), new_call_count);
 }
 
+PCallsBucket* CCParallelCalls::getBucket(const string& uuid)
+{
+  unsigned int h = hashlittle(uuid.c_str(), uuid.length(), 0);
+  return call_control_calls.get_bucket(h & (PCALLS_BUCKETS-1));
+}
+
+void CCParallelCalls::getCalls(AmArg& ret)
+{
+  // one bucket at a time, not blocking call setup as a whole
+  ret.assertStruct();
+  for (unsigned int i = 0; i < PCALLS_BUCKETS; i++) {
+    PCallsBucket* bucket = call_control_calls.get_bucket(i);
+    bucket->lock();
+    for (map<string, unsigned int>::iterator it = bucket->calls.begin();
+	 it != bucket->calls.end(); it++) {
+      ret[it->first] = (int)it->second;
+    }
+    bucket->unlock();
+  }
+}
+
+void CCParallelCalls::getStats(AmArg& ret)
+{
+  ret["active_calls"] = (int)active_calls.get();
+  ret["refused_calls"] = (long long)refused_calls.get();
+}
+
 CCParallelCalls* CCParallelCalls::_instance=0;
 
 CCParallelCalls* CCParallelCalls::instance()
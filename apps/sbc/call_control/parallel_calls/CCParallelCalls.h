@@ -27,12 +27,30 @@
 #define _CC_TEMPLATE_H
 
 #include "AmApi.h"
+#include "atomic_types.h"
+#include "hash_table.h"
 #include <map>
 
 #include "SBCCallProfile.h"
 
 using std::map;
 
+/* number of buckets for the call counts (power of 2) */
+#define PCALLS_BUCKETS 1024
+
+/**
+ * Hash-table bucket:
+ *   uuid -> # of calls
+ */
+class PCallsBucket
+  : public AmMutex
+{
+public:
+  map<string, unsigned int> calls;
+
+  PCallsBucket(unsigned long id) {}
+};
+
 /**
  * call control module limiting parallel number of calls
  */
@@ -41,9 +59,13 @@ class CCParallelCalls : public AmDynInvoke
   static unsigned int refuse_code;
   static string refuse_reason;
 
-  // this map contains # of calls per uuid
-  map<string, unsigned int> call_control_calls;
-  AmMutex call_control_calls_mut;
+  // # of calls per uuid, locked per bucket
+  hash_table<PCallsBucket> call_control_calls;
+
+  atomic_int active_calls;
+  atomic_int64 refused_calls;
+
+  PCallsBucket* getBucket(const string& uuid);
 
   static CCParallelCalls* _instance;
 
@@ -53,6 +75,9 @@ class CCParallelCalls : public AmDynInvoke
   void end(const string& cc_namespace,
 	   const string& ltag, SBCCallProfile* call_profile);
 
+  void getCalls(AmArg& ret);
+  void getStats(AmArg& ret);
+
  public:
   CCParallelCalls();
   ~CCParallelCalls();
@@ -58,6 +58,9 @@ public:
 
       return 0;
     }
+
+    /** XMLRPC requests are made synchronously from the call */
+    bool supportsSessionThreadPool() { return false; }
 };
 
 EXPORT_PLUGIN_CLASS_FACTORY(PrepaidXMLRPCFactory, MOD_NAME);
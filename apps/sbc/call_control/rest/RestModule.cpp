@@ -56,6 +56,9 @@ public:
 
       return 0;
     }
+
+    /** HTTP requests are made synchronously from the call */
+    bool supportsSessionThreadPool() { return false; }
 };
 
 EXPORT_PLUGIN_CLASS_FACTORY(RestModuleFactory, MOD_NAME);
@@ -30,6 +30,7 @@
 #include "SyslogCDR.h"
 
 #include "SBCCallControlAPI.h"
+#include "SBCEventLog.h"
 
 #include <string.h>
 #include <syslog.h>
@@ -83,7 +84,8 @@ SyslogCDR* SyslogCDR::instance()
 }
 
 SyslogCDR::SyslogCDR()
-  : level(2), syslog_prefix("CDR: "), quoting_enabled(true)
+  : level(2), syslog_prefix("CDR: "), quoting_enabled(true),
+    use_event_log(false), event_log_warned(false)
 {
 }
 
@@ -112,6 +114,8 @@ int SyslogCDR::onLoad() {
   quoting_enabled = cfg.hasParameter("quoting_enabled") ?
     cfg.getParameter("quoting_enabled") == "yes" : quoting_enabled;
 
+  use_event_log = cfg.getParameter("use_event_log") == "yes";
+
   if (level > 4) {
     WARN("log level > 4 not supported\n");
     level = 4;
@@ -372,6 +376,21 @@ void SyslogCDR::end(const string& ltag, SBCCallProfile* call_profile,
   if (cdr.size() && cdr[cdr.size()-1]==',')
     cdr.erase(cdr.size()-1, 1);
 
+  if (use_event_log) {
+    if (SBCEventLog::instance()->hasHandler()) {
+      SBCEventLog::instance()->logEvent(ltag, "cdr", AmArg(syslog_prefix + cdr));
+      DBG("passed CDR '%s' to the event log\n", ltag.c_str());
+      return;
+    }
+
+    // the CDR would be lost otherwise
+    if (!event_log_warned) {
+      WARN("use_event_log=yes, but no event_log is set in sbc.conf: "
+	   "writing CDRs to syslog\n");
+      event_log_warned = true;
+    }
+  }
+
   syslog(log2syslog_level[level], "%s%s", syslog_prefix.c_str(), cdr.c_str());
   DBG("written CDR '%s' to syslog\n", ltag.c_str());
 }
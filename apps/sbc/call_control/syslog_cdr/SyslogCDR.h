@@ -52,6 +52,11 @@ class SyslogCDR : public AmDynInvoke, public ExtendedCCInterface, public AmObjec
 
   bool quoting_enabled;
 
+  // pass CDRs to the SBC event log instead of syslog()
+  bool use_event_log;
+  // syslog() is used if the SBC has no event log
+  bool event_log_warned;
+
   /* map<string, CDR*> cdrs; */
   /* AmMutex cdrs_mut; */
 
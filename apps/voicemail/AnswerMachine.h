@@ -102,6 +102,11 @@ public:
   int onLoad();
   AmSession* onInvite(const AmSipRequest& req, const string& app_name,
 		      const map<string,string>& app_params);
+
+#ifdef USE_MYSQL
+  /** greetings are looked up in MySQL on each call */
+  bool supportsSessionThreadPool() { return false; }
+#endif
 };
 
 class AnswerMachineDialog : public AmSession
@@ -83,6 +83,16 @@ class AmPluginFactory
    * @return 1 on error.
    */
   virtual int onLoad()=0;
+
+  /**
+   * Tells whether the plug-in can be used if the sessions are run
+   * on the session thread pool (SESSION_THREADPOOL). Plug-ins that
+   * block in session context (e.g. waiting for a database, HTTP
+   * server or interpreter lock) stall all sessions sharing the same
+   * processor thread, and must return false here.
+   * @return true if nothing blocks in session context.
+   */
+  virtual bool supportsSessionThreadPool() { return true; }
 };
 
 /**
@@ -47,53 +47,105 @@ const char* AmArg::t2str(int type) {
 }
 
 AmArg::AmArg(const AmArg& v)
+  : type(Undef), cstr_inline(false)
 { 
-  type = Undef;
-
-  *this = v;
+  copy(v);
 }
 
 AmArg& AmArg::operator=(const AmArg& v) {
   if (this != &v) {
-    invalidate();
-    
-    type = v.type;
-    switch(type){
-    case Int:    { v_int = v.v_int; } break;
-    case LongLong: { v_long = v.v_long; } break;
-    case Bool:   { v_bool = v.v_bool; } break;
-    case Double: { v_double = v.v_double; } break;
-    case CStr:   { v_cstr = strdup(v.v_cstr); } break;
-    case AObject:{ v_obj = v.v_obj; } break;
-    case ADynInv:{ v_inv = v.v_inv; } break;
-    case Array:  { v_array = new ValueArray(*v.v_array); } break;
-    case Struct: { v_struct = new ValueStruct(*v.v_struct); } break;
-    case Blob:   {  v_blob = new ArgBlob(*v.v_blob); } break;
-    case Undef: break;
-    default: assert(0);
-    }
+    // copy first: v may be a member of this
+    AmArg tmp(v);
+    swap(tmp);
   }
   return *this;
 }
 
+/** copy v into this, which must be Undef */
+void AmArg::copy(const AmArg& v) {
+  switch(v.type){
+  case Int:    { v_int = v.v_int; } break;
+  case LongLong: { v_long = v.v_long; } break;
+  case Bool:   { v_bool = v.v_bool; } break;
+  case Double: { v_double = v.v_double; } break;
+  case CStr:   {
+    if (v.cstr_inline) {
+      memcpy(v_cstr_inline, v.v_cstr_inline, AMARG_INLINE_CSTR_LEN);
+      cstr_inline = true;
+    } else {
+      v_cstr = strdup(v.v_cstr);
+    }
+  } break;
+  case AObject:{ v_obj = v.v_obj; } break;
+  case ADynInv:{ v_inv = v.v_inv; } break;
+  case Array:  { v_array = new ValueArray(*v.v_array); } break;
+  case Struct: { v_struct = new ValueStruct(*v.v_struct); } break;
+  case Blob:   {  v_blob = new ArgBlob(*v.v_blob); } break;
+  case Undef: break;
+  default: assert(0);
+  }
+  type = v.type;
+}
+
+void AmArg::setCStr(const char* s, size_t len) {
+  invalidate();
+  if (len < AMARG_INLINE_CSTR_LEN) {
+    memcpy(v_cstr_inline, s, len);
+    v_cstr_inline[len] = '\0';
+    cstr_inline = true;
+  } else {
+    char* c = (char*)malloc(len + 1);
+    memcpy(c, s, len);
+    c[len] = '\0';
+    v_cstr = c;
+  }
+  type = CStr;
+}
+
+/** number of value bytes in use */
+size_t AmArg::valueLen() const {
+  if (cstr_inline)
+    return AMARG_INLINE_CSTR_LEN;
+  if (type == Undef)
+    return 0;
+  return sizeof(v_long);
+}
+
+void AmArg::swap(AmArg& a) {
+  if (this == &a)
+    return;
+
+  char v[AMARG_INLINE_CSTR_LEN];
+  size_t len = valueLen(), a_len = a.valueLen();
+  memcpy(v, v_cstr_inline, len);
+  memcpy(v_cstr_inline, a.v_cstr_inline, a_len);
+  memcpy(a.v_cstr_inline, v, len);
+
+  std::swap(type, a.type);
+  std::swap(cstr_inline, a.cstr_inline);
+}
+
 AmArg::AmArg(std::map<std::string, std::string>& v) 
-  : type(Undef) {
+  : type(Undef), cstr_inline(false) {
   assertStruct();
+  // already sorted
+  v_struct->reserve(v.size());
   for (std::map<std::string, std::string>::iterator it=
 	 v.begin();it!= v.end();it++)
-    (*v_struct)[it->first] = AmArg(it->second.c_str());
+    v_struct->insert(v_struct->end(), ValueStruct::value_type(it->first, AmArg(it->second)));
 }
 
 AmArg::AmArg(std::map<std::string, AmArg>& v) 
-  : type(Undef) {
+  : type(Undef), cstr_inline(false) {
   assertStruct();
+  v_struct->reserve(v.size());
   for (std::map<std::string, AmArg>::iterator it=
 	 v.begin();it!= v.end();it++)
-    (*v_struct)[it->first] = it->second;
+    v_struct->insert(v_struct->end(), *it);
 }
 
 AmArg::AmArg(vector<std::string>& v)
-  : type(Array) {
+  : type(Undef), cstr_inline(false) {
   assertArray(0);
   for (vector<std::string>::iterator it 
 	 = v.begin(); it != v.end(); it++) {
@@ -102,7 +154,7 @@ AmArg::AmArg(vector<std::string>& v)
 }
     
 AmArg::AmArg(const vector<int>& v ) 
-  : type(Array) {
+  : type(Undef), cstr_inline(false) {
   assertArray(0);
   for (vector<int>::const_iterator it 
 	 = v.begin(); it != v.end(); it++) {
@@ -111,7 +163,7 @@ AmArg::AmArg(const vector<int>& v )
 }
 
 AmArg::AmArg(const vector<double>& v)
-  : type(Array) {
+  : type(Undef), cstr_inline(false) {
   assertArray(0);
   for (vector<double>::const_iterator it 
 	 = v.begin(); it != v.end(); it++) {
@@ -164,11 +216,12 @@ void AmArg::assertStruct() const {
 }
 
 void AmArg::invalidate() {
-  if(type == CStr) { free((void*)v_cstr); }
+  if(type == CStr) { if (!cstr_inline) free((void*)v_cstr); }
   else if(type == Array) { delete v_array; }
   else if(type == Struct) { delete v_struct; }
   else if(type == Blob) { delete v_blob; }
   type = Undef;
+  cstr_inline = false;
 }
 
 void AmArg::push(const AmArg& a) {
@@ -178,7 +231,9 @@ void AmArg::push(const AmArg& a) {
 
 void AmArg::push(const string &key, const AmArg &val) {
   assertStruct();
-  (*v_struct)[key] = val;
+  // copy first: val may be a member of this
+  AmArg v(val);
+  (*v_struct)[key].swap(v);
 }
 
 void AmArg::pop(AmArg &a) {
@@ -189,8 +244,10 @@ void AmArg::pop(AmArg &a) {
     a = AmArg();
     return;
   }
-  a = v_array->front();
+  AmArg v;
+  v.swap(v_array->front());
   v_array->erase(v_array->begin());
+  a.swap(v);
 }
 
 void AmArg::pop_back(AmArg &a) {
@@ -201,15 +258,17 @@ void AmArg::pop_back(AmArg &a) {
     a = AmArg();
     return;
   }
-  a = v_array->back();
-  v_array->erase(v_array->end());
+  AmArg v;
+  v.swap(v_array->back());
+  v_array->pop_back();
+  a.swap(v);
 }
 
 void AmArg::pop_back() {
   assertArray();
   if (!size())
     return;
-  v_array->erase(v_array->end());
+  v_array->pop_back();
 }
 
 void AmArg::concat(const AmArg& a) {
@@ -325,7 +384,7 @@ bool operator==(const AmArg& lhs, const AmArg& rhs) {
   case AmArg::LongLong: { return lhs.v_long == rhs.v_long; } break;
   case AmArg::Bool:   { return lhs.v_bool == rhs.v_bool; } break;
   case AmArg::Double: { return lhs.v_double == rhs.v_double; } break;
-  case AmArg::CStr:   { return !strcmp(lhs.v_cstr,rhs.v_cstr); } break;
+  case AmArg::CStr:   { return !strcmp(lhs.asCStr(),rhs.asCStr()); } break;
   case AmArg::AObject:{ return lhs.v_obj == rhs.v_obj; } break;
   case AmArg::ADynInv:{ return lhs.v_inv == rhs.v_inv; } break;
   case AmArg::Array:  { return lhs.v_array == rhs.v_array;  } break;
@@ -39,6 +39,8 @@ using std::vector;
 using std::string;
 
 #include <map>
+#include <utility>
+#include <algorithm>
 
 #include "log.h"
 
@@ -76,8 +78,113 @@ struct ArgBlob {
   ~ArgBlob() { if (data) free(data); }
 };
 
+/**
+ * Struct value storage of @see AmArg: members are kept in one
+ * vector, sorted by name, instead of one map node each. Provides
+ * the part of the std::map interface used on AmArg::ValueStruct.
+ *
+ * Note: adding a member moves the members behind it, i.e.
+ * references to members are invalidated by operator[] and insert.
+ */
+template<class V>
+class ArgStruct
+{
+ public:
+  typedef std::string               key_type;
+  typedef V                         mapped_type;
+  typedef std::pair<std::string, V> value_type;
+
+ private:
+  typedef std::vector<value_type> Members;
+  Members members;
+
+  struct NameLess {
+    bool operator()(const value_type& m, const std::string& name) const {
+      return m.first < name;
+    }
+  };
+
+ public:
+  typedef typename Members::iterator       iterator;
+  typedef typename Members::const_iterator const_iterator;
+  typedef typename Members::size_type      size_type;
+
+  iterator begin() { return members.begin(); }
+  iterator end() { return members.end(); }
+  const_iterator begin() const { return members.begin(); }
+  const_iterator end() const { return members.end(); }
+
+  size_type size() const { return members.size(); }
+  bool empty() const { return members.empty(); }
+  void reserve(size_type n) { members.reserve(n); }
+  void clear() { members.clear(); }
+
+  iterator lower_bound(const std::string& name) {
+    return std::lower_bound(members.begin(), members.end(), name, NameLess());
+  }
+
+  const_iterator lower_bound(const std::string& name) const {
+    return std::lower_bound(members.begin(), members.end(), name, NameLess());
+  }
+
+  iterator find(const std::string& name) {
+    iterator it = lower_bound(name);
+    if (it == members.end() || it->first != name)
+      return members.end();
+    return it;
+  }
+
+  const_iterator find(const std::string& name) const {
+    const_iterator it = lower_bound(name);
+    if (it == members.end() || it->first != name)
+      return members.end();
+    return it;
+  }
+
+  size_type count(const std::string& name) const {
+    return find(name) != members.end() ? 1 : 0;
+  }
+
+  V& operator[](const std::string& name) {
+    iterator it = lower_bound(name);
+    if (it == members.end() || it->first != name)
+      it = members.insert(it, value_type(name, V()));
+    return it->second;
+  }
+
+  std::pair<iterator, bool> insert(const value_type& m) {
+    iterator it = lower_bound(m.first);
+    if (it != members.end() && it->first == m.first)
+      return std::make_pair(it, false);
+    return std::make_pair(members.insert(it, m), true);
+  }
+
+  /** appends without searching if m sorts after the last member */
+  iterator insert(iterator hint, const value_type& m) {
+    if (hint == members.end() &&
+	(members.empty() || members.back().first < m.first)) {
+      members.push_back(m);
+      return members.end() - 1;
+    }
+    return insert(m).first;
+  }
+
+  void erase(iterator it) { members.erase(it); }
+
+  size_type erase(const std::string& name) {
+    iterator it = find(name);
+    if (it == members.end())
+      return 0;
+    members.erase(it);
+    return 1;
+  }
+};
+
 class AmDynInvoke;
 
+/** strings up to this length (including '\0') are stored inside AmArg */
+#define AMARG_INLINE_CSTR_LEN 16
+
 /** \brief variable type argument for DynInvoke APIs */
 class AmArg
 : public AmObject
@@ -109,11 +216,14 @@ class AmArg
   };
   
   typedef std::vector<AmArg> ValueArray;
-  typedef std::map<std::string, AmArg> ValueStruct; 
+  typedef ArgStruct<AmArg> ValueStruct;
 
  private:
   // type
   short type;
+
+  // CStr value is stored in v_cstr_inline
+  bool cstr_inline;
     
   // value
   union {
@@ -127,68 +237,80 @@ class AmArg
     ArgBlob*       v_blob;
     ValueArray*    v_array;
     ValueStruct*   v_struct;
+    char           v_cstr_inline[AMARG_INLINE_CSTR_LEN];
   };
 
   void invalidate();
+  void copy(const AmArg& v);
+  void setCStr(const char* s, size_t len);
+  size_t valueLen() const;
 
  public:
 
  AmArg() 
-   : type(Undef) 
+   : type(Undef), cstr_inline(false)
   { }
   
   AmArg(const AmArg& v);
+
+#if __cplusplus >= 201103L
+  AmArg(AmArg&& v) noexcept
+    : type(Undef), cstr_inline(false)
+  {
+    swap(v);
+  }
+#endif
   
  AmArg(const int& v)
-   : type(Int),
+   : type(Int), cstr_inline(false),
     v_int(v)
     { }
 
  AmArg(const long int& v)
-   : type(Int),
+   : type(Int), cstr_inline(false),
     v_int(v)
     { }
 
  AmArg(const long long int& v)
-   : type(LongLong),
+   : type(LongLong), cstr_inline(false),
     v_long(v)
     { }
 
  AmArg(const bool& v)
-   : type(Bool),
+   : type(Bool), cstr_inline(false),
     v_bool(v)
     { }
   
  AmArg(const double& v)
-   : type(Double),
+   : type(Double), cstr_inline(false),
     v_double(v)
     { }
   
  AmArg(const char* v)
-   : type(CStr)
+   : type(Undef), cstr_inline(false)
   {
-    v_cstr = strdup(v);
+    setCStr(v, strlen(v));
   }
   
  AmArg(const string &v)
-   : type(CStr)
+   : type(Undef), cstr_inline(false)
   {
-    v_cstr = strdup(v.c_str());
+    setCStr(v.c_str(), v.length());
   }
   
  AmArg(const ArgBlob v)
-   : type(Blob)
+   : type(Blob), cstr_inline(false)
   {
     v_blob = new ArgBlob(v);
   }
 
   AmArg(AmObject* v) 
-    : type(AObject),
+    : type(AObject), cstr_inline(false),
     v_obj(v) 
    { }
 
   AmArg(AmDynInvoke* v) 
-    : type(ADynInv),
+    : type(ADynInv), cstr_inline(false),
     v_inv(v) 
    { }
 
@@ -211,6 +333,21 @@ class AmArg
 
   AmArg& operator=(const AmArg& rhs);
 
+#if __cplusplus >= 201103L
+  AmArg& operator=(AmArg&& rhs) noexcept {
+    if (this != &rhs) {
+      // rhs may be a member of this
+      AmArg tmp;
+      tmp.swap(rhs);
+      swap(tmp);
+    }
+    return *this;
+  }
+#endif
+
+  /** exchange values with a, without copying */
+  void swap(AmArg& a);
+
 #define isArgUndef(a) (AmArg::Undef == a.getType())
 #define isArgArray(a) (AmArg::Array == a.getType())
 #define isArgStruct(a)(AmArg::Struct == a.getType())
@@ -271,7 +408,7 @@ class AmArg
   long long   asLongLong() const { return v_long; }
   int         asBool()   const { return v_bool; }
   double      asDouble() const { return v_double; }
-  const char* asCStr()   const { return v_cstr; }
+  const char* asCStr()   const { return cstr_inline ? v_cstr_inline : v_cstr; }
   AmObject*  asObject() const { return v_obj; }
   AmDynInvoke* asDynInv() const { return v_inv; }
   ArgBlob*    asBlob()   const { return v_blob; }
@@ -0,0 +1,147 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmAsyncJob.h"
+#include "AmEventDispatcher.h"
+#include "log.h"
+
+_AmAsyncJobProcessor::_AmAsyncJobProcessor()
+  : jobs_pending(false)
+{
+}
+
+_AmAsyncJobProcessor::~_AmAsyncJobProcessor()
+{
+  dispose();
+}
+
+void _AmAsyncJobProcessor::dispose()
+{
+  workers_mut.lock();
+  for(std::vector<AmAsyncJobWorker*>::iterator it = workers.begin();
+      it != workers.end(); it++) {
+    (*it)->stop();
+    (*it)->join();
+    delete *it;
+  }
+  workers.clear();
+  workers_mut.unlock();
+
+  jobs_mut.lock();
+  while(!jobs.empty()) {
+    delete jobs.front();
+    jobs.pop_front();
+    queued.dec();
+  }
+  jobs_pending.set(false);
+  jobs_mut.unlock();
+}
+
+void _AmAsyncJobProcessor::addThreads(unsigned int num_threads)
+{
+  DBG("starting %u async job threads\n", num_threads);
+  workers_mut.lock();
+  for (unsigned int i=0; i < num_threads;i++) {
+    workers.push_back(new AmAsyncJobWorker(this));
+    workers.back()->start();
+  }
+  DBG("now %zd async job threads running\n", workers.size());
+  workers_mut.unlock();
+}
+
+int _AmAsyncJobProcessor::post(AmAsyncJob* job)
+{
+  workers_mut.lock();
+  bool have_workers = !workers.empty();
+  workers_mut.unlock();
+
+  if(!have_workers) {
+    ERROR("posting async job but no async job thread running\n");
+    delete job;
+    return -1;
+  }
+
+  jobs_mut.lock();
+  jobs.push_back(job);
+  queued.inc();
+  jobs_pending.set(true);
+  jobs_mut.unlock();
+
+  return 0;
+}
+
+AmAsyncJob* _AmAsyncJobProcessor::getJob()
+{
+  if(!jobs_pending.wait_for_to(500))
+    return NULL;
+
+  AmLock l(jobs_mut);
+  if(jobs.empty()) {
+    jobs_pending.set(false);
+    return NULL;
+  }
+
+  AmAsyncJob* job = jobs.front();
+  jobs.pop_front();
+  if(jobs.empty())
+    jobs_pending.set(false);
+
+  queued.dec();
+  running.inc();
+  return job;
+}
+
+void _AmAsyncJobProcessor::jobDone(AmAsyncJob* job)
+{
+  AmEvent* ev = job->getResultEvent();
+  if(ev && !AmEventDispatcher::instance()->post(job->getSessionId(), ev)) {
+    DBG("session '%s' gone, dropping async job result\n",
+	job->getSessionId().c_str());
+    undelivered.inc();
+    delete ev;
+  }
+
+  running.dec();
+  finished.inc();
+  delete job;
+}
+
+void AmAsyncJobWorker::run()
+{
+  while(!stop_requested.get()) {
+
+    AmAsyncJob* job = processor->getJob();
+    if(!job)
+      continue;
+
+    job->run();
+    processor->jobDone(job);
+  }
+}
+
+void AmAsyncJobWorker::on_stop()
+{
+  stop_requested.set(true);
+}
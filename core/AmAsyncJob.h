@@ -0,0 +1,136 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _AmAsyncJob_h_
+#define _AmAsyncJob_h_
+
+#include "AmThread.h"
+#include "AmEvent.h"
+#include "atomic_types.h"
+#include "singleton.h"
+
+#include <string>
+#include <deque>
+#include <vector>
+using std::string;
+
+/**
+ * \brief a blocking operation executed outside of the session
+ *
+ * Application logic that would block (database queries, HTTP
+ * requests, external commands) is wrapped into a job and handed
+ * to the async job processor. The session keeps processing its
+ * other events in the meantime; once the job is done, its result
+ * event is posted to the session's event queue, where the
+ * application continues.
+ */
+class AmAsyncJob
+{
+  string session_id;
+
+ public:
+  /** @param session_id local tag of the session to post the result to */
+  AmAsyncJob(const string& session_id)
+    : session_id(session_id) { }
+  virtual ~AmAsyncJob() { }
+
+  /** executed by a job worker thread; may block */
+  virtual void run() = 0;
+
+  /**
+   * Event to post to the session after run().
+   * @return NULL if nothing should be posted
+   */
+  virtual AmEvent* getResultEvent() = 0;
+
+  const string& getSessionId() const { return session_id; }
+};
+
+class _AmAsyncJobProcessor;
+
+class AmAsyncJobWorker
+  : public AmThread
+{
+  _AmAsyncJobProcessor* processor;
+  AmSharedVar<bool> stop_requested;
+
+ public:
+  AmAsyncJobWorker(_AmAsyncJobProcessor* processor)
+    : processor(processor), stop_requested(false) { }
+
+ protected:
+  void run();
+  void on_stop();
+};
+
+/**
+ * The async job processor executes AmAsyncJob's
+ * using a pool of workers (async_job_threads).
+ */
+class _AmAsyncJobProcessor
+{
+  std::deque<AmAsyncJob*>        jobs;
+  AmMutex                        jobs_mut;
+  AmCondition<bool>              jobs_pending;
+
+  std::vector<AmAsyncJobWorker*> workers;
+  AmMutex                        workers_mut;
+
+  atomic_int queued;
+  atomic_int running;
+  atomic_int finished;
+  atomic_int undelivered;
+
+  friend class AmAsyncJobWorker;
+
+  /** get the next job, waits at most 500ms */
+  AmAsyncJob* getJob();
+  void jobDone(AmAsyncJob* job);
+
+ protected:
+  _AmAsyncJobProcessor();
+  ~_AmAsyncJobProcessor();
+
+  void dispose();
+
+ public:
+  void addThreads(unsigned int num_threads);
+
+  /**
+   * Queue a job for execution.
+   * The processor takes ownership of the job.
+   * @return 0 on success, -1 if no worker is running
+   */
+  int post(AmAsyncJob* job);
+
+  unsigned int getQueued() { return queued.get(); }
+  unsigned int getRunning() { return running.get(); }
+  unsigned int getFinished() { return finished.get(); }
+  unsigned int getUndelivered() { return undelivered.get(); }
+};
+
+typedef singleton<_AmAsyncJobProcessor> AmAsyncJobProcessor;
+
+#endif // _AmAsyncJob_h_
@@ -1191,16 +1191,22 @@ void AmB2BMedia::setRelayDTMFReceiving(bool enabled) {
     DBG("force_receive_dtmf %sabled for [%p]\n", enabled?"en":"dis", &(*j)->b);
     (*j)->a.force_receive_dtmf = enabled;
     (*j)->b.force_receive_dtmf = enabled;
+    (*j)->a.invalidateRelayOffload();
+    (*j)->b.invalidateRelayOffload();
   }
 
   for (AudioStreamIterator j = audio.begin(); j != audio.end(); j++) {
     DBG("force_receive_dtmf %sabled for [%p]\n", enabled?"en":"dis", j->a.getStream());
     DBG("force_receive_dtmf %sabled for [%p]\n", enabled?"en":"dis", j->b.getStream());
-    if (NULL != j->a.getStream())
+    if (NULL != j->a.getStream()) {
       j->a.getStream()->force_receive_dtmf = enabled;
+      j->a.getStream()->invalidateRelayOffload();
+    }
     
-    if (NULL != j->b.getStream())
+    if (NULL != j->b.getStream()) {
       j->b.getStream()->force_receive_dtmf = enabled;
+      j->b.getStream()->invalidateRelayOffload();
+    }
   }
 }
 
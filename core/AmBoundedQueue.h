@@ -0,0 +1,124 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _AmBoundedQueue_h_
+#define _AmBoundedQueue_h_
+
+/**
+ * \brief bounded lock-free multi-producer, single-consumer queue
+ *
+ * A ring of preallocated cells, each with a sequence number telling
+ * whether it is free for the producer at a position or filled for
+ * the consumer. Producers claim a cell with one CAS and fill it in
+ * place; they never block, a full queue is reported to the caller.
+ *
+ * Producer:
+ *   unsigned long pos;
+ *   T* e = q.begin_push(pos);
+ *   if (e) { ...fill *e...; q.end_push(pos); }
+ *
+ * Consumer (one thread only):
+ *   while (T* e = q.front()) { ...use *e...; q.pop(); }
+ */
+template<class T>
+class AmBoundedQueue
+{
+  struct Cell {
+    volatile unsigned long seq;
+    T                      elem;
+  };
+
+  Cell*                  cells;
+  unsigned long          mask;
+  volatile unsigned long enqueue_pos;
+  unsigned long          dequeue_pos;
+
+  AmBoundedQueue(const AmBoundedQueue&);
+  AmBoundedQueue& operator=(const AmBoundedQueue&);
+
+public:
+  /** @param size rounded up to a power of 2 */
+  AmBoundedQueue(unsigned int size)
+    : enqueue_pos(0), dequeue_pos(0)
+  {
+    unsigned long n = 2;
+    while (n < size)
+      n <<= 1;
+
+    cells = new Cell[n];
+    mask = n - 1;
+    for (unsigned long i = 0; i < n; i++)
+      cells[i].seq = i;
+  }
+
+  ~AmBoundedQueue() {
+    delete [] cells;
+  }
+
+  /**
+   * Claim the next free element.
+   * @return element to fill, NULL if the queue is full
+   */
+  T* begin_push(unsigned long& pos) {
+    pos = enqueue_pos;
+    while (true) {
+      Cell* c = &cells[pos & mask];
+      long diff = (long)c->seq - (long)pos;
+      if (diff == 0) {
+	if (__sync_bool_compare_and_swap(&enqueue_pos, pos, pos + 1))
+	  return &c->elem;
+      } else if (diff < 0) {
+	return NULL;
+      }
+      pos = enqueue_pos;
+    }
+  }
+
+  /** hand the element claimed at pos over to the consumer */
+  void end_push(unsigned long pos) {
+    __sync_synchronize();
+    cells[pos & mask].seq = pos + 1;
+  }
+
+  /** @return the oldest element, NULL if there is none (consumer) */
+  T* front() {
+    Cell* c = &cells[dequeue_pos & mask];
+    if (c->seq != dequeue_pos + 1)
+      return NULL;
+
+    __sync_synchronize();
+    return &c->elem;
+  }
+
+  /** release the element returned by front() (consumer) */
+  void pop() {
+    __sync_synchronize();
+    cells[dequeue_pos & mask].seq = dequeue_pos + mask + 1;
+    dequeue_pos++;
+  }
+};
+
+#endif
@@ -41,6 +41,7 @@
 #include "AmConfigReader.h"
 #include "AmUtils.h"
 #include "AmSessionContainer.h"
+#include "AmEventDispatcher.h"
 #include "Am100rel.h"
 #include "sip/transport.h"
 #include "sip/resolver.h"
@@ -61,6 +62,8 @@ string       AmConfig::ExcludePlugins          = "";
 string       AmConfig::ExcludePayloads         = "";
 int          AmConfig::LogLevel                = L_INFO;
 bool         AmConfig::LogStderr               = false;
+bool         AmConfig::LogAsync                = false;
+unsigned int AmConfig::LogAsyncQueueSize       = 1024;
 
 vector<AmConfig::SIP_interface> AmConfig::SIP_Ifs;
 vector<AmConfig::RTP_interface> AmConfig::RTP_Ifs;
@@ -82,6 +85,13 @@ int          AmConfig::SessionProcessorThreads = NUM_SESSION_PROCESSORS;
 int          AmConfig::MediaProcessorThreads   = NUM_MEDIA_PROCESSORS;
 int          AmConfig::RTPReceiverThreads      = NUM_RTP_RECEIVERS;
 int          AmConfig::SIPServerThreads        = NUM_SIP_SERVERS;
+int          AmConfig::AsyncJobThreads         = NUM_ASYNC_JOB_THREADS;
+AmCpuSet     AmConfig::SessionProcessorCpus;
+AmCpuSet     AmConfig::MediaProcessorCpus;
+AmCpuSet     AmConfig::RTPReceiverCpus;
+AmCpuSet     AmConfig::SIPServerCpus;
+unsigned int AmConfig::EventDispatcherShards   = EVENT_DISPATCHER_BUCKETS;
+unsigned int AmConfig::SessionCleanerThreads   = NUM_SESSION_CLEANER_THREADS;
 string       AmConfig::OutboundProxy           = "";
 bool         AmConfig::ForceOutboundProxy      = false;
 string       AmConfig::NextHop                 = "";
@@ -96,10 +106,12 @@ string       AmConfig::Signature               = "";
 unsigned int AmConfig::MaxForwards             = MAX_FORWARDS;
 bool	     AmConfig::SingleCodecInOK	       = false;
 unsigned int AmConfig::DeadRtpTime             = DEAD_RTP_TIME;
+unsigned int AmConfig::RtpBufferPoolSize       = 0;
+bool         AmConfig::RtpRelayOffload         = false;
 bool         AmConfig::IgnoreRTPXHdrs          = false;
 string       AmConfig::Application             = "";
 AmConfig::ApplicationSelector AmConfig::AppSelect        = AmConfig::App_SPECIFIED;
-RegexMappingVector AmConfig::AppMapping;
+RegexMapping AmConfig::AppMapping;
 bool         AmConfig::LogSessions             = false;
 bool         AmConfig::LogEvents               = false;
 int          AmConfig::UnhandledReplyLoglevel  = 0;
@@ -172,7 +184,8 @@ AmConfig::SIP_interface::SIP_interface()
     SigSockOpts(0),
     RtpInterface(-1),
     tcp_connect_timeout(DEFAULT_TCP_CONNECT_TIMEOUT),
-    tcp_idle_timeout(DEFAULT_TCP_IDLE_TIMEOUT)
+    tcp_idle_timeout(DEFAULT_TCP_IDLE_TIMEOUT),
+    tcp_max_send_queue(DEFAULT_TCP_MAX_SEND_QUEUE)
 {
 }
 
@@ -296,6 +309,13 @@ int AmConfig::setSIPServerThreads(const string& th){
   return 1;
 }
 
+int AmConfig::setAsyncJobThreads(const string& th){
+  if(sscanf(th.c_str(),"%u",&AsyncJobThreads) != 1) {
+    return 0;
+  }
+  return 1;
+}
+
 
 int AmConfig::setDeadRtpTime(const string& drt)
 {
@@ -343,6 +363,15 @@ int AmConfig::readConfiguration()
   }
 #endif
 
+  LogAsync = cfg.getParameter("log_async") == "yes";
+  if (cfg.hasParameter("log_async_queue_size")) {
+    if (str2i(cfg.getParameter("log_async_queue_size"), LogAsyncQueueSize) ||
+	!LogAsyncQueueSize) {
+      ERROR("invalid log_async_queue_size value specified\n");
+      ret = -1;
+    }
+  }
+
   // plugin_config_path
   if (cfg.hasParameter("plugin_config_path")) {
     ModConfigPath = cfg.getParameter("plugin_config_path",ModConfigPath);
@@ -487,8 +516,8 @@ int AmConfig::readConfiguration()
     AppSelect = App_MAPPING;  
     string appcfg_fname = ModConfigPath + "app_mapping.conf"; 
     DBG("Loading application mapping...\n");
-    if (!read_regex_mapping(appcfg_fname, "=>", "application mapping",
-			    AppMapping)) {
+    AppMapping.clear();
+    if (!AppMapping.read(appcfg_fname, "=>", "application mapping")) {
       ERROR("reading application mapping\n");
       ret = -1;
     }
@@ -543,7 +572,8 @@ int AmConfig::readConfiguration()
 #else
     WARN("session_processor_threads specified in sems.conf,\n");
     WARN("but SEMS is compiled without SESSION_THREADPOOL support.\n");
-    WARN("set USE_THREADPOOL in Makefile.defs to enable session thread pool.\n");
+    WARN("set USE_THREADPOOL in Makefile.defs (or SEMS_USE_THREADPOOL with cmake)"
+	 " to enable session thread pool.\n");
     WARN("SEMS will start now, but every call will have its own thread.\n");    
 #endif
   }
@@ -569,6 +599,60 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if(cfg.hasParameter("async_job_threads")){
+    if(!setAsyncJobThreads(cfg.getParameter("async_job_threads"))){
+      ERROR("invalid async_job_threads value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("session_cleaner_threads")){
+    if(str2i(cfg.getParameter("session_cleaner_threads"),
+	     SessionCleanerThreads) || !SessionCleanerThreads) {
+      ERROR("invalid session_cleaner_threads value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("session_processor_cpus")){
+    if(!SessionProcessorCpus.parse(cfg.getParameter("session_processor_cpus"))){
+      ERROR("invalid session_processor_cpus value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("media_processor_cpus")){
+    if(!MediaProcessorCpus.parse(cfg.getParameter("media_processor_cpus"))){
+      ERROR("invalid media_processor_cpus value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("rtp_receiver_cpus")){
+    if(!RTPReceiverCpus.parse(cfg.getParameter("rtp_receiver_cpus"))){
+      ERROR("invalid rtp_receiver_cpus value specified");
+      ret = -1;
+    }
+  } else {
+    // keep RTP receivers next to the media processors
+    RTPReceiverCpus = MediaProcessorCpus;
+  }
+
+  if(cfg.hasParameter("sip_server_cpus")){
+    if(!SIPServerCpus.parse(cfg.getParameter("sip_server_cpus"))){
+      ERROR("invalid sip_server_cpus value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("event_dispatcher_shards")){
+    if(str2i(cfg.getParameter("event_dispatcher_shards"),
+	     EventDispatcherShards) || !EventDispatcherShards) {
+      ERROR("invalid event_dispatcher_shards value specified");
+      ret = -1;
+    }
+  }
+
   // single codec in 200 OK
   if(cfg.hasParameter("single_codec_in_ok")){
     SingleCodecInOK = (cfg.getParameter("single_codec_in_ok") == "yes");
@@ -590,6 +674,17 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if(cfg.hasParameter("rtp_buffer_pool_size")){
+    if(str2i(cfg.getParameter("rtp_buffer_pool_size"), RtpBufferPoolSize)) {
+      ERROR("invalid rtp_buffer_pool_size value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("rtp_relay_offload")) {
+    RtpRelayOffload = (cfg.getParameter("rtp_relay_offload") == "yes");
+  }
+
   if(cfg.hasParameter("dtmf_detector")){
     if (cfg.getParameter("dtmf_detector") == "spandsp") {
 #ifndef USE_SPANDSP
@@ -802,6 +897,10 @@ static int readSIPInterface(AmConfigReader& cfg, const string& i_name)
   intf.tcp_idle_timeout =
     cfg.getParameterInt("tcp_idle_timeout" + suffix, DEFAULT_TCP_IDLE_TIMEOUT);
 
+  intf.tcp_max_send_queue =
+    cfg.getParameterInt("tcp_max_send_queue" + suffix,
+			DEFAULT_TCP_MAX_SEND_QUEUE);
+
   if(!i_name.empty())
     intf.name = i_name;
   else
@@ -1213,11 +1312,12 @@ void AmConfig::dump_Ifs()
     SIP_interface& it_ref = SIP_Ifs[i];
 
     INFO("\t(%i) name='%s'" ";LocalIP='%s'" 
-	 ";LocalPort='%u'" ";PublicIP='%s';TCP=%u/%u",
+	 ";LocalPort='%u'" ";PublicIP='%s';TCP=%u/%u/%u",
 	 i,it_ref.name.c_str(),it_ref.LocalIP.c_str(),
 	 it_ref.LocalPort,it_ref.PublicIP.c_str(),
 	 it_ref.tcp_connect_timeout,
-	 it_ref.tcp_idle_timeout);
+	 it_ref.tcp_idle_timeout,
+	 it_ref.tcp_max_send_queue);
   }
   
   INFO("Signaling address map:");
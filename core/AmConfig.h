@@ -33,6 +33,7 @@
 #include "AmSipDialog.h"
 #include "AmUtils.h"
 #include "AmAudio.h"
+#include "AmThread.h"
 
 #include <string>
 using std::string;
@@ -65,6 +66,10 @@ struct AmConfig
   static int LogLevel;
   /** log to stderr */
   static bool LogStderr;
+  /** write log records from a background thread */
+  static bool LogAsync;
+  /** number of records queued for the background thread */
+  static unsigned int LogAsyncQueueSize;
 
 #ifndef DISABLE_DAEMON_MODE
   /** run the program in daemon mode? */
@@ -112,6 +117,7 @@ struct AmConfig
 
     unsigned int tcp_connect_timeout;
     unsigned int tcp_idle_timeout;
+    unsigned int tcp_max_send_queue;
 
     /** RTP interface index */
     int RtpInterface;
@@ -177,6 +183,20 @@ struct AmConfig
   static int RTPReceiverThreads;
   /** number of SIP server threads */
   static int SIPServerThreads;
+  /** number of async job threads */
+  static int AsyncJobThreads;
+  /** CPUs the session processor threads are bound to (empty: any) */
+  static AmCpuSet SessionProcessorCpus;
+  /** CPUs the media processor threads are bound to (empty: any) */
+  static AmCpuSet MediaProcessorCpus;
+  /** CPUs the RTP receiver threads are bound to (empty: any) */
+  static AmCpuSet RTPReceiverCpus;
+  /** CPUs the SIP server threads are bound to (empty: any) */
+  static AmCpuSet SIPServerCpus;
+  /** number of event dispatcher shards (rounded up to a power of 2) */
+  static unsigned int EventDispatcherShards;
+  /** number of threads destroying dead sessions */
+  static unsigned int SessionCleanerThreads;
   /** Outbound Proxy (optional, outgoing calls only) */
   static string OutboundProxy;
   /** force Outbound Proxy to be used for in dialog requests */
@@ -219,7 +239,7 @@ struct AmConfig
   static ApplicationSelector AppSelect;
 
   /* this is regex->application mapping is used if  App_MAPPING */
-  static RegexMappingVector AppMapping; 
+  static RegexMapping AppMapping; 
 
 #ifdef WITH_ZRTP
   static bool enable_zrtp;
@@ -264,6 +284,12 @@ struct AmConfig
   /** Time of no RTP after which Session is regarded as dead, 0 for no Timeout */
   static unsigned int DeadRtpTime;
 
+  /** number of RTP receive buffers kept for reuse, 0 for none */
+  static unsigned int RtpBufferPoolSize;
+
+  /** relay RTP in the kernel where possible (AmRtpRelayOffload)? */
+  static bool RtpRelayOffload;
+
   /** Ignore RTP Extension headers? */
   static bool IgnoreRTPXHdrs;
 
@@ -313,6 +339,8 @@ struct AmConfig
   static int setRTPReceiverThreads(const string& th);
   /** Setter for parameter SIPServerThreads, returns 0 on invalid value */
   static int setSIPServerThreads(const string& th);
+  /** Setter for parameter AsyncJobThreads, returns 0 on invalid value */
+  static int setAsyncJobThreads(const string& th);
   /** Setter for parameter DeadRtpTime, returns 0 on invalid value */
   static int setDeadRtpTime(const string& drt);
 
@@ -1,12 +1,12 @@
 #include "AmEvent.h"
 
 AmEvent::AmEvent(int event_id)
-  : event_id(event_id), processed(false)
+  : event_id(event_id), processed(false), queue_next(NULL)
 {
 }
 
 AmEvent::AmEvent(const AmEvent& rhs) 
-: event_id(rhs.event_id), processed(rhs.processed)
+: event_id(rhs.event_id), processed(rhs.processed), queue_next(NULL)
 {
 }
 
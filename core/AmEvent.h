@@ -45,6 +45,9 @@ struct AmEvent
   int event_id;
   bool processed;
 
+  /** intrusive link used by AmEventQueue */
+  AmEvent* volatile queue_next;
+
   AmEvent(int event_id);
   AmEvent(const AmEvent& rhs);
 
@@ -30,20 +30,26 @@
 #include "AmConfig.h"
 #include "sip/hash.h"
 
-unsigned int AmEventDispatcher::hash(const string& s1)
+uint64_t AmEventDispatcher::hash(const string& s)
 {
-  return hashlittle(s1.c_str(),s1.length(),0) 
-    & (EVENT_DISPATCHER_BUCKETS-1);
+  uint32_t pc=0, pb=0;
+  hashlittle2(s.c_str(),s.length(),&pc,&pb);
+  return ((uint64_t)pc << 32) | pb;
 }
 
-unsigned int AmEventDispatcher::hash(const string& s1, const string s2)
+string AmEventDispatcher::get_id(const string& callid,
+				 const string& remote_tag,
+				 const string& via_branch)
 {
-    unsigned int h=0;
-
-    h = hashlittle(s1.c_str(),s1.length(),h);
-    h = hashlittle(s2.c_str(),s2.length(),h);
-
-    return h & (EVENT_DISPATCHER_BUCKETS-1);
+  string id;
+  id.reserve(callid.length() + remote_tag.length() +
+	     (AmConfig::AcceptForkedDialogs ? via_branch.length() : 0));
+  id += callid;
+  id += remote_tag;
+  if(AmConfig::AcceptForkedDialogs){
+    id += via_branch;
+  }
+  return id;
 }
 
 AmEventDispatcher* AmEventDispatcher::_instance=NULL;
@@ -53,23 +59,40 @@ AmEventDispatcher* AmEventDispatcher::instance()
   return _instance ? _instance : ((_instance = new AmEventDispatcher()));
 }
 
+AmEventDispatcher::AmEventDispatcher()
+{
+  // round up to the next power of 2
+  unsigned int power = 0;
+  while ((power < EVENT_DISPATCHER_MAX_POWER) &&
+	 ((1U << power) < AmConfig::EventDispatcherShards))
+    power++;
+  shards = 1U << power;
+
+  queues = new EvQueueMap[shards];
+  queues_mut = new AmMutex[shards];
+  id_lookup = new Dictionnary[shards];
+  id_lookup_mut = new AmMutex[shards];
+}
+
+AmEventDispatcher::~AmEventDispatcher()
+{
+  delete [] queues;
+  delete [] queues_mut;
+  delete [] id_lookup;
+  delete [] id_lookup_mut;
+}
 
 bool AmEventDispatcher::addEventQueue(const string& local_tag,
 				      AmEventQueueInterface* q)
 {
-    unsigned int queue_bucket = hash(local_tag);
+    uint64_t h = hash(local_tag);
+    unsigned int queue_bucket = shard(h);
 
     queues_mut[queue_bucket].lock();
-
-    if (queues[queue_bucket].find(local_tag) != queues[queue_bucket].end()) {
-      queues_mut[queue_bucket].unlock();
-      return false;
-    }
-
-    queues[queue_bucket][local_tag] = QueueEntry(q);
+    bool res = queues[queue_bucket].insert(h, local_tag, QueueEntry(q));
     queues_mut[queue_bucket].unlock();
     
-    return true;
+    return res;
 }
 
 
@@ -85,33 +108,30 @@ bool AmEventDispatcher::addEventQueue(const string& local_tag,
       return false;
     }
 
-    unsigned int queue_bucket = hash(local_tag);
+    uint64_t h = hash(local_tag);
+    unsigned int queue_bucket = shard(h);
 
     queues_mut[queue_bucket].lock();
 
-    if (queues[queue_bucket].find(local_tag) != queues[queue_bucket].end()) {
+    if (queues[queue_bucket].find(h, local_tag)) {
       queues_mut[queue_bucket].unlock();
       return false;
     }
 
     // try to find via id_lookup
-    string id = callid+remote_tag;
-    if(AmConfig::AcceptForkedDialogs){
-      id += via_branch;
-    }
-    unsigned int id_bucket = hash(id);
+    string id = get_id(callid,remote_tag,via_branch);
+    uint64_t id_h = hash(id);
+    unsigned int id_bucket = shard(id_h);
 
     id_lookup_mut[id_bucket].lock();
     
-    if (id_lookup[id_bucket].find(id) != 
-	id_lookup[id_bucket].end()) {
+    if (!id_lookup[id_bucket].insert(id_h, id, local_tag)) {
       id_lookup_mut[id_bucket].unlock();
       queues_mut[queue_bucket].unlock();
       return false;
     }
 
-    queues[queue_bucket][local_tag] = QueueEntry(q,id);
-    id_lookup[id_bucket][id] = local_tag;
+    queues[queue_bucket].insert(h, local_tag, QueueEntry(q,id));
 
     id_lookup_mut[id_bucket].unlock();
     queues_mut[queue_bucket].unlock();
@@ -122,27 +142,22 @@ bool AmEventDispatcher::addEventQueue(const string& local_tag,
 AmEventQueueInterface* AmEventDispatcher::delEventQueue(const string& local_tag)
 {
     AmEventQueueInterface* q = NULL;
-    unsigned int queue_bucket = hash(local_tag);
+    uint64_t h = hash(local_tag);
+    unsigned int queue_bucket = shard(h);
 
     queues_mut[queue_bucket].lock();
     
-    EvQueueMapIter qi = queues[queue_bucket].find(local_tag);
-    if(qi != queues[queue_bucket].end()) {
+    QueueEntry qe;
+    if(queues[queue_bucket].erase(h, local_tag, &qe)) {
 
-      QueueEntry qe(qi->second);
-      queues[queue_bucket].erase(qi);
       q = qe.q;
       
       if(!qe.id.empty()) {
-	unsigned int id_bucket = hash(qe.id);
+	uint64_t id_h = hash(qe.id);
+	unsigned int id_bucket = shard(id_h);
 	
 	id_lookup_mut[id_bucket].lock();
-	
-	DictIter di = id_lookup[id_bucket].find(qe.id);
-	if(di != id_lookup[id_bucket].end()) {	    
-	  id_lookup[id_bucket].erase(di);
-	}
-	
+	id_lookup[id_bucket].erase(id_h, qe.id);
 	id_lookup_mut[id_bucket].unlock();
       }
     }
@@ -151,17 +166,17 @@ AmEventQueueInterface* AmEventDispatcher::delEventQueue(const string& local_tag)
     return q;
 }
 
-bool AmEventDispatcher::post(const string& local_tag, AmEvent* ev)
+bool AmEventDispatcher::post(uint64_t h, const string& local_tag, AmEvent* ev)
 {
     bool posted = false;
   
-    unsigned int queue_bucket = hash(local_tag);
+    unsigned int queue_bucket = shard(h);
   
     queues_mut[queue_bucket].lock();
  
-    EvQueueMapIter it = queues[queue_bucket].find(local_tag);
-    if(it != queues[queue_bucket].end()){
-	it->second.q->postEvent(ev);
+    QueueEntry* qe = queues[queue_bucket].find(h, local_tag);
+    if(qe){
+	qe->q->postEvent(ev);
 	posted = true;
     }
 
@@ -170,26 +185,29 @@ bool AmEventDispatcher::post(const string& local_tag, AmEvent* ev)
     return posted;
 }
 
+bool AmEventDispatcher::post(const string& local_tag, AmEvent* ev)
+{
+    return post(hash(local_tag), local_tag, ev);
+}
+
 
 bool AmEventDispatcher::post(const string& callid, 
 			     const string& remote_tag, 
 			     const string& via_branch,
 			     AmEvent* ev)
 {
-    string id = callid+remote_tag;
-    if(AmConfig::AcceptForkedDialogs){
-      id += via_branch;
-    }
-    unsigned int id_bucket = hash(id);
+    string id = get_id(callid,remote_tag,via_branch);
+    uint64_t id_h = hash(id);
+    unsigned int id_bucket = shard(id_h);
 
     id_lookup_mut[id_bucket].lock();
 
-    DictIter di = id_lookup[id_bucket].find(id);
-    if (di == id_lookup[id_bucket].end()) {
+    string* lt = id_lookup[id_bucket].find(id_h, id);
+    if (!lt) {
       id_lookup_mut[id_bucket].unlock();
       return false;
     }
-    string local_tag = di->second;
+    string local_tag = *lt;
     id_lookup_mut[id_bucket].unlock();
  
     return post(local_tag, ev);
@@ -201,16 +219,14 @@ bool AmEventDispatcher::broadcast(AmEvent* ev)
       return false;
 
     bool posted = false;
-    for (size_t i=0;i<EVENT_DISPATCHER_BUCKETS;i++) {
+    for (size_t i=0;i<shards;i++) {
       queues_mut[i].lock();
 
-      EvQueueMapIter it = queues[i].begin(); 
-      while (it != queues[i].end()) {
-	EvQueueMapIter this_evq = it;
-	it++;
-	queues_mut[i].unlock();
-	this_evq->second.q->postEvent(ev->clone());
-	queues_mut[i].lock();
+      // the table is not modified while we hold the lock
+      for (size_t j=0; j<queues[i].capacity(); j++) {
+	if(!queues[i].is_used(j))
+	  continue;
+	queues[i].val_at(j).q->postEvent(ev->clone());
 	posted = true;
       }
       queues_mut[i].unlock();
@@ -223,7 +239,7 @@ bool AmEventDispatcher::broadcast(AmEvent* ev)
 
 bool AmEventDispatcher::empty() {
     bool res = true;
-    for (size_t i=0;i<EVENT_DISPATCHER_BUCKETS;i++) {
+    for (size_t i=0;i<shards;i++) {
       queues_mut[i].lock();
       res = res&queues[i].empty();
       queues_mut[i].unlock();    
@@ -233,16 +249,27 @@ bool AmEventDispatcher::empty() {
     return res;  
 }
 
+size_t AmEventDispatcher::size() {
+    size_t res = 0;
+    for (size_t i=0;i<shards;i++) {
+      queues_mut[i].lock();
+      res += queues[i].size();
+      queues_mut[i].unlock();
+    }
+    return res;
+}
+
 void AmEventDispatcher::dump()
 {
     DBG("*** dumping Event dispatcher buckets ***\n");
-    for (size_t i=0;i<EVENT_DISPATCHER_BUCKETS;i++) {
+    for (size_t i=0;i<shards;i++) {
       queues_mut[i].lock();
       if(!queues[i].empty()) {
 	DBG("queues[%zu].size() = %zu",i,queues[i].size());
-	for(EvQueueMapIter it = queues[i].begin();
-	    it != queues[i].end(); it++){
-	  DBG("\t%s -> %p\n",it->first.c_str(),it->second.q);
+	for(size_t j=0; j<queues[i].capacity(); j++){
+	  if(queues[i].is_used(j))
+	    DBG("\t%s -> %p\n",queues[i].key_at(j).c_str(),
+		queues[i].val_at(j).q);
 	}
       }
       queues_mut[i].unlock();
@@ -273,33 +300,30 @@ bool AmEventDispatcher::postSipRequest(const AmSipRequest& req)
 {
     // get local tag
     bool posted = false;
-    string callid = req.callid;
-    string remote_tag = req.from_tag;
 
-    string id = callid+remote_tag;
-    if(AmConfig::AcceptForkedDialogs){
-      id += req.via_branch;
-    }
-    unsigned int id_bucket = hash(id);
+    string id = get_id(req.callid,req.from_tag,req.via_branch);
+    uint64_t id_h = hash(id);
+    unsigned int id_bucket = shard(id_h);
 
     id_lookup_mut[id_bucket].lock();
 
-    DictIter di = id_lookup[id_bucket].find(id);
-    if (di == id_lookup[id_bucket].end()) {
+    string* lt = id_lookup[id_bucket].find(id_h, id);
+    if (!lt) {
       id_lookup_mut[id_bucket].unlock();
       return false;
     }
-    string local_tag = di->second;
+    string local_tag = *lt;
     id_lookup_mut[id_bucket].unlock();
  
     // post(local_tag)
-    unsigned int queue_bucket = hash(local_tag);
+    uint64_t h = hash(local_tag);
+    unsigned int queue_bucket = shard(h);
   
     queues_mut[queue_bucket].lock();
  
-    EvQueueMapIter it = queues[queue_bucket].find(local_tag);
-    if(it != queues[queue_bucket].end()){
-	it->second.q->postEvent(new AmSipRequestEvent(req));
+    QueueEntry* qe = queues[queue_bucket].find(h, local_tag);
+    if(qe){
+	qe->q->postEvent(new AmSipRequestEvent(req));
 	posted = true;
     }
 
@@ -29,10 +29,136 @@
 
 #include "AmEventQueue.h"
 #include "AmSipMsg.h"
-#include <map>
+
+#include <stdint.h>
 
 #define EVENT_DISPATCHER_POWER   10
 #define EVENT_DISPATCHER_BUCKETS (1<<EVENT_DISPATCHER_POWER)
+#define EVENT_DISPATCHER_MAX_POWER 16
+
+/**
+ * Open addressing (linear probing) hash table keyed by tags, which
+ * stores the 64-bit hash of each key next to it, so that only
+ * entries with matching hashes need a string compare.
+ * Not thread-safe: the event dispatcher locks each shard.
+ */
+template<class V>
+class AmTagTable
+{
+  enum SlotState { SlotEmpty = 0, SlotUsed, SlotDeleted };
+
+  struct Slot {
+    uint64_t      h;
+    string        key;
+    V             val;
+    unsigned char state;
+
+    Slot() : h(0), state(SlotEmpty) {}
+  };
+
+  Slot*  slots;
+  size_t mask;
+  size_t used;
+  size_t filled; // used + deleted
+
+  // the low bits of the hash select the dispatcher shard
+  static size_t slot_idx(uint64_t h) { return (size_t)(h >> 32); }
+
+  Slot* lookup(uint64_t h, const string& key) const {
+    for(size_t i = slot_idx(h);; i++) {
+      Slot& s = slots[i & mask];
+      if(s.state == SlotEmpty)
+	return NULL;
+      if((s.state == SlotUsed) && (s.h == h) && (s.key == key))
+	return &s;
+    }
+  }
+
+  void resize(size_t capacity) {
+    Slot* old_slots = slots;
+    size_t old_cap = mask + 1;
+
+    slots = new Slot[capacity];
+    mask = capacity - 1;
+    filled = used;
+
+    for(size_t j = 0; j < old_cap; j++) {
+      Slot& o = old_slots[j];
+      if(o.state != SlotUsed)
+	continue;
+
+      size_t i = slot_idx(o.h);
+      while(slots[i & mask].state != SlotEmpty)
+	i++;
+
+      Slot& n = slots[i & mask];
+      n.h = o.h;
+      n.key.swap(o.key);
+      n.val = o.val;
+      n.state = SlotUsed;
+    }
+
+    delete [] old_slots;
+  }
+
+ public:
+  AmTagTable()
+    : slots(new Slot[8]), mask(7), used(0), filled(0) {}
+  ~AmTagTable() { delete [] slots; }
+
+  V* find(uint64_t h, const string& key) {
+    Slot* s = lookup(h, key);
+    return s ? &s->val : NULL;
+  }
+
+  /** @return false if key is already in the table */
+  bool insert(uint64_t h, const string& key, const V& val) {
+    if(lookup(h, key))
+      return false;
+
+    // keep the load (incl. deleted slots) below 1/2
+    if((filled + 1) * 2 > mask + 1)
+      resize((used + 1) * 2 > (mask + 1) / 2 ? (mask + 1) * 2 : mask + 1);
+
+    size_t i = slot_idx(h);
+    while(slots[i & mask].state == SlotUsed)
+      i++;
+
+    Slot& s = slots[i & mask];
+    if(s.state == SlotEmpty)
+      filled++;
+    s.h = h;
+    s.key = key;
+    s.val = val;
+    s.state = SlotUsed;
+    used++;
+    return true;
+  }
+
+  /** @return false if key is not in the table */
+  bool erase(uint64_t h, const string& key, V* old_val = NULL) {
+    Slot* s = lookup(h, key);
+    if(!s)
+      return false;
+
+    if(old_val)
+      *old_val = s->val;
+    s->key.clear();
+    s->val = V();
+    s->state = SlotDeleted;
+    used--;
+    return true;
+  }
+
+  size_t size() const { return used; }
+  bool empty() const { return !used; }
+
+  /** slot access for iterating (capacity() may change on insert) */
+  size_t capacity() const { return mask + 1; }
+  bool is_used(size_t i) const { return slots[i].state == SlotUsed; }
+  const string& key_at(size_t i) const { return slots[i].key; }
+  V& val_at(size_t i) { return slots[i].val; }
+};
 
 class AmEventDispatcher
 {
@@ -52,37 +178,47 @@ public:
 	: q(q), id(id){} 
     };
 
-    typedef std::map<string, QueueEntry> EvQueueMap;
-    typedef EvQueueMap::iterator         EvQueueMapIter;
-    
-    typedef std::map<string,string>  Dictionnary;
-    typedef Dictionnary::iterator    DictIter;
-
+    typedef AmTagTable<QueueEntry> EvQueueMap;
+    typedef AmTagTable<string>     Dictionnary;
 
 private:
 
     static AmEventDispatcher *_instance;
 
+    /** number of shards (power of 2) */
+    unsigned int shards;
+
     /** 
      * Container for active sessions 
      * local tag -> event queue
      */
-    EvQueueMap queues[EVENT_DISPATCHER_BUCKETS];
+    EvQueueMap* queues;
     
     // mutex for "queues" 
-    AmMutex queues_mut[EVENT_DISPATCHER_BUCKETS];
+    AmMutex* queues_mut;
 
     /** 
      * Call ID + remote tag + via_branch -> local tag 
      *  (needed for CANCELs)
      *  (UAS sessions only)
      */
-    Dictionnary id_lookup[EVENT_DISPATCHER_BUCKETS];
+    Dictionnary* id_lookup;
     // mutex for "id_lookup" 
-    AmMutex id_lookup_mut[EVENT_DISPATCHER_BUCKETS];
+    AmMutex* id_lookup_mut;
+
+    static uint64_t hash(const string& s);
+    unsigned int shard(uint64_t h) { return (unsigned int)h & (shards - 1); }
+
+    static string get_id(const string& callid,
+			 const string& remote_tag,
+			 const string& via_branch);
+
+    /** post to local_tag with its precomputed hash */
+    bool post(uint64_t h, const string& local_tag, AmEvent* ev);
+
+    AmEventDispatcher();
+    ~AmEventDispatcher();
 
-    unsigned int hash(const string& s1);
-    unsigned int hash(const string& s1, const string s2);
 public:
 
     static AmEventDispatcher* instance();
@@ -112,6 +248,9 @@ public:
 
     bool empty();
 
+    /** number of registered event queues */
+    size_t size();
+
     void dump();
 };
 
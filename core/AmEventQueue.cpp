@@ -30,9 +30,15 @@
 #include "AmConfig.h"
 
 #include <typeinfo>
+#include <sched.h>
+
 AmEventQueue::AmEventQueue(AmEventHandler* handler)
   : handler(handler),
     wakeup_handler(NULL),
+    q_head(&q_stub),
+    q_tail(&q_stub),
+    q_stub(0),
+    ev_notified(false),
     ev_pending(false),
     finalized(false)
 {
@@ -40,12 +46,80 @@ AmEventQueue::AmEventQueue(AmEventHandler* handler)
 
 AmEventQueue::~AmEventQueue()
 {
-  m_queue.lock();
-  while(!ev_queue.empty()){
-    delete ev_queue.front();
-    ev_queue.pop();
+  AmLock l(m_queue);
+  AmEvent* event;
+  while((event = pop()) != NULL)
+    delete event;
+}
+
+void AmEventQueue::push(AmEvent* event)
+{
+  event->queue_next = NULL;
+  AmEvent* prev = __sync_lock_test_and_set(&q_head, event);
+  __sync_synchronize();
+  prev->queue_next = event;
+}
+
+/*
+ * Must be called with m_queue held (single consumer). Returns NULL if the queue is
+ * empty or if the next event is still being linked in by a producer
+ * (ev_count is then still non-zero).
+ */
+AmEvent* AmEventQueue::pop()
+{
+  AmEvent* tail = q_tail;
+  AmEvent* next = tail->queue_next;
+
+  if(tail == &q_stub) {
+    if(next == NULL)
+      return NULL;
+    q_tail = next;
+    tail = next;
+    next = next->queue_next;
   }
-  m_queue.unlock();
+
+  if(next != NULL) {
+    q_tail = next;
+    ev_count.dec();
+    return tail;
+  }
+
+  if(tail != q_head)
+    return NULL;
+
+  push(&q_stub);
+
+  next = tail->queue_next;
+  if(next != NULL) {
+    q_tail = next;
+    ev_count.dec();
+    return tail;
+  }
+
+  return NULL;
+}
+
+void AmEventQueue::notify()
+{
+  if(!__sync_bool_compare_and_swap(&ev_notified, false, true))
+    return;
+
+  ev_pending.set(true);
+
+  AmLock l(m_sink);
+  if (NULL != wakeup_handler)
+    wakeup_handler->notify(this);
+}
+
+void AmEventQueue::clearPending()
+{
+  ev_pending.set(false);
+  __sync_bool_compare_and_swap(&ev_notified, true, false);
+  __sync_synchronize();
+
+  // a producer may have posted while we were clearing the flags
+  if(ev_count.get())
+    notify();
 }
 
 void AmEventQueue::postEvent(AmEvent* event)
@@ -53,18 +127,12 @@ void AmEventQueue::postEvent(AmEvent* event)
   if (AmConfig::LogEvents) 
     DBG("AmEventQueue: trying to post event\n");
 
-  m_queue.lock();
-
-  if(event)
-    ev_queue.push(event);
-
-  if(!ev_pending.get()) {
-    ev_pending.set(true);
-    if (NULL != wakeup_handler)
-      wakeup_handler->notify(this);
+  if(event) {
+    ev_count.inc();
+    push(event);
   }
 
-  m_queue.unlock();
+  notify();
 
   if (AmConfig::LogEvents) 
     DBG("AmEventQueue: event posted\n");
@@ -72,14 +140,21 @@ void AmEventQueue::postEvent(AmEvent* event)
 
 void AmEventQueue::processEvents()
 {
-  m_queue.lock();
+  while(true) {
 
-  while(!ev_queue.empty()) {
-	
-    AmEvent* event = ev_queue.front();
-    ev_queue.pop();
+    m_queue.lock();
+    AmEvent* event = pop();
     m_queue.unlock();
 
+    if(!event) {
+      if(!ev_count.get())
+	break;
+
+      // a producer is still linking in its event
+      sched_yield();
+      continue;
+    }
+
     if (AmConfig::LogEvents) 
       DBG("before processing event (%s)\n",
 	  typeid(*event).name());
@@ -88,11 +163,9 @@ void AmEventQueue::processEvents()
       DBG("event processed (%s)\n",
 	  typeid(*event).name());
     delete event;
-    m_queue.lock();
   }
-    
-  ev_pending.set(false);
-  m_queue.unlock();
+
+  clearPending();
 }
 
 void AmEventQueue::waitForEvent()
@@ -103,12 +176,10 @@ void AmEventQueue::waitForEvent()
 void AmEventQueue::processSingleEvent()
 {
   m_queue.lock();
+  AmEvent* event = pop();
+  m_queue.unlock();
 
-  if (!ev_queue.empty()) {
-
-    AmEvent* event = ev_queue.front();
-    ev_queue.pop();
-    m_queue.unlock();
+  if (event != NULL) {
 
     if (AmConfig::LogEvents) 
       DBG("before processing event\n");
@@ -116,28 +187,20 @@ void AmEventQueue::processSingleEvent()
     if (AmConfig::LogEvents) 
       DBG("event processed\n");
     delete event;
-
-    m_queue.lock();
-    if (ev_queue.empty())
-      ev_pending.set(false);
   }
 
-  m_queue.unlock();
+  if (!ev_count.get())
+    clearPending();
 }
 
 bool AmEventQueue::eventPending() {
-  m_queue.lock();
-  bool res = !ev_queue.empty();
-  m_queue.unlock();
-  return res;
+  return ev_count.get() != 0;
 }
 
 void AmEventQueue::setEventNotificationSink(AmEventNotificationSink* 
 					    _wakeup_handler) {
-  // locking actually not necessary - if replacing pointer is atomic 
-  m_queue.lock(); 
+  AmLock l(m_sink);
   wakeup_handler = _wakeup_handler;
   if(wakeup_handler && ev_pending.get())
     wakeup_handler->notify(this);
-  m_queue.unlock();
 }
@@ -32,8 +32,6 @@
 #include "AmEvent.h"
 #include "atomic_types.h"
 
-#include <queue>
-
 class AmEventQueueInterface
 {
  public:
@@ -58,6 +56,11 @@ class AmEventNotificationSink
  * \ref AmEvent can safely be posted at any time from any 
  * thread, which are then processed by the registered event
  *  handler.
+ *
+ * Posting is lock-free: events are linked through
+ * AmEvent::queue_next into a multi-producer/single-consumer
+ * list. The consumer is only signaled when the queue goes
+ * from idle to pending.
  */
 class AmEventQueue
   : public AmEventQueueInterface,
@@ -67,12 +70,33 @@ protected:
   AmEventHandler*           handler;
   AmEventNotificationSink*  wakeup_handler;
 
-  std::queue<AmEvent*>      ev_queue;
+  /** producers append at q_head, the consumer pops at q_tail */
+  AmEvent* volatile         q_head;
+  AmEvent*                  q_tail;
+  AmEvent                   q_stub;
+
+  /** number of events posted but not yet popped */
+  atomic_int                ev_count;
+
+  /** set by the producer which has to wake up the consumer */
+  volatile bool             ev_notified;
+
+  /** serializes pop() */
   AmMutex                   m_queue;
+  /** protects wakeup_handler */
+  AmMutex                   m_sink;
   AmCondition<bool>         ev_pending;
 
   bool finalized;
 
+  void push(AmEvent* event);
+  AmEvent* pop();
+
+  /** signals the consumer if nobody else did so yet */
+  void notify();
+  /** called by the consumer once the queue has been drained */
+  void clearPending();
+
 public:
   AmEventQueue(AmEventHandler* handler);
   virtual ~AmEventQueue();
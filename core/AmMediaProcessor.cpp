@@ -68,6 +68,7 @@ void AmMediaProcessor::init() {
   threads = new AmMediaProcessorThread*[num_threads];
   for (unsigned int i=0;i<num_threads;i++) {
     threads[i] = new AmMediaProcessorThread();
+    threads[i]->setCpuSet(&AmConfig::MediaProcessorCpus);
     threads[i]->start();
   }
 }
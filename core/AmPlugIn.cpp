@@ -240,6 +240,18 @@ int AmPlugIn::load(const string& directory, const string& plugins)
   }
 
   DBG("AmPlugIn: modules loaded.\n");
+
+#ifdef SESSION_THREADPOOL
+  for (vector<AmPluginFactory*>::iterator it =
+	 loaded_plugins.begin(); it != loaded_plugins.end(); it++) {
+    if (!(*it)->supportsSessionThreadPool()) {
+      ERROR("plug-in '%s' blocks in session context and can not be used "
+	    "with the session thread pool (SESSION_THREADPOOL)\n",
+	    (*it)->getName().c_str());
+      return -1;
+    }
+  }
+#endif
   DBG("Initializing %zd plugins...\n", loaded_plugins.size());
   for (vector<AmPluginFactory*>::iterator it =
 	 loaded_plugins.begin(); it != loaded_plugins.end(); it++) {
@@ -807,7 +819,7 @@ AmSessionFactory* AmPlugIn::findSessionFactory(const AmSipRequest& req, string&
       break;
     case AmConfig::App_MAPPING:
       m_app_name = ""; // no match if not found
-      run_regex_mapping(AmConfig::AppMapping, req.r_uri.c_str(), m_app_name);
+      AmConfig::AppMapping.run(req.r_uri.c_str(), m_app_name);
       break;
     case AmConfig::App_SPECIFIED: 
       m_app_name = AmConfig::Application; 
@@ -0,0 +1,313 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "AmPrefixTable.h"
+#include "log.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+/** segments are indexed by the first digits */
+#define INDEX_DIGITS 5
+#define INDEX_SIZE   100000ULL
+#define INDEX_STEP   10000000000000ULL /* 10^(18-INDEX_DIGITS) */
+
+static const uint64_t pow10[PREFIX_TABLE_MAX_DIGITS + 1] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL
+};
+
+static inline bool is_separator(char c)
+{
+  return c == ' ' || c == '\t' || c == ',' || c == ';';
+}
+
+AmPrefixTable::AmPrefixTable()
+  : duplicates(0)
+{
+}
+
+size_t AmPrefixTable::parseNumber(const char* s, size_t len,
+				  uint64_t& key, size_t& digits)
+{
+  size_t i = 0;
+  if (len && s[0] == '+')
+    i++;
+
+  uint64_t v = 0;
+  digits = 0;
+  for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+    if (digits < PREFIX_TABLE_MAX_DIGITS) {
+      v = v * 10 + (s[i] - '0');
+      digits++;
+    }
+  }
+  key = v * pow10[PREFIX_TABLE_MAX_DIGITS - digits];
+  return i;
+}
+
+bool AmPrefixTable::add(const string& prefix, const string& value)
+{
+  uint64_t key;
+  size_t digits;
+  size_t plus = !prefix.empty() && prefix[0] == '+';
+  size_t n = parseNumber(prefix.data(), prefix.length(), key, digits);
+  if (n != prefix.length() || n - plus != digits)
+    return false;
+
+  addEntry(key, digits, value.data(), value.length());
+  return true;
+}
+
+void AmPrefixTable::addEntry(uint64_t key, size_t digits,
+			     const char* value, size_t value_len)
+{
+  Pending p;
+  p.start = key;
+  p.len = digits;
+
+  // tables are usually sorted by route
+  if (!pending.empty()) {
+    const string& last = values[pending.back().value];
+    if (last.length() == value_len && !memcmp(last.data(), value, value_len)) {
+      p.value = pending.back().value;
+      pending.push_back(p);
+      return;
+    }
+  }
+
+  string v(value, value_len);
+  std::map<string, uint32_t>::iterator it = value_ids.find(v);
+  if (it == value_ids.end()) {
+    values.push_back(v);
+    it = value_ids.insert(std::make_pair(v, (uint32_t)values.size() - 1)).first;
+  }
+  p.value = it->second;
+  pending.push_back(p);
+}
+
+void AmPrefixTable::addSegment(uint64_t start, int32_t entry)
+{
+  if (!bounds.empty() && bounds.back() == start) {
+    segments.back() = entry;
+    if (segments.size() > 1 && segments[segments.size() - 2] == entry) {
+      bounds.pop_back();
+      segments.pop_back();
+    }
+    return;
+  }
+
+  if (!segments.empty() && segments.back() == entry)
+    return;
+
+  bounds.push_back(start);
+  segments.push_back(entry);
+}
+
+void AmPrefixTable::build()
+{
+  // outer prefixes before the ones they contain
+  std::stable_sort(pending.begin(), pending.end());
+
+  entries.clear();
+  entries.reserve(pending.size());
+  bounds.clear();
+  segments.clear();
+  bounds.reserve(pending.size() * 2 + 1);
+  segments.reserve(pending.size() * 2 + 1);
+
+  // open prefixes and where they end
+  std::vector<int32_t> open;
+  std::vector<uint64_t> open_end;
+
+  addSegment(0, -1);
+  for (size_t i = 0; i <= pending.size(); i++) {
+    uint64_t start = i < pending.size() ?
+      pending[i].start : pow10[PREFIX_TABLE_MAX_DIGITS];
+
+    while (!open.empty() && open_end.back() <= start) {
+      uint64_t end = open_end.back();
+      open.pop_back();
+      open_end.pop_back();
+      addSegment(end, open.empty() ? -1 : open.back());
+    }
+
+    if (i == pending.size())
+      break;
+
+    if (i && pending[i].start == pending[i-1].start &&
+	pending[i].len == pending[i-1].len) {
+      duplicates++;
+      continue;
+    }
+
+    Entry e;
+    e.value = pending[i].value;
+    e.parent = open.empty() ? -1 : open.back();
+    e.len = pending[i].len;
+    entries.push_back(e);
+
+    int32_t id = entries.size() - 1;
+    addSegment(start, id);
+    open.push_back(id);
+    open_end.push_back(start + pow10[PREFIX_TABLE_MAX_DIGITS - e.len]);
+  }
+
+  index.resize(INDEX_SIZE + 1);
+  size_t seg = 0;
+  for (size_t k = 0; k <= INDEX_SIZE; k++) {
+    while (seg + 1 < bounds.size() && bounds[seg + 1] <= k * INDEX_STEP)
+      seg++;
+    index[k] = seg;
+  }
+
+  std::vector<Pending>().swap(pending);
+  value_ids.clear();
+}
+
+bool AmPrefixTable::load(const string& fname)
+{
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ERROR("opening prefix table '%s': %s\n", fname.c_str(), strerror(errno));
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st)) {
+    ERROR("prefix table '%s': %s\n", fname.c_str(), strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  const char* data = NULL;
+  if (st.st_size) {
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ERROR("mapping prefix table '%s': %s\n", fname.c_str(), strerror(errno));
+      close(fd);
+      return false;
+    }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    data = (const char*)p;
+  }
+
+  bool res = true;
+  unsigned int line_no = 0;
+  const char* end = data + st.st_size;
+  for (const char* line = data; line < end;) {
+    const char* eol = (const char*)memchr(line, '\n', end - line);
+    if (!eol)
+      eol = end;
+    line_no++;
+
+    const char* s = line;
+    const char* e = eol;
+    line = eol + 1;
+
+    while (s < e && (*s == ' ' || *s == '\t'))
+      s++;
+    while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r'))
+      e--;
+    if (s == e || *s == '#')
+      continue;
+
+    uint64_t key;
+    size_t digits;
+    size_t plus = *s == '+';
+    size_t n = parseNumber(s, e - s, key, digits);
+    const char* v = s + n;
+    if (n == plus || n - plus != digits || (v < e && !is_separator(*v))) {
+      ERROR("%s:%u: invalid prefix\n", fname.c_str(), line_no);
+      res = false;
+      break;
+    }
+
+    while (v < e && is_separator(*v))
+      v++;
+    addEntry(key, digits, v, e - v);
+  }
+
+  if (data)
+    munmap((void*)data, st.st_size);
+  close(fd);
+
+  if (!res) {
+    clear();
+    return false;
+  }
+
+  build();
+  return true;
+}
+
+void AmPrefixTable::clear()
+{
+  entries.clear();
+  values.clear();
+  bounds.clear();
+  segments.clear();
+  index.clear();
+  pending.clear();
+  value_ids.clear();
+  duplicates = 0;
+}
+
+const string* AmPrefixTable::lookup(const char* number, size_t* prefix_len) const
+{
+  if (index.empty())
+    return NULL;
+
+  uint64_t key;
+  size_t digits;
+  parseNumber(number, strlen(number), key, digits);
+
+  // search the segments starting with the same first digits
+  size_t k = key / INDEX_STEP;
+  std::vector<uint64_t>::const_iterator seg =
+    std::upper_bound(bounds.begin() + index[k], bounds.begin() + index[k+1] + 1, key);
+  int32_t e = segments[seg - bounds.begin() - 1];
+
+  // number shorter than the prefix
+  while (e >= 0 && entries[e].len > digits)
+    e = entries[e].parent;
+
+  if (e < 0)
+    return NULL;
+
+  if (prefix_len)
+    *prefix_len = entries[e].len;
+  return &values[entries[e].value];
+}
@@ -0,0 +1,143 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _AmPrefixTable_h_
+#define _AmPrefixTable_h_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <map>
+using std::string;
+
+/** max. number of digits of a prefix; numbers are looked up by as many digits */
+#define PREFIX_TABLE_MAX_DIGITS 18
+
+/**
+ * \brief longest prefix match table for numbers (e.g. E.164 routing)
+ *
+ * Each prefix covers an interval of the 18 digit numbers. The nested
+ * intervals are flattened into one sorted array of disjoint segments,
+ * each pointing to the longest prefix covering it, so a lookup is a
+ * binary search in the segments of the number's first five digits.
+ * Shorter numbers than the prefix found fall back to the prefix
+ * covering it (parent).
+ *
+ * Prefixes are added with add() and looked up after build(); a built
+ * table is read-only and may be used by several threads.
+ */
+class AmPrefixTable
+{
+  struct Entry {
+    uint32_t value;
+    /** next shorter prefix covering this one, or -1 */
+    int32_t parent;
+    unsigned char len;
+  };
+
+  /** prefixes added, but not yet built */
+  struct Pending {
+    uint64_t start;
+    uint32_t value;
+    unsigned char len;
+
+    bool operator<(const Pending& rhs) const {
+      return start < rhs.start || (start == rhs.start && len < rhs.len);
+    }
+  };
+
+  std::vector<Entry> entries;
+  std::vector<string> values;
+
+  /** start of the segments, sorted; [0] == 0 */
+  std::vector<uint64_t> bounds;
+  /** entry covering a segment, or -1 */
+  std::vector<int32_t> segments;
+  /** first segment for each value of the first digits */
+  std::vector<uint32_t> index;
+
+  std::vector<Pending> pending;
+  std::map<string, uint32_t> value_ids;
+  size_t duplicates;
+
+  /**
+   * Read a number (leading digits after an optional '+') into 'key',
+   * padded to the max. digits.
+   * @param digits number of digits used
+   * @return number of characters read
+   */
+  static size_t parseNumber(const char* s, size_t len,
+			    uint64_t& key, size_t& digits);
+
+  void addEntry(uint64_t key, size_t digits, const char* value, size_t value_len);
+  void addSegment(uint64_t start, int32_t entry);
+
+  // not copyable
+  AmPrefixTable(const AmPrefixTable&);
+  const AmPrefixTable& operator=(const AmPrefixTable&);
+
+public:
+  AmPrefixTable();
+
+  /**
+   * Add a prefix (digits, optionally after '+'). If a prefix is added
+   * more than once, the first value is used.
+   * @return false if prefix is not a number
+   */
+  bool add(const string& prefix, const string& value);
+
+  /** build the lookup table from the prefixes added (which are not kept) */
+  void build();
+
+  /**
+   * Read and build a table from a file with lines "<prefix> <value>";
+   * prefix and value are separated by blanks, ',' or ';', lines
+   * starting with '#' are ignored.
+   * @return false on error
+   */
+  bool load(const string& fname);
+
+  /** remove all prefixes */
+  void clear();
+
+  /**
+   * Find the longest prefix of a number. Only the leading digits
+   * (after an optional '+') are used.
+   * @param prefix_len if set, length of the prefix found (in digits)
+   * @return value of the prefix, or NULL if none matches
+   */
+  const string* lookup(const char* number, size_t* prefix_len = NULL) const;
+
+  /** @return number of prefixes */
+  size_t size() const { return entries.size(); }
+  /** @return number of distinct values */
+  size_t getValues() const { return values.size(); }
+  /** @return number of prefixes ignored because added before */
+  size_t getDuplicates() const { return duplicates; }
+};
+
+#endif
@@ -42,6 +42,8 @@ _AmRtpReceiver::_AmRtpReceiver()
 {
   n_receivers = AmConfig::RTPReceiverThreads;
   receivers = new AmRtpReceiverThread[n_receivers];
+  for(unsigned int i=0; i<n_receivers; i++)
+    receivers[i].setCpuSet(&AmConfig::RTPReceiverCpus);
 }
 
 _AmRtpReceiver::~_AmRtpReceiver()
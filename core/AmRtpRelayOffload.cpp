@@ -0,0 +1,624 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmRtpRelayOffload.h"
+#include "AmConfig.h"
+#include "log.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+#if defined(__linux__)
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <sys/syscall.h>
+#endif
+
+// BPF links for XDP and the fib lookup helper need recent headers
+#if defined(__linux__) && defined(BPF_F_XDP_HAS_FRAGS) && defined(__NR_bpf)
+#define RTP_RELAY_OFFLOAD_SUPPORTED 1
+#endif
+
+AmRtpRelayOffloadRule::AmRtpRelayOffloadRule()
+  : rewrite_ssrc(false), ssrc(0), check_payloads(false)
+{
+  memset(&local, 0, sizeof(local));
+  memset(&expect_src, 0, sizeof(expect_src));
+  memset(&src, 0, sizeof(src));
+  memset(&dst, 0, sizeof(dst));
+  payloads[0] = payloads[1] = 0;
+}
+
+#ifdef RTP_RELAY_OFFLOAD_SUPPORTED
+
+/** map key: local address of the receiving stream (network order) */
+struct offload_key {
+  uint32_t addr;
+  uint16_t port;
+  uint16_t pad;
+};
+
+#define OFFLOAD_F_SSRC     1
+#define OFFLOAD_F_PAYLOADS 2
+
+/** map value; the offsets are used by the XDP program */
+struct offload_value {
+  uint32_t src_addr;    //  0
+  uint32_t dst_addr;    //  4
+  uint16_t src_port;    //  8
+  uint16_t dst_port;    // 10
+  uint32_t expect_addr; // 12 (0: any)
+  uint16_t expect_port; // 16 (0: any)
+  uint16_t flags;       // 18
+  uint32_t ssrc;        // 20
+  uint64_t payloads[2]; // 24
+  uint64_t packets;     // 40
+  uint64_t bytes;       // 48
+  uint64_t last_ns;     // 56
+};
+
+static int sys_bpf(int cmd, union bpf_attr* attr)
+{
+  return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/** \brief minimal BPF assembler with forward jump labels */
+class BpfAsm
+{
+  std::vector<struct bpf_insn> insns;
+  std::vector<int> labels;
+  // insn index -> label
+  std::vector<std::pair<size_t,int> > fixups;
+
+  void emit(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+    struct bpf_insn i;
+    memset(&i, 0, sizeof(i));
+    i.code = code;
+    i.dst_reg = dst;
+    i.src_reg = src;
+    i.off = off;
+    i.imm = imm;
+    insns.push_back(i);
+  }
+
+public:
+  int newLabel() { labels.push_back(-1); return labels.size() - 1; }
+  void bind(int l) { labels[l] = insns.size(); }
+
+  void mov(uint8_t dst, uint8_t src) { emit(BPF_ALU64|BPF_MOV|BPF_X, dst, src, 0, 0); }
+  void movi(uint8_t dst, int32_t imm) { emit(BPF_ALU64|BPF_MOV|BPF_K, dst, 0, 0, imm); }
+  void alui(uint8_t op, uint8_t dst, int32_t imm) { emit(BPF_ALU64|op|BPF_K, dst, 0, 0, imm); }
+  void alu(uint8_t op, uint8_t dst, uint8_t src) { emit(BPF_ALU64|op|BPF_X, dst, src, 0, 0); }
+  /** byte swap to network order (little endian hosts) */
+  void hton(uint8_t dst, int bits) { emit(BPF_ALU|BPF_END|BPF_TO_BE, dst, 0, 0, bits); }
+
+  void ld(uint8_t size, uint8_t dst, uint8_t src, int16_t off) {
+    emit(BPF_LDX|BPF_MEM|size, dst, src, off, 0);
+  }
+  void st(uint8_t size, uint8_t dst, int16_t off, uint8_t src) {
+    emit(BPF_STX|BPF_MEM|size, dst, src, off, 0);
+  }
+  void sti(uint8_t size, uint8_t dst, int16_t off, int32_t imm) {
+    emit(BPF_ST|BPF_MEM|size, dst, 0, off, imm);
+  }
+  void xadd(uint8_t dst, int16_t off, uint8_t src) {
+    emit(BPF_STX|BPF_ATOMIC|BPF_DW, dst, src, off, BPF_ADD);
+  }
+  void ldMapFd(uint8_t dst, int fd) {
+    emit(BPF_LD|BPF_DW|BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, fd);
+    emit(0, 0, 0, 0, 0);
+  }
+
+  void jmp(uint8_t op, uint8_t dst, uint8_t src, int l) {
+    fixups.push_back(std::make_pair(insns.size(), l));
+    emit(BPF_JMP|op|BPF_X, dst, src, 0, 0);
+  }
+  void jmpi(uint8_t op, uint8_t dst, int32_t imm, int l) {
+    fixups.push_back(std::make_pair(insns.size(), l));
+    emit(BPF_JMP|op|BPF_K, dst, 0, 0, imm);
+  }
+  void call(int32_t helper) { emit(BPF_JMP|BPF_CALL, 0, 0, 0, helper); }
+  void exit() { emit(BPF_JMP|BPF_EXIT, 0, 0, 0, 0); }
+
+  std::vector<struct bpf_insn>& finish() {
+    for (size_t i = 0; i < fixups.size(); i++) {
+      insns[fixups[i].first].off =
+	labels[fixups[i].second] - fixups[i].first - 1;
+    }
+    return insns;
+  }
+};
+
+// Ethernet + IPv4 (no options) + UDP + RTP header
+#define OFF_ETH_PROTO  12
+#define OFF_IP         14
+#define OFF_IP_LEN     (OFF_IP + 2)
+#define OFF_IP_FRAG    (OFF_IP + 6)
+#define OFF_IP_TTL     (OFF_IP + 8)
+#define OFF_IP_PROTO   (OFF_IP + 9)
+#define OFF_IP_CSUM    (OFF_IP + 10)
+#define OFF_IP_SRC     (OFF_IP + 12)
+#define OFF_IP_DST     (OFF_IP + 16)
+#define OFF_UDP        (OFF_IP + 20)
+#define OFF_UDP_CSUM   (OFF_UDP + 6)
+#define OFF_RTP        (OFF_UDP + 8)
+#define OFF_RTP_SSRC   (OFF_RTP + 8)
+#define MIN_PKT_LEN    (OFF_RTP + 12)
+
+// stack: map key at fp-8, fib lookup parameters below
+#define FP_KEY  (-8)
+#define FP_FIB  (FP_KEY - (int)sizeof(struct bpf_fib_lookup))
+
+#define FIB(m) (FP_FIB + (int)offsetof(struct bpf_fib_lookup, m))
+#define VAL(m) ((int)offsetof(struct offload_value, m))
+
+static std::vector<struct bpf_insn>& build_program(BpfAsm& a, int map_fd)
+{
+  const uint8_t ctx = BPF_REG_6, data = BPF_REG_7,
+    data_end = BPF_REG_8, val = BPF_REG_9;
+  int pass = a.newLabel();
+  int no_pt_check = a.newLabel();
+  int no_ssrc = a.newLabel();
+  int any_addr = a.newLabel();
+  int any_port = a.newLabel();
+  int pt_lo = a.newLabel();
+
+  a.mov(ctx, BPF_REG_1);
+  a.ld(BPF_W, data, ctx, offsetof(struct xdp_md, data));
+  a.ld(BPF_W, data_end, ctx, offsetof(struct xdp_md, data_end));
+  a.mov(BPF_REG_1, data);
+  a.alui(BPF_ADD, BPF_REG_1, MIN_PKT_LEN);
+  a.jmp(BPF_JGT, BPF_REG_1, data_end, pass);
+
+  // IPv4 without options, UDP, not fragmented, RTP version 2
+  a.ld(BPF_H, BPF_REG_1, data, OFF_ETH_PROTO);
+  a.jmpi(BPF_JNE, BPF_REG_1, htons(0x0800), pass);
+  a.ld(BPF_B, BPF_REG_1, data, OFF_IP);
+  a.jmpi(BPF_JNE, BPF_REG_1, 0x45, pass);
+  a.ld(BPF_B, BPF_REG_1, data, OFF_IP_PROTO);
+  a.jmpi(BPF_JNE, BPF_REG_1, IPPROTO_UDP, pass);
+  a.ld(BPF_H, BPF_REG_1, data, OFF_IP_FRAG);
+  a.alui(BPF_AND, BPF_REG_1, htons(0x3fff));
+  a.jmpi(BPF_JNE, BPF_REG_1, 0, pass);
+  a.ld(BPF_B, BPF_REG_1, data, OFF_RTP);
+  a.alui(BPF_AND, BPF_REG_1, 0xc0);
+  a.jmpi(BPF_JNE, BPF_REG_1, 0x80, pass);
+
+  // rule lookup by destination
+  a.ld(BPF_W, BPF_REG_1, data, OFF_IP_DST);
+  a.st(BPF_W, BPF_REG_10, FP_KEY, BPF_REG_1);
+  a.ld(BPF_H, BPF_REG_1, data, OFF_UDP + 2);
+  a.st(BPF_H, BPF_REG_10, FP_KEY + 4, BPF_REG_1);
+  a.sti(BPF_H, BPF_REG_10, FP_KEY + 6, 0);
+  a.ldMapFd(BPF_REG_1, map_fd);
+  a.mov(BPF_REG_2, BPF_REG_10);
+  a.alui(BPF_ADD, BPF_REG_2, FP_KEY);
+  a.call(BPF_FUNC_map_lookup_elem);
+  a.jmpi(BPF_JEQ, BPF_REG_0, 0, pass);
+  a.mov(val, BPF_REG_0);
+
+  // source check
+  a.ld(BPF_W, BPF_REG_1, val, VAL(expect_addr));
+  a.jmpi(BPF_JEQ, BPF_REG_1, 0, any_addr);
+  a.ld(BPF_W, BPF_REG_2, data, OFF_IP_SRC);
+  a.jmp(BPF_JNE, BPF_REG_1, BPF_REG_2, pass);
+  a.bind(any_addr);
+  a.ld(BPF_H, BPF_REG_1, val, VAL(expect_port));
+  a.jmpi(BPF_JEQ, BPF_REG_1, 0, any_port);
+  a.ld(BPF_H, BPF_REG_2, data, OFF_UDP);
+  a.jmp(BPF_JNE, BPF_REG_1, BPF_REG_2, pass);
+  a.bind(any_port);
+
+  // payload type check
+  a.ld(BPF_H, BPF_REG_1, val, VAL(flags));
+  a.mov(BPF_REG_2, BPF_REG_1);
+  a.alui(BPF_AND, BPF_REG_2, OFFLOAD_F_PAYLOADS);
+  a.jmpi(BPF_JEQ, BPF_REG_2, 0, no_pt_check);
+  a.ld(BPF_B, BPF_REG_2, data, OFF_RTP + 1);
+  a.alui(BPF_AND, BPF_REG_2, 0x7f);
+  a.ld(BPF_DW, BPF_REG_3, val, VAL(payloads));
+  a.jmpi(BPF_JLT, BPF_REG_2, 64, pt_lo);
+  a.ld(BPF_DW, BPF_REG_3, val, VAL(payloads) + 8);
+  a.alui(BPF_SUB, BPF_REG_2, 64);
+  a.bind(pt_lo);
+  a.alu(BPF_RSH, BPF_REG_3, BPF_REG_2);
+  a.alui(BPF_AND, BPF_REG_3, 1);
+  a.jmpi(BPF_JEQ, BPF_REG_3, 0, pass);
+  a.bind(no_pt_check);
+
+  // next hop for the new destination
+  for (int off = 0; off < (int)sizeof(struct bpf_fib_lookup); off += 8)
+    a.sti(BPF_DW, BPF_REG_10, FP_FIB + off, 0);
+  a.sti(BPF_B, BPF_REG_10, FIB(family), AF_INET);
+  a.sti(BPF_B, BPF_REG_10, FIB(l4_protocol), IPPROTO_UDP);
+  a.ld(BPF_H, BPF_REG_2, val, VAL(src_port));
+  a.st(BPF_H, BPF_REG_10, FIB(sport), BPF_REG_2);
+  a.ld(BPF_H, BPF_REG_2, val, VAL(dst_port));
+  a.st(BPF_H, BPF_REG_10, FIB(dport), BPF_REG_2);
+  a.ld(BPF_H, BPF_REG_2, data, OFF_IP_LEN);
+  a.hton(BPF_REG_2, 16);
+  a.st(BPF_H, BPF_REG_10, FIB(tot_len), BPF_REG_2);
+  a.ld(BPF_W, BPF_REG_2, ctx, offsetof(struct xdp_md, ingress_ifindex));
+  a.st(BPF_W, BPF_REG_10, FIB(ifindex), BPF_REG_2);
+  a.ld(BPF_W, BPF_REG_2, val, VAL(src_addr));
+  a.st(BPF_W, BPF_REG_10, FIB(ipv4_src), BPF_REG_2);
+  a.ld(BPF_W, BPF_REG_2, val, VAL(dst_addr));
+  a.st(BPF_W, BPF_REG_10, FIB(ipv4_dst), BPF_REG_2);
+  a.mov(BPF_REG_1, ctx);
+  a.mov(BPF_REG_2, BPF_REG_10);
+  a.alui(BPF_ADD, BPF_REG_2, FP_FIB);
+  a.movi(BPF_REG_3, sizeof(struct bpf_fib_lookup));
+  a.movi(BPF_REG_4, 0);
+  a.call(BPF_FUNC_fib_lookup);
+  a.jmpi(BPF_JNE, BPF_REG_0, BPF_FIB_LKUP_RET_SUCCESS, pass);
+
+  // rewrite
+  a.ld(BPF_H, BPF_REG_1, val, VAL(flags));
+  a.alui(BPF_AND, BPF_REG_1, OFFLOAD_F_SSRC);
+  a.jmpi(BPF_JEQ, BPF_REG_1, 0, no_ssrc);
+  a.ld(BPF_W, BPF_REG_1, val, VAL(ssrc));
+  a.st(BPF_W, data, OFF_RTP_SSRC, BPF_REG_1);
+  a.bind(no_ssrc);
+
+  a.ld(BPF_W, BPF_REG_1, val, VAL(src_addr));
+  a.st(BPF_W, data, OFF_IP_SRC, BPF_REG_1);
+  a.ld(BPF_W, BPF_REG_1, val, VAL(dst_addr));
+  a.st(BPF_W, data, OFF_IP_DST, BPF_REG_1);
+  a.ld(BPF_H, BPF_REG_1, val, VAL(src_port));
+  a.st(BPF_H, data, OFF_UDP, BPF_REG_1);
+  a.ld(BPF_H, BPF_REG_1, val, VAL(dst_port));
+  a.st(BPF_H, data, OFF_UDP + 2, BPF_REG_1);
+  // UDP checksum is optional with IPv4
+  a.sti(BPF_H, data, OFF_UDP_CSUM, 0);
+  a.sti(BPF_B, data, OFF_IP_TTL, 64);
+  a.sti(BPF_H, data, OFF_IP_CSUM, 0);
+
+  a.movi(BPF_REG_1, 0);
+  a.movi(BPF_REG_2, 0);
+  a.mov(BPF_REG_3, data);
+  a.alui(BPF_ADD, BPF_REG_3, OFF_IP);
+  a.movi(BPF_REG_4, 20);
+  a.movi(BPF_REG_5, 0);
+  a.call(BPF_FUNC_csum_diff);
+  for (int i = 0; i < 2; i++) {
+    a.mov(BPF_REG_1, BPF_REG_0);
+    a.alui(BPF_RSH, BPF_REG_1, 16);
+    a.alui(BPF_AND, BPF_REG_0, 0xffff);
+    a.alu(BPF_ADD, BPF_REG_0, BPF_REG_1);
+  }
+  a.alui(BPF_XOR, BPF_REG_0, 0xffff);
+  a.st(BPF_H, data, OFF_IP_CSUM, BPF_REG_0);
+
+  for (int i = 0; i < 6; i += 2) {
+    a.ld(BPF_H, BPF_REG_1, BPF_REG_10, FIB(dmac) + i);
+    a.st(BPF_H, data, i, BPF_REG_1);
+    a.ld(BPF_H, BPF_REG_1, BPF_REG_10, FIB(smac) + i);
+    a.st(BPF_H, data, 6 + i, BPF_REG_1);
+  }
+
+  // counters: RTP packets and bytes (UDP payload)
+  a.movi(BPF_REG_1, 1);
+  a.xadd(val, VAL(packets), BPF_REG_1);
+  a.ld(BPF_H, BPF_REG_1, data, OFF_IP_LEN);
+  a.hton(BPF_REG_1, 16);
+  a.alui(BPF_SUB, BPF_REG_1, 28);
+  a.xadd(val, VAL(bytes), BPF_REG_1);
+  a.call(BPF_FUNC_ktime_get_ns);
+  a.st(BPF_DW, val, VAL(last_ns), BPF_REG_0);
+
+  a.ld(BPF_W, BPF_REG_1, BPF_REG_10, FIB(ifindex));
+  a.movi(BPF_REG_2, 0);
+  a.call(BPF_FUNC_redirect);
+  a.exit();
+
+  a.bind(pass);
+  a.movi(BPF_REG_0, XDP_PASS);
+  a.exit();
+
+  return a.finish();
+}
+
+static bool make_key(const struct sockaddr_storage* local, struct offload_key& key)
+{
+  if (local->ss_family != AF_INET)
+    return false;
+  memset(&key, 0, sizeof(key));
+  key.addr = ((const struct sockaddr_in*)local)->sin_addr.s_addr;
+  key.port = ((const struct sockaddr_in*)local)->sin_port;
+  return true;
+}
+
+_AmRtpRelayOffload::_AmRtpRelayOffload()
+  : prog_fd(-1), map_fd(-1), init_done(false), init_failed(false)
+{
+}
+
+_AmRtpRelayOffload::~_AmRtpRelayOffload()
+{
+}
+
+void _AmRtpRelayOffload::dispose()
+{
+  AmLock l(mut);
+  // closing the links detaches the program
+  for (std::map<unsigned int, int>::iterator it = links.begin();
+       it != links.end(); it++) {
+    if (it->second >= 0)
+      close(it->second);
+  }
+  links.clear();
+  if (prog_fd >= 0) close(prog_fd);
+  if (map_fd >= 0) close(map_fd);
+  prog_fd = map_fd = -1;
+}
+
+bool _AmRtpRelayOffload::init()
+{
+  if (init_done)
+    return !init_failed;
+  init_done = true;
+  init_failed = true;
+
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_type = BPF_MAP_TYPE_HASH;
+  attr.key_size = sizeof(struct offload_key);
+  attr.value_size = sizeof(struct offload_value);
+  attr.max_entries = RTP_RELAY_OFFLOAD_MAX_STREAMS;
+  map_fd = sys_bpf(BPF_MAP_CREATE, &attr);
+  if (map_fd < 0) {
+    ERROR("RTP relay offload: creating BPF map: %s\n", strerror(errno));
+    return false;
+  }
+
+  BpfAsm a;
+  std::vector<struct bpf_insn>& insns = build_program(a, map_fd);
+
+  static char log_buf[16384];
+  log_buf[0] = '\0';
+  memset(&attr, 0, sizeof(attr));
+  attr.prog_type = BPF_PROG_TYPE_XDP;
+  attr.insns = (uint64_t)(unsigned long)&insns[0];
+  attr.insn_cnt = insns.size();
+  attr.license = (uint64_t)(unsigned long)"GPL";
+  attr.log_buf = (uint64_t)(unsigned long)log_buf;
+  attr.log_size = sizeof(log_buf);
+  attr.log_level = 1;
+  strncpy(attr.prog_name, "sems_rtp_relay", sizeof(attr.prog_name) - 1);
+  prog_fd = sys_bpf(BPF_PROG_LOAD, &attr);
+  if (prog_fd < 0) {
+    ERROR("RTP relay offload: loading XDP program: %s\n%s\n",
+	  strerror(errno), log_buf);
+    close(map_fd);
+    map_fd = -1;
+    return false;
+  }
+
+  INFO("RTP relay offload: XDP program loaded (%zd instructions)\n",
+       insns.size());
+  init_failed = false;
+  return true;
+}
+
+bool _AmRtpRelayOffload::attach(unsigned int ifindex)
+{
+  std::map<unsigned int, int>::iterator it = links.find(ifindex);
+  if (it != links.end())
+    return it->second >= 0;
+
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.link_create.prog_fd = prog_fd;
+  attr.link_create.target_ifindex = ifindex;
+  attr.link_create.attach_type = BPF_XDP;
+  attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+  int fd = sys_bpf(BPF_LINK_CREATE, &attr);
+  if (fd < 0) {
+    ERROR("RTP relay offload: attaching to interface %u: %s; "
+	  "relaying in userspace\n", ifindex, strerror(errno));
+  } else {
+    INFO("RTP relay offload: attached to interface %u\n", ifindex);
+  }
+  links[ifindex] = fd;
+  return fd >= 0;
+}
+
+bool _AmRtpRelayOffload::isEnabled()
+{
+  if (!AmConfig::RtpRelayOffload)
+    return false;
+  AmLock l(mut);
+  return init();
+}
+
+bool _AmRtpRelayOffload::addRule(unsigned int ifindex,
+				 const AmRtpRelayOffloadRule& rule)
+{
+  struct offload_key key;
+  if (!make_key(&rule.local, key) ||
+      rule.src.ss_family != AF_INET || rule.dst.ss_family != AF_INET)
+    return false;
+
+  struct offload_value v;
+  memset(&v, 0, sizeof(v));
+  v.src_addr = ((const struct sockaddr_in*)&rule.src)->sin_addr.s_addr;
+  v.src_port = ((const struct sockaddr_in*)&rule.src)->sin_port;
+  v.dst_addr = ((const struct sockaddr_in*)&rule.dst)->sin_addr.s_addr;
+  v.dst_port = ((const struct sockaddr_in*)&rule.dst)->sin_port;
+  if (rule.expect_src.ss_family == AF_INET) {
+    v.expect_addr = ((const struct sockaddr_in*)&rule.expect_src)->sin_addr.s_addr;
+    v.expect_port = ((const struct sockaddr_in*)&rule.expect_src)->sin_port;
+  }
+  if (rule.rewrite_ssrc) {
+    v.flags |= OFFLOAD_F_SSRC;
+    v.ssrc = htonl(rule.ssrc);
+  }
+  if (rule.check_payloads) {
+    v.flags |= OFFLOAD_F_PAYLOADS;
+    v.payloads[0] = rule.payloads[0];
+    v.payloads[1] = rule.payloads[1];
+  }
+
+  AmLock l(mut);
+  if (!init() || !attach(ifindex))
+    return false;
+
+  // a replaced rule counts as removed
+  struct offload_value old;
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map_fd;
+  attr.key = (uint64_t)(unsigned long)&key;
+  attr.value = (uint64_t)(unsigned long)&old;
+  bool replaced = sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr) == 0;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map_fd;
+  attr.key = (uint64_t)(unsigned long)&key;
+  attr.value = (uint64_t)(unsigned long)&v;
+  attr.flags = BPF_ANY;
+  if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr)) {
+    DBG("RTP relay offload: adding rule: %s\n", strerror(errno));
+    return false;
+  }
+
+  installed.inc();
+  if (replaced) {
+    removed.inc();
+    relayed_packets.inc(old.packets);
+    relayed_bytes.inc(old.bytes);
+  } else {
+    active_rules.inc();
+  }
+  return true;
+}
+
+void _AmRtpRelayOffload::removeRule(const struct sockaddr_storage* local)
+{
+  struct offload_key key;
+  if (!make_key(local, key))
+    return;
+
+  AmLock l(mut);
+  if (map_fd < 0)
+    return;
+
+  struct offload_value old;
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map_fd;
+  attr.key = (uint64_t)(unsigned long)&key;
+  attr.value = (uint64_t)(unsigned long)&old;
+  if (sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr))
+    return;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map_fd;
+  attr.key = (uint64_t)(unsigned long)&key;
+  if (sys_bpf(BPF_MAP_DELETE_ELEM, &attr))
+    return;
+
+  removed.inc();
+  active_rules.dec();
+  relayed_packets.inc(old.packets);
+  relayed_bytes.inc(old.bytes);
+}
+
+bool _AmRtpRelayOffload::getCounters(const struct sockaddr_storage* local,
+				     unsigned long long& packets,
+				     unsigned long long& bytes)
+{
+  struct offload_key key;
+  if (!make_key(local, key) || map_fd < 0)
+    return false;
+
+  struct offload_value v;
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map_fd;
+  attr.key = (uint64_t)(unsigned long)&key;
+  attr.value = (uint64_t)(unsigned long)&v;
+  if (sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr))
+    return false;
+
+  packets = v.packets;
+  bytes = v.bytes;
+  return true;
+}
+
+#else // RTP_RELAY_OFFLOAD_SUPPORTED
+
+_AmRtpRelayOffload::_AmRtpRelayOffload()
+  : prog_fd(-1), map_fd(-1), init_done(false), init_failed(true)
+{
+}
+
+_AmRtpRelayOffload::~_AmRtpRelayOffload()
+{
+}
+
+void _AmRtpRelayOffload::dispose()
+{
+}
+
+bool _AmRtpRelayOffload::init()
+{
+  return false;
+}
+
+bool _AmRtpRelayOffload::attach(unsigned int ifindex)
+{
+  return false;
+}
+
+bool _AmRtpRelayOffload::isEnabled()
+{
+  if (AmConfig::RtpRelayOffload && !init_done) {
+    init_done = true;
+    WARN("RTP relay offload is not supported on this platform\n");
+  }
+  return false;
+}
+
+bool _AmRtpRelayOffload::addRule(unsigned int ifindex,
+				 const AmRtpRelayOffloadRule& rule)
+{
+  return false;
+}
+
+void _AmRtpRelayOffload::removeRule(const struct sockaddr_storage* local)
+{
+}
+
+bool _AmRtpRelayOffload::getCounters(const struct sockaddr_storage* local,
+				     unsigned long long& packets,
+				     unsigned long long& bytes)
+{
+  return false;
+}
+
+#endif // RTP_RELAY_OFFLOAD_SUPPORTED
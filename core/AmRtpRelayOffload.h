@@ -0,0 +1,140 @@
+/*
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _AmRtpRelayOffload_h_
+#define _AmRtpRelayOffload_h_
+
+#include "AmThread.h"
+#include "atomic_types.h"
+#include "singleton.h"
+
+#include <sys/socket.h>
+#include <stdint.h>
+
+#include <map>
+
+/** max. number of streams relayed in the kernel at the same time */
+#define RTP_RELAY_OFFLOAD_MAX_STREAMS 65536
+
+/**
+ * \brief forwarding rule for one relayed RTP stream
+ *
+ * RTP arriving at 'local' (from 'expect_src', if set) is sent
+ * from 'src' to 'dst'. Everything the rule does not cover (other
+ * payload types, other sources, non-RTP, IPv6, packets without a
+ * resolved next hop) is passed up to the RTP receiver as usual.
+ */
+struct AmRtpRelayOffloadRule
+{
+  struct sockaddr_storage local;
+  struct sockaddr_storage expect_src;
+  struct sockaddr_storage src;
+  struct sockaddr_storage dst;
+
+  /** rewrite the SSRC to 'ssrc' */
+  bool rewrite_ssrc;
+  uint32_t ssrc;
+
+  /** relay only payload types in 'payloads' (bit per PT) */
+  bool check_payloads;
+  uint64_t payloads[2];
+
+  AmRtpRelayOffloadRule();
+};
+
+/**
+ * \brief relays RTP in the kernel (XDP)
+ *
+ * A small XDP program, attached in generic (SKB) mode to the RTP
+ * interfaces, looks up each received UDP packet by its destination
+ * in a hash map of rules. Matching packets get their addresses,
+ * ports and optionally their SSRC rewritten and are redirected to
+ * the next hop found with a kernel FIB lookup, without ever
+ * reaching the RTP receiver threads. Per-rule packet counters are
+ * kept in the map, so that RTP timeouts can still be detected.
+ *
+ * The program is assembled here and loaded with the bpf() system
+ * call, no BPF toolchain is needed. Needs Linux >= 5.18 headers at
+ * compile time, and CAP_BPF/CAP_NET_ADMIN at runtime; if loading
+ * fails all streams are relayed in userspace.
+ */
+class _AmRtpRelayOffload
+{
+  int prog_fd;
+  int map_fd;
+  bool init_done;
+  bool init_failed;
+
+  /** ifindex -> XDP link fd (-1: could not attach) */
+  std::map<unsigned int, int> links;
+  AmMutex mut;
+
+  atomic_int   active_rules;
+  atomic_int64 installed;
+  atomic_int64 removed;
+  atomic_int64 relayed_packets;
+  atomic_int64 relayed_bytes;
+
+  bool init();
+  bool attach(unsigned int ifindex);
+
+protected:
+  _AmRtpRelayOffload();
+  ~_AmRtpRelayOffload();
+
+  void dispose();
+
+public:
+  /** @return true if offloading is configured and available */
+  bool isEnabled();
+
+  /**
+   * Install (or replace) a rule; the XDP program is attached to
+   * 'ifindex' on first use.
+   * @return true if the stream is relayed in the kernel now
+   */
+  bool addRule(unsigned int ifindex, const AmRtpRelayOffloadRule& rule);
+
+  /** Remove the rule for 'local', adding its counters to the totals */
+  void removeRule(const struct sockaddr_storage* local);
+
+  /**
+   * Read the counters of a rule.
+   * @return false if there is no rule for 'local'
+   */
+  bool getCounters(const struct sockaddr_storage* local,
+		   unsigned long long& packets, unsigned long long& bytes);
+
+  unsigned int getActiveRules() { return active_rules.get(); }
+  unsigned long long getInstalled() { return installed.get(); }
+  unsigned long long getRemoved() { return removed.get(); }
+  /** packets and bytes relayed by removed rules */
+  unsigned long long getRelayedPackets() { return relayed_packets.get(); }
+  unsigned long long getRelayedBytes() { return relayed_bytes.get(); }
+};
+
+typedef singleton<_AmRtpRelayOffload> AmRtpRelayOffload;
+
+#endif
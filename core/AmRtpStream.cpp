@@ -28,6 +28,7 @@
 #include "AmRtpStream.h"
 #include "AmRtpPacket.h"
 #include "AmRtpReceiver.h"
+#include "AmRtpRelayOffload.h"
 #include "AmConfig.h"
 #include "AmPlugIn.h"
 #include "AmAudio.h"
@@ -366,21 +367,21 @@ int AmRtpStream::receive( unsigned char* buffer, unsigned int size,
   last_payload = rp->payload;
 
   if(!rp->getDataSize()) {
-    mem.freePacket(rp);
+    mem->freePacket(rp);
     return RTP_EMPTY;
   }
 
   if (rp->payload == getLocalTelephoneEventPT())
     {
       recvDtmfPacket(rp);
-      mem.freePacket(rp);
+      mem->freePacket(rp);
       return RTP_DTMF;
     }
 
   assert(rp->getData());
   if(rp->getDataSize() > size){
     ERROR("received too big RTP packet\n");
-    mem.freePacket(rp);
+    mem->freePacket(rp);
     return RTP_BUFFER_SIZE;
   }
 
@@ -389,10 +390,12 @@ int AmRtpStream::receive( unsigned char* buffer, unsigned int size,
   out_payload = rp->payload;
 
   int res = rp->getDataSize();
-  mem.freePacket(rp);
+  mem->freePacket(rp);
   return res;
 }
 
+AmMutex AmRtpStream::relay_offload_mut;
+
 AmRtpStream::AmRtpStream(AmSession* _s, int _if) 
   : r_port(0),
     l_if(_if),
@@ -422,6 +425,13 @@ AmRtpStream::AmRtpStream(AmSession* _s, int _if)
   memset(&r_saddr,0,sizeof(struct sockaddr_storage));
   memset(&l_saddr,0,sizeof(struct sockaddr_storage));
 
+  relay_offloaded = false;
+  relay_offload_retry = 0;
+  relay_offload_packets = 0;
+  relay_offload_to = NULL;
+
+  mem = PacketMemPool::get();
+
   l_ssrc = get_random();
   sequence = get_random();
   clearRTPTimeout();
@@ -432,6 +442,8 @@ AmRtpStream::AmRtpStream(AmSession* _s, int _if)
 
 AmRtpStream::~AmRtpStream()
 {
+  invalidateRelayOffload();
+
   if(l_sd){
     if (AmRtpReceiver::haveInstance()){
       AmRtpReceiver::instance()->removeStream(l_sd);
@@ -441,6 +453,9 @@ AmRtpStream::~AmRtpStream()
     close(l_rtcp_sd);
   }
   if (logger) dec_ref(logger);
+
+  // not used by the RTP receiver any more
+  PacketMemPool::put(mem);
 }
 
 int AmRtpStream::getLocalPort()
@@ -501,6 +516,8 @@ void AmRtpStream::setRAddr(const string& addr, unsigned short port,
 	  (SAv4(&r_saddr)->sin_addr.s_addr == INADDR_ANY)) ||
     ((r_saddr.ss_family == AF_INET6) && 
      IN6_IS_ADDR_UNSPECIFIED(&SAv6(&r_saddr)->sin6_addr));
+
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::handleSymmetricRtp(struct sockaddr_storage* recv_addr, bool rtcp) {
@@ -552,6 +569,7 @@ void AmRtpStream::setPassiveMode(bool p)
   } else {
     DBG("Passive mode not activated.\n");
   }
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::getSdp(SdpMedia& m)
@@ -755,12 +773,14 @@ int AmRtpStream::init(const AmSdp& local,
   last_payload = payload;
 
   active = false; // mark as nothing received yet
+  invalidateRelayOffload();
   return 0;
 }
 
 void AmRtpStream::setReceiving(bool r) {
   DBG("RTP stream instance [%p] set receiving=%s\n", this, r?"true":"false");
   receiving = r;
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::pause()
@@ -774,6 +794,7 @@ void AmRtpStream::pause()
   }
 #endif
 
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::resume()
@@ -781,7 +802,7 @@ void AmRtpStream::resume()
   DBG("RTP Stream instance [%p] resuming (receiving=true, clearing biffers/TS/TO)\n", this);
   clearRTPTimeout();
   receive_mut.lock();
-  mem.clear();
+  mem->clear();
   receive_buf.clear();
   while (!rtp_ev_qu.empty())
     rtp_ev_qu.pop();
@@ -797,6 +818,7 @@ void AmRtpStream::resume()
 
 void AmRtpStream::setOnHold(bool on_hold) {
   hold = on_hold;
+  invalidateRelayOffload();
 }
 
 bool AmRtpStream::getOnHold() {
@@ -828,7 +850,7 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
       recvDtmfPacket(p);
     }
 
-    mem.freePacket(p);
+    mem->freePacket(p);
     return;
   }
 
@@ -856,9 +878,10 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
       if (NULL != relay_stream &&
 	  (!(relay_filter_dtmf && is_dtmf_packet))) {
         relay_stream->relay(p);
+        updateRelayOffload(p->recv_time);
       }
 
-      mem.freePacket(p);
+      mem->freePacket(p);
       return;
     }
   }
@@ -866,7 +889,7 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
 #ifndef WITH_ZRTP
   // throw away ZRTP packets 
   if(p->version != RTP_VERSION) {
-      mem.freePacket(p);
+      mem->freePacket(p);
       return;
   }
 #endif
@@ -879,7 +902,7 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
     if (NULL == session->zrtp_session_state.zrtp_audio) {
       WARN("dropping received packet, as there's no ZRTP stream initialized\n");
       receive_mut.unlock();
-      mem.freePacket(p);
+      mem->freePacket(p);
       return;      
     }
  
@@ -891,7 +914,7 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
 	p->setBufferSize(size);
 	if (p->parse() < 0) {
 	  ERROR("parsing decoded packet!\n");
-	  mem.freePacket(p);
+	  mem->freePacket(p);
 	} else {
 
           if(p->payload == getLocalTelephoneEventPT()) {
@@ -899,7 +922,7 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
           } else {
 	    if(!receive_buf.insert(ReceiveBuffer::value_type(p->timestamp,p)).second) {
 	      // insert failed
-	      mem.freePacket(p);
+	      mem->freePacket(p);
 	    }
           }
 
@@ -911,7 +934,7 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
 	// This is a protocol ZRTP packet or masked RTP media.
 	// In either case the packet must be dropped to protect your 
 	// media codec
-	mem.freePacket(p);
+	mem->freePacket(p);
 	
       } break;
 
@@ -921,7 +944,7 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
         //
         // This is some kind of error - see logs for more information
         //
-	mem.freePacket(p);
+	mem->freePacket(p);
       } break;
       }
   } else {
@@ -932,7 +955,7 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
     } else {
       if(!receive_buf.insert(ReceiveBuffer::value_type(p->timestamp,p)).second) {
 	// insert failed
-	mem.freePacket(p);
+	mem->freePacket(p);
       }
     }
 
@@ -984,7 +1007,8 @@ int AmRtpStream::nextPacket(AmRtpPacket*& p)
   if(monitor_rtp_timeout &&
      AmConfig::DeadRtpTime && 
      (diff.tv_sec > 0) &&
-     ((unsigned int)diff.tv_sec > AmConfig::DeadRtpTime)){
+     ((unsigned int)diff.tv_sec > AmConfig::DeadRtpTime) &&
+     !checkRelayOffloadActivity()){
     WARN("RTP Timeout detected. Last received packet is too old "
 	 "(diff.tv_sec = %i\n",(unsigned int)diff.tv_sec);
     receive_mut.unlock();
@@ -1031,7 +1055,7 @@ void AmRtpStream::recvPacket(int fd)
     return;
   }
 
-  AmRtpPacket* p = mem.newPacket();
+  AmRtpPacket* p = mem->newPacket();
   if (!p) p = reuseBufferedPacket();
   if (!p) {
     DBG("out of buffers for RTP packets, dropping (stream [%p])\n",
@@ -1060,12 +1084,12 @@ void AmRtpStream::recvPacket(int fd)
     if (parse_res == -1) {
       DBG("error while parsing RTP packet.\n");
       clearRTPTimeout(&p->recv_time);
-      mem.freePacket(p);	  
+      mem->freePacket(p);	  
     } else {
       bufferPacket(p);
     }
   } else {
-    mem.freePacket(p);
+    mem->freePacket(p);
   }
 }
 
@@ -1161,6 +1185,130 @@ void AmRtpStream::relay(AmRtpPacket* p)
   }
 }
 
+bool AmRtpStream::canOffloadRelay()
+{
+  AmRtpStream* to = relay_stream;
+
+  // everything the kernel program can not do stays in userspace:
+  // renumbering, DTMF filtering/detection, logging, IPv6, ...
+  if (!relay_enabled || !to || passive || !receiving ||
+      force_receive_dtmf || relay_filter_dtmf ||
+      (!relay_raw && !relay_transparent_seqno) || logger)
+    return false;
+
+#ifdef WITH_ZRTP
+  if (session && session->enable_zrtp)
+    return false;
+#endif
+
+  if (l_saddr.ss_family != AF_INET || r_saddr.ss_family != AF_INET ||
+      !am_get_port(&r_saddr))
+    return false;
+
+  if (!to->l_port || to->mute || to->hold || to->logger ||
+      to->l_saddr.ss_family != AF_INET || to->r_saddr.ss_family != AF_INET ||
+      !am_get_port(&to->r_saddr) ||
+      SAv4(&to->r_saddr)->sin_addr.s_addr == 0)
+    return false;
+
+  if (to->session && !to->session->canOffloadRTPRelay())
+    return false;
+
+  return true;
+}
+
+void AmRtpStream::updateRelayOffload(const struct timeval& now)
+{
+  if (!AmConfig::RtpRelayOffload || relay_offloaded ||
+      now.tv_sec < relay_offload_retry)
+    return;
+
+  // one attempt per second at most
+  relay_offload_retry = now.tv_sec + 1;
+
+  AmLock l(relay_offload_mut);
+  if (relay_offloaded || !canOffloadRelay() ||
+      !AmRtpRelayOffload::instance()->isEnabled())
+    return;
+
+  AmRtpStream* to = relay_stream;
+
+  AmRtpRelayOffloadRule rule;
+  memcpy(&rule.local, &l_saddr, sizeof(struct sockaddr_storage));
+  memcpy(&rule.expect_src, &r_saddr, sizeof(struct sockaddr_storage));
+  memcpy(&rule.src, &to->l_saddr, sizeof(struct sockaddr_storage));
+  memcpy(&rule.dst, &to->r_saddr, sizeof(struct sockaddr_storage));
+
+  if (!relay_raw && !relay_transparent_ssrc) {
+    rule.rewrite_ssrc = true;
+    rule.ssrc = to->l_ssrc;
+  }
+
+  if (!relay_raw) {
+    rule.check_payloads = true;
+    for (unsigned char pt = 0; pt < 128; pt++) {
+      if (relay_payloads.get(pt))
+	rule.payloads[pt / 64] |= 1ULL << (pt % 64);
+    }
+  }
+
+  if (!AmRtpRelayOffload::instance()->
+      addRule(AmConfig::RTP_Ifs[l_if].NetIfIdx, rule))
+    return;
+
+  DBG("RTP stream [%p] relayed to [%p] in the kernel now\n", this, to);
+  relay_offloaded = true;
+  relay_offload_packets = 0;
+  relay_offload_to = to;
+  to->relay_offload_sources.insert(this);
+}
+
+void AmRtpStream::dropRelayOffload()
+{
+  if (!relay_offloaded)
+    return;
+
+  DBG("RTP stream [%p] relayed in userspace again\n", this);
+  AmRtpRelayOffload::instance()->removeRule(&l_saddr);
+  relay_offloaded = false;
+  relay_offload_retry = 0;
+  if (relay_offload_to) {
+    relay_offload_to->relay_offload_sources.erase(this);
+    relay_offload_to = NULL;
+  }
+
+  // the kernel has been receiving for us until now
+  clearRTPTimeout();
+}
+
+bool AmRtpStream::checkRelayOffloadActivity()
+{
+  if (!relay_offloaded)
+    return false;
+
+  AmLock l(relay_offload_mut);
+  unsigned long long packets = 0, bytes = 0;
+  if (!relay_offloaded ||
+      !AmRtpRelayOffload::instance()->getCounters(&l_saddr, packets, bytes) ||
+      packets == relay_offload_packets)
+    return false;
+
+  relay_offload_packets = packets;
+  clearRTPTimeout();
+  return true;
+}
+
+void AmRtpStream::invalidateRelayOffload()
+{
+  if (!AmConfig::RtpRelayOffload)
+    return;
+
+  AmLock l(relay_offload_mut);
+  dropRelayOffload();
+  while (!relay_offload_sources.empty())
+    (*relay_offload_sources.begin())->dropRelayOffload();
+}
+
 int AmRtpStream::getLocalTelephoneEventRate()
 {
   if (local_telephone_event_pt.get())
@@ -1188,51 +1336,60 @@ void AmRtpStream::setRelayStream(AmRtpStream* stream) {
   relay_stream = stream;
   DBG("set relay stream [%p] for RTP instance [%p]\n",
       stream, this);
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::setRelayPayloads(const PayloadMask &_relay_payloads)
 {
   relay_payloads = _relay_payloads;
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::enableRtpRelay() {
   DBG("enabled RTP relay for RTP stream instance [%p]\n", this);
   relay_enabled = true;
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::disableRtpRelay() {
   DBG("disabled RTP relay for RTP stream instance [%p]\n", this);
   relay_enabled = false;
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::enableRawRelay()
 {
   DBG("enabled RAW relay for RTP stream instance [%p]\n", this);
   relay_raw = true;
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::disableRawRelay()
 {
   DBG("disabled RAW relay for RTP stream instance [%p]\n", this);
   relay_raw = false;
+  invalidateRelayOffload();
 }
  
 void AmRtpStream::setRtpRelayTransparentSeqno(bool transparent) {
   DBG("%sabled RTP relay transparent seqno for RTP stream instance [%p]\n",
       transparent ? "en":"dis", this);
   relay_transparent_seqno = transparent;
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::setRtpRelayTransparentSSRC(bool transparent) {
   DBG("%sabled RTP relay transparent SSRC for RTP stream instance [%p]\n",
       transparent ? "en":"dis", this);
   relay_transparent_ssrc = transparent;
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::setRtpRelayFilterRtpDtmf(bool filter) {
   DBG("%sabled RTP relay filtering of RTP DTMF (2833 / 4733) for RTP stream instance [%p]\n",
       filter ? "en":"dis", this);
   relay_filter_dtmf = filter;
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::stopReceiving()
@@ -1242,6 +1399,7 @@ void AmRtpStream::stopReceiving()
     AmRtpReceiver::instance()->removeStream(getLocalSocket());
     if (l_rtcp_sd > 0) AmRtpReceiver::instance()->removeStream(l_rtcp_sd);
   }
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::resumeReceiving()
@@ -1310,11 +1468,75 @@ inline void PacketMem::clear()
   n_used = cur_idx = 0;
 }
 
+AmMutex            PacketMemPool::pool_mut;
+vector<PacketMem*> PacketMemPool::pool;
+unsigned int       PacketMemPool::max_size = 0;
+atomic_int64       PacketMemPool::reused;
+atomic_int64       PacketMemPool::allocated;
+
+PacketMem* PacketMemPool::get()
+{
+  PacketMem* m = NULL;
+
+  if (max_size) {
+    pool_mut.lock();
+    if (!pool.empty()) {
+      m = pool.back();
+      pool.pop_back();
+    }
+    pool_mut.unlock();
+  }
+
+  if (m) {
+    m->clear();
+    reused.inc();
+    return m;
+  }
+
+  allocated.inc();
+  return new PacketMem();
+}
+
+void PacketMemPool::put(PacketMem* m)
+{
+  if (!m)
+    return;
+
+  if (max_size) {
+    pool_mut.lock();
+    if (pool.size() < max_size) {
+      pool.push_back(m);
+      m = NULL;
+    }
+    pool_mut.unlock();
+  }
+
+  delete m;
+}
+
+void PacketMemPool::setMaxSize(unsigned int size)
+{
+  AmLock lock(pool_mut);
+  max_size = size;
+  pool.reserve(size);
+  while (pool.size() > size) {
+    delete pool.back();
+    pool.pop_back();
+  }
+}
+
+unsigned int PacketMemPool::getPooled()
+{
+  AmLock lock(pool_mut);
+  return pool.size();
+}
+
 void AmRtpStream::setLogger(msg_logger* _logger)
 {
   if (logger) dec_ref(logger);
   logger = _logger;
   if (logger) inc_ref(logger);
+  invalidateRelayOffload();
 }
 
 void AmRtpStream::debug()
@@ -35,16 +35,20 @@
 #include "AmRtpPacket.h"
 #include "AmEvent.h"
 #include "AmDtmfSender.h"
+#include "atomic_types.h"
 
 #include <netinet/in.h>
 
 #include <string>
 #include <map>
+#include <set>
 #include <queue>
+#include <vector>
 #include <memory>
 using std::string;
 using std::auto_ptr;
 using std::pair;
+using std::vector;
 
 // return values of AmRtpStream::receive
 #define RTP_EMPTY        0 // no rtp packet available
@@ -87,6 +91,41 @@ private:
   unsigned int n_used;
 };
 
+/**
+ * \brief pool of receive buffer memory (@see PacketMem)
+ *
+ * The receive buffer is the biggest allocation per stream
+ * (MAX_PACKETS packets). If enabled, the buffers of deleted
+ * streams are kept and reused for new streams instead of
+ * being freed and allocated again (cold) for every call.
+ */
+class PacketMemPool
+{
+  static AmMutex            pool_mut;
+  static vector<PacketMem*> pool;
+  static unsigned int       max_size;
+
+  static atomic_int64       reused;
+  static atomic_int64       allocated;
+
+ public:
+  /** get a cleared receive buffer */
+  static PacketMem* get();
+  /** return a buffer which is no longer used */
+  static void put(PacketMem* m);
+
+  /** set the number of buffers kept, 0 disables the pool */
+  static void setMaxSize(unsigned int size);
+  static unsigned int getMaxSize() { return max_size; }
+
+  /** number of buffers in the pool */
+  static unsigned int getPooled();
+  /** number of buffers taken from the pool */
+  static unsigned long long getReused() { return reused.get(); }
+  /** number of buffers newly allocated */
+  static unsigned long long getAllocated() { return allocated.get(); }
+};
+
 /** \brief event fired on RTP timeout */
 class AmRtpTimeoutEvent
   : public AmEvent
@@ -248,7 +287,7 @@ protected:
   /**
    * Receive buffer, queue and mutex
    */
-  PacketMem       mem;
+  PacketMem*      mem;
   ReceiveBuffer   receive_buf;
   RtpEventQueue   rtp_ev_qu;
   AmMutex         receive_mut;
@@ -271,6 +310,19 @@ protected:
   /** filter RTP DTMF (2833 / 4733) in relaying */
   bool            relay_filter_dtmf;
 
+  /** relayed in the kernel (AmRtpRelayOffload) */
+  bool            relay_offloaded;
+  /** no new offload attempt before this time */
+  time_t          relay_offload_retry;
+  /** kernel packet counter at the last activity check */
+  unsigned long long relay_offload_packets;
+  /** stream the offloaded packets are sent from */
+  AmRtpStream*    relay_offload_to;
+  /** streams whose offloaded packets are sent from this stream */
+  std::set<AmRtpStream*> relay_offload_sources;
+  /** protects the offload state of all streams */
+  static AmMutex  relay_offload_mut;
+
   /** Session owning this stream */
   AmSession*         session;
 
@@ -295,6 +347,15 @@ protected:
 
   void relay(AmRtpPacket* p);
 
+  /** @return true if relaying to relay_stream can be done in the kernel */
+  bool canOffloadRelay();
+  /** try to hand relaying over to the kernel after a relayed packet */
+  void updateRelayOffload(const struct timeval& now);
+  /** stop relaying in the kernel; relay_offload_mut must be held */
+  void dropRelayOffload();
+  /** @return true if the kernel relayed packets since the last check */
+  bool checkRelayOffloadActivity();
+
   /** Sets generic parameters on SDP media */
   void getSdp(SdpMedia& m);
 
@@ -516,6 +577,13 @@ public:
   /** set destination for logging all received/sent RTP and RTCP packets */
   void setLogger(msg_logger *_logger);
 
+  /**
+   * Return relaying from and to this stream to userspace, e.g. after
+   * changing mute or force_receive_dtmf. It is handed to the kernel
+   * again with the next relayed packet if still possible.
+   */
+  void invalidateRelayOffload();
+
   void debug();
 };
 
@@ -80,7 +80,7 @@ AmSession::AmSession(AmSipDialog* p_dlg)
 #endif
 
 #ifdef SESSION_THREADPOOL
-  , _pid(this)
+  , _pid(this), sched_state(0)
 #endif
 {
   DBG("dlg = %p",dlg);
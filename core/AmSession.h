@@ -110,6 +110,10 @@ public:
 private:
   void stop();
   void* _pid;
+
+  friend class AmSessionProcessorThread;
+  /** scheduling state in the session processor pool */
+  volatile int sched_state;
 #endif
 
   static void session_started();
@@ -296,13 +300,19 @@ public:
   virtual void clearAudio();
 
   /** setter for rtp_str->mute */
-  void setMute(bool mute) { RTPStream()->mute = mute; }
+  void setMute(bool mute) {
+    RTPStream()->mute = mute;
+    RTPStream()->invalidateRelayOffload();
+  }
 
   /** setter for rtp_str->receiving */
   void setReceiving(bool receive) { RTPStream()->setReceiving(receive); }
 
   /** setter for rtp_str->force_receive_dtmf*/
-  void setForceDtmfReceiving(bool receive) { RTPStream()->force_receive_dtmf = receive; }
+  void setForceDtmfReceiving(bool receive) {
+    RTPStream()->force_receive_dtmf = receive;
+    RTPStream()->invalidateRelayOffload();
+  }
 
   /* ----         SIP dialog attributes                  ---- */
 
@@ -609,6 +619,14 @@ public:
 
   virtual void onAfterRTPRelay(AmRtpPacket* p, sockaddr_storage* remote_addr) {}
 
+  /**
+   * Called before RTP relayed to this session's stream is handed over
+   * to the kernel (see rtp_relay_offload), after which onBeforeRTPRelay
+   * and onAfterRTPRelay are not called for most packets any more.
+   * @return false to keep relaying in userspace
+   */
+  virtual bool canOffloadRTPRelay() { return true; }
+
   int getRtpInterface();
   void setRtpInterface(int _rtp_interface);
 };
@@ -44,9 +44,17 @@ AmSessionContainer* AmSessionContainer::_instance=NULL;
 _MONITORING_DECLARE_INTERFACE(AmSessionContainer);
 
 AmSessionContainer::AmSessionContainer()
-  : _run_cond(false), _container_closed(false), enable_unclean_shutdown(false),
-    CPSLimit(0), CPSHardLimit(0), max_cps(0)
+  : _container_closed(false), enable_unclean_shutdown(false),
+    next_shard(0), admission_max_us(0),
+    max_cps(0), CPSLimit(0), CPSHardLimit(0)
 {
+  num_shards = AmConfig::SessionCleanerThreads;
+  if (!num_shards)
+    num_shards = 1;
+  shards = new DeadSessionShard[num_shards];
+
+  for (unsigned int i=0; i<CPS_SAMPLERATE; i++)
+    cps_slots[i] = 0;
 }
 
 AmSessionContainer* AmSessionContainer::instance()
@@ -67,77 +75,127 @@ void AmSessionContainer::dispose()
 	usleep(10000);
     }
     // todo: add locking here
+    for (vector<AmSessionCleaner*>::iterator it = _instance->cleaners.begin();
+	 it != _instance->cleaners.end(); it++)
+      delete *it;
+    delete [] _instance->shards;
     delete _instance;
     _instance = NULL;
   }
 }
 
-bool AmSessionContainer::clean_sessions() {
-  ds_mut.lock();
-  DBG("Session cleaner starting its work\n");
-  
+bool AmSessionContainer::clean_sessions(unsigned int shard, bool force) {
+  DeadSessionShard& sh = shards[shard];
+
+  // take the whole queue: stopAndQueue() does not wait for us
+  SessionQueue batch;
+  sh.ds_mut.lock();
+  batch.swap(sh.d_sessions);
+  sh.ds_mut.unlock();
+
+  if (!batch.empty())
+    DBG("Session cleaner %u starting its work\n", shard);
+
+  struct timeval now, start, diff;
+  gettimeofday(&now, NULL);
+  start = now;
+
+  SessionQueue n_sessions;
+  unsigned int destroyed = 0;
+
   try {
-    SessionQueue n_sessions;
-    
-    while(!d_sessions.empty()){
-      
-      AmSession* cur_session = d_sessions.front();
-      d_sessions.pop();
-      
-      ds_mut.unlock();
-      
+    for (SessionQueue::iterator it = batch.begin(); it != batch.end(); it++) {
+
+      AmSession* cur_session = it->s;
+
+      // Give the Sessions some time to stop by themselves
+      timersub(&now, &it->queued, &diff);
+      if (!force && diff.tv_sec < SESSION_CLEANER_GRACE) {
+	n_sessions.push_back(*it);
+	continue;
+      }
+
       if(cur_session->is_stopped() && !cur_session->isProcessingMedia()){
 	
 	MONITORING_MARK_FINISHED(cur_session->getLocalTag().c_str());
 
 	DBG("session [%p] has been destroyed\n",(void*)cur_session->_pid);
 	delete cur_session;
+	destroyed++;
       }
       else {
 	DBG("session [%p] still running\n",(void*)cur_session->_pid);
-	n_sessions.push(cur_session);
+	n_sessions.push_back(*it);
       }
-      
-      ds_mut.lock();
     }
-    
-    swap(d_sessions,n_sessions);
-    
   }catch(std::exception& e){
     ERROR("exception caught in session cleaner: %s\n", e.what());
-    throw; /* throw again as this is fatal (because unlocking the mutex fails!! */
+    throw; /* throw again as this is fatal */
   }catch(...){
     ERROR("unknown exception caught in session cleaner!\n");
-    throw; /* throw again as this is fatal (because unlocking the mutex fails!! */
+    throw; /* throw again as this is fatal */
   }
-  bool more = !d_sessions.empty();
-  ds_mut.unlock();
-  return more;
-}
 
-void AmSessionContainer::initMonitoring() {
-  _MONITORING_INIT;
+  if (destroyed) {
+    dead_sessions.dec(destroyed);
+    reclaimed_sessions.inc(destroyed);
+    gettimeofday(&now, NULL);
+    timersub(&now, &start, &diff);
+    reclaim_us.inc(diff.tv_sec * 1000000ULL + diff.tv_usec);
+  }
+
+  sh.ds_mut.lock();
+  sh.d_sessions.insert(sh.d_sessions.end(),
+		       n_sessions.begin(), n_sessions.end());
+  bool more = !sh.d_sessions.empty();
+  // under ds_mut: stopAndQueue() can not set it in between
+  if (!more && !_container_closed.get())
+    sh.run_cond.set(false);
+  sh.ds_mut.unlock();
+
+  return more;
 }
 
-void AmSessionContainer::run()
+void AmSessionContainer::run_cleaner(unsigned int shard)
 {
+  DeadSessionShard& sh = shards[shard];
+
   while(!_container_closed.get()){
 
-    _run_cond.wait_for();
+    sh.run_cond.wait_for();
 
     if(_container_closed.get()) 
       break;
 
-    // Give the Sessions some time to stop by themselves
-    sleep(5);
+    bool more = clean_sessions(shard, false);
+
+    if(more) {
+      // sessions left: check again in a while
+      _container_closed.wait_for_to(500);
+    }
+  }
+  DBG("Session cleaner %u terminating\n", shard);
+}
+
+void AmSessionCleaner::run()
+{
+  container->run_cleaner(shard);
+}
 
-    bool more = clean_sessions();
+void AmSessionContainer::initMonitoring() {
+  _MONITORING_INIT;
+}
 
-    DBG("Session cleaner finished\n");
-    if(!more  && (!_container_closed.get()))
-      _run_cond.set(false);
+void AmSessionContainer::run()
+{
+  for (unsigned int i=1; i<num_shards; i++) {
+    AmSessionCleaner* c = new AmSessionCleaner(this, i);
+    cleaners.push_back(c);
+    c->start();
   }
-  DBG("Session cleaner terminating\n");
+
+  // the first shard is ours
+  run_cleaner(0);
 }
 
 void AmSessionContainer::broadcastShutdown() {
@@ -147,10 +205,30 @@ void AmSessionContainer::broadcastShutdown() {
     broadcast(new AmSystemEvent(AmSystemEvent::ServerShutdown));
 }
 
+void AmSessionContainer::wake_cleaners()
+{
+  for (unsigned int i=0; i<num_shards; i++)
+    shards[i].run_cond.set(true);
+}
+
 void AmSessionContainer::on_stop() 
 { 
   _container_closed.set(true);
 
+  // A cleaner holds its batch outside of the shard queue while it runs,
+  // so all cleaner loops (including our own for shard 0) must have
+  // finished before the remaining sessions are destroyed below.
+  wake_cleaners();
+
+  while (!is_stopped())
+    usleep(10000);
+
+  for (vector<AmSessionCleaner*>::iterator it = cleaners.begin();
+       it != cleaners.end(); it++) {
+    while (!(*it)->is_stopped())
+      usleep(10000);
+  }
+
   if (enable_unclean_shutdown) {
     INFO("unclean shutdown requested - not broadcasting shutdown\n");
   } else {
@@ -169,11 +247,15 @@ void AmSessionContainer::on_stop()
     }
     
     DBG("cleaning sessions...\n");
-    while (clean_sessions()) 
-      usleep(10000);
+    bool more;
+    do {
+      more = false;
+      for (unsigned int i=0; i<num_shards; i++)
+	more |= clean_sessions(i, true);
+      if (more)
+	usleep(10000);
+    } while (more);
   }
-
-  _run_cond.set(true); // so that thread stops
 }
 
 void AmSessionContainer::stopAndQueue(AmSession* s)
@@ -186,10 +268,17 @@ void AmSessionContainer::stopAndQueue(AmSession* s)
 
   s->stop();
 
-  ds_mut.lock();
-  d_sessions.push(s);
-  _run_cond.set(true);    
-  ds_mut.unlock();
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  DeadSessionShard& sh =
+    shards[__sync_fetch_and_add(&next_shard, 1) % num_shards];
+
+  dead_sessions.inc();
+  sh.ds_mut.lock();
+  sh.d_sessions.push_back(DeadSession(s, now));
+  sh.run_cond.set(true);    
+  sh.ds_mut.unlock();
 }
 
 void AmSessionContainer::destroySession(AmSession* s)
@@ -381,7 +470,6 @@ bool AmSessionContainer::postEvent(const string& local_tag,
 
 void AmSessionContainer::setCPSLimit(unsigned int limit)
 {
-  AmLock lock(cps_mut);
   CPSLimit = CPSHardLimit = limit;
 }
 
@@ -392,96 +480,102 @@ void AmSessionContainer::setCPSSoftLimit(unsigned int percent)
     return;
   }
 
-  struct timeval tv, res;
-  gettimeofday(&tv,0);
-
-  AmLock lock(cps_mut);
-
-  while (cps_queue.size()) {
-    timersub(&tv, &cps_queue.front(), &res);
-    if (res.tv_sec >= CPS_SAMPLERATE) {
-      cps_queue.pop();
-    }   
-    else {
-      break;
-    }
-  }
-  CPSLimit = ((float)percent / 100) * ((float)cps_queue.size() / CPS_SAMPLERATE);
+  unsigned int cps = get_cps_window(time(NULL));
+  CPSLimit = ((float)percent / 100) * ((float)cps / CPS_SAMPLERATE);
   if(0 == CPSLimit) CPSLimit = 1;
 }
 
 pair<unsigned int, unsigned int> AmSessionContainer::getCPSLimit()
 {
-  AmLock lock(cps_mut);
   return pair<unsigned int, unsigned int>(CPSHardLimit, CPSLimit);
 }
 
-unsigned int AmSessionContainer::getAvgCPS()
+unsigned int AmSessionContainer::get_cps_window(unsigned int now)
 {
-  struct timeval tv, res;
-  gettimeofday(&tv,0);
-
-  AmLock lock(cps_mut);
-
-  while (cps_queue.size()) {
-    timersub(&tv, &cps_queue.front(), &res);
-    if (res.tv_sec >= CPS_SAMPLERATE) {
-      cps_queue.pop();
-    }   
-    else {
-      break;
-    }
+  unsigned int calls = 0;
+  for (unsigned int i=0; i<CPS_SAMPLERATE; i++) {
+    // atomic read, also on 32 bit
+    unsigned long long slot = __sync_fetch_and_add(&cps_slots[i], 0);
+    if (now - (unsigned int)(slot >> 32) < CPS_SAMPLERATE)
+      calls += (unsigned int)slot;
   }
+  return calls;
+}
 
-  return (float)cps_queue.size() / CPS_SAMPLERATE;
+unsigned int AmSessionContainer::getAvgCPS()
+{
+  return (float)get_cps_window(time(NULL)) / CPS_SAMPLERATE;
 }
 
 unsigned int AmSessionContainer::getMaxCPS()
 {
-  AmLock lock(cps_mut);
-  unsigned int res = max_cps;
-  max_cps = 0;
-  return res;
+  return __sync_lock_test_and_set(&max_cps, 0);
 }
 
 bool AmSessionContainer::check_and_add_cps()
 {
-  struct timeval tv, res;
-  gettimeofday(&tv,0);
+  unsigned int now = time(NULL);
 
-  AmLock lock(cps_mut);
+  unsigned int cps = (float)get_cps_window(now) / CPS_SAMPLERATE;
 
-  while (cps_queue.size()) {
-    timersub(&tv, &cps_queue.front(), &res);
-    if (res.tv_sec >= CPS_SAMPLERATE) {
-      cps_queue.pop();
-    }   
-    else {
+  unsigned int max = max_cps;
+  while (cps > max) {
+    if (__sync_bool_compare_and_swap(&max_cps, max, cps))
       break;
-    }
-  }
-
-  unsigned int cps = (float)cps_queue.size() / CPS_SAMPLERATE;
-  if (cps > max_cps) {
-    max_cps = cps;
+    max = max_cps;
   }
 
-  if( CPSLimit && cps > CPSLimit ){
-    DBG("cps_limit %d reached. Not creating session.\n", CPSLimit);
+  unsigned int limit = CPSLimit;
+  if( limit && cps > limit ){
+    DBG("cps_limit %d reached. Not creating session.\n", limit);
     return true;
   }
-  else {
-    cps_queue.push(tv);
-    return false;
+
+  volatile unsigned long long* slot = &cps_slots[now % CPS_SAMPLERATE];
+  unsigned long long old_val, new_val;
+  do {
+    old_val = __sync_fetch_and_add(slot, 0);
+    if ((unsigned int)(old_val >> 32) == now)
+      new_val = old_val + 1;
+    else
+      // slot is from an older second: start over
+      new_val = ((unsigned long long)now << 32) | 1;
+  } while (!__sync_bool_compare_and_swap(slot, old_val, new_val));
+
+  return false;
+}
+
+void AmSessionContainer::add_admission_time(const struct timeval& start,
+					    bool new_session)
+{
+  struct timeval now, diff;
+  gettimeofday(&now, NULL);
+  timersub(&now, &start, &diff);
+  unsigned int us = diff.tv_sec * 1000000 + diff.tv_usec;
+
+  if (new_session)
+    admissions.inc();
+  admission_us.inc(us);
+
+  unsigned int max = admission_max_us;
+  while (us > max) {
+    if (__sync_bool_compare_and_swap(&admission_max_us, max, us))
+      break;
+    max = admission_max_us;
   }
 }
 
+unsigned int AmSessionContainer::getMaxAdmissionTime()
+{
+  return __sync_lock_test_and_set(&admission_max_us, 0);
+}
+
 AmSession* AmSessionContainer::createSession(const AmSipRequest& req,
 					     string& app_name,
 					     AmArg* session_params)
 {
   if (AmConfig::ShutdownMode) {
-    _run_cond.set(true); // so that thread stops
+    wake_cleaners(); // so that the cleaner threads stop
     DBG("Shutdown mode. Not creating session.\n");
 
     AmSipDialog::reply_error(req,AmConfig::ShutdownModeErrCode,
@@ -489,18 +583,25 @@ AmSession* AmSessionContainer::createSession(const AmSipRequest& req,
     return NULL;
   }
 
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
   if (AmConfig::SessionLimit &&
       AmConfig::SessionLimit <= AmSession::session_num) {
       
       DBG("session_limit %d reached. Not creating session.\n", 
 	  AmConfig::SessionLimit);
 
+      add_admission_time(start, true);
       AmSipDialog::reply_error(req,AmConfig::SessionLimitErrCode, 
 			       AmConfig::SessionLimitErrReason);
       return NULL;
   }
 
-  if (check_and_add_cps()) {
+  bool cps_reached = check_and_add_cps();
+  add_admission_time(start, true);
+
+  if (cps_reached) {
       AmSipDialog::reply_error(req,AmConfig::CPSLimitErrCode, 
 			       AmConfig::CPSLimitErrReason);
       return NULL;
@@ -565,14 +666,16 @@ AmSessionContainer::addSession(const string& callid,
 {
   if(_container_closed.get())
     return ShutDown;
-  
-  if(AmEventDispatcher::instance()->
-     addEventQueue(local_tag,(AmEventQueue*)session,
-		   callid,remote_tag,via_branch)) {
-    return Inserted;
-  }
 
-  return AlreadyExist;
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  bool inserted = AmEventDispatcher::instance()->
+    addEventQueue(local_tag,(AmEventQueue*)session,
+		  callid,remote_tag,via_branch);
+
+  add_admission_time(start, false);
+  return inserted ? Inserted : AlreadyExist;
 }
 
 AmSessionContainer::AddSessionStatus 
@@ -582,12 +685,14 @@ AmSessionContainer::addSession(const string& local_tag,
   if(_container_closed.get()) 
     return ShutDown;
 
-  if(AmEventDispatcher::instance()->
-     addEventQueue(local_tag,(AmEventQueue*)session)){
-    return Inserted;
-  }
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  bool inserted = AmEventDispatcher::instance()->
+    addEventQueue(local_tag,(AmEventQueue*)session);
 
-  return AlreadyExist;
+  add_admission_time(start, false);
+  return inserted ? Inserted : AlreadyExist;
 }
 
 void AmSessionContainer::enableUncleanShutdown() {
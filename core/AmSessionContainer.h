@@ -33,37 +33,98 @@
 
 #include "ampi/MonitoringAPI.h"
 
+#include <sys/time.h>
+
 #include <string>
 #include <queue>
+#include <deque>
+#include <vector>
 #include <map>
 
 using std::string;
 
+class AmSessionContainer;
+
+/** \brief additional thread cleaning one dead session shard */
+class AmSessionCleaner : public AmThread
+{
+  AmSessionContainer* container;
+  unsigned int shard;
+
+ protected:
+  void run();
+  void on_stop() {}
+
+ public:
+  AmSessionCleaner(AmSessionContainer* container, unsigned int shard)
+    : container(container), shard(shard) {}
+};
+
 /**
  * \brief Centralized session container.
  *
  * This is the register for all active and dead sessions.
- * If has a deamon which wakes up only if it has work. 
- * Then, it kills all dead sessions and try to go to bed 
- * (it cannot sleep if one or more sessions are still alive).
+ * Dead sessions are spread over shards, each with a daemon
+ * which wakes up only if it has work. Then, it kills all
+ * dead sessions and try to go to bed (it cannot sleep if
+ * one or more sessions are still alive). The container's
+ * own thread cleans the first shard.
  */
 class AmSessionContainer : public AmThread
 {
+  friend class AmSessionCleaner;
+
   static AmSessionContainer* _instance;
 
-  typedef std::queue<AmSession*>      SessionQueue;
+  struct DeadSession {
+    AmSession*     s;
+    struct timeval queued;
+    DeadSession(AmSession* s, const struct timeval& queued)
+      : s(s), queued(queued) {}
+  };
+
+  typedef std::deque<DeadSession> SessionQueue;
+
+  /** dead sessions, cleaned by one thread */
+  struct DeadSessionShard {
+    /** Container for dead sessions */
+    SessionQueue d_sessions;
+    /** Mutex to protect the dead session container */
+    AmMutex      ds_mut;
+    /** the shard's cleaner only runs if this is true */
+    AmCondition<bool> run_cond;
+
+    DeadSessionShard() : run_cond(false) {}
+  };
+
+  DeadSessionShard* shards;
+  unsigned int      num_shards;
+  /** round robin shard selection */
+  unsigned int      next_shard;
 
-  /** Container for dead sessions */
-  SessionQueue d_sessions;
-  /** Mutex to protect the dead session container */
-  AmMutex      ds_mut;
+  std::vector<AmSessionCleaner*> cleaners;
+
+  /** sessions queued and not yet destroyed */
+  atomic_int   dead_sessions;
+  atomic_int64 reclaimed_sessions;
+  /** time spent destroying sessions */
+  atomic_int64 reclaim_us;
+
+  /** new sessions checked against the limits */
+  atomic_int64 admissions;
+  /** time spent in limit checks and insertion */
+  atomic_int64 admission_us;
+  volatile unsigned int admission_max_us;
+
+  /**
+   * account time since start to admission
+   * @param new_session limit check of a new session (not insertion)
+   */
+  void add_admission_time(const struct timeval& start, bool new_session);
 
   /** is container closed for new sessions? */
   AmCondition<bool> _container_closed;
 
-  /** the daemon only runs if this is true */
-  AmCondition<bool> _run_cond;
-
   /** We are a Singleton ! Avoid people to have their own instance. */
   AmSessionContainer();
 
@@ -80,21 +141,38 @@ class AmSessionContainer : public AmThread
   /** @see AmThread::on_stop() */
   void on_stop();
 
-  bool clean_sessions();
+  /** cleaner loop for one shard */
+  void run_cleaner(unsigned int shard);
+
+  /**
+   * Destroys the stopped sessions of a shard.
+   * @param force ignore the grace time (shutdown)
+   * @return true if sessions are left in the shard
+   */
+  bool clean_sessions(unsigned int shard, bool force);
+
+  /** wake up all cleaner threads */
+  void wake_cleaners();
 
-  typedef std::queue<struct timeval> TimevalQueue;
+  /** seconds a session is given to stop by itself */
+  enum { SESSION_CLEANER_GRACE = 5 };
+
+  enum { CPS_SAMPLERATE = 5 };
 
-  /** Container for cps timevals*/
-  TimevalQueue cps_queue;
+  /**
+   * Calls accepted per second of the last CPS_SAMPLERATE
+   * seconds: each slot holds (second << 32 | count) and is
+   * updated with compare and swap.
+   */
+  volatile unsigned long long cps_slots[CPS_SAMPLERATE];
   /** Maximum cps since the lasd getMaxCPS()*/
-  unsigned int max_cps;
-  /** Mutex to protect the cps container */
-  AmMutex      cps_mut;
+  volatile unsigned int max_cps;
 
-  enum { CPS_SAMPLERATE = 5 };
+  volatile unsigned int CPSLimit;
+  volatile unsigned int CPSHardLimit;
 
-  unsigned int CPSLimit;
-  unsigned int CPSHardLimit;
+  /** calls accepted in the last CPS_SAMPLERATE seconds */
+  unsigned int get_cps_window(unsigned int now);
 
   bool check_and_add_cps();
 
@@ -202,6 +280,20 @@ class AmSessionContainer : public AmThread
    */
   unsigned int getMaxCPS();
 
+  /** number of dead sessions not yet destroyed */
+  unsigned int getDeadSessions() { return dead_sessions.get(); }
+  /** number of dead sessions destroyed */
+  unsigned long long getReclaimedSessions() { return reclaimed_sessions.get(); }
+  /** total time spent destroying sessions */
+  unsigned long long getReclaimTime() { return reclaim_us.get(); }
+
+  /** number of new sessions admitted or rejected */
+  unsigned long long getAdmissions() { return admissions.get(); }
+  /** total time spent in limit checks and insertion of new sessions */
+  unsigned long long getAdmissionTime() { return admission_us.get(); }
+  /** maximum time of one admission since the last query */
+  unsigned int getMaxAdmissionTime();
+
   void initMonitoring();
 
   _MONITORING_DEFINE_INTERFACE;
@@ -31,6 +31,7 @@
 
 #include "AmSessionProcessor.h"
 #include "AmSession.h"
+#include "AmConfig.h"
 
 #include <vector>
 #include <list>
@@ -41,6 +42,14 @@ AmMutex AmSessionProcessor::threads_mut;
 vector<AmSessionProcessorThread*>::iterator 
 AmSessionProcessor::threads_it = AmSessionProcessor::threads.begin();
 
+atomic_int AmSessionProcessor::sched_latency[SCHED_LATENCY_BUCKETS];
+atomic_int AmSessionProcessor::steals;
+
+const unsigned int AmSessionProcessor::
+sched_latency_bounds[SCHED_LATENCY_BUCKETS] = {
+  100, 1000, 10000, 100000, 1000000, 0
+};
+
 AmSessionProcessorThread* AmSessionProcessor::getProcessorThread() {
   threads_mut.lock();
   if (!threads.size()) {
@@ -62,29 +71,161 @@ AmSessionProcessorThread* AmSessionProcessor::getProcessorThread() {
 void AmSessionProcessor::addThreads(unsigned int num_threads) {
   DBG("starting %u session processor threads\n", num_threads);
   threads_mut.lock();
+  // the thread list is read without locking when stealing,
+  // so it must be complete before the first thread starts
+  size_t first = threads.size();
   for (unsigned int i=0; i < num_threads;i++) {
     threads.push_back(new AmSessionProcessorThread());
-    threads.back()->start();
+    threads.back()->setCpuSet(&AmConfig::SessionProcessorCpus);
+  }
+  for (size_t i=first; i < threads.size(); i++) {
+    threads[i]->start();
   }
   threads_it = threads.begin();
   DBG("now %zd session processor threads running\n",  threads.size());
   threads_mut.unlock();
 }
 
+AmSession* AmSessionProcessor::steal(AmSessionProcessorThread* thief,
+				     struct timeval& queued) {
+  size_t n = threads.size();
+  size_t start = 0;
+  for (; start < n; start++)
+    if (threads[start] == thief) break;
+
+  for (size_t i=1; i < n; i++) {
+    AmSession* s = threads[(start + i) % n]->stealReady(queued);
+    if (s != NULL) {
+      steals.inc();
+      return s;
+    }
+  }
+
+  return NULL;
+}
+
+void AmSessionProcessor::wakeupIdleThread(AmSessionProcessorThread* except) {
+  for (size_t i=0; i < threads.size(); i++) {
+    if ((threads[i] != except) && !threads[i]->isBusy()) {
+      threads[i]->wakeup();
+      return;
+    }
+  }
+}
+
+void AmSessionProcessor::addLatency(const struct timeval& queued) {
+  struct timeval now, diff;
+  gettimeofday(&now, NULL);
+  timersub(&now, &queued, &diff);
+
+  unsigned long long us = diff.tv_sec * 1000000ULL + diff.tv_usec;
+  unsigned int b = 0;
+  while ((b < SCHED_LATENCY_BUCKETS - 1) && (us >= sched_latency_bounds[b]))
+    b++;
+
+  sched_latency[b].inc();
+}
+
+unsigned int AmSessionProcessor::getLatencyCount(unsigned int bucket) {
+  if (bucket >= SCHED_LATENCY_BUCKETS)
+    return 0;
+  return sched_latency[bucket].get();
+}
+
 
 AmSessionProcessorThread::AmSessionProcessorThread() 
-  : events(this), runcond(false)
+  : events(this), runcond(false), busy(false)
 {
 }
 
 AmSessionProcessorThread::~AmSessionProcessorThread() {
 }
 
-void AmSessionProcessorThread::notify(AmEventQueue* sender) {
-  process_sessions_mut.lock();
+void AmSessionProcessorThread::pushReady(AmSession* s) {
+  ReadySession rs;
+  rs.s = s;
+  gettimeofday(&rs.queued, NULL);
+
+  ready_mut.lock();
+  ready.push_back(rs);
+  ready_mut.unlock();
+
   runcond.set(true);
-  process_sessions.insert(sender);
-  process_sessions_mut.unlock();
+
+  // let an idle thread take it over if we are stuck in a session
+  if (busy)
+    AmSessionProcessor::wakeupIdleThread(this);
+}
+
+AmSession* AmSessionProcessorThread::popReady(struct timeval& queued) {
+  AmLock l(ready_mut);
+  if (ready.empty())
+    return NULL;
+
+  AmSession* s = ready.front().s;
+  queued = ready.front().queued;
+  ready.pop_front();
+  return s;
+}
+
+AmSession* AmSessionProcessorThread::stealReady(struct timeval& queued) {
+  return popReady(queued);
+}
+
+void AmSessionProcessorThread::notify(AmEventQueue* sender) {
+  // only sessions register us as notification sink
+  AmSession* s = static_cast<AmSession*>(sender);
+
+  while (true) {
+    int state = s->sched_state;
+    switch (state) {
+    case SESSION_SCHED_IDLE:
+      if (__sync_bool_compare_and_swap(&s->sched_state, state,
+				       SESSION_SCHED_QUEUED)) {
+	pushReady(s);
+	return;
+      }
+      break;
+
+    case SESSION_SCHED_RUNNING:
+      // the running thread will queue it again when done
+      if (__sync_bool_compare_and_swap(&s->sched_state, state,
+				       SESSION_SCHED_RUNNING_NOTIFIED))
+	return;
+      break;
+
+    default:
+      // starting (processed after startup), already queued or finished
+      return;
+    }
+  }
+}
+
+void AmSessionProcessorThread::runSession(AmSession* s) {
+  if (!__sync_bool_compare_and_swap(&s->sched_state, SESSION_SCHED_QUEUED,
+				    SESSION_SCHED_RUNNING)) {
+    ERROR("session [%p] scheduled in wrong state %i\n", s, s->sched_state);
+    return;
+  }
+
+  busy = true;
+  bool cont = s->processingCycle();
+  busy = false;
+
+  if (!cont) {
+    s->sched_state = SESSION_SCHED_FINISHED;
+    DBG("finalizing session [%p/%s/%s]\n",
+	s, s->getCallID().c_str(), s->getLocalTag().c_str());
+    s->finalize();
+    return;
+  }
+
+  if (!__sync_bool_compare_and_swap(&s->sched_state, SESSION_SCHED_RUNNING,
+				    SESSION_SCHED_IDLE)) {
+    // events arrived while processing
+    s->sched_state = SESSION_SCHED_QUEUED;
+    pushReady(s);
+  }
 }
 
 void AmSessionProcessorThread::run() {
@@ -96,13 +237,7 @@ void AmSessionProcessorThread::run() {
 
     DBG("running processing loop\n");
 
-    process_sessions_mut.lock();
     runcond.set(false);
-    // get the list of session s that need processing
-    std::set<AmEventQueue*> pending_process_sessions 
-      = process_sessions;
-    process_sessions.clear();
-    process_sessions_mut.unlock();
 
     // process control events (AmSessionProcessorThreadAddEvent)
     events.processEvents();
@@ -118,42 +253,27 @@ void AmSessionProcessorThread::run() {
 	DBG("starting up [%s|%s]: [%p]\n",
 	    (*it)->getCallID().c_str(), (*it)->getLocalTag().c_str(),*it);
 	if ((*it)->startup()) {
-	  sessions.push_back(*it); // startup successful
-	  // make sure this session is being processed for startup events
-	  pending_process_sessions.insert(*it);
+	  // startup successful: process startup events
+	  (*it)->sched_state = SESSION_SCHED_QUEUED;
+	  pushReady(*it);
 	}
       }
 
       startup_sessions.clear();
     }
 
-    std::vector<AmSession*> fin_sessions;
-
-    DBG("processing events for  up to %zd sessions\n",
-	pending_process_sessions.size());
-
-    std::list<AmSession*>::iterator it=sessions.begin();
-    while (it != sessions.end()) {
-      if ((pending_process_sessions.find(*it)!=
-	      pending_process_sessions.end()) &&
-	  (!(*it)->processingCycle())) {
-	fin_sessions.push_back(*it);
-	std::list<AmSession*>::iterator d_it = it;
-	it++;
-	sessions.erase(d_it);
-      } else {
-	it++;
-      }
-    }
+    // process ready sessions, ours first, then those of busy threads
+    struct timeval queued;
+    AmSession* s;
+    while (!stop_requested.get() &&
+	   (((s = popReady(queued)) != NULL) ||
+	    ((s = AmSessionProcessor::steal(this, queued)) != NULL))) {
 
-    if (fin_sessions.size()) {
-      DBG("finalizing %zd sessions\n", fin_sessions.size());
-      for (std::vector<AmSession*>::iterator it=fin_sessions.begin(); 
-	   it != fin_sessions.end(); it++) {
-	DBG("finalizing session [%p/%s/%s]\n",
-	    *it, (*it)->getCallID().c_str(), (*it)->getLocalTag().c_str());
-	(*it)->finalize();
-      }
+      AmSessionProcessor::addLatency(queued);
+      runSession(s);
+
+      if (events.eventPending())
+	break; // new sessions to start up
     }
   }
 }
@@ -161,6 +281,7 @@ void AmSessionProcessorThread::run() {
 void AmSessionProcessorThread::on_stop() {
   INFO("requesting session to stop.\n");
   stop_requested.set(true);
+  runcond.set(true);
 }
 
 // AmEventHandler interface
@@ -183,9 +304,6 @@ void AmSessionProcessorThread::startSession(AmSession* s) {
   // add this to be scheduled
   events.postEvent(new AmSessionProcessorThreadAddEvent(s));
 
-  // trigger processing of events already in queue at startup
-  notify(s);
-
   // wakeup the thread
   runcond.set(true);
 }
@@ -34,22 +34,61 @@
 
 #include "AmThread.h"
 #include "AmEventQueue.h"
+#include "atomic_types.h"
 
 #include <vector>
 #include <list>
-#include <set>
+#include <deque>
+#include <sys/time.h>
+
 class AmSessionProcessorThread;
 class AmSession;
 
+/** number of buckets in the scheduling latency histogram */
+#define SCHED_LATENCY_BUCKETS 6
+
+/**
+ * Scheduling state of a session in the processor pool
+ * (AmSession::sched_state). A session is in at most one
+ * ready queue and is run by at most one thread at a time,
+ * which keeps its events in order.
+ */
+enum {
+  SESSION_SCHED_STARTING = 0,
+  SESSION_SCHED_IDLE,
+  SESSION_SCHED_QUEUED,
+  SESSION_SCHED_RUNNING,
+  SESSION_SCHED_RUNNING_NOTIFIED,
+  SESSION_SCHED_FINISHED
+};
+
 class AmSessionProcessor {
   static vector<AmSessionProcessorThread*> threads;
   static AmMutex threads_mut;
   static vector<AmSessionProcessorThread*>::iterator 
     threads_it;
 
+  /** time from becoming ready until processing starts */
+  static atomic_int sched_latency[SCHED_LATENCY_BUCKETS];
+  static atomic_int steals;
+
  public: 
+  /** upper bounds of the latency buckets in us (last: unbounded) */
+  static const unsigned int sched_latency_bounds[SCHED_LATENCY_BUCKETS];
+
   static AmSessionProcessorThread* getProcessorThread();
   static void addThreads(unsigned int num_threads);
+
+  /** take a ready session from another thread's queue */
+  static AmSession* steal(AmSessionProcessorThread* thief,
+			  struct timeval& queued);
+  /** wake up a thread which is not processing a session */
+  static void wakeupIdleThread(AmSessionProcessorThread* except);
+
+  static void addLatency(const struct timeval& queued);
+
+  static unsigned int getLatencyCount(unsigned int bucket);
+  static unsigned int getSteals() { return steals.get(); }
 };
 
 struct AmSessionProcessorThreadAddEvent 
@@ -65,14 +104,27 @@ class AmSessionProcessorThread
   public AmEventHandler,
   public AmEventNotificationSink
 {
+  struct ReadySession {
+    AmSession* s;
+    struct timeval queued;
+  };
+
   AmEventQueue    events;
-  std::list<AmSession*> sessions;
   std::vector<AmSession*> startup_sessions;
   AmSharedVar<bool> stop_requested;
 
   AmCondition<bool> runcond;
-  std::set<AmEventQueue*> process_sessions;
-  AmMutex process_sessions_mut;
+
+  /** sessions ready to be processed */
+  std::deque<ReadySession> ready;
+  AmMutex ready_mut;
+
+  /** currently processing a session */
+  volatile bool busy;
+
+  void pushReady(AmSession* s);
+  AmSession* popReady(struct timeval& queued);
+  void runSession(AmSession* s);
 
   // AmEventHandler interface
   void process(AmEvent* e);
@@ -89,6 +141,12 @@ class AmSessionProcessorThread
   void notify(AmEventQueue* sender);
 
   void startSession(AmSession* s);
+
+  bool isBusy() { return busy; }
+  void wakeup() { runcond.set(true); }
+
+  /** remove the oldest ready session (used by idle threads) */
+  AmSession* stealReady(struct timeval& queued);
 };
 
 #endif // _AmSessionProcessor_h_
@@ -50,34 +50,32 @@ bool hasHeader(const string& hdrs,const string& hdr_name) {
 }
 
 #include "log.h"
+
+static inline char lower_char(char c)
+{
+  if('A' <= c && c <= 'Z')
+    return c - ('A' - 'a');
+  return c;
+}
+
 bool findHeader(const string& hdrs,const string& hdr_name, const size_t skip, 
 		size_t& pos1, size_t& pos2, size_t& hdr_start)
 {
   unsigned int p;
   if(skip >= hdrs.length()) return false;
-  char* hdr = strdup(hdr_name.c_str());
   const char* hdrs_c = hdrs.c_str() + skip;
-  char* hdr_c = hdr;
+  const char* hdr = hdr_name.c_str();
+  const char* hdr_c = hdr;
   const char* hdrs_end = hdrs.c_str() + hdrs.length();
   const char* hdr_end = hdr_c + hdr_name.length(); 
 
-  while(hdr_c != hdr_end){
-    if('A' <= *hdr_c && *hdr_c <= 'Z')
-      *hdr_c -= 'A' - 'a';
-    hdr_c++;
-  }
-
   while(hdrs_c != hdrs_end){
 
     hdr_c = hdr;
 
     while((hdrs_c != hdrs_end) && (hdr_c != hdr_end)){
 
-      char c = *hdrs_c;
-      if('A' <= *hdrs_c && *hdrs_c <= 'Z')
-	c -= 'A' - 'a';
-
-      if(c != *hdr_c)
+      if(lower_char(*hdrs_c) != lower_char(*hdr_c))
 	break;
 
       hdr_c++;
@@ -95,11 +93,12 @@ bool findHeader(const string& hdrs,const string& hdr_name, const size_t skip,
       // current hdr just starts with hdr, continue search
     }
 
-    while((hdrs_c != hdrs_end) && (*hdrs_c != '\n'))
-      hdrs_c++;
-
-    if(hdrs_c != hdrs_end)
-      hdrs_c++;
+    const char* eol = (const char*)memchr(hdrs_c, '\n', hdrs_end - hdrs_c);
+    if(!eol) {
+      hdrs_c = hdrs_end;
+      break;
+    }
+    hdrs_c = eol + 1;
   }
     
   if(hdr_c == hdr_end){
@@ -121,16 +120,12 @@ bool findHeader(const string& hdrs,const string& hdr_name, const size_t skip,
 	     hdrs[p_end] != '\r' &&
 	     hdrs[p_end] != '\n')
 	p_end++;
-      free(hdr);
-      // return hdrs.substr(p,p_end-p);
       pos1 = p;
       pos2 = p_end;
       return true;
     }
   }
 
-  free(hdr);
-  //    return "";
   return false;
 }
 
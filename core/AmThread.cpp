@@ -29,9 +29,14 @@
 #include "log.h"
 
 #include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "errno.h"
 #include <string>
+#include <algorithm>
 using std::string;
+using std::vector;
 
 AmMutex::AmMutex(bool recursive)
 {
@@ -63,7 +68,8 @@ void AmMutex::unlock()
 }
 
 AmThread::AmThread()
-  : _stopped(true)
+  : _stopped(true),
+    _cpus(NULL)
 {
 }
 
@@ -72,6 +78,8 @@ void * AmThread::_start(void * _t)
   AmThread* _this = (AmThread*)_t;
   _this->_pid = (unsigned long) _this->_td;
   DBG("Thread %lu is starting.\n", (unsigned long) _this->_pid);
+  if(_this->_cpus && !_this->_cpus->empty())
+    _this->_cpus->apply();
   _this->run();
 
   DBG("Thread %lu is ending.\n", (unsigned long) _this->_pid);
@@ -189,6 +197,134 @@ int AmThread::setRealtime() {
   return 0;
 }
 
+/** parse "0-3,8"; item separators may be ',' or whitespace */
+static bool parse_cpu_ranges(const char* s, vector<int>& cpus)
+{
+  while (*s) {
+    if (*s == ',' || *s == ' ' || *s == '\t' || *s == '\n') {
+      s++;
+      continue;
+    }
+
+    char* end;
+    long first = strtol(s, &end, 10);
+    if (end == s || first < 0)
+      return false;
+    long last = first;
+    s = end;
+    if (*s == '-') {
+      s++;
+      last = strtol(s, &end, 10);
+      if (end == s || last < first)
+	return false;
+      s = end;
+    }
+    for (long c = first; c <= last; c++)
+      cpus.push_back((int)c);
+  }
+  return true;
+}
+
+bool AmCpuSet::parse(const string& cpu_list)
+{
+  vector<int> res;
+  size_t pos = 0;
+  while (pos < cpu_list.length()) {
+    size_t next = cpu_list.find(',', pos);
+    if (next == string::npos)
+      next = cpu_list.length();
+    string item = cpu_list.substr(pos, next - pos);
+    pos = next + 1;
+
+    size_t b = item.find_first_not_of(" \t");
+    if (b == string::npos)
+      continue;
+    item = item.substr(b, item.find_last_not_of(" \t") - b + 1);
+
+    if (item.compare(0, 4, "node") == 0) {
+      // all CPUs of a NUMA node
+      string node = item.substr(4);
+      if (node.empty() || node.find_first_not_of("0123456789") != string::npos) {
+	ERROR("invalid NUMA node '%s'\n", item.c_str());
+	return false;
+      }
+      string fname = "/sys/devices/system/node/node" + node + "/cpulist";
+      FILE* f = fopen(fname.c_str(), "r");
+      if (!f) {
+	ERROR("NUMA node %s not found (%s)\n", node.c_str(), fname.c_str());
+	return false;
+      }
+      char buf[1024];
+      bool ok = fgets(buf, sizeof(buf), f) != NULL &&
+	parse_cpu_ranges(buf, res);
+      fclose(f);
+      if (!ok) {
+	ERROR("reading %s\n", fname.c_str());
+	return false;
+      }
+    }
+    else if (!parse_cpu_ranges(item.c_str(), res)) {
+      ERROR("invalid CPU list item '%s'\n", item.c_str());
+      return false;
+    }
+  }
+
+  long n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+  for (vector<int>::iterator it = res.begin(); it != res.end(); it++) {
+    if (n_cpus > 0 && *it >= n_cpus) {
+      ERROR("CPU %d does not exist (%ld CPUs configured)\n", *it, n_cpus);
+      return false;
+    }
+  }
+
+  std::sort(res.begin(), res.end());
+  res.erase(std::unique(res.begin(), res.end()), res.end());
+  cpus.swap(res);
+  return true;
+}
+
+string AmCpuSet::print() const
+{
+  string res;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    size_t j = i;
+    while (j + 1 < cpus.size() && cpus[j+1] == cpus[j] + 1)
+      j++;
+    char buf[32];
+    if (j > i)
+      snprintf(buf, sizeof(buf), "%d-%d", cpus[i], cpus[j]);
+    else
+      snprintf(buf, sizeof(buf), "%d", cpus[i]);
+    if (!res.empty())
+      res += ",";
+    res += buf;
+    i = j;
+  }
+  return res;
+}
+
+int AmCpuSet::apply() const
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (vector<int>::const_iterator it = cpus.begin(); it != cpus.end(); it++) {
+    if (*it < CPU_SETSIZE)
+      CPU_SET(*it, &set);
+  }
+
+  int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (res) {
+    ERROR("binding thread to CPUs %s: %s\n", print().c_str(), strerror(res));
+    return -1;
+  }
+  DBG("thread bound to CPUs %s\n", print().c_str());
+  return 0;
+#else
+  WARN("binding threads to CPUs is not supported on this platform\n");
+  return -1;
+#endif
+}
 
 AmThreadWatcher* AmThreadWatcher::_instance=0;
 AmMutex AmThreadWatcher::_inst_mut;
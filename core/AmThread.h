@@ -34,6 +34,8 @@
 #include <errno.h>
 
 #include <queue>
+#include <string>
+#include <vector>
 
 /**
  * \brief C++ Wrapper class for pthread mutex
@@ -184,6 +186,28 @@ public:
   }
 };
 
+/**
+ * \brief Set of CPUs a thread is bound to
+ *
+ * Parsed from a list like "0-3,8,node1": plain CPU numbers,
+ * ranges, and NUMA nodes (all CPUs of the node).
+ */
+class AmCpuSet
+{
+  std::vector<int> cpus;
+
+public:
+  /** @return false if the list is invalid */
+  bool parse(const std::string& cpu_list);
+
+  bool empty() const { return cpus.empty(); }
+  const std::vector<int>& get() const { return cpus; }
+  std::string print() const;
+
+  /** bind the calling thread to the set. @return 0 on success */
+  int apply() const;
+};
+
 /**
  * \brief C++ Wrapper class for pthread
  */
@@ -194,6 +218,8 @@ class AmThread
 
   AmSharedVar<bool> _stopped;
 
+  const AmCpuSet* _cpus;
+
   static void* _start(void*);
 
 protected:
@@ -219,6 +245,12 @@ public:
   void cancel();
 
   int setRealtime();
+
+  /**
+   * Bind the thread to a set of CPUs when it is started.
+   * The set must outlive the thread (e.g. an AmConfig member).
+   */
+  void setCpuSet(const AmCpuSet* cpus) { _cpus = cpus; }
 };
 
 /**
@@ -37,6 +37,7 @@
 
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -1071,7 +1072,8 @@ size_t skip_to_end_of_brackets(const string& s, size_t start) {
 
 bool read_regex_mapping(const string& fname, const char* sep,
 			const char* dbg_type,
-			RegexMappingVector& result) {
+			RegexMappingVector& result,
+			std::vector<string>* patterns) {
   std::ifstream appcfg(fname.c_str());
   if (!appcfg.good()) {
     ERROR("could not load %s file at '%s'\n",
@@ -1102,6 +1104,8 @@ bool read_regex_mapping(const string& fname, const char* sep,
       DBG("adding %s '%s' => '%s'\n",
 	  dbg_type, re_v[0].c_str(),re_v[1].c_str());
       result.push_back(make_pair(app_re, re_v[1]));
+      if (patterns)
+	patterns->push_back(re_v[0]);
     }
   }
   return true;
@@ -1118,32 +1122,175 @@ void ReplaceStringInPlace(std::string& subject, const std::string& search,
 
 #define MAX_GROUPS 9
 
+/** run one mapping entry, setting result with \\1..\\9 replaced */
+static bool run_regex_mapping_entry(const std::pair<regex_t, string>& entry,
+				    const char* test_s, string& result) {
+  regmatch_t groups[MAX_GROUPS];
+  if (regexec(&entry.first, test_s, MAX_GROUPS, groups, 0))
+    return false;
+
+  result = entry.second;
+  string soh(1, char(1));
+  ReplaceStringInPlace(result, "\\\\", soh);
+  unsigned int g = 0;
+  for (g = 1; g < MAX_GROUPS; g++) {
+    if (groups[g].rm_so == (int)(size_t)-1) break;
+    DBG("group %u: [%2u-%2u]: %.*s\n",
+	g, (unsigned int)groups[g].rm_so, (unsigned int)groups[g].rm_eo,
+	(int)(groups[g].rm_eo - groups[g].rm_so), test_s + groups[g].rm_so);
+    std::string match(test_s + groups[g].rm_so,
+		      groups[g].rm_eo - groups[g].rm_so);
+    ReplaceStringInPlace(result, "\\" + int2str(g), match);
+  }
+  ReplaceStringInPlace(result, soh, "\\");
+  return true;
+}
+
 bool run_regex_mapping(const RegexMappingVector& mapping, const char* test_s,
                        string& result) {
-  regmatch_t groups[MAX_GROUPS];
   for (RegexMappingVector::const_iterator it = mapping.begin();
        it != mapping.end(); it++) {
-    if (!regexec(&it->first, test_s, MAX_GROUPS, groups, 0)) {
-      result = it->second;
-      string soh(1, char(1));
-      ReplaceStringInPlace(result, "\\\\", soh);
-      unsigned int g = 0;
-      for (g = 1; g < MAX_GROUPS; g++) {
-        if (groups[g].rm_so == (int)(size_t)-1) break;
-        DBG("group %u: [%2u-%2u]: %.*s\n",
-            g, (unsigned int)groups[g].rm_so, (unsigned int)groups[g].rm_eo,
-            (int)(groups[g].rm_eo - groups[g].rm_so), test_s + groups[g].rm_so);
-	std::string match(test_s + groups[g].rm_so,
-			  groups[g].rm_eo - groups[g].rm_so);
-        ReplaceStringInPlace(result, "\\" + int2str(g), match);
-      }
-      ReplaceStringInPlace(result, soh, "\\");
+    if (run_regex_mapping_entry(*it, test_s, result))
       return true;
+  }
+  return false;
+}
+
+RegexMapping::RegexMapping()
+  : nodes(1)
+{
+}
+
+RegexMapping::~RegexMapping()
+{
+  clear();
+}
+
+void RegexMapping::clear()
+{
+  for (RegexMappingVector::iterator it = entries.begin();
+       it != entries.end(); it++) {
+    regfree(&it->first);
+  }
+  entries.clear();
+  nodes.assign(1, Node());
+  unindexed.clear();
+}
+
+bool RegexMapping::read(const string& fname, const char* sep,
+			const char* dbg_type)
+{
+  RegexMappingVector v;
+  std::vector<string> patterns;
+  if (!read_regex_mapping(fname, sep, dbg_type, v, &patterns)) {
+    for (RegexMappingVector::iterator it = v.begin(); it != v.end(); it++)
+      regfree(&it->first);
+    return false;
+  }
+
+  for (size_t i = 0; i < v.size(); i++) {
+    entries.push_back(v[i]);
+    index(entries.size() - 1, patterns[i]);
+  }
+  return true;
+}
+
+bool RegexMapping::add(const string& pattern, const string& value)
+{
+  regex_t re;
+  if (regcomp(&re, pattern.c_str(), REG_EXTENDED))
+    return false;
+
+  entries.push_back(make_pair(re, value));
+  index(entries.size() - 1, pattern);
+  return true;
+}
+
+void RegexMapping::index(unsigned int entry, const string& pattern)
+{
+  string prefix = anchoredPrefix(pattern);
+  if (prefix.empty()) {
+    unindexed.push_back(entry);
+    return;
+  }
+
+  unsigned int node = 0;
+  for (size_t i = 0; i < prefix.length(); i++) {
+    std::map<char, unsigned int>::iterator it = nodes[node].next.find(prefix[i]);
+    if (it != nodes[node].next.end()) {
+      node = it->second;
+    } else {
+      nodes.push_back(Node());
+      nodes[node].next[prefix[i]] = nodes.size() - 1;
+      node = nodes.size() - 1;
     }
   }
+  nodes[node].entries.push_back(entry);
+}
+
+bool RegexMapping::run(const char* test_s, string& result) const
+{
+  // entries whose prefix the string starts with
+  std::vector<unsigned int> candidates;
+  unsigned int node = 0;
+  for (const char* c = test_s; *c; c++) {
+    std::map<char, unsigned int>::const_iterator it = nodes[node].next.find(*c);
+    if (it == nodes[node].next.end())
+      break;
+    node = it->second;
+    candidates.insert(candidates.end(), nodes[node].entries.begin(),
+		      nodes[node].entries.end());
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  // try them merged with the unindexed ones, in mapping order
+  std::vector<unsigned int>::const_iterator c_it = candidates.begin();
+  std::vector<unsigned int>::const_iterator u_it = unindexed.begin();
+  while (c_it != candidates.end() || u_it != unindexed.end()) {
+    unsigned int entry;
+    if (u_it == unindexed.end() ||
+	(c_it != candidates.end() && *c_it < *u_it)) {
+      entry = *c_it++;
+    } else {
+      entry = *u_it++;
+    }
+
+    if (run_regex_mapping_entry(entries[entry], test_s, result))
+      return true;
+  }
   return false;
 }
 
+string RegexMapping::anchoredPrefix(const string& pattern)
+{
+  // alternatives could match without the prefix
+  if (pattern.empty() || pattern[0] != '^' ||
+      pattern.find('|') != string::npos)
+    return "";
+
+  string prefix;
+  for (size_t i = 1; i < pattern.length(); i++) {
+    char c = pattern[i];
+    if (c == '*' || c == '?' || c == '{') {
+      // previous character is optional
+      if (!prefix.empty())
+	prefix.erase(prefix.length() - 1);
+      break;
+    }
+    if (c == '\\') {
+      // only escaped punctuation is a literal in an ERE
+      if (i + 1 >= pattern.length() || !ispunct(pattern[i+1]))
+	break;
+      prefix += pattern[++i];
+      continue;
+    }
+    if (strchr(".[]()+^$", c))
+      break;
+    prefix += c;
+  }
+  return prefix;
+}
+
 // These function comes basically from ser's uac module 
 void cvt_hex(HASH bin, HASHHEX hex)
 {
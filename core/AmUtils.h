@@ -271,11 +271,13 @@ size_t skip_to_end_of_brackets(const string& s, size_t start);
 typedef std::vector<std::pair<regex_t, string> > RegexMappingVector;
 
 /** read a regex=>string mapping from file
+    @param patterns if set, the regex strings are added to it
     @return true on success
  */
 bool read_regex_mapping(const string& fname, const char* sep,
 			const char* dbg_type,
-			RegexMappingVector& result);
+			RegexMappingVector& result,
+			std::vector<string>* patterns = NULL);
 
 /** run a regex mapping - result is the first matching entry 
     @return true if matched
@@ -283,6 +285,63 @@ bool read_regex_mapping(const string& fname, const char* sep,
 bool run_regex_mapping(const RegexMappingVector& mapping, const char* test_s,
 		       string& result);
 
+/**
+ * \brief regex=>string mapping with a prefix index
+ *
+ * Regexes which start with '^' and a literal (e.g. ^\+4930 in a
+ * routing table) are indexed by that literal in a prefix tree, so
+ * that a lookup only runs the regexes whose literal prefixes the
+ * string, and the ones without such a prefix. These are tried in
+ * the order of the mapping, so the result is the same as with
+ * run_regex_mapping (first match).
+ */
+class RegexMapping
+{
+  RegexMappingVector entries;
+
+  struct Node {
+    std::map<char, unsigned int> next;
+    /** entries with the prefix ending here, in mapping order */
+    std::vector<unsigned int> entries;
+  };
+  /** prefix tree, [0] is the root */
+  std::vector<Node> nodes;
+  /** entries without literal prefix, in mapping order */
+  std::vector<unsigned int> unindexed;
+
+  void index(unsigned int entry, const string& pattern);
+
+  // not copyable (owns the compiled regexes)
+  RegexMapping(const RegexMapping&);
+  const RegexMapping& operator=(const RegexMapping&);
+
+public:
+  RegexMapping();
+  ~RegexMapping();
+
+  /** read a regex=>string mapping from file, see read_regex_mapping */
+  bool read(const string& fname, const char* sep, const char* dbg_type);
+
+  /** add an entry (REG_EXTENDED) @return false if regex is invalid */
+  bool add(const string& pattern, const string& value);
+
+  /** remove all entries */
+  void clear();
+
+  /** @return true if matched, result is set from the first matching entry */
+  bool run(const char* test_s, string& result) const;
+
+  size_t size() const { return entries.size(); }
+  /** @return number of entries in the prefix tree */
+  size_t indexed() const { return entries.size() - unindexed.size(); }
+
+  /**
+   * @return literal every string matching 'pattern' (an ERE)
+   *         starts with, or "" if not anchored or not known
+   */
+  static string anchoredPrefix(const string& pattern);
+};
+
 
 /** convert a binary MD5 hash to hex representation */
 void cvt_hex(HASH bin, HASHHEX hex);
@@ -47,6 +47,7 @@
 #include "sip/udp_trsp.h"
 #include "sip/ip_util.h"
 #include "sip/tcp_trsp.h"
+#include "sip/trans_pacer.h"
 
 #include "log.h"
 
@@ -61,6 +62,37 @@
 bool _SipCtrlInterface::log_parsed_messages = true;
 int _SipCtrlInterface::udp_rcvbuf = -1;
 
+/** assign a cstring to an STL string without a temporary copy */
+static inline void c2stlstr_assign(string& dst, const cstring& src)
+{
+    dst.assign(src.s, src.len);
+}
+
+/** append 'name: value\r\n' of a parsed header to an STL string */
+static inline void append_hdr(string& dst, const sip_header* h)
+{
+    dst.append(h->name.s, h->name.len);
+    dst.append(": ", 2);
+    dst.append(h->value.s, h->value.len);
+    dst.append(CRLF, 2);
+}
+
+/**
+ * Pre-compute the size needed for all headers of the given types,
+ * so that the target string is allocated only once.
+ */
+static inline size_t hdrs_len(const list<sip_header*>& hdrs,
+			      int type1, int type2)
+{
+    size_t len = 0;
+    for (list<sip_header*>::const_iterator it = hdrs.begin();
+	 it != hdrs.end(); ++it) {
+	if(((*it)->type == type1) || ((*it)->type == type2))
+	    len += (*it)->name.len + (*it)->value.len + 4 /* ': ' + CRLF */;
+    }
+    return len;
+}
+
 int _SipCtrlInterface::alloc_udp_structs()
 {
     udp_sockets = new udp_trsp_socket*[ AmConfig::SIP_Ifs.size() ];
@@ -137,6 +169,7 @@ int _SipCtrlInterface::init_tcp_servers(int if_num)
 
     tcp_socket->set_connect_timeout(AmConfig::SIP_Ifs[if_num].tcp_connect_timeout);
     tcp_socket->set_idle_timeout(AmConfig::SIP_Ifs[if_num].tcp_idle_timeout);
+    tcp_socket->set_max_send_queue(AmConfig::SIP_Ifs[if_num].tcp_max_send_queue);
 
     if(tcp_socket->bind(AmConfig::SIP_Ifs[if_num].LocalIP,
 			AmConfig::SIP_Ifs[if_num].LocalPort) < 0){
@@ -150,7 +183,8 @@ int _SipCtrlInterface::init_tcp_servers(int if_num)
     }
 
     //TODO: add some more threads
-    tcp_socket->add_threads(AmConfig::SIPServerThreads);
+    tcp_socket->add_threads(AmConfig::SIPServerThreads,
+			    &AmConfig::SIPServerCpus);
 
     trans_layer::instance()->register_transport(tcp_socket);
     tcp_sockets[if_num] = tcp_socket;
@@ -174,6 +208,8 @@ int _SipCtrlInterface::load()
 	}
     }
 
+    unsigned int trans_table_power = H_TABLE_POWER;
+
     AmConfigReader cfg;
     string cfgfile = AmConfig::ConfigurationFile.c_str();
     if (file_exists(cfgfile) && !cfg.loadFile(cfgfile)) {
@@ -218,10 +254,43 @@ int _SipCtrlInterface::load()
 	    DBG("udp_rcvbuf = %d\n", udp_rcvbuf);
 	}
 
+	if (cfg.hasParameter("trans_table_size")) {
+	    unsigned int table_size = 0;
+	    if (str2i(cfg.getParameter("trans_table_size"), table_size) ||
+		!table_size) {
+		ERROR("invalid value specified for trans_table_size\n");
+		return -1;
+	    }
+
+	    // round up to the next power of 2
+	    trans_table_power = 1;
+	    while ((trans_table_power < H_TABLE_MAX_POWER) &&
+		   ((1U << trans_table_power) < table_size))
+		trans_table_power++;
+	}
+	DBG("trans_table_size = %u\n", 1U << trans_table_power);
+
+	trans_pacer::instance()->
+	    set_max_rate(cfg.getParameterInt("retr_rate_limit", 0));
+	trans_pacer::instance()->
+	    set_max_dest_rate(cfg.getParameterInt("retr_rate_limit_per_dest", 0));
+	trans_pacer::instance()->
+	    set_jitter(cfg.getParameterInt("retr_jitter", 0));
+	DBG("retr_rate_limit = %u, retr_rate_limit_per_dest = %u, "
+	    "retr_jitter = %u%%\n",
+	    cfg.getParameterInt("retr_rate_limit", 0),
+	    cfg.getParameterInt("retr_rate_limit_per_dest", 0),
+	    cfg.getParameterInt("retr_jitter", 0));
+
     } else {
 	DBG("assuming SIP default settings.\n");
     }
 
+    // before any transport may touch the transaction table
+    if (init_trans_table(trans_table_power) < 0) {
+	return -1;
+    }
+
     if(alloc_udp_structs() < 0) {
 	ERROR("no enough memory to alloc UDP structs");
 	return -1;
@@ -383,12 +452,14 @@ int _SipCtrlInterface::run()
 
     if (NULL != udp_servers) {
 	for(int i=0; i<nr_udp_servers;i++){
+	    udp_servers[i]->setCpuSet(&AmConfig::SIPServerCpus);
 	    udp_servers[i]->start();
 	}
     }
 
     if (NULL != tcp_servers) {
 	for(int i=0; i<nr_tcp_servers;i++){
+	    tcp_servers[i]->setCpuSet(&AmConfig::SIPServerCpus);
 	    tcp_servers[i]->start();
 	}
     }
@@ -517,10 +588,10 @@ inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg,
     assert(msg->from && msg->from->p);
     assert(msg->to && msg->to->p);
     
-    req.method   = c2stlstr(msg->u.request->method_str);
-    req.user     = c2stlstr(msg->u.request->ruri.user);
-    req.domain   = c2stlstr(msg->u.request->ruri.host);
-    req.r_uri    = c2stlstr(msg->u.request->ruri_str);
+    c2stlstr_assign(req.method, msg->u.request->method_str);
+    c2stlstr_assign(req.user,   msg->u.request->ruri.user);
+    c2stlstr_assign(req.domain, msg->u.request->ruri.host);
+    c2stlstr_assign(req.r_uri,  msg->u.request->ruri_str);
     req.tt       = tt;
 
     if(get_contact(msg) && get_contact(msg)->value.len){
@@ -550,15 +621,16 @@ inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg,
 		return false;
 	    }
 
-	    req.from_uri = c2stlstr(na.addr);
+	    c2stlstr_assign(req.from_uri, na.addr);
 	}
 
 	list<sip_header*>::const_iterator c_it = msg->contacts.begin();
-	req.contact = c2stlstr((*c_it)->value);
+	c2stlstr_assign(req.contact, (*c_it)->value);
 	++c_it;
 
 	for(;c_it!=msg->contacts.end(); ++c_it){
-	    req.contact += ", " + c2stlstr((*c_it)->value);
+	    req.contact.append(", ", 2);
+	    req.contact.append((*c_it)->value.s, (*c_it)->value.len);
 	}
     }
     else {
@@ -571,27 +643,32 @@ inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg,
 	}
     }
     
+    const sip_nameaddr& from_na = get_from(msg)->nameaddr;
     if(req.from_uri.empty()) {
-	req.from_uri = c2stlstr(get_from(msg)->nameaddr.addr);
+	c2stlstr_assign(req.from_uri, from_na.addr);
     }
 
-    if(get_from(msg)->nameaddr.name.len){
-	req.from += c2stlstr(get_from(msg)->nameaddr.name) + ' ';
+    req.from.reserve(from_na.name.len + from_na.addr.len + 3);
+    if(from_na.name.len){
+	req.from.append(from_na.name.s, from_na.name.len);
+	req.from += ' ';
     }
 
-    req.from += '<' + c2stlstr(get_from(msg)->nameaddr.addr) + '>';
+    req.from += '<';
+    req.from.append(from_na.addr.s, from_na.addr.len);
+    req.from += '>';
 
-    req.to       = c2stlstr(msg->to->value);
-    req.callid   = c2stlstr(msg->callid->value);
-    req.from_tag = c2stlstr(((sip_from_to*)msg->from->p)->tag);
-    req.to_tag   = c2stlstr(((sip_from_to*)msg->to->p)->tag);
+    c2stlstr_assign(req.to,       msg->to->value);
+    c2stlstr_assign(req.callid,   msg->callid->value);
+    c2stlstr_assign(req.from_tag, ((sip_from_to*)msg->from->p)->tag);
+    c2stlstr_assign(req.to_tag,   ((sip_from_to*)msg->to->p)->tag);
     req.cseq     = get_cseq(msg)->num;
-    req.cseq_method = c2stlstr(get_cseq(msg)->method_str);
-    req.via_branch = c2stlstr(msg->via_p1->branch);
+    c2stlstr_assign(req.cseq_method, get_cseq(msg)->method_str);
+    c2stlstr_assign(req.via_branch,  msg->via_p1->branch);
 
     if (msg->rack) {
         req.rseq = get_rack(msg)->rseq;
-	req.rack_method = c2stlstr(get_rack(msg)->method_str);
+	c2stlstr_assign(req.rack_method, get_rack(msg)->method_str);
 	req.rack_cseq = get_rack(msg)->cseq;
     }
 
@@ -609,19 +686,22 @@ inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg,
     }
 
     prepare_routes_uas(msg->record_route, req.route);
-	
+
+    req.hdrs.reserve(hdrs_len(msg->hdrs, sip_header::H_OTHER,
+			      sip_header::H_REQUIRE));
+    req.vias.reserve(hdrs_len(msg->hdrs, sip_header::H_VIA,
+			      sip_header::H_VIA));
+
     for (list<sip_header *>::const_iterator it = msg->hdrs.begin(); 
 	 it != msg->hdrs.end(); ++it) {
 
 	switch((*it)->type) {
 	case sip_header::H_OTHER:
 	case sip_header::H_REQUIRE:
-	    req.hdrs += c2stlstr((*it)->name) + ": " 
-		+ c2stlstr((*it)->value) + CRLF;
+	    append_hdr(req.hdrs, *it);
 	    break;
 	case sip_header::H_VIA:
-	    req.vias += c2stlstr((*it)->name) + ": " 
-		+ c2stlstr((*it)->value) + CRLF;
+	    append_hdr(req.vias, *it);
 	    break;
 	case sip_header::H_MAX_FORWARDS:
 	    if(!str2int(c2stlstr((*it)->value),req.max_forwards) ||
@@ -647,7 +727,7 @@ inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg,
     req.trsp = msg->local_socket->get_transport();
     req.local_if = msg->local_socket->get_if();
 
-    req.via1 = c2stlstr(msg->via1->value);
+    c2stlstr_assign(req.via1, msg->via1->value);
     if(msg->vias.size() > 1) {
 	req.first_hop = false;
     } 
@@ -676,10 +756,10 @@ inline bool _SipCtrlInterface::sip_msg2am_reply(sip_msg *msg, AmSipReply &reply)
     }
 
     reply.cseq = get_cseq(msg)->num;
-    reply.cseq_method = c2stlstr(get_cseq(msg)->method_str);
+    c2stlstr_assign(reply.cseq_method, get_cseq(msg)->method_str);
 
     reply.code   = msg->u.reply->code;
-    reply.reason = c2stlstr(msg->u.reply->reason);
+    c2stlstr_assign(reply.reason, msg->u.reply->reason);
 
     if(get_contact(msg) && get_contact(msg)->value.len){
 
@@ -692,26 +772,30 @@ inline bool _SipCtrlInterface::sip_msg2am_reply(sip_msg *msg, AmSipReply &reply)
 		  contact.len,contact.s);
 	}
 	else {
-	    reply.to_uri = c2stlstr(na.addr);
+	    c2stlstr_assign(reply.to_uri, na.addr);
 	}
 
 	list<sip_header*>::iterator c_it = msg->contacts.begin();
-	reply.contact = c2stlstr((*c_it)->value);
+	c2stlstr_assign(reply.contact, (*c_it)->value);
 	++c_it;
 
 	for(;c_it!=msg->contacts.end(); ++c_it){
-	    reply.contact += "," + c2stlstr((*c_it)->value);
+	    reply.contact += ',';
+	    reply.contact.append((*c_it)->value.s, (*c_it)->value.len);
 	}
     }
 
-    reply.callid = c2stlstr(msg->callid->value);
+    c2stlstr_assign(reply.callid, msg->callid->value);
     
-    reply.to_tag = c2stlstr(((sip_from_to*)msg->to->p)->tag);
-    reply.from_tag  = c2stlstr(((sip_from_to*)msg->from->p)->tag);
+    c2stlstr_assign(reply.to_tag,   ((sip_from_to*)msg->to->p)->tag);
+    c2stlstr_assign(reply.from_tag, ((sip_from_to*)msg->from->p)->tag);
 
 
     prepare_routes_uac(msg->record_route, reply.route);
 
+    reply.hdrs.reserve(hdrs_len(msg->hdrs, sip_header::H_OTHER,
+				sip_header::H_REQUIRE));
+
     unsigned rseq;
     for (list<sip_header*>::iterator it = msg->hdrs.begin(); 
 	 it != msg->hdrs.end(); ++it) {
@@ -721,8 +805,7 @@ inline bool _SipCtrlInterface::sip_msg2am_reply(sip_msg *msg, AmSipReply &reply)
         switch ((*it)->type) {
           case sip_header::H_OTHER:
           case sip_header::H_REQUIRE:
-	      reply.hdrs += c2stlstr((*it)->name) + ": " 
-                  + c2stlstr((*it)->value) + CRLF;
+	      append_hdr(reply.hdrs, *it);
               break;
           case sip_header::H_RSEQ:
               if (! parse_rseq(&rseq, (*it)->value.s, (*it)->value.len)) {
@@ -907,7 +990,7 @@ void _SipCtrlInterface::prepare_routes_uac(const list<sip_header*>& routes, stri
     sip_route* route = (sip_route*)(*it_rh)->p;
 
     list<route_elmt*>::const_reverse_iterator it_re = route->elmts.rbegin();
-    route_field = c2stlstr((*it_re)->route);
+    c2stlstr_assign(route_field, (*it_re)->route);
     
     while(true) {
 	
@@ -928,7 +1011,8 @@ void _SipCtrlInterface::prepare_routes_uac(const list<sip_header*>& routes, stri
 	    it_re = route->elmts.rbegin();
 	}
 	
-	route_field += ", " + c2stlstr((*it_re)->route);
+	route_field.append(", ", 2);
+	route_field.append((*it_re)->route.s, (*it_re)->route.len);
     }
 
 }
@@ -939,12 +1023,13 @@ void _SipCtrlInterface::prepare_routes_uas(const list<sip_header*>& routes, stri
 	
 	list<sip_header*>::const_iterator it = routes.begin();
 
-	route_field = c2stlstr((*it)->value);
+	c2stlstr_assign(route_field, (*it)->value);
 	++it;
 
 	for(; it != routes.end(); ++it) {
 		
-	    route_field += ", " + c2stlstr((*it)->value);
+	    route_field.append(", ", 2);
+	    route_field.append((*it)->value.s, (*it)->value.len);
 	}
     }
 }
@@ -248,6 +248,29 @@ loglevel=2
 # Example:
 # syslog_facility=LOCAL0
 
+# optional parameter: log_async=[yes|no]
+#
+# - if set to yes, log messages are queued and written to syslog
+#   (and other logging modules) by a background thread, so that
+#   the threads processing calls do not wait for the log.
+#   If the queue is full, messages are dropped (and counted, see
+#   the stats module's 'get_logstats' command). stderr output
+#   (-E) is still written directly.
+#
+# Default: no
+#
+# log_async=yes
+
+# optional parameter: log_async_queue_size=<num_value>
+#
+# - number of log messages that can be queued with log_async=yes
+#   (rounded up to a power of 2). Each queued message takes about
+#   4kB of memory.
+#
+# Default: 1024
+#
+# log_async_queue_size=4096
+
 # optional parameter: log_sessions=[yes|no]
 # 
 # Default: no
@@ -275,7 +298,14 @@ loglevel=2
 # - controls how many threads should be created that
 #   process the application logic and in-dialog signaling. 
 #   This is only available if compiled with threadpool support!
-#   (set USE_THREADPOOL in Makefile.defs)
+#   (set USE_THREADPOOL in Makefile.defs, or SEMS_USE_THREADPOOL
+#    with cmake)
+#   Plug-ins which block in session context (ivr, py_sems,
+#   conference, early_announce and voicemail with MySQL, the
+#   DSM modules mod_mysql, mod_redis, mod_curl, mod_py, mod_aws
+#   and mod_sys, and the SBC call control modules cc_bl_redis,
+#   cc_rest and cc_prepaid_xmlrpc) can not be used with the
+#   thread pool, SEMS refuses to start if they are loaded.
 #   Defaults to 10
 #
 # session_processor_threads=50
@@ -289,6 +319,35 @@ loglevel=2
 #
 # media_processor_threads=1
 
+# optional parameter: async_job_threads=<num_value>
+#
+# - controls how many threads should be created that
+#   execute blocking application jobs (e.g. DSM's
+#   sys.popenAsync) without stalling the calls' signaling.
+#   Default: 4
+#
+# async_job_threads=4
+
+# optional parameter: session_cleaner_threads=<num_value>
+#
+# - number of threads destroying the sessions of ended calls.
+#   Ended sessions are spread over the threads, so that many
+#   calls ending at once (e.g. a trunk failure) are cleaned up
+#   in parallel.
+#   Default: 2
+#
+# session_cleaner_threads=4
+
+# optional parameter: event_dispatcher_shards=<num_value>
+#
+# - number of independently locked parts of the table which
+#   maps session tags to event queues. Rounded up to a power
+#   of 2 (max. 65536). Raise it if many threads post events
+#   to sessions concurrently.
+#   Default: 1024
+#
+# event_dispatcher_shards=4096
+
 
 # optional parameter: session_limit=<limit>;<err code>;<err reason>
 # 
@@ -337,6 +396,42 @@ loglevel=2
 #    # RTP timeout after 10 seconds
 #    dead_rtp_time=10  
 
+# optional parameter: rtp_buffer_pool_size=<unsigned int>
+#
+# - number of RTP receive buffers (about 130kB each, one per
+#   RTP stream) which are kept after a call has ended, and
+#   reused for new calls instead of being freed and allocated
+#   again. Set it to about the number of streams started in a
+#   few seconds at peak CPS; the pooled buffers stay allocated.
+#   The stats module's 'get_rtpbufpool' command shows how
+#   many buffers were reused.
+#
+#   default=0 (no pool)
+#
+# Example:
+#    rtp_buffer_pool_size=200
+
+# optional parameter: rtp_relay_offload={yes|no}
+#
+# - relay RTP of relayed calls (e.g. sbc with RTP relay) in the
+#   kernel: a small XDP program is attached to the RTP interfaces,
+#   and a stream is handed to it once packets have been relayed
+#   and nothing needs to be done in userspace. Packets of other
+#   payload types (e.g. DTMF), RTCP and IPv6 are still relayed by
+#   SEMS, so are streams with transcoding, DTMF detection/filtering,
+#   RTP renumbering (set rtp_relay_transparent_seqno in sbc),
+#   RTP rate limits, measurements or message logging.
+#   Needs Linux >= 5.18 and CAP_BPF/CAP_NET_ADMIN (or root); if
+#   loading the program fails, RTP is relayed in userspace.
+#   Note that RTP relayed in the kernel bypasses netfilter on the
+#   way in. The stats module's 'get_rtpoffload' command shows
+#   counters.
+#
+#   default=no
+#
+# Example:
+#    rtp_relay_offload=yes
+
 # optional parameter: use_default_signature={yes|no}
 #
 # - use a Server/User-Agent header with the SEMS server 
@@ -463,8 +558,54 @@ use_default_signature=yes
 #
 # udp_rcvbuf = <value>
 
+# Number of buckets in the SIP transaction table
+#
+# Rounded up to the next power of 2 (max. 2^24). Raise it if
+# many transactions are active at the same time (e.g. REGISTER
+# or OPTIONS storms), to keep the per-bucket lists short. The
+# occupancy can be checked with the stats module's
+# 'get_transstats' command.
+#
+# Default: 1024
+#
+# trans_table_size=65536
+
+# Pacing of non-INVITE request retransmissions (e.g. mass OPTIONS
+# or NOTIFY). Retransmissions above the global or per-destination
+# rate (per second) are postponed to a random point in the next
+# second. retr_jitter adds up to the given percentage of random
+# delay to every retransmission interval, so that requests sent in
+# the same burst do not retransmit in lockstep.
+# Counters: stats module command 'get_pacingstats'.
+#
+# Default: 0 (off)
+#
+# retr_rate_limit=2000
+# retr_rate_limit_per_dest=200
+# retr_jitter=20
+
 # Number of SIP UDP receiver threads
 #
 # Default: 4
 #
 # sip_server_threads=8
+
+# CPU placement of the worker pools: session_processor_cpus,
+# media_processor_cpus, rtp_receiver_cpus and sip_server_cpus
+# bind the threads of the pool to a list of CPUs. Items are CPU
+# numbers, ranges and NUMA nodes ('nodeN': all CPUs of node N),
+# e.g. '0-3,8' or 'node1'. The threads of a pool float within
+# the set.
+#
+# Memory a thread touches first is allocated on its own NUMA
+# node, so binding related pools to the same node keeps their
+# buffers local: RTP receivers and media processors share the
+# media buffers, and the RTP receive buffers are allocated by the
+# thread creating the session (the SIP server thread for incoming
+# calls). rtp_receiver_cpus defaults to media_processor_cpus.
+#
+# Default: empty (no binding)
+#
+# media_processor_cpus=node0
+# sip_server_cpus=node0
+# session_processor_cpus=node1
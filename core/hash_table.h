@@ -87,6 +87,13 @@ public:
 	return id;
     }
 
+    /**
+     * Returns the number of values in this bucket.
+     */
+    size_t size() const {
+	return elmts.size();
+    }
+
     // debug method
     void dump() const {
 
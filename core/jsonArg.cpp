@@ -39,6 +39,8 @@ using namespace jsonxx;
 
 const char *hex_chars = "0123456789abcdef";
 
+static void str2json_append(const char* str, size_t len, string& result);
+
 string str2json(const char* str)
 {
   return str2json(str,strlen(str));
@@ -50,17 +52,28 @@ string str2json(const string& str)
 }
 
 string str2json(const char* str, size_t len)
+{
+  string result;
+  str2json_append(str, len, result);
+  return result;
+}
+
+/** append str as JSON string to result */
+static void str2json_append(const char* str, size_t len, string& result)
 {
     // borrowed from jsoncpp
     // Not sure how to handle unicode...
-    if (strpbrk(str, "\"\\\b\f\n\r\t") == NULL)
-      return string("\"") + str + "\"";
+    if (strpbrk(str, "\"\\\b\f\n\r\t") == NULL) {
+      result += '"';
+      result += str;
+      result += '"';
+      return;
+    }
     // We have to walk value and escape any special characters.
     // Appending to std::string is not efficient, but this should be rare.
     // (Note: forward slashes are *not* rare, but I am not escaping them.)
     unsigned maxsize = len*2 + 3; // allescaped+quotes+NULL
-    std::string result;
-    result.reserve(maxsize); // to avoid lots of mallocs
+    result.reserve(result.size() + maxsize); // to avoid lots of mallocs
     result += "\"";
     const char* end = str + len;
     for (const char* c = str; (c != end) && (*c != 0); ++c){
@@ -99,57 +112,75 @@ string str2json(const char* str, size_t len)
       }
     }
     result += "\"";
-    return result;
 }
 
-string arg2json(const AmArg &a) {
-  // TODO: optimize to avoid lots of mallocs
+/** append a as JSON to s: the whole value is built in one string */
+static void arg2json_append(const AmArg &a, string& s) {
   // TODO: how to get a bool? 
-  string s;
+  size_t start;
   switch (a.getType()) {
   case AmArg::Undef:
-    return "null";
+    s += "null";
+    return;
 
   case AmArg::Int:
-    return a.asInt()<0?"-"+int2str(abs(a.asInt())):int2str(abs(a.asInt()));
+    s += a.asInt()<0?"-"+int2str(abs(a.asInt())):int2str(abs(a.asInt()));
+    return;
 
   case AmArg::LongLong:
-    return longlong2str(a.asLongLong());
+    s += longlong2str(a.asLongLong());
+    return;
 
   case AmArg::Bool:
-    return a.asBool()?"true":"false";
+    s += a.asBool()?"true":"false";
+    return;
 
   case AmArg::Double: 
-    return double2str(a.asDouble());
+    s += double2str(a.asDouble());
+    return;
 
-  case AmArg::CStr:
-    return str2json(a.asCStr());
+  case AmArg::CStr: {
+    const char* str = a.asCStr();
+    str2json_append(str, strlen(str), s);
+  } return;
 
   case AmArg::Array:
-    s = "[";
-    for (size_t i = 0; i < a.size(); i ++)
-      s += arg2json(a[i]) + ", ";
-    if (1 < s.size()) 
+    start = s.size();
+    s += "[";
+    for (size_t i = 0; i < a.size(); i ++) {
+      arg2json_append(a[i], s);
+      s += ", ";
+    }
+    if (start + 1 < s.size())
       s.resize(s.size() - 2); // strip last ", "
     s += "]";
-    return s;
+    return;
 
   case AmArg::Struct:
-    s = "{";
+    start = s.size();
+    s += "{";
     for (AmArg::ValueStruct::const_iterator it = a.asStruct()->begin();
 	 it != a.asStruct()->end(); it ++) {
-      s += '"'+it->first + "\": ";
-      s += arg2json(it->second);
+      s += '"';
+      s += it->first;
+      s += "\": ";
+      arg2json_append(it->second, s);
       s += ", ";
     }
-    if (1 < s.size())
+    if (start + 1 < s.size())
       s.resize(s.size() - 2); // strip last ", "
     s += "}";
-    return s;
+    return;
   default: break;
   }
 
-  return "{}";
+  s += "{}";
+}
+
+string arg2json(const AmArg &a) {
+  string s;
+  arg2json_append(a, s);
+  return s;
 }
 
 // based on jsonxx
@@ -206,7 +237,7 @@ bool object_parse(std::istream& input, AmArg& res) {
       res.clear();
       return false;
     }
-    res[key] = AmArg(); // using the reference
+    // parse into the member (json2arg clears it)
     if (!json2arg(input, res[key])) {
       res.clear();
       return false;
@@ -237,7 +268,7 @@ bool json2arg(std::istream& input, AmArg& res) {
 
   std::string string_value;
   if (parse_string(input, &string_value)) {
-    res = string_value; // todo: unnecessary value copy here
+    res = string_value;
     return true;
   }
 
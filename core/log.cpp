@@ -28,6 +28,7 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <string.h>
 #include "sems.h"
 
 #ifndef DISABLE_SYSLOG_LOG
@@ -39,6 +40,7 @@
 
 #include "AmApi.h"	/* AmLoggingFacility */
 #include "AmThread.h"   /* AmMutex */
+#include "AmBoundedQueue.h"
 #include "log.h"
 
 
@@ -52,6 +54,119 @@ const char* log_level2str[] = { "ERROR", "WARNING", "INFO", "DEBUG" };
 static vector<AmLoggingFacility*> log_hooks;
 static AmMutex log_hooks_mutex;
 
+static void run_log_hooks_sync(int level, pid_t pid, pthread_t tid,
+			       const char* func, const char* file,
+			       int line, char* msg);
+
+/** poll interval of the async log writer when idle */
+#define ASYNC_LOG_IDLE_US 5000
+#define ASYNC_LOG_NAME_LEN 64
+
+/** records dropped by all async log writers (queue full) */
+static volatile unsigned long async_log_dropped = 0;
+
+/**
+ * Async log writer: a bounded lock-free queue of pre-formatted
+ * records, written out to the log hooks by one background thread.
+ * Producers never block: if the queue is full, the record is
+ * dropped and counted.
+ */
+class AsyncLogWriter : public AmThread
+{
+  struct Record {
+    int       level;
+    pid_t     pid;
+    pthread_t tid;
+    int       line;
+    // copies: the strings may belong to a plug-in which is
+    // unloaded before the record is written
+    char      func[ASYNC_LOG_NAME_LEN];
+    char      file[ASYNC_LOG_NAME_LEN];
+    char      msg[LOG_BUFFER_LEN];
+  };
+
+  AmBoundedQueue<Record> queue;
+  unsigned long          reported_dropped;
+
+  AmSharedVar<bool>      stop_requested;
+
+  static void copy_str(char* dst, const char* src, size_t len) {
+    if (!src) src = "";
+    strncpy(dst, src, len - 1);
+    dst[len - 1] = '\0';
+  }
+
+  /** write out queued records, returns the number written */
+  unsigned int drain() {
+    unsigned int n = 0;
+    while (Record* r = queue.front()) {
+      run_log_hooks_sync(r->level, r->pid, r->tid,
+			 r->func, r->file, r->line, r->msg);
+      queue.pop();
+      n++;
+    }
+
+    unsigned long d = async_log_dropped;
+    if (d != reported_dropped) {
+      char msg[128];
+      snprintf(msg, sizeof(msg), "%lu log messages dropped (queue full)",
+	       d - reported_dropped);
+      reported_dropped = d;
+      run_log_hooks_sync(L_WARN, GET_PID(), GET_TID(), __FUNCTION__,
+			 __FILE__, __LINE__, msg);
+    }
+
+    return n;
+  }
+
+ protected:
+  void run() {
+    while (!stop_requested.get()) {
+      if (!drain())
+	usleep(ASYNC_LOG_IDLE_US);
+    }
+    drain();
+  }
+
+  void on_stop() {
+    stop_requested.set(true);
+  }
+
+ public:
+  AsyncLogWriter(unsigned int queue_size)
+    : queue(queue_size), reported_dropped(async_log_dropped),
+      stop_requested(false)
+  {
+  }
+
+  bool push(int level, pid_t pid, pthread_t tid, const char* func,
+	    const char* file, int line, const char* msg) {
+    unsigned long pos;
+    Record* r = queue.begin_push(pos);
+    if (!r) {
+      // full
+      __sync_add_and_fetch(&async_log_dropped, 1);
+      return false;
+    }
+
+    r->level = level;
+    r->pid = pid;
+    r->tid = tid;
+    r->line = line;
+    copy_str(r->func, func, sizeof(r->func));
+    copy_str(r->file, file, sizeof(r->file));
+    copy_str(r->msg, msg, sizeof(r->msg));
+
+    queue.end_push(pos);
+    return true;
+  }
+};
+
+/** set while the async log writer is running */
+static AsyncLogWriter* volatile async_log = NULL;
+/** producers which may still use async_log */
+static volatile int async_log_users = 0;
+
 #ifndef DISABLE_SYSLOG_LOG
 
 /**
@@ -184,6 +299,23 @@ void init_logging()
  * Run log hooks
  */
 void run_log_hooks(int level, pid_t pid, pthread_t tid, const char* func, const char* file, int line, char* msg)
+{
+  if (async_log) {
+    // stop_async_logging() waits for us before the last drain
+    __sync_add_and_fetch(&async_log_users, 1);
+    AsyncLogWriter* al = async_log;
+    if (al) {
+      al->push(level, pid, tid, func, file, line, msg);
+      __sync_sub_and_fetch(&async_log_users, 1);
+      return;
+    }
+    __sync_sub_and_fetch(&async_log_users, 1);
+  }
+
+  run_log_hooks_sync(level, pid, tid, func, file, line, msg);
+}
+
+static void run_log_hooks_sync(int level, pid_t pid, pthread_t tid, const char* func, const char* file, int line, char* msg)
 {
   log_hooks_mutex.lock();
 
@@ -197,6 +329,47 @@ void run_log_hooks(int level, pid_t pid, pthread_t tid, const char* func, const
   log_hooks_mutex.unlock();
 }
 
+int start_async_logging(unsigned int queue_size)
+{
+  if (async_log) {
+    ERROR("async logging already started\n");
+    return -1;
+  }
+
+  AsyncLogWriter* al = new AsyncLogWriter(queue_size);
+  al->start();
+  async_log = al;
+
+  INFO("Async logging started (queue size %u)\n", queue_size);
+  return 0;
+}
+
+void stop_async_logging()
+{
+  AsyncLogWriter* al = async_log;
+  if (!al)
+    return;
+
+  async_log = NULL;
+  __sync_synchronize();
+
+  // records pushed after the last drain would be lost
+  while (async_log_users)
+    usleep(100);
+
+  // stop() detaches the thread: wait for the last records
+  al->stop();
+  while (!al->is_stopped())
+    usleep(1000);
+
+  delete al;
+}
+
+unsigned long get_async_log_dropped()
+{
+  return async_log_dropped;
+}
+
 /**
  * Register the log hook
  */
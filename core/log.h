@@ -174,6 +174,18 @@ extern const char* log_level2str[];
 void init_logging(void);
 void run_log_hooks(int, pid_t, pthread_t, const char*, const char*, int, char*);
 
+/**
+ * Hand log records to a background thread instead of running
+ * the log hooks in the caller's thread. Records which do not fit
+ * into the queue are dropped and counted.
+ * @param queue_size number of records (rounded up to a power of 2)
+ */
+int start_async_logging(unsigned int queue_size);
+/** stop the background thread after writing out all queued records */
+void stop_async_logging(void);
+/** number of log records dropped because the queue was full */
+unsigned long get_async_log_dropped(void);
+
 #ifndef DISABLE_SYSLOG_LOG
 int set_syslog_facility(const char*);
 #endif
@@ -37,11 +37,21 @@
 #include "AmApi.h"
 
 #include "sip/trans_table.h"
+#include "sip/trans_pacer.h"
+#include "sip/tcp_trsp.h"
+#include "AmAsyncJob.h"
+#include "AmRtpStream.h"
+#include "AmRtpRelayOffload.h"
+
+#ifdef SESSION_THREADPOOL
+#include "AmSessionProcessor.h"
+#endif
 
 #include <string>
 using std::string;
 
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <errno.h>
@@ -276,6 +286,30 @@ static int msg_get_param(char*& msg_c, string& p, char* line_buf, unsigned int s
   return 0;
 }
 
+/** read a 'Name:  value' line from /proc/self/status */
+static string proc_status_value(const char* name)
+{
+  FILE* f = fopen("/proc/self/status", "r");
+  if (!f)
+    return "n/a";
+
+  char line[256];
+  size_t name_len = strlen(name);
+  string res = "n/a";
+  while (fgets(line, sizeof(line), f)) {
+    if (!strncmp(line, name, name_len) && line[name_len] == ':') {
+      char* v = line + name_len + 1;
+      while (*v == ' ' || *v == '\t') v++;
+      res = v;
+      if (!res.empty() && res[res.length()-1] == '\n')
+	res.erase(res.length()-1);
+      break;
+    }
+  }
+  fclose(f);
+  return res;
+}
+
 int StatsUDPServer::execute(char* msg_buf, string& reply, 
 			    struct sockaddr_in& addr)
 {
@@ -302,6 +336,18 @@ int StatsUDPServer::execute(char* msg_buf, string& reply,
       "get_callsmax                       -  get maximum of active calls since the last query\n"
       "get_cpsavg                         -  get calls per second (5 sec average)\n"
       "get_cpsmax                         -  get maximum of CPS since the last query\n"
+      "get_transstats                     -  get transaction table occupancy\n"
+      "get_pacingstats                    -  get retransmission pacing counters\n"
+      "get_tcpstats                       -  get TCP transport counters\n"
+      "get_asyncjobstats                  -  get async job counters\n"
+      "get_logstats                       -  get number of dropped async log messages\n"
+      "get_cleanerstats                   -  get session cleanup and admission counters\n"
+      "get_rtpbufpool                     -  get RTP receive buffer pool counters\n"
+      "get_rtpoffload                     -  get in-kernel RTP relay counters\n"
+      "get_resources                      -  get process threads, memory and context switches\n"
+#ifdef SESSION_THREADPOOL
+      "get_schedstats                     -  get session processor scheduling latency\n"
+#endif
 
       "dump_transactions                  -  dump transaction table to log (loglevel debug)\n"
 
@@ -375,6 +421,103 @@ int StatsUDPServer::execute(char* msg_buf, string& reply,
     else if(cmd_str.substr(4, 8) == "cpslimit")
       reply = "CPS hard limit: " + int2str(sc->getCPSLimit().first) + ", CPS limit: " +
         int2str(sc->getCPSLimit().second) + "\n";
+    else if(cmd_str.substr(4, 10) == "transstats") {
+      trans_table_stats ts;
+      get_trans_table_stats(ts);
+      reply = "Transactions: " + long2str(ts.transactions) +
+	", buckets: " + long2str(ts.buckets) +
+	", used buckets: " + long2str(ts.used_buckets) +
+	", max bucket length: " + long2str(ts.max_bucket_len) + "\n";
+    }
+    else if(cmd_str.substr(4, 11) == "pacingstats") {
+      reply = "Paced retransmissions: " +
+	int2str(trans_pacer::instance()->get_paced_retrans()) +
+	", pending: " + int2str(trans_pacer::instance()->get_paced_pending()) +
+	", total delay (ms): " +
+	longlong2str(trans_pacer::instance()->get_pacing_delay()) + "\n";
+    }
+    else if(cmd_str.substr(4, 8) == "tcpstats") {
+      tcp_trsp_stats& ts = tcp_server_socket::get_stats();
+      reply = "TCP accepted connections: " +
+	int2str(ts.get_accepted_connections()) +
+	", received msgs: " + int2str(ts.get_received_msgs()) +
+	", sent msgs: " + int2str(ts.get_sent_msgs()) +
+	", write calls: " + int2str(ts.get_write_calls()) +
+	", queued bytes: " + int2str(ts.get_queued_bytes()) +
+	", send queue overflows: " + int2str(ts.get_send_q_overflows()) + "\n";
+    }
+    else if(cmd_str.substr(4, 13) == "asyncjobstats") {
+      reply = "Async jobs queued: " +
+	int2str(AmAsyncJobProcessor::instance()->getQueued()) +
+	", running: " + int2str(AmAsyncJobProcessor::instance()->getRunning()) +
+	", finished: " + int2str(AmAsyncJobProcessor::instance()->getFinished()) +
+	", undelivered: " +
+	int2str(AmAsyncJobProcessor::instance()->getUndelivered()) + "\n";
+    }
+    else if(cmd_str.substr(4, 12) == "cleanerstats") {
+      AmSessionContainer* sc = AmSessionContainer::instance();
+      unsigned long long reclaimed = sc->getReclaimedSessions();
+      unsigned long long reclaim_us = sc->getReclaimTime();
+      unsigned long long admissions = sc->getAdmissions();
+      unsigned long long admission_us = sc->getAdmissionTime();
+      reply = "Dead sessions pending: " + int2str(sc->getDeadSessions()) +
+	", destroyed: " + longlong2str(reclaimed) +
+	", destroy time: " +
+	longlong2str(reclaimed ? reclaim_us / reclaimed : 0) + "us avg" +
+	"; admissions: " + longlong2str(admissions) +
+	", admission time: " +
+	longlong2str(admissions ? admission_us / admissions : 0) + "us avg, " +
+	int2str(sc->getMaxAdmissionTime()) + "us max\n";
+    }
+    else if(cmd_str.substr(4, 10) == "rtpbufpool") {
+      reply = "RTP buffer pool size: " + int2str(PacketMemPool::getMaxSize()) +
+	", pooled: " + int2str(PacketMemPool::getPooled()) +
+	", reused: " + longlong2str(PacketMemPool::getReused()) +
+	", allocated: " + longlong2str(PacketMemPool::getAllocated()) + "\n";
+    }
+    else if(cmd_str.substr(4, 10) == "rtpoffload") {
+      if (!AmConfig::RtpRelayOffload) {
+	reply = "RTP relay offload disabled\n";
+      } else {
+	AmRtpRelayOffload* o = AmRtpRelayOffload::instance();
+	reply = "RTP relay offload active streams: " + int2str(o->getActiveRules()) +
+	  ", installed: " + longlong2str(o->getInstalled()) +
+	  ", removed: " + longlong2str(o->getRemoved()) +
+	  ", relayed (removed streams): " + longlong2str(o->getRelayedPackets()) +
+	  " packets, " + longlong2str(o->getRelayedBytes()) + " bytes\n";
+      }
+    }
+    else if(cmd_str.substr(4, 9) == "resources") {
+      struct rusage ru;
+      if (getrusage(RUSAGE_SELF, &ru)) {
+	reply = "getrusage failed: " + string(strerror(errno)) + "\n";
+      } else {
+	reply = "Active calls: " + int2str(AmSession::getSessionNum()) +
+	  ", threads: " + proc_status_value("Threads") +
+	  ", RSS: " + proc_status_value("VmRSS") +
+	  " (max " + longlong2str(ru.ru_maxrss) + " kB)" +
+	  ", context switches: " + longlong2str(ru.ru_nvcsw) + " voluntary, " +
+	  longlong2str(ru.ru_nivcsw) + " involuntary\n";
+      }
+    }
+    else if(cmd_str.substr(4, 8) == "logstats") {
+      reply = "Async log messages dropped: " +
+	longlong2str(get_async_log_dropped()) + "\n";
+    }
+#ifdef SESSION_THREADPOOL
+    else if(cmd_str.substr(4, 10) == "schedstats") {
+      reply = "Scheduling latency:";
+      for(unsigned int i=0; i<SCHED_LATENCY_BUCKETS; i++) {
+	if(AmSessionProcessor::sched_latency_bounds[i])
+	  reply += " <" + int2str(AmSessionProcessor::sched_latency_bounds[i]) + "us: ";
+	else
+	  reply += " more: ";
+	reply += int2str(AmSessionProcessor::getLatencyCount(i));
+	reply += (i + 1 < SCHED_LATENCY_BUCKETS) ? "," : "";
+      }
+      reply += "; steals: " + int2str(AmSessionProcessor::getSteals()) + "\n";
+    }
+#endif
 
     else if (cmd_str.substr(4, 12) == "shutdownmode") {
       if(AmConfig::ShutdownMode)
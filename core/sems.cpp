@@ -32,6 +32,7 @@
 #include "AmSessionContainer.h"
 #include "AmMediaProcessor.h"
 #include "AmRtpReceiver.h"
+#include "AmRtpRelayOffload.h"
 #include "AmEventDispatcher.h"
 #include "AmSessionProcessor.h"
 #include "AmAppTimer.h"
@@ -43,6 +44,7 @@
 #include "SipCtrlInterface.h"
 #include "sip/trans_table.h"
 #include "sip/async_file_writer.h"
+#include "AmAsyncJob.h"
 
 #include "log.h"
 
@@ -582,6 +584,11 @@ int main(int argc, char* argv[])
   }
 #endif
 
+  if(AmConfig::LogAsync) {
+    if(start_async_logging(AmConfig::LogAsyncQueueSize))
+      goto error;
+  }
+
   INFO("Starting application timer scheduler\n");
   AmAppTimer::instance()->start();
 
@@ -593,6 +600,9 @@ int main(int argc, char* argv[])
   AmSessionProcessor::addThreads(AmConfig::SessionProcessorThreads);
 #endif 
 
+  INFO("Starting async job threads\n");
+  AmAsyncJobProcessor::instance()->addThreads(AmConfig::AsyncJobThreads);
+
   INFO("Starting media processor\n");
   AmMediaProcessor::instance()->init();
 
@@ -606,6 +616,8 @@ int main(int argc, char* argv[])
   // start the asynchronous file writer (sorry, no better place...)
   async_file_writer::instance()->start();
 
+  PacketMemPool::setMaxSize(AmConfig::RtpBufferPoolSize);
+
   INFO("Starting RTP receiver\n");
   AmRtpReceiver::instance()->start();
 
@@ -641,6 +653,9 @@ int main(int argc, char* argv[])
   INFO("Disposing session container\n");
   AmSessionContainer::dispose();
 
+  INFO("Disposing async job threads\n");
+  AmAsyncJobProcessor::dispose();
+
   DBG("** Transaction table dump: **\n");
   dumps_transactions();
   DBG("*****************************\n");
@@ -648,6 +663,11 @@ int main(int argc, char* argv[])
   INFO("Disposing RTP receiver\n");
   AmRtpReceiver::dispose();
 
+  if (AmConfig::RtpRelayOffload) {
+    INFO("Disposing RTP relay offload\n");
+    AmRtpRelayOffload::dispose();
+  }
+
   INFO("Disposing media processor\n");
   AmMediaProcessor::dispose();
 
@@ -661,6 +681,8 @@ int main(int argc, char* argv[])
   async_file_writer::instance()->stop();
   async_file_writer::instance()->join();
 
+  stop_async_logging();
+
 #ifndef DISABLE_DAEMON_MODE
   if (AmConfig::DaemonMode) {
     unlink(AmConfig::DaemonPidFile.c_str());
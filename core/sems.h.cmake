@@ -65,6 +65,10 @@
 #define NUM_RTP_RECEIVERS 1
 // number of SIP servers to start
 #define NUM_SIP_SERVERS 4
+// threads to start for blocking application jobs
+#define NUM_ASYNC_JOB_THREADS 4
+// threads to destroy dead sessions
+#define NUM_SESSION_CLEANER_THREADS 2
 
 #define MAX_NET_DEVICES     32
 
@@ -33,6 +33,7 @@
 #include "wheeltimer.h"
 #include "trans_table.h"
 #include "trans_layer.h"
+#include "trans_pacer.h"
 #include "transport.h"
 #include "msg_logger.h"
 #include "ip_util.h"
@@ -74,7 +75,8 @@ sip_trans::sip_trans()
       retr_len(0),
       last_rseq(0),
       logger(NULL),
-      canceled(false)
+      canceled(false),
+      paced(false)
 {
     memset(timers,0,SIP_TRANS_TIMERS*sizeof(void*));
 }
@@ -82,6 +84,9 @@ sip_trans::sip_trans()
 sip_trans::~sip_trans() 
 {
     reset_all_timers();
+    if(paced) {
+	trans_pacer::instance()->dequeued();
+    }
     delete msg;
     delete targets;
     delete [] retr_buf;
@@ -159,6 +159,9 @@ class sip_trans
     /** request canceled? */
     bool canceled;
 
+    /** retransmission postponed by the pacer? */
+    bool paced;
+
     /**
      * Tells if a specific timer is set
      *
@@ -12,6 +12,9 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+
+tcp_trsp_stats tcp_server_socket::stats;
 
 
 void tcp_trsp_socket::on_sock_read(int fd, short ev, void* arg)
@@ -35,7 +38,7 @@ tcp_trsp_socket::tcp_trsp_socket(tcp_server_socket* server_sock,
   : trsp_socket(server_sock->get_if(),0,0,sd),
     server_sock(server_sock), server_worker(server_worker),
     closed(false), connected(false),
-    input_len(0), evbase(evbase),
+    input_len(0), evbase(evbase), send_q_bytes(0),
     read_ev(NULL), write_ev(NULL)
 {
   // local address
@@ -249,7 +252,17 @@ int tcp_trsp_socket::send(const sockaddr_storage* sa, const char* msg,
   if(closed || (check_connection() < 0))
     return -1;
 
+  unsigned int max_q = server_sock->get_max_send_queue();
+  if(max_q && (send_q_bytes + msg_len > max_q)) {
+    WARN("send queue to %s:%u full (%u bytes): dropping message",
+	 peer_ip.c_str(),peer_port,send_q_bytes);
+    tcp_server_socket::get_stats().inc_send_q_overflows();
+    return -1;
+  }
+
   send_q.push_back(new msg_buf(sa,msg,msg_len));
+  send_q_bytes += msg_len;
+  tcp_server_socket::get_stats().inc_queued_bytes(msg_len);
 
   if(connected) {
     add_write_event_ul();
@@ -284,10 +297,8 @@ void tcp_trsp_socket::generate_transport_errors()
   while(!send_q.empty()) {
 
     msg_buf* msg = send_q.front();
-    send_q.pop_front();
-
     sip_msg s_msg(msg->msg,msg->msg_len);
-    delete msg;
+    pop_send_q();
 
     copy_peer_addr(&s_msg.remote_ip);
     copy_addr_to(&s_msg.local_ip);
@@ -404,6 +415,8 @@ int tcp_trsp_socket::parse_input()
     s_msg->local_socket = this;
     inc_ref(this);
 
+    tcp_server_socket::get_stats().inc_received_msgs();
+
     // pass message to the parser / transaction layer
     trans_layer::instance()->received_msg(s_msg);
 
@@ -424,6 +437,18 @@ int tcp_trsp_socket::parse_input()
   //return 0;
 }
 
+void tcp_trsp_socket::pop_send_q()
+{
+  msg_buf* msg = send_q.front();
+  send_q.pop_front();
+
+  if(msg) {
+    send_q_bytes -= msg->msg_len;
+    tcp_server_socket::get_stats().dec_queued_bytes(msg->msg_len);
+    delete msg;
+  }
+}
+
 void tcp_trsp_socket::on_write(short ev)
 {
   AmLock _l(sock_mut);
@@ -437,17 +462,32 @@ void tcp_trsp_socket::on_write(short ev)
 
   while(!send_q.empty()) {
 
-    msg_buf* msg = send_q.front();
-    if(!msg || !msg->bytes_left()) {
-      send_q.pop_front();
-      delete msg;
-      continue;
+    // coalesce queued messages into one writev()
+    struct iovec iov[MAX_TCP_WRITEV_IOV];
+    int iov_cnt = 0;
+    for(deque<msg_buf*>::iterator it = send_q.begin();
+	(it != send_q.end()) && (iov_cnt < MAX_TCP_WRITEV_IOV); ++it) {
+
+      if(!*it || !(*it)->bytes_left())
+	continue;
+
+      iov[iov_cnt].iov_base = (*it)->cursor;
+      iov[iov_cnt].iov_len = (*it)->bytes_left();
+      iov_cnt++;
+    }
+
+    if(!iov_cnt) {
+      // only empty messages left
+      while(!send_q.empty())
+	pop_send_q();
+      break;
     }
 
-    // send msg
-    int bytes = write(sd,msg->cursor,msg->bytes_left());
+    // send msgs
+    ssize_t bytes = writev(sd,iov,iov_cnt);
+    tcp_server_socket::get_stats().inc_write_calls();
     if(bytes < 0) {
-      DBG("error on write: %i",bytes);
+      DBG("error on write: %i",(int)bytes);
       switch(errno){
       case EINTR:
       case EAGAIN: // would block
@@ -463,16 +503,35 @@ void tcp_trsp_socket::on_write(short ev)
       return;
     }
 
-    DBG("bytes written: <%.*s>",bytes,msg->cursor);
+    DBG("bytes written: %i (%i buffers)",(int)bytes,iov_cnt);
+
+    // consume what has been written
+    unsigned int sent_msgs = 0;
+    while(!send_q.empty()) {
+
+      msg_buf* msg = send_q.front();
+      if(!msg || !msg->bytes_left()) {
+	pop_send_q();
+	continue;
+      }
+
+      if(bytes < msg->bytes_left()) {
+	msg->cursor += bytes;
+	break;
+      }
+
+      bytes -= msg->bytes_left();
+      pop_send_q();
+      sent_msgs++;
+    }
+    tcp_server_socket::get_stats().inc_sent_msgs(sent_msgs);
 
-    if(bytes < msg->bytes_left()) {
-      msg->cursor += bytes;
+    if(!send_q.empty() && send_q.front() &&
+       (send_q.front()->cursor != send_q.front()->msg)) {
+      // partial write: wait until the socket is writable again
       add_write_event();
       return;
     }
-
-    send_q.pop_front();
-    delete msg;
   }
 }
 
@@ -593,7 +652,8 @@ void tcp_server_worker::on_stop()
 
 tcp_server_socket::tcp_server_socket(unsigned short if_num)
   : trsp_socket(if_num,0),
-    evbase(NULL), ev_accept(NULL)
+    evbase(NULL), ev_accept(NULL),
+    max_send_queue(DEFAULT_TCP_MAX_SEND_QUEUE)
 {
 }
 
@@ -692,10 +752,11 @@ void tcp_server_socket::add_event(struct event_base *evbase)
   }
 }
 
-void tcp_server_socket::add_threads(unsigned int n)
+void tcp_server_socket::add_threads(unsigned int n, const AmCpuSet* cpus)
 {
   for(unsigned int i=0; i<n; i++) {
     workers.push_back(new tcp_server_worker(this));
+    workers.back()->setCpuSet(cpus);
   }
 }
 
@@ -731,13 +792,16 @@ void tcp_server_socket::on_accept(int sd, short ev)
     return;
   }
 
+  stats.inc_accepted_connections();
+
   uint32_t h = hash_addr(&src_addr);
   unsigned int idx = h % workers.size();
   
-  // in case of thread pooling, do following in worker thread
+  // the connection is served by the event loop of the same worker
+  // which sends to this peer address
   DBG("tcp_trsp_socket::create_connected (idx = %u)",idx);
   tcp_trsp_socket::create_connected(this,workers[idx],connection_sd,
-				    &src_addr,evbase);
+				    &src_addr,workers[idx]->get_evbase());
 }
 
 int tcp_server_socket::send(const sockaddr_storage* sa, const char* msg,
@@ -13,9 +13,17 @@ using std::vector;
  */
 #define MAX_TCP_MSGLEN 65535
 
+/**
+ * Maximum number of queued messages
+ * written with a single writev()
+ */
+#define MAX_TCP_WRITEV_IOV 64
+
 #include <sys/socket.h>
 #include <event2/event.h>
 
+#include "atomic_types.h"
+
 #include <map>
 #include <deque>
 #include <string>
@@ -26,6 +34,34 @@ using std::string;
 class tcp_server_worker;
 class tcp_server_socket;
 
+/* TCP transport counters, for all TCP sockets */
+class tcp_trsp_stats
+{
+  private:
+    atomic_int accepted_connections;
+    atomic_int received_msgs;
+    atomic_int sent_msgs;
+    atomic_int write_calls;
+    atomic_int queued_bytes;
+    atomic_int send_q_overflows;
+
+  public:
+    void inc_accepted_connections() { accepted_connections.inc(); }
+    void inc_received_msgs() { received_msgs.inc(); }
+    void inc_sent_msgs(unsigned int n) { sent_msgs.inc(n); }
+    void inc_write_calls() { write_calls.inc(); }
+    void inc_queued_bytes(unsigned int n) { queued_bytes.inc(n); }
+    void dec_queued_bytes(unsigned int n) { queued_bytes.dec(n); }
+    void inc_send_q_overflows() { send_q_overflows.inc(); }
+
+    unsigned get_accepted_connections() const { return accepted_connections.get(); }
+    unsigned get_received_msgs() const { return received_msgs.get(); }
+    unsigned get_sent_msgs() const { return sent_msgs.get(); }
+    unsigned get_write_calls() const { return write_calls.get(); }
+    unsigned get_queued_bytes() const { return queued_bytes.get(); }
+    unsigned get_send_q_overflows() const { return send_q_overflows.get(); }
+};
+
 class tcp_trsp_socket: public trsp_socket
 {
   tcp_server_socket* server_sock;
@@ -60,9 +96,13 @@ class tcp_trsp_socket: public trsp_socket
   };
 
   deque<msg_buf*> send_q;
+  unsigned int    send_q_bytes;
   
   AmMutex sock_mut;
 
+  /** removes the message at the front of send_q */
+  void pop_send_q();
+
   unsigned char*   get_input() { return input_buf + input_len; }
   int              get_input_free_space() {
     if(input_len > MAX_TCP_MSGLEN) return 0;
@@ -201,6 +241,8 @@ public:
   tcp_server_worker(tcp_server_socket* server_sock);
   ~tcp_server_worker();
 
+  struct event_base* get_evbase() { return evbase; }
+
   int send(const sockaddr_storage* sa, const char* msg,
 	   const int msg_len, unsigned int flags);
 
@@ -225,6 +267,13 @@ class tcp_server_socket: public trsp_socket
    */
   struct timeval idle_timeout;
 
+  /**
+   * Max. bytes queued for sending per connection (0 = unlimited).
+   */
+  unsigned int max_send_queue;
+
+  static tcp_trsp_stats stats;
+
   /* callback on new connection */
   void on_accept(int sd, short ev);
 
@@ -237,7 +286,7 @@ public:
   tcp_server_socket(unsigned short if_num);
   ~tcp_server_socket() {}
 
-  void add_threads(unsigned int n);
+  void add_threads(unsigned int n, const AmCpuSet* cpus = NULL);
   void start_threads();
   void stop_threads();
 
@@ -266,6 +315,15 @@ public:
 
   struct timeval* get_connect_timeout();
   struct timeval* get_idle_timeout();
+
+  /**
+   * Set the max. number of bytes queued for sending on a
+   * connection. Messages which would exceed it are refused.
+   */
+  void set_max_send_queue(unsigned int bytes) { max_send_queue = bytes; }
+  unsigned int get_max_send_queue() { return max_send_queue; }
+
+  static tcp_trsp_stats& get_stats() { return stats; }
 };
 
 class tcp_trsp: public transport
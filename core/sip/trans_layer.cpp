@@ -48,6 +48,7 @@
 #include "wheeltimer.h"
 #include "sip_timers.h"
 #include "tr_blacklist.h"
+#include "trans_pacer.h"
 
 #define DEFAULT_BL_TTL 60000 /* 60s */
 
@@ -2123,7 +2124,9 @@ int _trans_layer::update_uac_request(trans_bucket* bucket, sip_trans*& t,
     default:
 	if(!msg->local_socket->is_reliable()) {
 	    // if transport == UDP
-	    t->reset_timer(STIMER_E,E_TIMER,bucket->get_id());
+	    t->reset_timer(STIMER_E,
+			   trans_pacer::instance()->add_jitter(E_TIMER),
+			   bucket->get_id());
 	}
 
 	// for any transport type
@@ -2496,6 +2499,26 @@ void _trans_layer::timer_expired(trans_timer* t, trans_bucket* bucket,
 	}
 	else {
 
+	    if(type == STIMER_E) {
+		unsigned int delay =
+		    trans_pacer::instance()->check(&tr->msg->remote_ip);
+
+		if(delay) {
+		    if(!tr->paced) {
+			tr->paced = true;
+			trans_pacer::instance()->enqueued();
+		    }
+		    // try again later, without counting a retransmission
+		    tr->reset_timer(((n-1)<<16) | type, delay, bucket->get_id());
+		    break;
+		}
+
+		if(tr->paced) {
+		    tr->paced = false;
+		    trans_pacer::instance()->dequeued();
+		}
+	    }
+
 	    // re-transmit request
 	    tr->msg->send(tr->flags);
             stats.inc_sent_request_retrans();
@@ -2512,12 +2535,16 @@ void _trans_layer::timer_expired(trans_timer* t, trans_bucket* bucket,
 	unsigned int retr_timer = (type == STIMER_E) ?
 	    E_TIMER << n : G_TIMER << n;
 
-	if(retr_timer<<n > T2_TIMER) {
-	    tr->reset_timer((n<<16) | type, T2_TIMER, bucket->get_id());
+	if(type == STIMER_E) {
+	    // before the cap: intervals must not exceed T2
+	    retr_timer = trans_pacer::instance()->add_jitter(retr_timer);
 	}
-	else {
-	    tr->reset_timer((n<<16) | type, retr_timer, bucket->get_id());
+
+	if(retr_timer<<n > T2_TIMER) {
+	    retr_timer = T2_TIMER;
 	}
+
+	tr->reset_timer((n<<16) | type, retr_timer, bucket->get_id());
     } break;
 
     case STIMER_M: {
@@ -2788,7 +2815,9 @@ int _trans_layer::try_next_ip(trans_bucket* bucket, sip_trans* tr,
     else {
 	tr->state = TS_TRYING;
 	if(!tr->msg->local_socket->is_reliable()) {
-	    tr->reset_timer(STIMER_E,E_TIMER,bucket->get_id());
+	    tr->reset_timer(STIMER_E,
+			    trans_pacer::instance()->add_jitter(E_TIMER),
+			    bucket->get_id());
 	}
 	if(!tr->get_timer(STIMER_F)) {
 	    tr->reset_timer(STIMER_F,F_TIMER,bucket->get_id());
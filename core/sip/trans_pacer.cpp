@@ -0,0 +1,63 @@
+#include "trans_pacer.h"
+#include "wheeltimer.h"
+#include "ip_util.h"
+#include "hash.h"
+
+#include "log.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+// pacing window: 1 second in wheeltimer ticks
+#define PACER_WINDOW_TICKS (1000000 / TIMER_RESOLUTION)
+#define PACER_WINDOW_MS    1000
+
+_trans_pacer::_trans_pacer()
+  : max_rate(0), max_dest_rate(0), jitter(0),
+    window_start(0), global_cnt(0)
+{
+  memset(dest_cnt,0,sizeof(dest_cnt));
+}
+
+unsigned int _trans_pacer::check(const sockaddr_storage* dst)
+{
+  if(!max_rate && !max_dest_rate)
+    return 0;
+
+  unsigned int now = wheeltimer::instance()->wall_clock;
+  if(now - window_start >= PACER_WINDOW_TICKS) {
+    window_start = now;
+    global_cnt = 0;
+    memset(dest_cnt,0,sizeof(dest_cnt));
+  }
+
+  unsigned int slot = hashlittle(dst,SA_len(dst),0) & PACER_DEST_SLOTS_MASK;
+
+  if((!max_rate || (global_cnt < max_rate)) &&
+     (!max_dest_rate || (dest_cnt[slot] < max_dest_rate))) {
+    global_cnt++;
+    dest_cnt[slot]++;
+    return 0;
+  }
+
+  // postpone to a random point in the next window
+  unsigned int left = (PACER_WINDOW_TICKS - (now - window_start))
+    * (TIMER_RESOLUTION/1000);
+  unsigned int delay = left + (random() % PACER_WINDOW_MS);
+
+  paced_retrans.inc();
+  pacing_delay.inc(delay);
+
+  DBG("pacing retransmission to %s:%i by %u ms\n",
+      am_inet_ntop(dst).c_str(),am_get_port(dst),delay);
+
+  return delay;
+}
+
+unsigned int _trans_pacer::add_jitter(unsigned int interval)
+{
+  if(!jitter || !interval)
+    return interval;
+
+  return interval + random() % (interval * jitter / 100 + 1);
+}
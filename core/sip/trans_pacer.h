@@ -0,0 +1,79 @@
+#ifndef _trans_pacer_h_
+#define _trans_pacer_h_
+
+#include "singleton.h"
+#include "atomic_types.h"
+
+#include <sys/socket.h>
+
+#define PACER_DEST_SLOTS_POWER 8
+#define PACER_DEST_SLOTS       (1 << PACER_DEST_SLOTS_POWER)
+#define PACER_DEST_SLOTS_MASK  (PACER_DEST_SLOTS - 1)
+
+/**
+ * Paces the retransmissions of non-INVITE client transactions.
+ *
+ * Retransmissions are limited to a global and a per-destination
+ * rate (per second); destinations are hashed into PACER_DEST_SLOTS
+ * slots. A retransmission over the limit is postponed to a random
+ * point within the next window instead of being sent, so that
+ * transactions created in the same burst do not keep
+ * retransmitting in lockstep.
+ *
+ * check() is only called from the timer thread, the counters
+ * may be read from any thread.
+ */
+class _trans_pacer
+{
+  // configuration
+  unsigned int max_rate;
+  unsigned int max_dest_rate;
+  unsigned int jitter;
+
+  // current window
+  unsigned int window_start;
+  unsigned int global_cnt;
+  unsigned int dest_cnt[PACER_DEST_SLOTS];
+
+  // statistics
+  atomic_int   paced_retrans;
+  atomic_int   paced_pending;
+  atomic_int64 pacing_delay;
+
+protected:
+  _trans_pacer();
+  ~_trans_pacer() {}
+
+  void dispose() {}
+
+public:
+  /** max. retransmissions per second, 0 = unlimited */
+  void set_max_rate(unsigned int rate) { max_rate = rate; }
+  /** max. retransmissions per second to one destination, 0 = unlimited */
+  void set_max_dest_rate(unsigned int rate) { max_dest_rate = rate; }
+  /** random jitter (in percent) added to retransmission intervals */
+  void set_jitter(unsigned int percent) { jitter = percent; }
+
+  /**
+   * @return 0 if a retransmission to dst may be sent now,
+   *         otherwise the delay (ms) after which to try again.
+   */
+  unsigned int check(const sockaddr_storage* dst);
+
+  /** @return the interval (ms) with the configured jitter applied */
+  unsigned int add_jitter(unsigned int interval);
+
+  /** a retransmission has been postponed */
+  void enqueued() { paced_pending.inc(); }
+
+  /** a postponed retransmission has been sent or dropped */
+  void dequeued() { paced_pending.dec(); }
+
+  unsigned int get_paced_retrans() const { return paced_retrans.get(); }
+  unsigned int get_paced_pending() const { return paced_pending.get(); }
+  unsigned long long get_pacing_delay() { return pacing_delay.get(); }
+};
+
+typedef singleton<_trans_pacer> trans_pacer;
+
+#endif
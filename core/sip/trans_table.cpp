@@ -46,7 +46,32 @@
 // Global transaction table
 //
 
-hash_table<trans_bucket> _trans_table(H_TABLE_ENTRIES);
+static hash_table<trans_bucket>* _trans_table = NULL;
+
+int init_trans_table(unsigned int power)
+{
+    if(_trans_table) {
+	ERROR("transaction table already initialized (%lu buckets)\n",
+	      _trans_table->get_size());
+	return -1;
+    }
+
+    if(!power || (power > H_TABLE_MAX_POWER)) {
+	ERROR("invalid transaction table size 2^%u\n",power);
+	return -1;
+    }
+
+    _trans_table = new hash_table<trans_bucket>(1UL << power);
+    DBG("transaction table initialized with %lu buckets\n",
+	_trans_table->get_size());
+
+    return 0;
+}
+
+static inline hash_table<trans_bucket>& trans_table()
+{
+    return *_trans_table;
+}
 
 trans_bucket::trans_bucket(unsigned long id)
     : ht_bucket<sip_trans>::ht_bucket(id)
@@ -560,17 +585,41 @@ void compute_branch(char* branch/*[8]*/, const cstring& callid, const cstring& c
 
 trans_bucket* get_trans_bucket(const cstring& callid, const cstring& cseq_num)
 {
-    return _trans_table[hash(callid,cseq_num)];
+    return trans_table()[hash(callid,cseq_num)];
 }
 
 trans_bucket* get_trans_bucket(unsigned int h)
 {
-    return _trans_table[h];
+    return trans_table()[h];
+}
+
+void get_trans_table_stats(trans_table_stats& stats)
+{
+    hash_table<trans_bucket>& table = trans_table();
+
+    stats = trans_table_stats();
+    stats.buckets = table.get_size();
+
+    for(unsigned long i=0; i<stats.buckets; i++) {
+
+	trans_bucket* bucket = table[i];
+	bucket->lock();
+	unsigned long len = bucket->size();
+	bucket->unlock();
+
+	if(!len)
+	    continue;
+
+	stats.used_buckets++;
+	stats.transactions += len;
+	if(len > stats.max_bucket_len)
+	    stats.max_bucket_len = len;
+    }
 }
 
 void dumps_transactions()
 {
-    _trans_table.dump();
+    trans_table().dump();
 }
 
 
@@ -8,6 +8,9 @@
 #define H_TABLE_POWER   10
 #define H_TABLE_ENTRIES (1<<H_TABLE_POWER)
 
+// upper limit for the configurable table size
+#define H_TABLE_MAX_POWER 24
+
 class trans_bucket: 
     public ht_bucket<sip_trans>
 {
@@ -46,9 +49,38 @@ private:
     sip_trans* match_200_ack(sip_trans* t,sip_msg* msg);
 };
 
+/**
+ * Allocates the transaction table with 2^power buckets.
+ * Must be called once before the SIP stack processes its first
+ * message (see _SipCtrlInterface::load()).
+ *
+ * @return 0 on success, -1 if the table already exists
+ *         or power is out of range.
+ */
+int init_trans_table(unsigned int power);
+
 trans_bucket* get_trans_bucket(const cstring& callid, const cstring& cseq_num);
 trans_bucket* get_trans_bucket(unsigned int h);
 
+struct trans_table_stats
+{
+    unsigned long buckets;
+    unsigned long used_buckets;
+    unsigned long transactions;
+    unsigned long max_bucket_len;
+
+    trans_table_stats()
+	: buckets(0), used_buckets(0),
+	  transactions(0), max_bucket_len(0)
+    {}
+};
+
+/**
+ * Collects the bucket occupancy of the transaction table.
+ * Each bucket is locked only while its length is read.
+ */
+void get_trans_table_stats(trans_table_stats& stats);
+
 unsigned int hash(const cstring& ci, const cstring& cs);
 
 
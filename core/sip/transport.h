@@ -38,6 +38,7 @@ using std::string;
 
 #define DEFAULT_TCP_CONNECT_TIMEOUT 2000 /* 2 seconds */
 #define DEFAULT_TCP_IDLE_TIMEOUT 3600000 /* 1 hour */
+#define DEFAULT_TCP_MAX_SEND_QUEUE 0 /* unlimited */
 
 class trsp_socket
     : public atomic_ref_cnt
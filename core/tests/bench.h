@@ -0,0 +1,28 @@
+#ifndef _tests_bench_h_
+#define _tests_bench_h_
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+/**
+ * Benchmarks are skipped unless SEMS_TESTS_BENCH is set
+ * ('make bench'). Use as
+ *   FCT_TEST_BGN_IF(bench_enabled(), xyz_bench) {
+ *     ...
+ *   } FCT_TEST_END_IF();
+ */
+static inline bool bench_enabled()
+{
+  return getenv("SEMS_TESTS_BENCH") != NULL;
+}
+
+/** @return seconds since 'start' */
+static inline double bench_seconds(const struct timeval& start)
+{
+  struct timeval now, diff;
+  gettimeofday(&now, NULL);
+  timersub(&now, &start, &diff);
+  return diff.tv_sec + diff.tv_usec / 1e6;
+}
+
+#endif
@@ -3520,6 +3520,9 @@ object (should be rare). */
                                 (fctkern_ptr__->ns.ts_skip_cndtn)\
                        );\
                        fct_ts__test_end(fctkern_ptr__->ns.ts_curr);\
+                       /* FCT_TEST_END_IF() is not reached */\
+                       fctkern_ptr__->ns.test_is_skip = 0;\
+                       fctkern_ptr__->ns.test_skip_cndtn = NULL;\
                        continue;\
                  } else {\
                       fctkern__log_test_start(fctkern_ptr__, fctkern_ptr__->ns.curr_test);\
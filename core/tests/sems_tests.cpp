@@ -14,6 +14,7 @@
   
 #include "AmSipMsg.h"
 #include "AmSipHeaders.h"
+#include "sip/trans_table.h"
 
 #include "fct.h"
 
@@ -22,12 +23,33 @@ FCT_BGN() {
   log_stderr=true;
   log_level=3;
 
+  init_trans_table(H_TABLE_POWER);
+
   FCTMF_SUITE_CALL(test_sdp);
   FCTMF_SUITE_CALL(test_auth);
   FCTMF_SUITE_CALL(test_headers);
   FCTMF_SUITE_CALL(test_uriparser);
   FCTMF_SUITE_CALL(test_jsonarg);
+  FCTMF_SUITE_CALL(test_amarg);
   FCTMF_SUITE_CALL(test_replaces);
+  FCTMF_SUITE_CALL(test_trans_table);
+  FCTMF_SUITE_CALL(test_eventqueue);
+  FCTMF_SUITE_CALL(test_boundedqueue);
+  FCTMF_SUITE_CALL(test_asyncjob);
+  FCTMF_SUITE_CALL(test_eventdispatcher);
+  FCTMF_SUITE_CALL(test_logging);
+  FCTMF_SUITE_CALL(test_rtpbufpool);
+  FCTMF_SUITE_CALL(test_cpuset);
+  FCTMF_SUITE_CALL(test_rtpoffload);
+  FCTMF_SUITE_CALL(test_paramreplacer);
+  FCTMF_SUITE_CALL(test_regexmapping);
+  FCTMF_SUITE_CALL(test_prefixtable);
+  FCTMF_SUITE_CALL(test_regcachestorage);
+  FCTMF_SUITE_CALL(test_regcacheexpiry);
+  FCTMF_SUITE_CALL(test_regthrottling);
+  FCTMF_SUITE_CALL(test_rtppolicing);
+  FCTMF_SUITE_CALL(test_callregistry);
+  FCTMF_SUITE_CALL(test_eventlog);
 } FCT_END();
 
 
@@ -0,0 +1,171 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmArg.h"
+#include "AmUtils.h"
+#include "jsonArg.h"
+
+#include "bench.h"
+
+#define BENCH_PAYLOADS 20000
+
+/** call control interface style request */
+static void fill_cc_payload(AmArg& cc, unsigned int i)
+{
+  cc["call_id"] = "a84b4c76e66710-" + int2str(i);
+  cc["ltag"] = "1928301774";
+  cc["from"] = "<sip:alice@example.com>;tag=1928301774";
+  cc["to"] = "<sip:bob@example.com>";
+  cc["ruri"] = "sip:bob@10.0.0.1";
+  cc["cc_name"] = "cc_pcalls";
+  cc["start_ts"] = (long long)1700000000;
+  cc["max_calls"] = 10;
+  AmArg& values = cc["values"];
+  values["user"] = "alice";
+  values["domain"] = "example.com";
+  values["limit"] = 5;
+  values["codecs"].push("PCMU");
+  values["codecs"].push("PCMA");
+  values["codecs"].push("telephone-event");
+}
+
+FCTMF_SUITE_BGN(test_amarg) {
+
+    FCT_TEST_BGN(amarg_cstr_short_and_long) {
+      string long_str(100, 'x');
+      AmArg s("short");
+      AmArg l(long_str);
+      fct_chk(!strcmp(s.asCStr(), "short"));
+      fct_chk(l.asCStr() == long_str);
+
+      AmArg s2(s), l2(l);
+      fct_chk(s2 == s);
+      fct_chk(l2 == l);
+      fct_chk(s2.asCStr() != s.asCStr());
+
+      s2.swap(l2);
+      fct_chk(s2.asCStr() == long_str);
+      fct_chk(!strcmp(l2.asCStr(), "short"));
+
+      AmArg e("");
+      fct_chk(isArgCStr(e) && !*e.asCStr());
+
+      // exactly at the inline limit
+      string edge(AMARG_INLINE_CSTR_LEN - 1, 'y');
+      AmArg a(edge), b(edge + "y");
+      fct_chk(a.asCStr() == edge);
+      fct_chk(b.asCStr() == edge + "y");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(amarg_struct_sorted) {
+      AmArg a;
+      a["c"] = 3;
+      a["a"] = 1;
+      a["b"] = 2;
+      a.push("d", AmArg("four"));
+      a["a"] = 10;
+      fct_chk(a.size() == 4);
+
+      vector<string> keys = a.enumerateKeys();
+      fct_chk(keys.size() == 4 && keys[0] == "a" && keys[1] == "b" &&
+	      keys[2] == "c" && keys[3] == "d");
+      fct_chk(a["a"].asInt() == 10);
+      fct_chk(a.hasMember("d") && !a.hasMember("e"));
+
+      a.erase("b");
+      fct_chk(a.size() == 3 && !a.hasMember("b"));
+      fct_chk(arg2json(a) == "{\"a\": 10, \"c\": 3, \"d\": \"four\"}");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(amarg_assign_from_member) {
+      AmArg a;
+      a["x"]["y"] = "inner";
+      a["z"] = 1;
+      a = a["x"];
+      fct_chk(isArgStruct(a) && a.size() == 1);
+      fct_chk(!strcmp(a["y"].asCStr(), "inner"));
+
+      AmArg b;
+      b["k"] = "value of k";
+      b.push("a", b["k"]);
+      fct_chk(!strcmp(b["a"].asCStr(), "value of k"));
+
+      AmArg arr;
+      arr.push(AmArg("first"));
+      arr.push(AmArg(2));
+      arr = arr[0];
+      fct_chk(isArgCStr(arr) && !strcmp(arr.asCStr(), "first"));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(amarg_array_pop) {
+      AmArg a;
+      a.push(AmArg(1));
+      a.push(AmArg("two"));
+      a.push(AmArg(3));
+
+      AmArg v;
+      a.pop(v);
+      fct_chk(isArgInt(v) && v.asInt() == 1);
+      a.pop_back(v);
+      fct_chk(isArgInt(v) && v.asInt() == 3);
+      a.pop_back();
+      fct_chk(a.size() == 0);
+      a.pop_back(v);
+      fct_chk(isArgUndef(v));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(amarg_map_constructor) {
+      std::map<string, string> m;
+      m["b"] = "2";
+      m["a"] = "1";
+      AmArg a(m);
+      fct_chk(a.size() == 2);
+      fct_chk(!strcmp(a["a"].asCStr(), "1"));
+      fct_chk(!strcmp(a["b"].asCStr(), "2"));
+
+      vector<string> v;
+      v.push_back("x");
+      v.push_back("y");
+      AmArg va(v);
+      fct_chk(isArgArray(va) && va.size() == 2);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), amarg_cc_payload_bench) {
+      struct timeval start;
+      gettimeofday(&start, NULL);
+      size_t n = 0;
+      for(unsigned int i=0; i<BENCH_PAYLOADS; i++) {
+	AmArg cc;
+	fill_cc_payload(cc, i);
+	AmArg res;
+	res.push(cc);
+	res.push(cc);
+	n += res.size();
+      }
+      double build_us = bench_seconds(start) * 1e6;
+      fct_chk(n == 2 * BENCH_PAYLOADS);
+
+      AmArg cc;
+      fill_cc_payload(cc, 1);
+      string json;
+      gettimeofday(&start, NULL);
+      for(unsigned int i=0; i<BENCH_PAYLOADS; i++) {
+	json = arg2json(cc);
+      }
+      double encode_us = bench_seconds(start) * 1e6;
+
+      AmArg decoded;
+      gettimeofday(&start, NULL);
+      for(unsigned int i=0; i<BENCH_PAYLOADS; i++) {
+	fct_chk(json2arg(json, decoded));
+      }
+      double decode_us = bench_seconds(start) * 1e6;
+      fct_chk(arg2json(decoded) == json);
+
+      INFO("call control payload: build+copy %.3fus, json encode %.3fus, "
+	   "decode %.3fus\n", build_us / BENCH_PAYLOADS,
+	   encode_us / BENCH_PAYLOADS, decode_us / BENCH_PAYLOADS);
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,93 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmAsyncJob.h"
+#include "AmEventQueue.h"
+#include "AmEventDispatcher.h"
+
+#define TEST_JOBS 50
+
+struct JobResultEvent : public AmEvent
+{
+  int result;
+  JobResultEvent(int result)
+    : AmEvent(0), result(result) {}
+};
+
+class SquareJob : public AmAsyncJob
+{
+  int arg;
+  int result;
+
+ public:
+  SquareJob(const string& session_id, int arg)
+    : AmAsyncJob(session_id), arg(arg), result(0) {}
+
+  void run() {
+    usleep(1000); // pretend to block
+    result = arg * arg;
+  }
+
+  AmEvent* getResultEvent() { return new JobResultEvent(result); }
+};
+
+struct JobResultHandler : public AmEventHandler
+{
+  unsigned int received;
+  long sum;
+
+  JobResultHandler() : received(0), sum(0) {}
+
+  void process(AmEvent* ev) {
+    JobResultEvent* r_ev = dynamic_cast<JobResultEvent*>(ev);
+    if(!r_ev) return;
+    received++;
+    sum += r_ev->result;
+  }
+};
+
+FCTMF_SUITE_BGN(test_asyncjob) {
+
+    FCT_TEST_BGN(asyncjob_results_posted_to_session) {
+      JobResultHandler h;
+      AmEventQueue q(&h);
+      fct_req(AmEventDispatcher::instance()->addEventQueue("asyncjob-test", &q));
+
+      AmAsyncJobProcessor::instance()->addThreads(4);
+
+      long expected = 0;
+      for(int i=0; i<TEST_JOBS; i++) {
+	fct_chk(AmAsyncJobProcessor::instance()->
+		post(new SquareJob("asyncjob-test", i)) == 0);
+	expected += i*i;
+      }
+
+      // results to a session which does not exist are dropped
+      unsigned int undelivered = AmAsyncJobProcessor::instance()->getUndelivered();
+      fct_chk(AmAsyncJobProcessor::instance()->
+	      post(new SquareJob("asyncjob-nonexisting", 1)) == 0);
+
+      for(int i=0; (i < 500) && (h.received < TEST_JOBS); i++) {
+	q.waitForEvent();
+	q.processEvents();
+      }
+      fct_chk(h.received == TEST_JOBS);
+      fct_chk(h.sum == expected);
+
+      for(int i=0; (i < 500) &&
+	    (AmAsyncJobProcessor::instance()->getFinished() < TEST_JOBS + 1); i++)
+	usleep(1000);
+      fct_chk(AmAsyncJobProcessor::instance()->getUndelivered() == undelivered + 1);
+      fct_chk(AmAsyncJobProcessor::instance()->getQueued() == 0);
+      AmAsyncJobProcessor::dispose();
+
+      AmEventDispatcher::instance()->delEventQueue("asyncjob-test");
+
+      // without workers, jobs are refused
+      fct_chk(AmAsyncJobProcessor::instance()->
+	      post(new SquareJob("asyncjob-test", 1)) < 0);
+      AmAsyncJobProcessor::dispose();
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
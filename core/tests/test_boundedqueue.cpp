@@ -0,0 +1,105 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmBoundedQueue.h"
+#include "AmThread.h"
+
+#include <vector>
+using std::vector;
+
+#define PRODUCERS          4
+#define ITEMS_PER_PRODUCER 20000
+
+struct SeqItem {
+  unsigned int producer;
+  unsigned int seq;
+};
+
+class SeqProducer : public AmThread
+{
+  AmBoundedQueue<SeqItem>* q;
+  unsigned int producer;
+
+ protected:
+  void run() {
+    for(unsigned int i=0; i<ITEMS_PER_PRODUCER; i++) {
+      unsigned long pos;
+      SeqItem* e;
+      while(!(e = q->begin_push(pos)))
+	sched_yield();
+      e->producer = producer;
+      e->seq = i;
+      q->end_push(pos);
+    }
+  }
+  void on_stop() {}
+
+ public:
+  SeqProducer(AmBoundedQueue<SeqItem>* q, unsigned int producer)
+    : q(q), producer(producer) {}
+};
+
+FCTMF_SUITE_BGN(test_boundedqueue) {
+
+    FCT_TEST_BGN(boundedqueue_full_and_wrap) {
+      // rounded up to 4
+      AmBoundedQueue<int> q(3);
+      unsigned long pos;
+
+      fct_chk(q.front() == NULL);
+      for(int round=0; round<3; round++) {
+	for(int i=0; i<4; i++) {
+	  int* e = q.begin_push(pos);
+	  fct_req(e != NULL);
+	  *e = round * 4 + i;
+	  q.end_push(pos);
+	}
+	fct_chk(q.begin_push(pos) == NULL);
+
+	for(int i=0; i<4; i++) {
+	  int* e = q.front();
+	  fct_req(e != NULL);
+	  fct_chk_eq_int(*e, round * 4 + i);
+	  q.pop();
+	}
+	fct_chk(q.front() == NULL);
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(boundedqueue_producers) {
+      AmBoundedQueue<SeqItem> q(256);
+
+      vector<SeqProducer*> producers;
+      for(unsigned int i=0; i<PRODUCERS; i++) {
+	producers.push_back(new SeqProducer(&q, i));
+	producers.back()->start();
+      }
+
+      // items of each producer arrive complete and in order
+      vector<unsigned int> next_seq(PRODUCERS, 0);
+      unsigned int received = 0, out_of_order = 0;
+      while(received < PRODUCERS * ITEMS_PER_PRODUCER) {
+	SeqItem* e = q.front();
+	if(!e) {
+	  sched_yield();
+	  continue;
+	}
+	if(e->producer >= PRODUCERS || e->seq != next_seq[e->producer])
+	  out_of_order++;
+	else
+	  next_seq[e->producer]++;
+	q.pop();
+	received++;
+      }
+
+      for(unsigned int i=0; i<PRODUCERS; i++) {
+	producers[i]->join();
+	delete producers[i];
+      }
+
+      fct_chk_eq_int(out_of_order, 0);
+      fct_chk(q.front() == NULL);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
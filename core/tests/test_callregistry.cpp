@@ -0,0 +1,158 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmThread.h"
+#include "AmUtils.h"
+#include "../../apps/sbc/SBCCallRegistry.h"
+
+#include "bench.h"
+
+#include <map>
+#include <vector>
+using std::vector;
+
+
+#define BENCH_CALLS 100000
+
+/** the registry as it used to be: one map, one mutex */
+struct GlobalLockRegistry
+{
+  AmMutex mut;
+  std::map<string, SBCCallRegistryEntry> registry;
+
+  void addCall(const string& ltag, const SBCCallRegistryEntry& other_dlg) {
+    AmLock l(mut);
+    registry[ltag] = other_dlg;
+  }
+
+  bool lookupCall(const string& ltag, SBCCallRegistryEntry& other_dlg) {
+    AmLock l(mut);
+    std::map<string, SBCCallRegistryEntry>::iterator it = registry.find(ltag);
+    if (it == registry.end()) return false;
+    other_dlg = it->second;
+    return true;
+  }
+
+  void removeCall(const string& ltag) {
+    AmLock l(mut);
+    registry.erase(ltag);
+  }
+};
+
+/** sets up and tears down calls: both legs, as CallLeg does */
+class CallSetupThread : public AmThread
+{
+  GlobalLockRegistry* global;
+  string prefix;
+  unsigned int calls;
+
+protected:
+  void run() {
+    SBCCallRegistryEntry e;
+    for (unsigned int i = 0; i < calls; i++) {
+      string a = prefix + int2str(i) + "-a", b = prefix + int2str(i) + "-b";
+      if (global) {
+	global->addCall(a, SBCCallRegistryEntry("cid", b, ""));
+	global->addCall(b, SBCCallRegistryEntry("cid", a, "rtag"));
+	global->lookupCall(a, e);
+	global->removeCall(a);
+	global->removeCall(b);
+      } else {
+	SBCCallRegistry::addCall(a, SBCCallRegistryEntry("cid", b, ""));
+	SBCCallRegistry::addCall(b, SBCCallRegistryEntry("cid", a, "rtag"));
+	SBCCallRegistry::updateCall(a, "btag");
+	SBCCallRegistry::lookupCall(a, e);
+	SBCCallRegistry::removeCall(a);
+	SBCCallRegistry::removeCall(b);
+      }
+    }
+  }
+  void on_stop() {}
+
+public:
+  CallSetupThread(GlobalLockRegistry* global, const string& prefix, unsigned int calls)
+    : global(global), prefix(prefix), calls(calls) {}
+};
+
+/** @return calls/s */
+static double bench(unsigned int threads, bool global_lock)
+{
+  GlobalLockRegistry global;
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  vector<CallSetupThread*> t;
+  for (unsigned int i = 0; i < threads; i++) {
+    t.push_back(new CallSetupThread(global_lock ? &global : NULL,
+				    "bench" + int2str(i) + "-", BENCH_CALLS / threads));
+    t.back()->start();
+  }
+  for (unsigned int i = 0; i < threads; i++) {
+    t[i]->join();
+    delete t[i];
+  }
+
+  return BENCH_CALLS / bench_seconds(start);
+}
+
+FCTMF_SUITE_BGN(test_callregistry) {
+
+    FCT_TEST_BGN(callregistry_calls) {
+      unsigned int size = SBCCallRegistry::getSize();
+
+      SBCCallRegistry::addCall("test-a", SBCCallRegistryEntry("cid1", "test-b", ""));
+      SBCCallRegistry::addCall("test-b", SBCCallRegistryEntry("cid1", "test-a", "rtag-a"));
+      fct_chk(SBCCallRegistry::getSize() == size + 2);
+
+      SBCCallRegistryEntry e;
+      fct_chk(SBCCallRegistry::lookupCall("test-a", e));
+      fct_chk(e.ltag == "test-b" && e.rtag == "" && e.callid == "cid1");
+
+      SBCCallRegistry::updateCall("test-a", "rtag-b");
+      fct_chk(SBCCallRegistry::lookupCall("test-a", e));
+      fct_chk(e.rtag == "rtag-b");
+
+      // replaced, not added
+      SBCCallRegistry::addCall("test-a", SBCCallRegistryEntry("cid2", "test-c", ""));
+      fct_chk(SBCCallRegistry::getSize() == size + 2);
+      fct_chk(SBCCallRegistry::lookupCall("test-a", e));
+      fct_chk(e.ltag == "test-c" && e.callid == "cid2");
+
+      std::vector<std::pair<string,SBCCallRegistryEntry> > calls;
+      SBCCallRegistry::getCalls(calls);
+      fct_chk(calls.size() == size + 2);
+      unsigned int found = 0;
+      for (unsigned int i = 0; i < calls.size(); i++) {
+	if (calls[i].first == "test-b" && calls[i].second.ltag == "test-a")
+	  found++;
+      }
+      fct_chk(found == 1);
+
+      SBCCallRegistry::removeCall("test-a");
+      SBCCallRegistry::removeCall("test-a");
+      SBCCallRegistry::removeCall("test-b");
+      fct_chk(!SBCCallRegistry::lookupCall("test-a", e));
+      fct_chk(!SBCCallRegistry::lookupCall("test-b", e));
+      fct_chk(SBCCallRegistry::getSize() == size);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), callregistry_bench) {
+      // debug output would dominate
+      int orig_log_level = log_level;
+      log_level = L_INFO;
+
+      unsigned int size = SBCCallRegistry::getSize();
+      for (unsigned int threads = 1; threads <= 8; threads *= 2) {
+	double global_cps = bench(threads, true);
+	double sharded_cps = bench(threads, false);
+	INFO("%u threads: %.0f calls/s with one registry lock, "
+	     "%.0f calls/s with locked buckets\n", threads, global_cps, sharded_cps);
+      }
+      fct_chk(SBCCallRegistry::getSize() == size);
+
+      log_level = orig_log_level;
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,76 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmThread.h"
+
+#include <unistd.h>
+
+class AffinityThread
+  : public AmThread
+{
+public:
+  int n_cpus;
+  int cpu0;
+
+  AffinityThread() : n_cpus(-1), cpu0(-1) {}
+
+  void run() {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (!pthread_getaffinity_np(pthread_self(), sizeof(set), &set)) {
+      n_cpus = CPU_COUNT(&set);
+      cpu0 = CPU_ISSET(0, &set) ? 1 : 0;
+    }
+#endif
+  }
+  void on_stop() {}
+};
+
+FCTMF_SUITE_BGN(test_cpuset) {
+
+    FCT_TEST_BGN(cpuset_parse) {
+      AmCpuSet s;
+      fct_chk(s.parse("0"));
+      fct_chk(s.print() == "0");
+      fct_chk(s.parse(""));
+      fct_chk(s.empty());
+      fct_chk(!s.parse("abc"));
+      fct_chk(!s.parse("3-1"));
+      fct_chk(!s.parse("nodex"));
+      fct_chk(!s.parse("100000"));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(cpuset_ranges) {
+      long n = sysconf(_SC_NPROCESSORS_CONF);
+      if (n >= 4) {
+	AmCpuSet s;
+	fct_chk(s.parse(" 3, 0-1 ,1"));
+	fct_chk(s.get().size() == 3);
+	fct_chk(s.print() == "0-1,3");
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(cpuset_numa_node) {
+      if (!access("/sys/devices/system/node/node0/cpulist", R_OK)) {
+	AmCpuSet s;
+	fct_chk(s.parse("node0"));
+	fct_chk(!s.empty());
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(cpuset_thread_bound) {
+      AmCpuSet s;
+      fct_chk(s.parse("0"));
+      AffinityThread t;
+      t.setCpuSet(&s);
+      t.start();
+      t.join();
+#if defined(__linux__)
+      fct_chk(t.n_cpus == 1);
+      fct_chk(t.cpu0 == 1);
+#endif
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,105 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmEventDispatcher.h"
+#include "AmUtils.h"
+
+#include "bench.h"
+
+#define BENCH_SESSIONS 100000
+
+struct CountingQueue : public AmEventQueueInterface
+{
+  unsigned int received;
+  CountingQueue() : received(0) {}
+
+  void postEvent(AmEvent* ev) {
+    received++;
+    delete ev;
+  }
+};
+
+FCTMF_SUITE_BGN(test_eventdispatcher) {
+
+    FCT_TEST_BGN(tag_table_basic) {
+      AmTagTable<int> t;
+      fct_chk(t.insert(1, "a", 1));
+      fct_chk(!t.insert(1, "a", 2));
+      // same hash, different key
+      fct_chk(t.insert(1, "b", 2));
+      fct_chk(t.find(1, "a") && *t.find(1, "a") == 1);
+      fct_chk(t.find(1, "b") && *t.find(1, "b") == 2);
+      fct_chk(t.find(2, "a") == NULL);
+
+      int old = 0;
+      fct_chk(t.erase(1, "a", &old) && old == 1);
+      fct_chk(!t.erase(1, "a"));
+      // still reachable after the deleted slot
+      fct_chk(t.find(1, "b") != NULL);
+      fct_chk(t.size() == 1);
+
+      // churn: deleted slots must not fill up the table
+      for(int i=0; i<10000; i++) {
+	string k = int2str(i);
+	fct_chk(t.insert(i << 8, k, i));
+	fct_chk(t.erase(i << 8, k));
+      }
+      fct_chk(t.size() == 1);
+      fct_chk(t.capacity() < 64);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), eventdispatcher_lookup_bench) {
+      AmEventDispatcher* d = AmEventDispatcher::instance();
+      size_t before = d->size();
+
+      CountingQueue q;
+      vector<string> tags;
+      tags.reserve(BENCH_SESSIONS);
+
+      struct timeval start;
+      gettimeofday(&start, NULL);
+      for(unsigned int i=0; i<BENCH_SESSIONS; i++) {
+	tags.push_back("bench-" + int2str(i) + "-" + int2str(i * 7919));
+	fct_chk(d->addEventQueue(tags.back(), &q, "callid-" + int2str(i),
+				 "rtag-" + int2str(i), "z9hG4bK" + int2str(i)));
+      }
+      double add_us = bench_seconds(start) * 1e6;
+      fct_chk(d->size() == before + BENCH_SESSIONS);
+      fct_chk(!d->addEventQueue(tags[0], &q));
+
+      gettimeofday(&start, NULL);
+      for(unsigned int i=0; i<BENCH_SESSIONS; i++) {
+	d->post(tags[(i * 31) % BENCH_SESSIONS], new AmEvent(0));
+      }
+      double post_us = bench_seconds(start) * 1e6;
+      fct_chk(q.received == BENCH_SESSIONS);
+
+      gettimeofday(&start, NULL);
+      for(unsigned int i=0; i<BENCH_SESSIONS; i++) {
+	d->post("callid-" + int2str(i), "rtag-" + int2str(i),
+		"z9hG4bK" + int2str(i), new AmEvent(0));
+      }
+      double id_post_us = bench_seconds(start) * 1e6;
+      fct_chk(q.received == 2 * BENCH_SESSIONS);
+
+      AmEvent* ev = new AmEvent(0);
+      fct_chk(!d->post("bench-nonexisting", ev));
+      delete ev;
+
+      INFO("%u sessions: add %.3fus, post %.3fus, post by id %.3fus per op\n",
+	   BENCH_SESSIONS, add_us / BENCH_SESSIONS, post_us / BENCH_SESSIONS,
+	   id_post_us / BENCH_SESSIONS);
+
+      for(unsigned int i=0; i<BENCH_SESSIONS; i++) {
+	fct_chk(d->delEventQueue(tags[i]) == &q);
+      }
+      fct_chk(d->size() == before);
+
+      // id lookup is removed with the queue
+      ev = new AmEvent(0);
+      fct_chk(!d->post("callid-0", "rtag-0", "z9hG4bK0", ev));
+      delete ev;
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,250 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmThread.h"
+#include "AmUtils.h"
+#include "jsonArg.h"
+#include "../../apps/sbc/SBCEventLogQueue.h"
+#include "../../apps/sbc/SBCEventLogSinks.h"
+
+#include "bench.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <vector>
+using std::vector;
+
+#define BENCH_THREADS 4
+#define BENCH_EVENTS  2000 /* per thread */
+
+/** sink sleeping for each event, as a slow syslog daemon would */
+struct SlowSink : public SBCEventLogHandler
+{
+  unsigned int delay_us;
+  atomic_int events;
+
+  SlowSink(unsigned int delay_us) : delay_us(delay_us) {}
+
+  void logEvent(long int timestamp, const string& id,
+		const string& type, const AmArg& ev) {
+    if (delay_us) usleep(delay_us);
+    events.inc();
+  }
+};
+
+static AmArg call_end_event(unsigned int i)
+{
+  AmArg ev;
+  ev["call-id"] = "call-" + int2str(i) + "@192.0.2.1";
+  ev["reason"] = "BYE";
+  ev["from"] = "sip:alice@example.com";
+  ev["to"] = "sip:bob@example.com";
+  ev["duration"] = 42.5;
+  return ev;
+}
+
+/** ends calls, logging call-end events */
+class HangupThread : public AmThread
+{
+  SBCEventLogHandler* h;
+  unsigned int id;
+
+protected:
+  void run() {
+    for (unsigned int i = 0; i < BENCH_EVENTS; i++) {
+      h->logEvent(1700000000, "ltag-" + int2str(id) + "-" + int2str(i),
+		  "call-end", call_end_event(i));
+      // synchronous: the sink writes every event
+      h->flush();
+    }
+  }
+  void on_stop() {}
+
+public:
+  HangupThread(SBCEventLogHandler* h, unsigned int id)
+    : h(h), id(id) {}
+};
+
+/** @return ms for all threads to log their events */
+static double hangup_storm(SBCEventLogHandler* h)
+{
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  vector<HangupThread*> t;
+  for (unsigned int i = 0; i < BENCH_THREADS; i++) {
+    t.push_back(new HangupThread(h, i));
+    t.back()->start();
+  }
+  for (unsigned int i = 0; i < BENCH_THREADS; i++) {
+    t[i]->join();
+    delete t[i];
+  }
+
+  return bench_seconds(start) * 1e3;
+}
+
+static unsigned int count_lines(const string& fname, bool& json_ok)
+{
+  std::ifstream f(fname.c_str());
+  string line;
+  unsigned int n = 0;
+  while (std::getline(f, line)) {
+    AmArg a;
+    if (!json2arg(line, a) || !a.hasMember("attrs") ||
+	a["type"].asCStr() != string("call-end"))
+      json_ok = false;
+    n++;
+  }
+  return n;
+}
+
+FCTMF_SUITE_BGN(test_eventlog) {
+
+    FCT_TEST_BGN(eventlog_json) {
+      AmArg ev;
+      ev["reason"] = "a \"quoted\" reason";
+      string j = event2json(1700000000, "ltag", "call-end", ev);
+      fct_chk(j == "{\"ts\":1700000000,\"id\":\"ltag\",\"type\":\"call-end\","
+	      "\"attrs\":{\"reason\": \"a \\\"quoted\\\" reason\"}}");
+
+      fct_chk(SyslogEventLogSink::format("ltag", "cdr", AmArg("CDR: 1,2")) == "CDR: 1,2");
+      fct_chk(SyslogEventLogSink::parseFacility("local3") == (3+16)<<3);
+      fct_chk(SyslogEventLogSink::parseFacility("kern") == -1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(eventlog_file_rotation) {
+      char dir_tmpl[] = "/tmp/sems_eventlog_XXXXXX";
+      char* dir = mkdtemp(dir_tmpl);
+      fct_req(dir != NULL);
+      string path = string(dir) + "/events.json";
+
+      FileEventLogSink* sink = new FileEventLogSink(path, 64 * 1024, 2);
+      fct_req(sink->open());
+
+      AsyncEventLogHandler h(1024, 64, AsyncEventLogHandler::Wait, 1000);
+      h.addSink(sink);
+      h.start();
+      for (unsigned int i = 0; i < 2000; i++)
+	h.logEvent(1700000000, "ltag-" + int2str(i), "call-end", call_end_event(i));
+      h.shutdown();
+
+      fct_chk(h.getQueued() == 2000);
+      fct_chk(h.getWritten() == 2000);
+      fct_chk(h.getDropped() == 0);
+      fct_chk(h.getSinkErrors() == 0);
+
+      // ~300kB: rotated, only the newest two old files kept
+      bool json_ok = true;
+      unsigned int lines = count_lines(path, json_ok) +
+	count_lines(path + ".1", json_ok) + count_lines(path + ".2", json_ok);
+      fct_chk(json_ok);
+      fct_chk(lines > 0 && lines < 2000);
+      fct_chk(access((path + ".1").c_str(), F_OK) == 0);
+      fct_chk(access((path + ".3").c_str(), F_OK) != 0);
+
+      unlink(path.c_str());
+      unlink((path + ".1").c_str());
+      unlink((path + ".2").c_str());
+      rmdir(dir);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(eventlog_overflow) {
+      // drop: the producer never waits
+      SlowSink* slow = new SlowSink(1000);
+      AsyncEventLogHandler drop(16, 4, AsyncEventLogHandler::Drop, 0);
+      drop.addSink(slow);
+      drop.start();
+      for (unsigned int i = 0; i < 200; i++)
+	drop.logEvent(1700000000, "ltag", "call-end", call_end_event(i));
+      drop.shutdown();
+
+      fct_chk(drop.getDropped() > 0);
+      fct_chk(drop.getQueued() + drop.getDropped() == 200);
+      fct_chk(drop.getWritten() == drop.getQueued());
+      fct_chk(slow->events.get() == drop.getWritten());
+
+      // wait: nothing lost while the sink keeps up within max_wait
+      slow = new SlowSink(100);
+      AsyncEventLogHandler wait(16, 4, AsyncEventLogHandler::Wait, 1000);
+      wait.addSink(slow);
+      wait.start();
+      for (unsigned int i = 0; i < 200; i++)
+	wait.logEvent(1700000000, "ltag", "call-end", call_end_event(i));
+      wait.shutdown();
+
+      fct_chk(wait.getDropped() == 0);
+      fct_chk(wait.getWaited() > 0);
+      fct_chk(wait.getWritten() == 200);
+      fct_chk(slow->events.get() == 200);
+
+      AmArg stats;
+      wait.getStats(stats);
+      fct_chk(stats["written"].asLongLong() == 200);
+      fct_chk(stats["pending"].asLongLong() == 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(eventlog_syslog_udp) {
+      int sd = socket(AF_INET, SOCK_DGRAM, 0);
+      struct sockaddr_in sa;
+      memset(&sa, 0, sizeof(sa));
+      sa.sin_family = AF_INET;
+      inet_pton(AF_INET, "127.0.0.1", &sa.sin_addr);
+      socklen_t sa_len = sizeof(sa);
+      fct_req(bind(sd, (struct sockaddr*)&sa, sizeof(sa)) == 0);
+      fct_req(getsockname(sd, (struct sockaddr*)&sa, &sa_len) == 0);
+      struct timeval tv = { 1, 0 };
+      setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+      SyslogEventLogSink sink(SyslogEventLogSink::UDP, "127.0.0.1",
+			      ntohs(sa.sin_port), -1);
+      fct_req(sink.open());
+      sink.logEvent(1700000000, "ltag", "cdr", AmArg("CDR: \"ltag\",1,2"));
+      fct_chk(sink.flush());
+
+      char buf[512];
+      ssize_t len = recv(sd, buf, sizeof(buf) - 1, 0);
+      fct_chk(len > 0);
+      if (len > 0) {
+	string msg(buf, len);
+	// user.info
+	fct_chk(msg.compare(0, 4, "<14>") == 0);
+	fct_chk(msg.find(" sems: CDR: \"ltag\",1,2") == msg.size() - 22);
+      }
+      close(sd);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), eventlog_bench) {
+      // debug output would dominate
+      int orig_log_level = log_level;
+      log_level = L_INFO;
+
+      // a syslog daemon taking 20us per event
+      SlowSink sync_sink(20);
+      double sync_ms = hangup_storm(&sync_sink);
+
+      SlowSink* async_sink = new SlowSink(20);
+      AsyncEventLogHandler h(BENCH_THREADS * BENCH_EVENTS, DEFAULT_EVENT_LOG_BATCH_SIZE,
+			     AsyncEventLogHandler::Drop, 0);
+      h.addSink(async_sink);
+      h.start();
+      double async_ms = hangup_storm(&h);
+      h.shutdown();
+
+      fct_chk(h.getDropped() == 0);
+      fct_chk(async_sink->events.get() == BENCH_THREADS * BENCH_EVENTS);
+
+      INFO("%u call-end events from %u threads: %.1fms logging in the "
+	   "calls' threads, %.1fms queued\n", BENCH_THREADS * BENCH_EVENTS,
+	   BENCH_THREADS, sync_ms, async_ms);
+
+      log_level = orig_log_level;
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
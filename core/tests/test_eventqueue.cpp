@@ -0,0 +1,121 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmEventQueue.h"
+#include "AmThread.h"
+
+#include <vector>
+using std::vector;
+
+#include <sys/time.h>
+
+#define POSTERS          8
+#define EVENTS_PER_POSTER 20000
+
+struct SeqEvent : public AmEvent
+{
+  unsigned int poster;
+  unsigned int seq;
+
+  SeqEvent(unsigned int poster, unsigned int seq)
+    : AmEvent(0), poster(poster), seq(seq) {}
+};
+
+struct SeqEventHandler : public AmEventHandler
+{
+  vector<unsigned int> next_seq;
+  unsigned int received;
+  unsigned int out_of_order;
+
+  SeqEventHandler()
+    : next_seq(POSTERS, 0), received(0), out_of_order(0) {}
+
+  void process(AmEvent* ev) {
+    SeqEvent* s_ev = dynamic_cast<SeqEvent*>(ev);
+    if(!s_ev) return;
+
+    if(next_seq[s_ev->poster] != s_ev->seq)
+      out_of_order++;
+    next_seq[s_ev->poster] = s_ev->seq + 1;
+    received++;
+  }
+};
+
+class EventPoster : public AmThread
+{
+  AmEventQueue* q;
+  unsigned int id;
+
+protected:
+  void run() {
+    for(unsigned int i=0; i<EVENTS_PER_POSTER; i++)
+      q->postEvent(new SeqEvent(id, i));
+  }
+  void on_stop() {}
+
+public:
+  EventPoster(AmEventQueue* q, unsigned int id)
+    : q(q), id(id) {}
+};
+
+FCTMF_SUITE_BGN(test_eventqueue) {
+
+    FCT_TEST_BGN(eventqueue_single_thread) {
+      SeqEventHandler h;
+      AmEventQueue q(&h);
+
+      fct_chk(!q.eventPending());
+      q.postEvent(new SeqEvent(0, 0));
+      q.postEvent(new SeqEvent(0, 1));
+      fct_chk(q.eventPending());
+
+      q.processSingleEvent();
+      fct_chk(h.received == 1);
+      fct_chk(q.eventPending());
+
+      q.processEvents();
+      fct_chk(h.received == 2);
+      fct_chk(!q.eventPending());
+
+      // events left in the queue are freed with it
+      AmEventQueue* q2 = new AmEventQueue(&h);
+      q2->postEvent(new SeqEvent(0, 2));
+      delete q2;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(eventqueue_contention) {
+      SeqEventHandler h;
+      AmEventQueue q(&h);
+
+      struct timeval start, end;
+      gettimeofday(&start, NULL);
+
+      vector<EventPoster*> posters;
+      for(unsigned int i=0; i<POSTERS; i++) {
+	posters.push_back(new EventPoster(&q, i));
+	posters.back()->start();
+      }
+
+      // one consumer, as a session thread would do
+      while(h.received < POSTERS * EVENTS_PER_POSTER) {
+	q.waitForEvent();
+	q.processEvents();
+      }
+
+      for(unsigned int i=0; i<POSTERS; i++) {
+	posters[i]->join();
+	delete posters[i];
+      }
+
+      gettimeofday(&end, NULL);
+      timersub(&end, &start, &end);
+      INFO("%u events from %u posters processed in %lu.%06lus\n",
+	   h.received, POSTERS, end.tv_sec, end.tv_usec);
+
+      fct_chk(h.received == POSTERS * EVENTS_PER_POSTER);
+      fct_chk(h.out_of_order == 0);
+      fct_chk(!q.eventPending());
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -133,4 +133,27 @@ FCTMF_SUITE_BGN(test_headers) {
       fct_chk(hdrs1.empty()== true); // last one
 
     } FCT_TEST_END();
+
+    FCT_TEST_BGN(findHeader_case_and_line_end) {
+      string hdrs =
+	"P-My-Test-2: other" CRLF
+	"p-my-test: myval" CRLF
+	"P-MY-TEST : myval2" CRLF
+	"Supported: timer";
+
+      fct_chk(getHeader(hdrs, "P-My-Test", true) == "myval");
+      fct_chk(getHeader(hdrs, "P-My-Test") == "myval, myval2");
+      fct_chk(getHeader(hdrs, "p-my-test-2") == "other");
+      fct_chk(getHeader(hdrs, "P-My").empty());
+      // last line without line end
+      fct_chk(getHeader(hdrs, "SUPPORTED") == "timer");
+      fct_chk(getHeader(hdrs, "Require", string("Supported")) == "timer");
+
+      size_t pos1, pos2, hdr_start;
+      fct_chk(findHeader(hdrs, "p-my-test", 0, pos1, pos2, hdr_start));
+      fct_chk(hdrs.substr(pos1, pos2 - pos1) == "myval");
+      fct_chk(findHeader(hdrs, "p-my-test", pos2, pos1, pos2, hdr_start));
+      fct_chk(hdrs.substr(pos1, pos2 - pos1) == "myval2");
+      fct_chk(!findHeader(hdrs, "p-my-test", pos2, pos1, pos2, hdr_start));
+    } FCT_TEST_END();
 } FCTMF_SUITE_END();
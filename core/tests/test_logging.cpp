@@ -0,0 +1,118 @@
+#include "fct.h"
+
+#include "log.h"
+#include "AmApi.h"
+#include "AmThread.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_LOG_MARKER "async-log-test"
+#define TEST_LOG_MSGS 1000
+
+class CountingLogger : public AmLoggingFacility
+{
+ public:
+  atomic_int received;
+
+  CountingLogger() : AmLoggingFacility("test_logging") {}
+
+  int onLoad() { return 0; }
+
+  void log(int level, pid_t pid, pthread_t tid, const char* func,
+	   const char* file, int line, char* msg) {
+    if(strstr(msg, TEST_LOG_MARKER))
+      received.inc();
+  }
+};
+
+// log hooks can not be unregistered
+static CountingLogger* test_logger = NULL;
+
+static void log_test_messages(unsigned int n)
+{
+  char msg[64];
+  for(unsigned int i=0; i<n; i++) {
+    snprintf(msg, sizeof(msg), TEST_LOG_MARKER " %u", i);
+    run_log_hooks(L_INFO, GET_PID(), GET_TID(), __FUNCTION__,
+		  __FILE__, __LINE__, msg);
+  }
+}
+
+class LogTestThread : public AmThread
+{
+ protected:
+  void run() { log_test_messages(TEST_LOG_MSGS); }
+  void on_stop() {}
+};
+
+FCTMF_SUITE_BGN(test_logging) {
+
+    if(!test_logger) {
+      test_logger = new CountingLogger();
+      register_log_hook(test_logger);
+    }
+
+    FCT_TEST_BGN(logging_async_delivers_all) {
+      test_logger->received.set(0);
+      unsigned long dropped = get_async_log_dropped();
+
+      fct_req(start_async_logging(TEST_LOG_MSGS * 2) == 0);
+      log_test_messages(TEST_LOG_MSGS);
+      stop_async_logging();
+
+      fct_chk_eq_int(get_async_log_dropped() - dropped, 0);
+      fct_chk_eq_int(test_logger->received.get(), TEST_LOG_MSGS);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(logging_async_full_queue_drops) {
+      test_logger->received.set(0);
+      unsigned long dropped = get_async_log_dropped();
+
+      fct_req(start_async_logging(2) == 0);
+      log_test_messages(TEST_LOG_MSGS);
+      stop_async_logging();
+
+      // producers never block: what did not fit is counted
+      unsigned long now_dropped = get_async_log_dropped() - dropped;
+      fct_chk(now_dropped > 0);
+      fct_chk_eq_int(test_logger->received.get() + now_dropped,
+		     TEST_LOG_MSGS);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(logging_async_restart) {
+      for(unsigned int i=0; i<2; i++) {
+	test_logger->received.set(0);
+	fct_req(start_async_logging(TEST_LOG_MSGS * 2) == 0);
+	log_test_messages(TEST_LOG_MSGS);
+	stop_async_logging();
+	fct_chk_eq_int(test_logger->received.get(), TEST_LOG_MSGS);
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(logging_async_stop_while_logging) {
+      test_logger->received.set(0);
+      unsigned long dropped = get_async_log_dropped();
+
+      fct_req(start_async_logging(TEST_LOG_MSGS * 8) == 0);
+      LogTestThread threads[4];
+      for(unsigned int i=0; i<4; i++)
+	threads[i].start();
+      while(test_logger->received.get() < TEST_LOG_MSGS)
+	usleep(100);
+      // records in flight while stopping are written, not lost
+      stop_async_logging();
+      for(unsigned int i=0; i<4; i++)
+	threads[i].join();
+
+      fct_chk_eq_int(get_async_log_dropped() - dropped, 0);
+      fct_chk_eq_int(test_logger->received.get(), 4 * TEST_LOG_MSGS);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(logging_sync_after_stop) {
+      test_logger->received.set(0);
+      log_test_messages(10);
+      fct_chk_eq_int(test_logger->received.get(), 10);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,172 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "../../apps/sbc/ParamReplacer.h"
+
+#include "bench.h"
+
+#define BENCH_REQUESTS 20000
+
+static void init_request(AmSipRequest& req)
+{
+  req.method = "INVITE";
+  req.r_uri = "sip:alice@10.0.0.1:5070;transport=udp;user=phone?X=1";
+  req.user = "alice";
+  req.from = "\"Bob B\" <sip:bob@example.org;p1=v1>;tag=abc";
+  req.from_tag = "abc";
+  req.to = "<sip:alice@example.com>";
+  req.callid = "cid-123@host";
+  req.remote_ip = "192.0.2.5";
+  req.remote_port = 5062;
+  req.local_ip = "10.0.0.1";
+  req.local_port = 5060;
+  req.local_if = 0;
+  req.hdrs =
+    "P-Asserted-Identity: \"PAI\" <sip:+4930123@pai.example:5080;x=y>\r\n"
+    "X-Foo: bar\r\n"
+    "X-Uri: <sip:u@h.example;tp=tcp>\r\n";
+}
+
+static string replace(const string& s)
+{
+  AmSipRequest req;
+  init_request(req);
+  ParamReplacerCtx ctx;
+  ctx.app_param = "profile=prof1;other=2";
+  return ctx.replaceParameters(s, "test", req);
+}
+
+/** active_profile rules and profile fields of a typical SBC setup */
+static const char* bench_patterns[] = {
+  // active_profile
+  "$H(P-Profile)", "$_l($H(X-Foo))", "$P(profile)",
+  // RURI, From, To, Call-ID, next hop
+  "sip:$rU@$H(X-Foo):5060;transport=$rP(transport)",
+  "\"$fn\" <sip:$fU@$fd>", "<sip:$tU@$td>", "$_5($ci)",
+  "$ai",
+  // append_headers
+  "P-Src: $si:$sp\\r\\nP-Orig: $fu\\r\\nX-Prof: $P(profile)\\r\\n",
+  // static fields
+  "sip:proxy.example.com;lr", "udp", "yes", "",
+};
+
+static double bench(bool precompiled)
+{
+  AmSipRequest req;
+  init_request(req);
+  unsigned int n = sizeof(bench_patterns) / sizeof(bench_patterns[0]);
+
+  ParamTemplateSet templates;
+  for (unsigned int p=0; p<n; p++)
+    templates.add(bench_patterns[p]);
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  for (unsigned int i=0; i<BENCH_REQUESTS; i++) {
+    ParamReplacerCtx ctx;
+    ctx.app_param = "profile=prof1";
+    ctx.templates = &templates;
+    for (unsigned int p=0; p<n; p++) {
+      if (precompiled) {
+	ctx.replaceParameters(bench_patterns[p], "bench", req);
+      } else {
+	// compile for each request
+	ParamTemplate t(bench_patterns[p]);
+	string res;
+	t.expand(ctx, req, res);
+      }
+    }
+  }
+  return bench_seconds(start) * 1e6 / BENCH_REQUESTS;
+}
+
+FCTMF_SUITE_BGN(test_paramreplacer) {
+
+    FCT_TEST_BGN(paramreplacer_request) {
+      fct_chk(replace("plain") == "plain");
+      fct_chk(replace("$f") == "\"Bob B\" <sip:bob@example.org;p1=v1>;tag=abc");
+      fct_chk(replace("$ft") == "abc");
+      fct_chk(replace("$tU@$td") == "alice@example.com");
+      fct_chk(replace("$ru") == "alice@10.0.0.1:5070");
+      fct_chk(replace("$rP(transport)x") == "udpx");
+      fct_chk(replace("$fP") == "p1=v1");
+      fct_chk(replace("$ci $si:$sp $Ri:$Rp $m") ==
+	      "cid-123@host 192.0.2.5:5062 10.0.0.1:5060 INVITE");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(paramreplacer_headers) {
+      fct_chk(replace("$ai") == "+4930123@pai.example:5080");
+      fct_chk(replace("$aP(x)") == "y");
+      fct_chk(replace("$H(X-Foo)z") == "barz");
+      fct_chk(replace("$Hh(X-Uri)") == "h.example");
+      fct_chk(replace("$H.(X-Uri)") == "<sip:u@h.example;tp=tcp>");
+      fct_chk(replace("$P(profile)") == "prof1");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(paramreplacer_nested) {
+      fct_chk(replace("$_u($rU)") == "ALICE");
+      fct_chk(replace("$_l(ABC$fU)") == "abcbob");
+      fct_chk(replace("$_u(a(b)c)d") == "A(B)Cd");
+      fct_chk(replace("$#(a b&c)") == "a+b%26c");
+      fct_chk(replace("$fU-$tU-$_u($H(X-Foo))") == "bob-alice-BAR");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(paramreplacer_escapes) {
+      fct_chk(replace("\\r\\n\\t\\x") == "\r\n\tx");
+      fct_chk(replace("x\\$f") == "x$f");
+      fct_chk(replace("a\\") == "a\\");
+      fct_chk(replace("a$") == "a");
+      fct_chk(replace("$P(unclosed") == "unclosed");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(paramreplacer_template_set) {
+      ParamTemplateSet templates;
+      templates.add("compiled $rU");
+      templates.add("plain");
+      fct_chk(templates.size() == 1);
+      fct_chk(templates.find("plain") == NULL);
+
+      const ParamTemplate* t = templates.find("compiled $rU");
+      fct_chk(t != NULL);
+      fct_chk(t->isReplaced());
+      fct_chk(t->getLiteralLength() == 9);
+
+      // copies share the compiled patterns
+      ParamTemplateSet copy(templates);
+      templates = ParamTemplateSet();
+      fct_chk(templates.find("compiled $rU") == NULL);
+      fct_chk(copy.find("compiled $rU") == t);
+
+      AmSipRequest req;
+      init_request(req);
+      ParamReplacerCtx ctx;
+      ctx.templates = &copy;
+      fct_chk(ctx.replaceParameters("compiled $rU", "test", req) ==
+	      "compiled alice");
+      fct_chk(ctx.replaceParameters("other $rU", "test", req) ==
+	      "other alice");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(paramreplacer_header_uri_changed) {
+      AmSipRequest req;
+      init_request(req);
+      ParamReplacerCtx ctx;
+      fct_chk(ctx.replaceParameters("$HU(X-Uri)", "test", req) == "u");
+      req.hdrs = "X-Uri: <sip:v@h.example>\r\n";
+      fct_chk(ctx.replaceParameters("$HU(X-Uri)", "test", req) == "v");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), paramreplacer_bench) {
+      // debug output would dominate
+      int orig_log_level = log_level;
+      log_level = L_INFO;
+      double us_compiled = bench(false);
+      double us_precompiled = bench(true);
+      log_level = orig_log_level;
+      INFO("%u requests: replacing a profile set %.3fus per request "
+	   "parsing the patterns, %.3fus with precompiled templates\n",
+	   BENCH_REQUESTS, us_compiled, us_precompiled);
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,178 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmPrefixTable.h"
+#include "AmUtils.h"
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <map>
+
+#define BENCH_PREFIXES 10000000
+#define BENCH_LOOKUPS  1000000
+
+static string random_number(unsigned int min_len, unsigned int max_len)
+{
+  unsigned int len = min_len + random() % (max_len - min_len + 1);
+  string res;
+  for (unsigned int i = 0; i < len; i++)
+    res += '0' + random() % 10;
+  return res;
+}
+
+/** longest prefix match trying every length */
+static const string* naive_lookup(const std::map<string, string>& m, const string& n)
+{
+  for (size_t len = n.length() + 1; len-- > 0;) {
+    std::map<string, string>::const_iterator it = m.find(n.substr(0, len));
+    if (it != m.end())
+      return &it->second;
+  }
+  return NULL;
+}
+
+FCTMF_SUITE_BGN(test_prefixtable) {
+
+    FCT_TEST_BGN(prefixtable_lookup) {
+      AmPrefixTable t;
+      fct_chk(t.lookup("4930") == NULL);
+
+      fct_chk(t.add("+49", "de"));
+      fct_chk(t.add("4930", "berlin"));
+      fct_chk(t.add("49301", "berlin1"));
+      fct_chk(t.add("4940", "hamburg"));
+      fct_chk(t.add("4930", "berlin, again"));
+      fct_chk(t.add("1", "nanp"));
+      fct_chk(t.add("999999999999999999", "long"));
+      fct_chk(!t.add("49a", "invalid"));
+      fct_chk(!t.add("1234567890123456789", "too long"));
+      t.build();
+
+      fct_chk(t.size() == 6);
+      fct_chk(t.getDuplicates() == 1);
+      fct_chk(t.getValues() == 7);
+
+      size_t len = 0;
+      const string* v = t.lookup("+493012345", &len);
+      fct_chk(v && *v == "berlin1" && len == 5);
+      v = t.lookup("4930", &len);
+      fct_chk(v && *v == "berlin" && len == 4);
+      v = t.lookup("493", &len);
+      fct_chk(v && *v == "de" && len == 2);
+      fct_chk(t.lookup("4") == NULL);
+      v = t.lookup("494012;npdi");
+      fct_chk(v && *v == "hamburg");
+      v = t.lookup("4950");
+      fct_chk(v && *v == "de");
+      v = t.lookup("12125551234");
+      fct_chk(v && *v == "nanp");
+      fct_chk(t.lookup("2") == NULL);
+      fct_chk(t.lookup("") == NULL);
+      fct_chk(t.lookup("sip:4930") == NULL);
+      v = t.lookup("99999999999999999999");
+      fct_chk(v && *v == "long");
+      fct_chk(t.lookup("99999999999999999") == NULL);
+
+      // default route
+      fct_chk(t.add("", "default"));
+      fct_chk(t.add("4930", "berlin"));
+      t.build();
+      fct_chk(t.size() == 2);
+      v = t.lookup("2");
+      fct_chk(v && *v == "default");
+      v = t.lookup("49301");
+      fct_chk(v && *v == "berlin");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(prefixtable_random) {
+      srandom(42);
+      std::map<string, string> m;
+      AmPrefixTable t;
+      for (unsigned int i = 0; i < 20000; i++) {
+	string p = random_number(1, 6);
+	string v = "r" + int2str((unsigned int)(random() % 50));
+	m.insert(std::make_pair(p, v));
+	t.add(p, v);
+      }
+      t.build();
+      fct_chk(t.size() == m.size());
+
+      unsigned int errors = 0;
+      for (unsigned int i = 0; i < 100000; i++) {
+	string n = random_number(0, 8);
+	const string* v = t.lookup(n.c_str());
+	const string* nv = naive_lookup(m, n);
+	if ((v == NULL) != (nv == NULL) || (v && *v != *nv))
+	  errors++;
+      }
+      fct_chk(errors == 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(prefixtable_load) {
+      string fname = "/tmp/sems_prefixtable_" + int2str((unsigned int)getpid());
+      FILE* f = fopen(fname.c_str(), "w");
+      fct_req(f != NULL);
+      fprintf(f, "# prefix, route\n\n+49;sip:gw-de.example.com\n"
+	      "4930, sip:gw-berlin.example.com;transport=tcp\r\n"
+	      "  1\tnanp\n44\n");
+      fclose(f);
+
+      AmPrefixTable t;
+      fct_chk(t.load(fname));
+      fct_chk(t.size() == 4);
+      const string* v = t.lookup("+4930123");
+      fct_chk(v && *v == "sip:gw-berlin.example.com;transport=tcp");
+      v = t.lookup("4989");
+      fct_chk(v && *v == "sip:gw-de.example.com");
+      v = t.lookup("1212");
+      fct_chk(v && *v == "nanp");
+      v = t.lookup("4420");
+      fct_chk(v && v->empty());
+
+      f = fopen(fname.c_str(), "w");
+      fct_req(f != NULL);
+      fprintf(f, "49 de\n49x invalid\n");
+      fclose(f);
+      AmPrefixTable t2;
+      fct_chk(!t2.load(fname));
+      fct_chk(t2.size() == 0);
+
+      unlink(fname.c_str());
+      fct_chk(!t2.load(fname));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), prefixtable_bench) {
+      srandom(43);
+      struct timeval start;
+      gettimeofday(&start, NULL);
+      AmPrefixTable t;
+      for (unsigned int i = 0; i < BENCH_PREFIXES; i++) {
+	// E.164 numbers: country code and some digits of the number
+	t.add(random_number(6, 12), "carrier" + int2str(i % 64));
+      }
+      t.build();
+      double build_s = bench_seconds(start);
+
+      std::vector<string> numbers;
+      for (unsigned int i = 0; i < BENCH_LOOKUPS; i++)
+	numbers.push_back(random_number(11, 15));
+
+      unsigned int found = 0;
+      gettimeofday(&start, NULL);
+      for (unsigned int i = 0; i < BENCH_LOOKUPS; i++) {
+	if (t.lookup(numbers[i].c_str()))
+	  found++;
+      }
+      double lookup_s = bench_seconds(start);
+      fct_chk(found > 0);
+
+      INFO("%zd prefixes (%zd duplicates) built in %.3fs, %.3fus per lookup "
+	   "(%u of %u found)\n", t.size(), t.getDuplicates(), build_s,
+	   lookup_s * 1e6 / BENCH_LOOKUPS, found, BENCH_LOOKUPS);
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,163 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmUtils.h"
+#include "../../apps/sbc/RegisterCache.h"
+#include "../../apps/sbc/RegExpiryWheel.h"
+
+#include "bench.h"
+
+#include <stdlib.h>
+
+#define BENCH_BINDINGS 1000000
+#define BENCH_SECONDS  60
+
+static AliasEntry alias_entry(unsigned int i, long int now)
+{
+  AliasEntry ae;
+  ae.aor = "sip:user" + int2str(i) + "@example.com";
+  ae.alias = "alias" + int2str(i);
+  ae.contact_uri = "sip:user" + int2str(i) + "@10.0.0.1:5062";
+  ae.source_ip = "192.0.2." + int2str(i % 256);
+  ae.source_port = 5060;
+  ae.trsp = "udp";
+  ae.ua_expire = now + 60;
+  return ae;
+}
+
+FCTMF_SUITE_BGN(test_regcacheexpiry) {
+
+    FCT_TEST_BGN(regexpirywheel_order) {
+      const long int base = 1000000000L;
+      const long int offsets[] = {
+	0, 1, 2, 63, 64, 65, 127, 4095, 4096, 4097, 100000, 262143, 262144,
+	300000, 20000000
+      };
+      const unsigned int n = sizeof(offsets) / sizeof(offsets[0]);
+
+      RegExpiryWheel wheel(base);
+      string keys[n];
+      RegExpiryTimer timers[n];
+      for (unsigned int i = 0; i < n; i++) {
+	keys[i] = int2str(i);
+	timers[i].aor = timers[i].idx = &keys[i];
+	wheel.schedule(&timers[i], base + offsets[i]);
+      }
+      fct_chk(wheel.getScheduled() == n);
+
+      // each one fires in its second, not before
+      vector<pair<string,string> > expired;
+      bool in_time = true;
+      unsigned int fired = 0;
+      for (long int t = base; t <= base + 300000; t++) {
+	expired.clear();
+	wheel.expire(t, expired);
+	for (unsigned int e = 0; e < expired.size(); e++) {
+	  unsigned int i = atoi(expired[e].first.c_str());
+	  if (base + offsets[i] != t) in_time = false;
+	  fired++;
+	}
+      }
+      fct_chk(in_time);
+      fct_chk(fired == n - 1);
+
+      expired.clear();
+      wheel.expire(base + 20000000 - 1, expired);
+      fct_chk(expired.empty());
+      wheel.expire(base + 20000000, expired);
+      fct_chk(expired.size() == 1);
+      fct_chk(wheel.getScheduled() == 0);
+
+      // re-scheduled and destroyed timers
+      RegExpiryTimer* t = new RegExpiryTimer();
+      t->aor = t->idx = &keys[0];
+      wheel.schedule(&timers[1], base + 20000010);
+      wheel.schedule(t, base + 20000010);
+      wheel.schedule(&timers[1], base + 20000020);
+      delete t;
+      fct_chk(wheel.getScheduled() == 1);
+      expired.clear();
+      wheel.expire(base + 20000019, expired);
+      fct_chk(expired.empty());
+      wheel.expire(base + 20000020, expired);
+      fct_chk(expired.size() == 1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(regcacheexpiry_bindings) {
+      RegisterCache::dispose();
+      _RegisterCache* cache = RegisterCache::instance();
+      long int now = time(NULL);
+
+      for (unsigned int i = 0; i < 10; i++) {
+	AliasEntry ae = alias_entry(i, now);
+	cache->update(ae.alias, now + 10 + i * 100, ae);
+      }
+      fct_chk(cache->getScheduledExpiries() == 10);
+
+      // refreshed at the registrar, and removed
+      AliasEntry ae0 = alias_entry(0, now);
+      cache->update(ae0.alias, now + 5000, ae0);
+      AliasEntry ae1 = alias_entry(1, now);
+      cache->remove(ae1.aor, ae1.contact_uri, ae1.alias);
+      fct_chk(cache->getScheduledExpiries() == 9);
+
+      cache->expireBindings(now + 9);
+      fct_chk(cache->getActiveRegs() == 9);
+      cache->expireBindings(now + 210);
+      fct_chk(cache->getActiveRegs() == 8);
+      fct_chk(cache->getExpiredRegs() == 1);
+
+      AliasEntry ae;
+      fct_chk(cache->findAliasEntry("alias0", ae));
+      fct_chk(!cache->findAliasEntry("alias2", ae));
+      fct_chk(cache->findAliasEntry("alias3", ae));
+      RegBinding b;
+      fct_chk(!cache->getAlias(alias_entry(2, now).aor, alias_entry(2, now).contact_uri,
+			       alias_entry(2, now).source_ip, b));
+
+      cache->expireBindings(now + 4999);
+      fct_chk(cache->getActiveRegs() == 1);
+      cache->expireBindings(now + 5000);
+      fct_chk(cache->getActiveRegs() == 0);
+      fct_chk(cache->getExpiredRegs() == 9);
+      fct_chk(cache->getScheduledExpiries() == 0);
+      fct_chk(cache->getExpiryRuns() == 4);
+
+      RegisterCache::dispose();
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), regcacheexpiry_bench) {
+      // debug output would dominate
+      int orig_log_level = log_level;
+      log_level = L_INFO;
+
+      RegisterCache::dispose();
+      _RegisterCache* cache = RegisterCache::instance();
+      long int now = time(NULL);
+
+      // spread over one hour
+      for (unsigned int i = 0; i < BENCH_BINDINGS; i++) {
+	AliasEntry ae = alias_entry(i, now);
+	cache->update(ae.alias, now + 1 + (i * 7919L) % 3600, ae);
+      }
+
+      struct timeval start;
+      gettimeofday(&start, NULL);
+      for (long int t = now + 1; t <= now + BENCH_SECONDS; t++)
+	cache->expireBindings(t);
+      double wheel_us = bench_seconds(start) * 1e6 / BENCH_SECONDS;
+      unsigned int expired = cache->getExpiredRegs();
+
+      fct_chk(cache->getActiveRegs() == BENCH_BINDINGS - expired);
+      fct_chk(cache->getScheduledExpiries() == BENCH_BINDINGS - expired);
+
+      INFO("%u bindings: expiring %u bindings per second took %.0fus "
+	   "(%.0fus CPU)\n", BENCH_BINDINGS, expired / BENCH_SECONDS, wheel_us,
+	   (double)cache->getExpiryCPUTime() / cache->getExpiryRuns());
+
+      RegisterCache::dispose();
+      log_level = orig_log_level;
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,178 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmUtils.h"
+#include "../../apps/sbc/RegisterCache.h"
+#include "../../apps/sbc/RegCacheStorage.h"
+
+#include "bench.h"
+
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define BENCH_BINDINGS 1000000
+
+static string tmp_dir()
+{
+  string dir = "/tmp/sems_regcache_" + int2str((unsigned int)getpid());
+  mkdir(dir.c_str(), 0700);
+  return dir;
+}
+
+static void remove_dir(const string& dir)
+{
+  if (system(("rm -rf " + dir).c_str())) {}
+}
+
+static AliasEntry alias_entry(unsigned int i, long int now)
+{
+  AliasEntry ae;
+  ae.aor = "sip:user" + int2str(i) + "@example.com";
+  ae.alias = "alias" + int2str(i);
+  ae.contact_uri = "sip:user" + int2str(i) + "@10.0." + int2str(i / 256 % 256)
+    + "." + int2str(i % 256) + ":5062;transport=udp";
+  ae.source_ip = "192.0.2." + int2str(i % 256);
+  ae.source_port = 5060 + i % 1000;
+  ae.trsp = "udp";
+  ae.local_if = i % 2;
+  ae.remote_ua = "test-ua/1.0";
+  ae.ua_expire = now + 60;
+  return ae;
+}
+
+/** new register cache, restored from 'dir' */
+static RegCacheFileStorage* restart(const string& dir, unsigned int threads)
+{
+  RegisterCache::dispose();
+  RegCacheFileStorage* s =
+    new RegCacheFileStorage(RegisterCache::instance(), dir, 0, threads);
+  if (!s->restore()) {
+    delete s;
+    return NULL;
+  }
+  RegisterCache::instance()->setStorageHandler(s);
+  return s;
+}
+
+FCTMF_SUITE_BGN(test_regcachestorage) {
+
+    FCT_TEST_BGN(regcachestorage_restore) {
+      string dir = tmp_dir();
+      long int now = time(NULL);
+      RegCacheFileStorage* s = restart(dir, 2);
+      fct_req(s != NULL);
+      fct_chk(RegisterCache::instance()->getActiveRegs() == 0);
+
+      for (unsigned int i = 0; i < 4; i++) {
+	AliasEntry ae = alias_entry(i, now);
+	RegisterCache::instance()->update(ae.alias, now + 3600, ae);
+      }
+      RegisterCache::instance()->updateAliasExpires("alias1", now + 120);
+      AliasEntry ae2 = alias_entry(2, now);
+      RegisterCache::instance()->remove(ae2.aor, ae2.contact_uri, ae2.alias);
+      // expired at the registrar meanwhile
+      AliasEntry ae3 = alias_entry(3, now);
+      RegisterCache::instance()->update(ae3.alias, now - 1, ae3);
+      fct_chk(s->getJournalRecords() == 7);
+
+      // from the journal
+      s = restart(dir, 2);
+      fct_req(s != NULL);
+      fct_chk(RegisterCache::instance()->getActiveRegs() == 2);
+      fct_chk(s->getRestoredBindings() == 2);
+
+      AliasEntry ae, ae1 = alias_entry(1, now);
+      fct_chk(RegisterCache::instance()->findAliasEntry("alias1", ae));
+      fct_chk(ae.ua_expire == now + 120);
+      fct_chk(ae.aor == ae1.aor);
+      fct_chk(ae.contact_uri == ae1.contact_uri);
+      fct_chk(ae.source_ip == ae1.source_ip);
+      fct_chk(ae.source_port == ae1.source_port);
+      fct_chk(ae.trsp == ae1.trsp);
+      fct_chk(ae.local_if == ae1.local_if);
+      fct_chk(ae.remote_ua == ae1.remote_ua);
+      fct_chk(!RegisterCache::instance()->findAliasEntry("alias2", ae));
+      fct_chk(!RegisterCache::instance()->findAliasEntry("alias3", ae));
+
+      RegBinding b;
+      fct_chk(RegisterCache::instance()->getAlias(ae1.aor, ae1.contact_uri,
+						  ae1.source_ip, b));
+      fct_chk(b.alias == "alias1");
+      fct_chk(b.reg_expire == now + 3600);
+      fct_chk(RegisterCache::instance()->findAEByContact(ae1.contact_uri, ae1.source_ip,
+							 ae1.source_port, ae));
+      fct_chk(ae.alias == "alias1");
+
+      // snapshot, and changes after it
+      fct_chk(s->writeSnapshot());
+      AliasEntry ae4 = alias_entry(4, now);
+      RegisterCache::instance()->update(ae4.alias, now + 3600, ae4);
+      AliasEntry ae0 = alias_entry(0, now);
+      RegisterCache::instance()->remove(ae0.aor, ae0.contact_uri, ae0.alias);
+
+      s = restart(dir, 3);
+      fct_req(s != NULL);
+      fct_chk(RegisterCache::instance()->getActiveRegs() == 2);
+      fct_chk(RegisterCache::instance()->findAliasEntry("alias1", ae));
+      fct_chk(RegisterCache::instance()->findAliasEntry("alias4", ae));
+      fct_chk(!RegisterCache::instance()->findAliasEntry("alias0", ae));
+
+      // incomplete record at the end of a journal
+      s->writeSnapshot();
+      RegisterCache::instance()->updateAliasExpires("alias4", now + 30);
+      RegisterCache::dispose();
+      int fd = open((dir + "/regcache.journal.1000").c_str(),
+		    O_WRONLY | O_CREAT | O_TRUNC, 0600);
+      fct_req(fd >= 0);
+      fct_chk(write(fd, "SEMSREG1\xe8\x03\x00\x00\x20\x00\x00\x00xx", 16) == 16);
+      close(fd);
+
+      s = restart(dir, 1);
+      fct_req(s != NULL);
+      fct_chk(RegisterCache::instance()->getActiveRegs() == 2);
+      fct_chk(RegisterCache::instance()->findAliasEntry("alias4", ae));
+      fct_chk(ae.ua_expire == now + 30);
+
+      RegisterCache::dispose();
+      remove_dir(dir);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), regcachestorage_bench) {
+      // debug output would dominate
+      int orig_log_level = log_level;
+      log_level = L_INFO;
+
+      string dir = tmp_dir();
+      long int now = time(NULL);
+      RegCacheFileStorage* s = restart(dir, DEFAULT_REG_CACHE_RESTORE_THREADS);
+      fct_req(s != NULL);
+
+      struct timeval start;
+      gettimeofday(&start, NULL);
+      for (unsigned int i = 0; i < BENCH_BINDINGS; i++) {
+	AliasEntry ae = alias_entry(i, now);
+	RegisterCache::instance()->update(ae.alias, now + 3600, ae);
+      }
+      double insert_s = bench_seconds(start);
+
+      gettimeofday(&start, NULL);
+      fct_chk(s->writeSnapshot());
+      double snapshot_s = bench_seconds(start);
+
+      s = restart(dir, DEFAULT_REG_CACHE_RESTORE_THREADS);
+      fct_req(s != NULL);
+      fct_chk(RegisterCache::instance()->getActiveRegs() == BENCH_BINDINGS);
+
+      INFO("%u bindings: inserted in %.3fs, snapshot written in %.3fs, "
+	   "restored in %.3fs\n", BENCH_BINDINGS, insert_s, snapshot_s,
+	   s->getRestoreTime());
+
+      RegisterCache::dispose();
+      remove_dir(dir);
+      log_level = orig_log_level;
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,143 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmUtils.h"
+
+#include "bench.h"
+
+#define BENCH_PREFIXES 20000
+#define BENCH_LOOKUPS  200
+
+static const char* mapping[][2] = {
+  { "^sip:\\+4930", "berlin" },
+  { "^sip:\\+49(.*)@", "de-\\1" },
+  { ".*@example\\.org$", "example" },
+  { "^sip:\\+493012", "never, berlin is first" },
+  { "^sip:\\+44[0-9]*@", "uk" },
+  { "^sip:(alice|bob)@", "\\1" },
+  { "^sips?:", "other" },
+};
+
+/** @return number of entries added */
+static unsigned int fill(RegexMapping& m, RegexMappingVector& v)
+{
+  unsigned int added = 0;
+  for (unsigned int i=0; i<sizeof(mapping)/sizeof(mapping[0]); i++) {
+    if (m.add(mapping[i][0], mapping[i][1]))
+      added++;
+    regex_t re;
+    regcomp(&re, mapping[i][0], REG_EXTENDED);
+    v.push_back(make_pair(re, string(mapping[i][1])));
+  }
+  return added;
+}
+
+static void free_mapping(RegexMappingVector& v)
+{
+  for (RegexMappingVector::iterator it = v.begin(); it != v.end(); it++)
+    regfree(&it->first);
+  v.clear();
+}
+
+/** @return result of both, or "!" if they differ */
+static string run_both(const RegexMapping& m, const RegexMappingVector& v,
+		       const char* s)
+{
+  string res, v_res;
+  bool matched = m.run(s, res);
+  bool v_matched = run_regex_mapping(v, s, v_res);
+  if (matched != v_matched || (matched && res != v_res))
+    return "!";
+  return matched ? res : "-";
+}
+
+static double bench(const RegexMapping& m, const RegexMappingVector& v,
+		    bool indexed, unsigned int& matched)
+{
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  matched = 0;
+  for (unsigned int i=0; i<BENCH_LOOKUPS; i++) {
+    string s = "sip:+49" + int2str((i * 7919) % BENCH_PREFIXES + 10000) + "5555@gw";
+    string res;
+    if (indexed ? m.run(s.c_str(), res) : run_regex_mapping(v, s.c_str(), res))
+      matched++;
+  }
+  return bench_seconds(start) * 1e6 / BENCH_LOOKUPS;
+}
+
+FCTMF_SUITE_BGN(test_regexmapping) {
+
+    FCT_TEST_BGN(regexmapping_prefix) {
+      fct_chk(RegexMapping::anchoredPrefix("^sip:\\+4930") == "sip:+4930");
+      fct_chk(RegexMapping::anchoredPrefix("^abc.*") == "abc");
+      fct_chk(RegexMapping::anchoredPrefix("^abc*") == "ab");
+      fct_chk(RegexMapping::anchoredPrefix("^abc?d") == "ab");
+      fct_chk(RegexMapping::anchoredPrefix("^ab{0,2}") == "a");
+      fct_chk(RegexMapping::anchoredPrefix("^ab+") == "ab");
+      fct_chk(RegexMapping::anchoredPrefix("^ab[0-9]") == "ab");
+      fct_chk(RegexMapping::anchoredPrefix("^ab(c)") == "ab");
+      fct_chk(RegexMapping::anchoredPrefix("^a\\.b$") == "a.b");
+      fct_chk(RegexMapping::anchoredPrefix("^a\\d") == "a");
+      fct_chk(RegexMapping::anchoredPrefix("^(a|b)") == "");
+      fct_chk(RegexMapping::anchoredPrefix("^ab|cd") == "");
+      fct_chk(RegexMapping::anchoredPrefix("abc") == "");
+      fct_chk(RegexMapping::anchoredPrefix("^.*") == "");
+      fct_chk(RegexMapping::anchoredPrefix("") == "");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(regexmapping_first_match) {
+      RegexMapping m;
+      RegexMappingVector v;
+      fct_chk(fill(m, v) == 7);
+      fct_chk(m.size() == 7);
+      fct_chk(m.indexed() == 5);
+
+      fct_chk(run_both(m, v, "sip:+4930123@gw") == "berlin");
+      fct_chk(run_both(m, v, "sip:+4940123@gw") == "de-40123");
+      fct_chk(run_both(m, v, "sip:+4940123@example.org") == "de-40123");
+      fct_chk(run_both(m, v, "sip:+33@example.org") == "example");
+      fct_chk(run_both(m, v, "sip:+441234@gw") == "uk");
+      fct_chk(run_both(m, v, "sip:+44x@gw") == "other");
+      fct_chk(run_both(m, v, "sip:bob@gw") == "bob");
+      fct_chk(run_both(m, v, "sips:+4930") == "other");
+      fct_chk(run_both(m, v, "tel:+4930") == "-");
+      fct_chk(run_both(m, v, "") == "-");
+
+      m.clear();
+      fct_chk(m.size() == 0);
+      string res;
+      fct_chk(!m.run("sip:+4930123@gw", res));
+      fct_chk(!m.add("^(", "invalid"));
+      free_mapping(v);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), regexmapping_bench) {
+      RegexMapping m;
+      RegexMappingVector v;
+      for (unsigned int i=0; i<BENCH_PREFIXES; i++) {
+	string re = "^sip:\\+49" + int2str(i + 10000) + "(.*)@";
+	string val = "gw" + int2str(i) + ";user=\\1";
+	m.add(re, val);
+	regex_t r;
+	regcomp(&r, re.c_str(), REG_EXTENDED);
+	v.push_back(make_pair(r, val));
+      }
+      fct_chk(m.indexed() == BENCH_PREFIXES);
+
+      int orig_log_level = log_level;
+      log_level = L_INFO;
+      unsigned int matched = 0, v_matched = 0;
+      double us_linear = bench(m, v, false, v_matched);
+      double us_indexed = bench(m, v, true, matched);
+      log_level = orig_log_level;
+
+      fct_chk(matched == BENCH_LOOKUPS);
+      fct_chk(v_matched == matched);
+      INFO("%u prefixes: %.3fus per lookup trying each regex, "
+	   "%.3fus with prefix index\n", BENCH_PREFIXES, us_linear, us_indexed);
+      free_mapping(v);
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
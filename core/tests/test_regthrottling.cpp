@@ -0,0 +1,151 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmUtils.h"
+#include "AmSipHeaders.h"
+#include "../../apps/sbc/RegisterCache.h"
+
+#define SIM_UAS 3600
+
+static AmSipRequest register_req(unsigned int i, const string& expires = "")
+{
+  AmSipRequest req;
+  req.method = SIP_METH_REGISTER;
+  req.from = "<sip:user" + int2str(i) + "@example.com>;tag=" + int2str(i);
+  req.contact = "<sip:user" + int2str(i) + "@10.0.0.1:5062>" + expires;
+  req.remote_ip = "192.0.2.1";
+  req.remote_port = 5060 + i % 1000;
+  return req;
+}
+
+/** cache the binding as if the registrar had accepted it */
+static void cache_binding(unsigned int i, long int reg_expire)
+{
+  AmSipRequest req = register_req(i);
+  AliasEntry ae;
+  ae.aor = RegisterCache::canonicalize_aor("sip:user" + int2str(i) + "@example.com");
+  ae.alias = "alias" + int2str(i);
+  ae.contact_uri = "sip:user" + int2str(i) + "@10.0.0.1:5062";
+  ae.source_ip = req.remote_ip;
+  ae.source_port = req.remote_port;
+  ae.trsp = "udp";
+  ae.ua_expire = time(NULL) + 60;
+  RegisterCache::instance()->update(ae.alias, reg_expire, ae);
+}
+
+static bool throttle(const AmSipRequest& req, unsigned int max_ua_expires = 60)
+{
+  RegisterCacheCtx ctx;
+  ctx.min_reg_expires = 3600;
+  ctx.max_ua_expires = max_ua_expires;
+  return RegisterCache::instance()->throttleRegister(ctx, req) && ctx.throttled;
+}
+
+FCTMF_SUITE_BGN(test_regthrottling) {
+
+    FCT_TEST_BGN(regthrottling_forward) {
+      // no transaction to reply to in the tests
+      int orig_log_level = log_level;
+      log_level = L_ERR - 1;
+
+      RegisterCache::dispose();
+      _RegisterCache* cache = RegisterCache::instance();
+      long int now = time(NULL);
+
+      fct_chk(!throttle(register_req(1)));
+      cache_binding(1, now + 3600);
+      fct_chk(throttle(register_req(1)));
+      fct_chk(throttle(register_req(1, ";expires=30")));
+      AliasEntry ae;
+      fct_chk(cache->findAliasEntry("alias1", ae));
+      fct_chk(ae.ua_expire >= now + 30 && ae.ua_expire <= now + 31);
+
+      // de-registration, other source, other contact
+      fct_chk(!throttle(register_req(1, ";expires=0")));
+      AmSipRequest req = register_req(1);
+      req.remote_port++;
+      fct_chk(!throttle(req));
+      req = register_req(1);
+      req.contact = "<sip:user1@10.0.0.2:5062>";
+      fct_chk(!throttle(req));
+      req.contact = "*";
+      fct_chk(!throttle(req));
+
+      // due upstream
+      cache_binding(1, now + 60);
+      fct_chk(!throttle(register_req(1)));
+
+      fct_chk(cache->getThrottleHits() == 2);
+      fct_chk(cache->getThrottleMisses() == 6);
+      fct_chk(cache->getThrottleRefreshes() == 1);
+
+      RegisterCache::dispose();
+      log_level = orig_log_level;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(regthrottling_expires_header) {
+      int orig_log_level = log_level;
+      log_level = L_ERR - 1;
+
+      RegisterCache::dispose();
+      _RegisterCache* cache = RegisterCache::instance();
+      long int now = time(NULL);
+      cache_binding(2, now + 3600);
+
+      // without max_ua_expires, the Expires header is used as it is
+      AmSipRequest req = register_req(2);
+      req.hdrs = "Expires: 120" CRLF;
+      fct_chk(throttle(req, 0));
+      AliasEntry ae;
+      fct_chk(cache->findAliasEntry("alias2", ae));
+      fct_chk(ae.ua_expire >= now + 120 && ae.ua_expire <= now + 121);
+
+      // with it, capped
+      fct_chk(throttle(req, 60));
+      fct_chk(cache->findAliasEntry("alias2", ae));
+      fct_chk(ae.ua_expire >= now + 60 && ae.ua_expire <= now + 61);
+
+      // de-registration
+      req.hdrs = "Expires: 0" CRLF;
+      fct_chk(!throttle(req, 0));
+
+      RegisterCache::dispose();
+      log_level = orig_log_level;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(regthrottling_upstream_load) {
+      int orig_log_level = log_level;
+      log_level = L_ERR - 1;
+
+      RegisterCache::dispose();
+      _RegisterCache* cache = RegisterCache::instance();
+      long int now = time(NULL);
+
+      // UAs re-registering every 60s, each with a binding at the
+      // registrar for 1h, registered at different times
+      for (unsigned int i = 0; i < SIM_UAS; i++)
+	cache_binding(i, now + 1 + i * 3600 / SIM_UAS);
+
+      unsigned int forwarded = 0;
+      for (unsigned int i = 0; i < SIM_UAS; i++) {
+	if (!throttle(register_req(i))) {
+	  forwarded++;
+	  cache_binding(i, now + 3600);
+	}
+      }
+      log_level = orig_log_level;
+
+      fct_chk(forwarded == cache->getThrottleMisses());
+      fct_chk(cache->getThrottleHits() == SIM_UAS - forwarded);
+      fct_chk(cache->getThrottleRefreshes() == forwarded);
+      // those expiring within 64s
+      fct_chk(forwarded >= 63 && forwarded <= 66);
+
+      INFO("%u UAs re-registering every 60s: %u REGISTERs forwarded to the "
+	   "registrar (%.1f%%)\n", SIM_UAS, forwarded, forwarded * 100.0 / SIM_UAS);
+
+      RegisterCache::dispose();
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
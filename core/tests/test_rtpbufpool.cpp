@@ -0,0 +1,110 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmRtpStream.h"
+
+#include "bench.h"
+
+#include <stdio.h>
+
+#define BENCH_CALLS        20000
+#define BENCH_ACTIVE_CALLS 200
+
+static long rss_kb()
+{
+  long size = 0, resident = 0;
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (!f) return 0;
+  if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+    resident = 0;
+  fclose(f);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/** receive some packets into a buffer, as a call would */
+static void use_buffer(PacketMem* m)
+{
+  for (unsigned int i=0; i<MAX_PACKETS; i++) {
+    memset(m->packets[i].getBuffer(), i, 172);
+    m->used[i] = (i & 1);
+  }
+}
+
+/** streams (two per call) set up and torn down, a window of calls active */
+static double bench_calls(unsigned int pool_size, long& rss_growth)
+{
+  PacketMemPool::setMaxSize(pool_size);
+
+  vector<PacketMem*> active(2 * BENCH_ACTIVE_CALLS, (PacketMem*)NULL);
+  long rss_start = rss_kb();
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  for (unsigned int i=0; i<BENCH_CALLS; i++) {
+    for (unsigned int s=0; s<2; s++) {
+      PacketMem*& slot = active[(2 * i + s) % active.size()];
+      PacketMemPool::put(slot);
+      slot = PacketMemPool::get();
+      use_buffer(slot);
+    }
+  }
+  double us = bench_seconds(start) * 1e6;
+  rss_growth = rss_kb() - rss_start;
+
+  for (unsigned int i=0; i<active.size(); i++)
+    PacketMemPool::put(active[i]);
+
+  PacketMemPool::setMaxSize(0);
+  return us / BENCH_CALLS;
+}
+
+FCTMF_SUITE_BGN(test_rtpbufpool) {
+
+    FCT_TEST_BGN(rtpbufpool_disabled) {
+      PacketMemPool::setMaxSize(0);
+      unsigned long long allocated = PacketMemPool::getAllocated();
+      PacketMem* m = PacketMemPool::get();
+      fct_chk(m != NULL);
+      PacketMemPool::put(m);
+      fct_chk(PacketMemPool::getPooled() == 0);
+      fct_chk(PacketMemPool::getAllocated() == allocated + 1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rtpbufpool_reuse) {
+      PacketMemPool::setMaxSize(1);
+      unsigned long long reused = PacketMemPool::getReused();
+
+      PacketMem* m1 = PacketMemPool::get();
+      PacketMem* m2 = PacketMemPool::get();
+      m1->used[3] = true;
+      PacketMemPool::put(m1);
+      // pool is full
+      PacketMemPool::put(m2);
+      fct_chk(PacketMemPool::getPooled() == 1);
+
+      PacketMem* m3 = PacketMemPool::get();
+      fct_chk(m3 == m1);
+      // cleared
+      fct_chk(!m3->used[3]);
+      fct_chk(PacketMemPool::getReused() == reused + 1);
+      fct_chk(PacketMemPool::getPooled() == 0);
+      PacketMemPool::put(m3);
+
+      PacketMemPool::setMaxSize(0);
+      fct_chk(PacketMemPool::getPooled() == 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), rtpbufpool_bench) {
+      long rss_nopool = 0, rss_pool = 0;
+      double us_nopool = bench_calls(0, rss_nopool);
+      double us_pool = bench_calls(2 * BENCH_ACTIVE_CALLS, rss_pool);
+
+      INFO("%u calls, %u active, %lu bytes per stream buffer: "
+	   "setup without pool %.3fus (RSS +%ldkB), "
+	   "with pool %.3fus (RSS +%ldkB)\n",
+	   BENCH_CALLS, BENCH_ACTIVE_CALLS, (unsigned long)sizeof(PacketMem),
+	   us_nopool, rss_nopool, us_pool, rss_pool);
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,223 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmRtpRelayOffload.h"
+#include "AmConfig.h"
+#include "AmUtils.h"
+#include "rtp/rtp.h"
+#include "sip/ip_util.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Relays between two veth pairs in network namespaces:
+ *
+ *   ns A: a0 10.201.1.1 <-> s0 10.201.1.2 :ns S: s1 10.201.2.2 <-> b0 10.201.2.1 :ns B
+ *
+ * Skipped unless running as root with iproute2 installed.
+ */
+
+#define B0_MAC "02:00:0a:c9:02:01"
+
+static string ns_name(const char* n)
+{
+  return string("sems_offload_") + n + "_" + int2str((unsigned int)getpid());
+}
+
+static bool sh(const string& cmd)
+{
+  return system((cmd + " >/dev/null 2>&1").c_str()) == 0;
+}
+
+static bool ns_exec(const char* ns, const string& cmd)
+{
+  return sh("ip netns exec " + ns_name(ns) + " " + cmd);
+}
+
+static void remove_netns()
+{
+  sh("ip netns del " + ns_name("a"));
+  sh("ip netns del " + ns_name("s"));
+  sh("ip netns del " + ns_name("b"));
+}
+
+static bool create_netns()
+{
+  string a = ns_name("a"), s = ns_name("s"), b = ns_name("b");
+  return
+    sh("ip netns add " + a) && sh("ip netns add " + s) && sh("ip netns add " + b) &&
+    sh("ip link add a0 netns " + a + " type veth peer name s0 netns " + s) &&
+    sh("ip link add s1 netns " + s + " type veth peer name b0 netns " + b) &&
+    sh("ip -n " + b + " link set b0 address " B0_MAC) &&
+    sh("ip -n " + a + " addr add 10.201.1.1/24 dev a0") &&
+    sh("ip -n " + s + " addr add 10.201.1.2/24 dev s0") &&
+    sh("ip -n " + s + " addr add 10.201.2.2/24 dev s1") &&
+    sh("ip -n " + b + " addr add 10.201.2.1/24 dev b0") &&
+    sh("ip -n " + a + " link set a0 up") &&
+    sh("ip -n " + s + " link set s0 up") &&
+    sh("ip -n " + s + " link set s1 up") &&
+    sh("ip -n " + b + " link set b0 up") &&
+    // the FIB lookup needs forwarding and a resolved next hop
+    ns_exec("s", "sh -c 'echo 1 > /proc/sys/net/ipv4/ip_forward'") &&
+    sh("ip -n " + s + " neigh replace 10.201.2.1 lladdr " B0_MAC " dev s1 nud permanent");
+}
+
+/** switch this thread to a namespace (NULL: the original one) */
+static bool enter_netns(const char* ns)
+{
+  static int orig_fd = -1;
+  if (orig_fd < 0)
+    orig_fd = open("/proc/self/ns/net", O_RDONLY);
+
+  int fd = ns ? open(("/var/run/netns/" + ns_name(ns)).c_str(), O_RDONLY) : orig_fd;
+  if (fd < 0)
+    return false;
+  bool res = setns(fd, CLONE_NEWNET) == 0;
+  if (ns) close(fd);
+  return res;
+}
+
+static int udp_socket(const char* ns, const char* addr, unsigned short port)
+{
+  if (!enter_netns(ns))
+    return -1;
+
+  int sd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  inet_pton(AF_INET, addr, &sa.sin_addr);
+  if (sd >= 0 && bind(sd, (struct sockaddr*)&sa, sizeof(sa))) {
+    close(sd);
+    sd = -1;
+  }
+
+  struct timeval tv = { 0, 300000 };
+  if (sd >= 0)
+    setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  enter_netns(NULL);
+  return sd;
+}
+
+static void set_addr(struct sockaddr_storage* ss, const char* addr, unsigned short port)
+{
+  memset(ss, 0, sizeof(struct sockaddr_storage));
+  struct sockaddr_in* sa = (struct sockaddr_in*)ss;
+  sa->sin_family = AF_INET;
+  sa->sin_port = htons(port);
+  inet_pton(AF_INET, addr, &sa->sin_addr);
+}
+
+static bool send_rtp(int sd, unsigned char pt, unsigned short seq)
+{
+  unsigned char buf[172];
+  memset(buf, 0, sizeof(buf));
+  rtp_hdr_t* hdr = (rtp_hdr_t*)buf;
+  hdr->version = RTP_VERSION;
+  hdr->pt = pt;
+  hdr->seq = htons(seq);
+  hdr->ts = htonl(seq * 160);
+  hdr->ssrc = htonl(0x11111111);
+
+  struct sockaddr_storage to;
+  set_addr(&to, "10.201.1.2", 30000);
+  return sendto(sd, buf, sizeof(buf), 0, (struct sockaddr*)&to, sizeof(struct sockaddr_in))
+    == sizeof(buf);
+}
+
+FCTMF_SUITE_BGN(test_rtpoffload) {
+
+    FCT_TEST_BGN(rtpoffload_veth) {
+      if (getuid() != 0 || !sh("ip netns list")) {
+	INFO("not root or no iproute2, skipping RTP relay offload test\n");
+      } else if (!create_netns()) {
+	INFO("could not create network namespaces, skipping RTP relay offload test\n");
+	remove_netns();
+      } else {
+	int a_sd = udp_socket("a", "10.201.1.1", 20000);
+	int b_sd = udp_socket("b", "10.201.2.1", 40000);
+	fct_chk(a_sd >= 0);
+	fct_chk(b_sd >= 0);
+
+	bool orig_offload = AmConfig::RtpRelayOffload;
+	AmConfig::RtpRelayOffload = true;
+
+	AmRtpRelayOffloadRule rule;
+	set_addr(&rule.local, "10.201.1.2", 30000);
+	set_addr(&rule.expect_src, "10.201.1.1", 20000);
+	set_addr(&rule.src, "10.201.2.2", 30002);
+	set_addr(&rule.dst, "10.201.2.1", 40000);
+	rule.rewrite_ssrc = true;
+	rule.ssrc = 0x22222222;
+	rule.check_payloads = true;
+	rule.payloads[0] = 1ULL << 8; // PCMA only
+
+	enter_netns("s");
+	unsigned int ifindex = if_nametoindex("s0");
+	bool added = ifindex && AmRtpRelayOffload::instance()->addRule(ifindex, rule);
+	enter_netns(NULL);
+
+	if (!added) {
+	  INFO("XDP not available, skipping RTP relay offload test\n");
+	} else {
+	  fct_chk(AmRtpRelayOffload::instance()->getActiveRules() == 1);
+
+	  unsigned char buf[512];
+	  struct sockaddr_storage from;
+	  socklen_t from_len = sizeof(from);
+
+	  // relayed in the kernel
+	  fct_chk(send_rtp(a_sd, 8, 1));
+	  ssize_t len = recvfrom(b_sd, buf, sizeof(buf), 0, (struct sockaddr*)&from, &from_len);
+	  fct_chk(len == 172);
+	  if (len == 172) {
+	    rtp_hdr_t* hdr = (rtp_hdr_t*)buf;
+	    fct_chk(ntohl(hdr->ssrc) == 0x22222222);
+	    fct_chk(ntohs(hdr->seq) == 1);
+	    fct_chk(get_addr_str(&from) == "10.201.2.2");
+	    fct_chk(am_get_port(&from) == 30002);
+	  }
+
+	  unsigned long long packets = 0, bytes = 0;
+	  fct_chk(AmRtpRelayOffload::instance()->getCounters(&rule.local, packets, bytes));
+	  fct_chk(packets == 1);
+	  fct_chk(bytes == 172);
+
+	  // other payload types are passed up
+	  fct_chk(send_rtp(a_sd, 101, 2));
+	  fct_chk(recv(b_sd, buf, sizeof(buf), 0) < 0);
+	  fct_chk(AmRtpRelayOffload::instance()->getCounters(&rule.local, packets, bytes));
+	  fct_chk(packets == 1);
+
+	  unsigned long long relayed = AmRtpRelayOffload::instance()->getRelayedPackets();
+	  AmRtpRelayOffload::instance()->removeRule(&rule.local);
+	  fct_chk(AmRtpRelayOffload::instance()->getActiveRules() == 0);
+	  fct_chk(AmRtpRelayOffload::instance()->getRelayedPackets() == relayed + 1);
+	  fct_chk(!AmRtpRelayOffload::instance()->getCounters(&rule.local, packets, bytes));
+
+	  // and nothing after the rule is removed
+	  fct_chk(send_rtp(a_sd, 8, 3));
+	  fct_chk(recv(b_sd, buf, sizeof(buf), 0) < 0);
+	}
+
+	AmRtpRelayOffload::dispose();
+	AmConfig::RtpRelayOffload = orig_offload;
+
+	if (a_sd >= 0) close(a_sd);
+	if (b_sd >= 0) close(b_sd);
+	remove_netns();
+      }
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
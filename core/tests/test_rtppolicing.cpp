@@ -0,0 +1,198 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmAppTimer.h"
+#include "AmSdp.h"
+#include "../../apps/sbc/RtpPolicer.h"
+
+#include "bench.h"
+
+#include <string.h>
+
+#define BENCH_PACKETS 5000000
+
+static volatile unsigned int relayed;
+
+static const char* test_sdp =
+  "v=0\r\n"
+  "o=- 1 1 IN IP4 192.0.2.1\r\n"
+  "s=-\r\n"
+  "c=IN IP4 192.0.2.1\r\n"
+  "t=0 0\r\n"
+  "m=audio 10000 RTP/AVP 8 101\r\n"
+  "a=rtpmap:8 PCMA/8000\r\n"
+  "a=rtpmap:101 telephone-event/8000\r\n"
+  "m=video 10002 RTP/AVP 96\r\n"
+  "a=rtpmap:96 H264/90000\r\n";
+
+/** send 'pps' packets per second for 'secs' seconds, @return packets dropped */
+static unsigned int send_packets(RtpPolicer& p, unsigned int ssrc, unsigned char pt,
+				 unsigned int size, unsigned int pps, unsigned int secs)
+{
+  // wall_clock ticks every 20ms
+  u_int32_t start = AmAppTimer::instance()->wall_clock;
+  unsigned int dropped = 0;
+  for (unsigned int i = 0; i < pps * secs; i++) {
+    AmAppTimer::instance()->wall_clock = start + i * 50 / pps;
+    if (p.police(ssrc, pt, size)) dropped++;
+  }
+  AmAppTimer::instance()->wall_clock = start + secs * 50;
+  return dropped;
+}
+
+/** renegotiates the same caps over and over, like re-INVITEs */
+class ReInviteThread
+  : public AmThread
+{
+  RtpPolicer& p;
+  const AmSdp& sdp;
+  volatile bool stop_requested;
+
+public:
+  ReInviteThread(RtpPolicer& p, const AmSdp& sdp)
+    : p(p), sdp(sdp), stop_requested(false) {}
+
+  void run() {
+    while (!stop_requested)
+      p.setCaps(sdp, sdp);
+  }
+  void on_stop() {}
+  void stop_loop() { stop_requested = true; }
+};
+
+static double bench(RtpPolicer* p, DynRateLimit* mutex_limit)
+{
+  unsigned char pkt[172], out[172];
+  memset(pkt, 0, sizeof(pkt));
+  AmMutex m;
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  for (unsigned int i = 0; i < BENCH_PACKETS; i++) {
+    // refill the buckets
+    if (!(i & 1023))
+      AmAppTimer::instance()->wall_clock += 51;
+    if (p && p->police(0x1000 + (i & 3), 8, sizeof(pkt)))
+      continue;
+    if (mutex_limit) {
+      // a mutex per packet, as before
+      m.lock();
+      bool drop = mutex_limit->limit(1000000000, 1000000000, sizeof(pkt));
+      m.unlock();
+      if (drop) continue;
+    }
+    pkt[2] = i & 0xff;
+    memcpy(out, pkt, sizeof(pkt));
+    relayed += out[2];
+  }
+  return BENCH_PACKETS / bench_seconds(start) / 1e6;
+}
+
+FCTMF_SUITE_BGN(test_rtppolicing) {
+
+    FCT_TEST_BGN(rtppolicing_bitrates) {
+      fct_chk(RtpPolicer::getBitrate(SdpPayload(8, "PCMA", 8000, 0)) == 64);
+      fct_chk(RtpPolicer::getBitrate(SdpPayload(18, "g729", 8000, 0)) == 8);
+      fct_chk(RtpPolicer::getBitrate(SdpPayload(97, "G726-32", 8000, 0)) == 32);
+      fct_chk(RtpPolicer::getBitrate(SdpPayload(98, "L16", 16000, 2)) == 512);
+      SdpPayload opus(111, "opus", 48000, 2);
+      fct_chk(RtpPolicer::getBitrate(opus) == 0);
+      opus.sdp_format_parameters = "useinbandfec=1;maxaveragebitrate=24000";
+      fct_chk(RtpPolicer::getBitrate(opus) == 24);
+      fct_chk(RtpPolicer::getBitrate(SdpPayload(96, "H264", 90000, 0)) == 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rtppolicing_police) {
+      u_int32_t orig_clock = AmAppTimer::instance()->wall_clock;
+      AmAppTimer::instance()->wall_clock = 100000;
+
+      RtpPolicingCounters* c = RtpPolicingStats::instance()->get("test_rtppolicing");
+      RtpPolicer p(50, c);
+
+      // nothing negotiated yet
+      fct_chk(!p.police(1, 0, 172));
+
+      AmSdp sdp;
+      fct_req(sdp.parse(test_sdp) == 0);
+      p.setCaps(sdp, sdp);
+
+      // not negotiated
+      fct_chk(p.police(1, 0, 172));
+      fct_chk(c->unknown_payload.get() == 1);
+
+      // PCMA at 20ms, two streams
+      fct_chk(send_packets(p, 1, 8, 172, 50, 3) == 0);
+      fct_chk(send_packets(p, 2, 8, 172, 50, 3) == 0);
+      fct_chk(c->dropped_packets.get() == 0);
+
+      // 4 times as much: about (8000 + 1200) * 1.5 bytes/s pass
+      unsigned int dropped = send_packets(p, 1, 8, 172, 200, 3);
+      fct_chk(dropped >= 250 && dropped <= 450);
+      fct_chk(c->dropped_packets.get() == dropped);
+      fct_chk(c->dropped_bytes.get() == dropped * 172);
+
+      // video is not policed
+      fct_chk(send_packets(p, 3, 96, 1200, 1000, 1) == 0);
+
+      // more streams than slots
+      for (unsigned int ssrc = 10; ssrc < 10 + RTP_POLICER_SLOTS; ssrc++)
+	fct_chk(!p.police(ssrc, 101, 20));
+
+      // a re-INVITE without PCMA
+      AmSdp sdp2;
+      fct_req(sdp2.parse(test_sdp) == 0);
+      sdp2.media[0].payloads.erase(sdp2.media[0].payloads.begin());
+      p.setCaps(sdp2, sdp2);
+      fct_chk(p.police(1, 8, 172));
+      fct_chk(!p.police(1, 101, 20));
+
+      AmArg report;
+      RtpPolicingStats::instance()->getReport(report);
+      fct_chk(report.hasMember("test_rtppolicing"));
+      fct_chk(report["test_rtppolicing"]["unknown_payload"].asLongLong() == 2);
+
+      AmAppTimer::instance()->wall_clock = orig_clock;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rtppolicing_reinvite) {
+      RtpPolicingCounters* c =
+	RtpPolicingStats::instance()->get("test_rtppolicing_reinvite");
+      RtpPolicer p(1000, c);
+
+      AmSdp sdp;
+      fct_req(sdp.parse(test_sdp) == 0);
+      p.setCaps(sdp, sdp);
+
+      // negotiated payload types are never seen as unknown
+      ReInviteThread t(p, sdp);
+      t.start();
+      for (unsigned int i = 0; i < 1000000; i++)
+	p.police(1, (i & 1) ? 8 : 101, 20);
+      t.stop_loop();
+      t.join();
+
+      fct_chk(c->unknown_payload.get() == 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN_IF(bench_enabled(), rtppolicing_bench) {
+      u_int32_t orig_clock = AmAppTimer::instance()->wall_clock;
+      AmAppTimer::instance()->wall_clock = 100000;
+
+      RtpPolicer p(1000, NULL);
+      AmSdp sdp;
+      fct_req(sdp.parse(test_sdp) == 0);
+      p.setCaps(sdp, sdp);
+      DynRateLimit limit(1000);
+
+      double off = bench(NULL, NULL);
+      double on = bench(&p, NULL);
+      double mutex = bench(NULL, &limit);
+
+      INFO("RTP relay: %.1f Mpps without policing, %.1f Mpps with policing, "
+	   "%.1f Mpps with a mutex per packet\n", off, on, mutex);
+
+      AmAppTimer::instance()->wall_clock = orig_clock;
+    } FCT_TEST_END_IF();
+
+} FCTMF_SUITE_END();
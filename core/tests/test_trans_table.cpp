@@ -0,0 +1,150 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmUtils.h"
+
+#include "sip/trans_table.h"
+#include "sip/sip_parser.h"
+#include "sip/sip_trans.h"
+#include "sip/parse_cseq.h"
+#include "sip/trans_pacer.h"
+#include "sip/ip_util.h"
+
+#include <vector>
+using std::vector;
+
+#include <sys/time.h>
+
+#define STORM_SIZE 20000
+
+static sip_msg* make_register(unsigned int n)
+{
+  string buf =
+    "REGISTER sip:example.org SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bK" + int2str(n) + "\r\n"
+    "From: <sip:user" + int2str(n) + "@example.org>;tag=" + int2str(n) + "\r\n"
+    "To: <sip:user" + int2str(n) + "@example.org>\r\n"
+    "Call-ID: " + int2str(n) + "-storm@10.0.0.1\r\n"
+    "CSeq: " + int2str(n % 100 + 1) + " REGISTER\r\n"
+    "Contact: <sip:user" + int2str(n) + "@10.0.0.1>\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+
+  sip_msg* msg = new sip_msg(buf.c_str(), buf.length());
+  char* err_msg = NULL;
+  if(parse_sip_msg(msg, err_msg)) {
+    delete msg;
+    return NULL;
+  }
+  return msg;
+}
+
+static trans_bucket* msg_bucket(sip_msg* msg)
+{
+  return get_trans_bucket(msg->callid->value, get_cseq(msg)->num_str);
+}
+
+FCTMF_SUITE_BGN(test_trans_table) {
+
+    FCT_TEST_BGN(trans_table_register_storm) {
+      trans_table_stats ts;
+      get_trans_table_stats(ts);
+      unsigned long before = ts.transactions;
+
+      // the table is allocated only once
+      fct_chk(init_trans_table(H_TABLE_POWER) < 0);
+
+      // keep the per-message debug output of the matching code quiet
+      int old_log_level = log_level;
+      log_level = L_WARN;
+
+      struct timeval start, end, diff;
+      gettimeofday(&start, NULL);
+
+      vector<sip_trans*> transactions;
+      for(unsigned int i=0; i<STORM_SIZE; i++) {
+	sip_msg* msg = make_register(i);
+	fct_req(msg != NULL);
+
+	trans_bucket* bucket = msg_bucket(msg);
+	bucket->lock();
+	transactions.push_back(bucket->add_trans(msg, TT_UAS));
+	bucket->unlock();
+      }
+
+      get_trans_table_stats(ts);
+      fct_chk(ts.transactions == before + STORM_SIZE);
+      fct_chk(ts.used_buckets <= ts.buckets);
+      fct_chk(ts.max_bucket_len * ts.used_buckets >= STORM_SIZE);
+
+      // retransmissions hit the existing transactions
+      unsigned int matched = 0;
+      for(unsigned int i=0; i<STORM_SIZE; i++) {
+	sip_msg* msg = make_register(i);
+	fct_req(msg != NULL);
+
+	trans_bucket* bucket = msg_bucket(msg);
+	bucket->lock();
+	if(bucket->match_request(msg, TT_UAS) == transactions[i])
+	  matched++;
+	bucket->unlock();
+	delete msg;
+      }
+      fct_chk(matched == STORM_SIZE);
+
+      for(unsigned int i=0; i<STORM_SIZE; i++) {
+	trans_bucket* bucket = msg_bucket(transactions[i]->msg);
+	bucket->lock();
+	bucket->remove(transactions[i]);
+	bucket->unlock();
+      }
+
+      gettimeofday(&end, NULL);
+      timersub(&end, &start, &diff);
+      log_level = old_log_level;
+      DBG("%u transactions added/matched/removed in %lu.%06lus "
+	  "(%lu buckets, max. bucket length %lu)\n",
+	  STORM_SIZE, diff.tv_sec, diff.tv_usec,
+	  ts.buckets, ts.max_bucket_len);
+
+      get_trans_table_stats(ts);
+      fct_chk(ts.transactions == before);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(trans_pacer_limits) {
+      sockaddr_storage dst1, dst2;
+      memset(&dst1, 0, sizeof(dst1));
+      memset(&dst2, 0, sizeof(dst2));
+      fct_req(am_inet_pton("10.0.0.1", &dst1) > 0);
+      fct_req(am_inet_pton("10.0.0.2", &dst2) > 0);
+      am_set_port(&dst1, 5060);
+      am_set_port(&dst2, 5060);
+
+      trans_pacer::instance()->set_max_dest_rate(2);
+      trans_pacer::instance()->set_max_rate(3);
+      unsigned int paced = trans_pacer::instance()->get_paced_retrans();
+
+      fct_chk(trans_pacer::instance()->check(&dst1) == 0);
+      fct_chk(trans_pacer::instance()->check(&dst1) == 0);
+      // per destination limit
+      fct_chk(trans_pacer::instance()->check(&dst1) > 0);
+      fct_chk(trans_pacer::instance()->check(&dst2) == 0);
+      // global limit
+      fct_chk(trans_pacer::instance()->check(&dst2) > 0);
+      fct_chk(trans_pacer::instance()->get_paced_retrans() == paced + 2);
+
+      trans_pacer::instance()->set_max_dest_rate(0);
+      trans_pacer::instance()->set_max_rate(0);
+      fct_chk(trans_pacer::instance()->check(&dst1) == 0);
+
+      fct_chk(trans_pacer::instance()->add_jitter(500) == 500);
+      trans_pacer::instance()->set_jitter(20);
+      for(int i=0; i<100; i++) {
+	unsigned int t = trans_pacer::instance()->add_jitter(500);
+	fct_chk(t >= 500 && t <= 600);
+      }
+      trans_pacer::instance()->set_jitter(0);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
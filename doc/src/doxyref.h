@@ -118,7 +118,7 @@ On top of that, you save lots of memory (mostly the stack memory), also, because
       them on the network (you can check this with your OS, for newer Linux in 
       /proc, check dropped packets on send for the SIP port)
     - there is contention on some mutexes
-      -> adapt EVENT_DISPATCHER_POWER in AmEventDispatcher.h
+      -> raise event_dispatcher_shards in sems.conf
       -> add striping for some other Mutexes
   </p>
  */